@@ -0,0 +1,99 @@
+#pragma once
+
+#include <arch/x86/instructions.h>
+#include <asmoutput.h>
+#include <core.h>
+#include <objectfile.h>
+
+/**
+ * @brief   Encodes the instructions of GeneratorX86 directly into an ELF32
+ *          object, so no external assembler has to run. It understands the
+ *          (NASM style) operands the generator produces, not assembly files.
+ */
+class AssemblerX86 : public AsmOutput
+{
+  private:
+    enum OperandKinds
+    {
+        OP_NONE,
+        OP_REG,
+        OP_IMM,
+        OP_MEM,
+        OP_SYM      // A bare symbol, jump and call targets
+    };
+
+    struct Operand
+    {
+        int     kind = OP_NONE;
+        int     size = 0;       // In bytes, 0 if not known (yet)
+        int     reg  = -1;      // OP_REG: the register, OP_MEM: the base
+        int32_t disp = 0;       // Immediate or displacement
+        string  symbol;         // Symbol the immediate or address is relative to
+    };
+
+    struct Label
+    {
+        int      section;
+        uint32_t offset;
+        bool     local;         // A '.' label, scoped to the previous label
+    };
+
+    /* A 32 bit field that refers to a symbol, resolved when closing */
+    struct Fixup
+    {
+        int      section;
+        uint32_t offset;
+        string   symbol;
+        bool     relative;
+    };
+
+    ObjectFile                    m_obj;
+    string                        m_path;
+    int                           m_text;
+    int                           m_data;
+    int                           m_cur;
+    string                        m_scope;      // Last non-local label
+    unordered_map<string, Label>  m_labels;
+    vector<string>                m_labelOrder;
+    vector<string>                m_globals;
+    vector<Fixup>                 m_fixups;
+
+  private:
+    vector<uint8_t> &bytes() { return m_obj.section(m_cur).bytes; }
+    uint32_t         offset() { return bytes().size(); }
+
+    void    emit8(uint8_t b);
+    void    emit16(uint16_t w);
+    void    emit32(uint32_t d);
+    void    emitRef(const string &symbol, int32_t addend, bool relative);
+    void    emitModRM(int regField, const Operand &rm);
+    void    emitImm(const Operand &imm, int size);
+
+    string  qualify(const string &name);
+    Operand parseOperand(string text);
+    Operand operand(const X86Operand &x);
+
+    void encode(int op, int cond, Operand &dest, Operand &src);
+    void encodeAlu(int ext, Operand &dest, Operand &src);
+    void encodeMov(Operand &dest, Operand &src);
+    void encodeUnary(uint8_t opcode, int ext, Operand &dest);
+    void encodeShift(int ext, Operand &dest, Operand &src);
+    void encodeJump(int cond, const Operand &target);
+
+  public:
+    AssemblerX86(const string &path, const string &sourceFile);
+
+    void section(const string &name);
+    void global(const string &name);
+    void externSymbol(const string &name);
+    void label(StringView name);
+    void instruction(StringView op, StringView dest = StringView(),
+                     StringView src = StringView());
+    void instruction(const X86Instr &instr);
+    void data(int size, const vector<string> &values);
+    void zeros(int size, int count);
+    void close();
+
+    ObjectFile &finish();
+    ObjectFile &object() { return m_obj; }
+};
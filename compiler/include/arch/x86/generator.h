@@ -1,57 +1,54 @@
 #pragma once
 
+#include <arch/x86/instructions.h>
 #include <core.h>
 #include <generator.h>
 
-#define EAX       0
-#define EBX       1
-#define ECX       2
-#define EDX       3
-#define REGAMOUNT 4
-
-#define MEMACCESS(symbol) "[" + symbol + "]"
-#define LABEL(label)      ".L" + to_string(label)
 #define SPECIFYSIZE(r)    m_sizeSpecifiers[r - 1]
 class GeneratorX86 : public Generator
 {
 
   private:
-    string m_dwordRegisters[4]  = {"eax", "ebx", "ecx", "edx"};
-    string m_wordRegisters[4]   = {"ax", "bx", "cx", "dx"};
-    string m_loByteRegisters[4] = {"al", "bl", "cl", "dl"};
-    string m_hiByteRegisters[4] = {"ah", "bh", "ch", "dh"};
-    
-    string  m_sizeSpecifiers[4] = {"dword", "word", "byte", "byte"};
-    string *m_registers[4]      = {m_dwordRegisters, m_wordRegisters,
-                                    m_hiByteRegisters, m_loByteRegisters};
-    
-    int m_spilledRegisters = 0;
+    /* Operand sizes of the register classes */
+    const int m_sizeSpecifiers[4] = {4, 2, 1, 1};
 
-    /* These are 0 if unused, otherwise indexes (-1) to m_registers */
-    int m_usedRegisters[4];
-    
-    string m_initDataSize[4] = {"db", "dw", "dd", "dq"};
+    /* The virtual registers of the function, 0 if unused, otherwise the
+     * class the register is used as: 1 dword, 2 word, 4 byte */
+    vector<int> m_usedRegisters;
+    int         m_firstUsed = 0;    // The ones before are all free
+
+    /* Locals that live in a virtual register of their own */
+    unordered_map<SymbolId, int> m_promoted;
 
+    /* The code of the function that is being generated */
+    X86Code m_code;
+    int     m_frameInstr;           // The sub that makes room for locals
+    int     m_frameSize;
+    
 private:
     void freeAllReg();
     int  allocReg();
-    int  allocReg(int r);
-    void spillReg(int r);
-    void loadReg(int r);
-    string getReg(int r);
-    bool hasFreeReg();
+    X86Operand getReg(int r);
+    X86Operand dwordReg(int r);
+    X86Operand loByteReg(int r);
+    X86Operand memAt(int r, int32_t disp = 0, int size = 0);
+    X86Operand variableReg(SymbolId symbol);
+    int        stepVariable(const X86Operand &var, int amount, bool after);
 
-    int checkRegisters();
-    int spillAmount();
-    int genLoadRegisters(vector <int> data);
+    void emit(int op, const X86Operand &dest = X86Operand(),
+              const X86Operand &src = X86Operand());
+    void emitCond(int op, int cond, const X86Operand &dest);
+    void move(const X86Operand &dest, const X86Operand &src);
+    void allocateRegisters();
+    void flushCode();
 
   protected:
     int genLoad(int val, int size);
     int genAdd(int reg1, int reg2);
     int genSub(int reg1, int reg2);
     int genMul(int reg1, int reg2);
-    int genIncrement(int sym, int amount, int after);
-    int genDecrement(int sym, int amount, int after);
+    int genIncrement(SymbolId sym, int amount, int after);
+    int genDecrement(SymbolId sym, int amount, int after);
     int genLeftShift(int reg1, int amount);
     int genRightShift(int reg1, int amount);
     
@@ -64,8 +61,9 @@ private:
     int genXor(int reg1, int reg2);
     
 
-    int genLoadVariable(int symbolidx, Type t);
-    int genStoreValue(int reg, int memloc, Type t);
+    int genLoadVariable(SymbolId symbolidx, const Type &t);
+    int genStoreValue(int reg, SymbolId memloc, const Type &t);
+    int genStoreVariable(int reg, SymbolId symbol, const Type &t);
 
     int genCompare(int reg1, int reg2, bool clear=true);
     int genCompareSet(int op, int reg1, int reg2);
@@ -73,15 +71,15 @@ private:
 
     int genJump(int label);
     int genLabel(int label);
-    int genLabel(string label);
-    int genGoto(string label);
+    int genLabel(Atom label);
+    int genGoto(Atom label);
     int genWidenRegister(int reg, int oldsize, int newsize, bool isSigned);
     int genPushArgument(int reg, int argindex);
-    int genFunctionCall(int symbolidx, int parameters, vector<int> data);
-    int genReturnJump(int reg, int funcIdx);
-    int genLoadLocation(int symbolidx);
+    int genFunctionCall(SymbolId symbolidx, int parameters, vector<int> data);
+    int genReturnJump(int reg, SymbolId funcIdx);
+    int genLoadLocation(SymbolId symbolidx);
     int genPtrAccess(int reg, int size);
-    int genDirectMemLoad(int offset, int symbol, int reg, int size);
+    int genDirectMemLoad(int offset, SymbolId symbol, int reg, int size);
     int genNegate(int reg);
     int genAccessStruct(int memreg, int idx, int size);
     int genBinNegate(int reg);
@@ -94,11 +92,11 @@ private:
     vector<int> genSaveRegisters();
     
   public:
-    GeneratorX86(string);
+    GeneratorX86(CompilationContext &ctx, AsmOutput *out);
     void genDebugComment(string);
     int  genDataSection();
     int  genExternSection();
 
-    int genFunctionPreamble(int funcInx);
-    int genFunctionPostamble(int funcIdx);
+    int genFunctionPreamble(SymbolId funcInx);
+    int genFunctionPostamble(SymbolId funcIdx);
 };
\ No newline at end of file
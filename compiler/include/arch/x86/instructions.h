@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atoms.h>
+#include <core.h>
+#include <stringview.h>
+
+class AsmOperand;
+class AsmOutput;
+
+/* Registers in the order the CPU numbers them. Byte operands use 4-7 for
+ * ah, ch, dh and bh. The generator numbers the values it computes from
+ * X86_VREG on, the register allocator gives them real registers. */
+enum X86Registers
+{
+    X86_EAX, X86_ECX, X86_EDX, X86_EBX, X86_ESP, X86_EBP, X86_ESI, X86_EDI,
+    X86_VREG
+};
+
+enum X86Opcodes
+{
+    /* The arithmetic group, in the order of their /digit */
+    X86_ADD, X86_OR, X86_ADC, X86_SBB, X86_AND, X86_SUB, X86_XOR, X86_CMP,
+
+    X86_MOV, X86_MOVZX, X86_MOVSX, X86_LEA,
+    X86_TEST, X86_NOT, X86_NEG, X86_MUL, X86_IMUL, X86_DIV, X86_IDIV,
+    X86_INC, X86_DEC, X86_SHL, X86_SHR, X86_SAR,
+    X86_PUSH, X86_POP,
+    X86_JMP, X86_JCC, X86_CALL, X86_RET, X86_SETCC, X86_INT,
+    X86_LEAVE, X86_CDQ, X86_CWDE, X86_NOP, X86_HLT,
+
+    /* Pseudo instructions, they don't become machine code */
+    X86_LABEL,      // Places the label or symbol of dest
+    X86_COMMENT,    // Comment number dest.disp of the X86Code
+};
+
+/* Condition codes of jcc and setcc */
+enum X86Conditions
+{
+    X86_CC_E = 4, X86_CC_NE = 5, X86_CC_L = 12, X86_CC_GE = 13,
+    X86_CC_LE = 14, X86_CC_G = 15
+};
+
+/**
+ * @brief   An operand of an X86Instr. Symbols are atoms of the active
+ *          compilation, labels the numbers the generator hands out (.L<n>)
+ *          or, for goto labels, an atom (.<name>).
+ */
+struct X86Operand
+{
+    enum Kinds
+    {
+        NONE,
+        REG,
+        IMM,
+        MEM,        // [reg+disp] or [symbol+disp]
+        SYMBOL,     // Call targets and addresses of globals
+        LABEL,
+    };
+
+    uint8_t kind   = NONE;
+    uint8_t size   = 0;         // In bytes, 0 if the other operand decides
+    int32_t reg    = -1;        // REG: the register, MEM: the base or -1
+    int32_t disp   = 0;         // IMM: the value, MEM: the displacement
+    int     label  = -1;        // LABEL: the number, -1 for a goto label
+    Atom    symbol = NOATOM;
+
+    static X86Operand regOp(int reg, int size = 4);
+    static X86Operand imm(int32_t value);
+    static X86Operand mem(int base, int32_t disp = 0, int size = 0);
+    static X86Operand global(Atom symbol, int32_t disp = 0, int size = 0);
+    static X86Operand symbolOp(Atom symbol);
+    static X86Operand labelOp(int label);
+    static X86Operand gotoLabel(Atom name);
+
+    static bool parseRegister(StringView name, int &reg, int &size);
+
+    bool is(int kind) const { return this->kind == kind; }
+    bool isReg(int reg) const { return kind == REG && this->reg == reg; }
+    bool isVirtual() const { return reg >= X86_VREG; }
+    void format(AsmOperand &out) const;
+
+    bool operator==(const X86Operand &other) const;
+    bool operator!=(const X86Operand &other) const { return !(*this == other); }
+};
+
+/* One instruction, operands in NASM order (destination first) */
+struct X86Instr
+{
+    uint8_t    op;
+    uint8_t    cond = 0;        // X86_JCC and X86_SETCC only
+    X86Operand dest;
+    X86Operand src;
+
+    X86Instr(int op, const X86Operand &dest = X86Operand(),
+             const X86Operand &src = X86Operand())
+        : op(op), dest(dest), src(src)
+    {
+    }
+
+    void               mnemonic(AsmOperand &out) const;
+    static const char *name(int op);
+    static bool        parseMnemonic(StringView name, int &op, int &cond);
+};
+
+/**
+ * @brief   The instructions of the function that is being generated. Code
+ *          stays here until the function is complete, so passes can still
+ *          change it, and is then lowered to the output: NASM text or
+ *          machine code straight from the structured form.
+ */
+class X86Code
+{
+  private:
+    vector<X86Instr> m_instrs;
+    vector<string>   m_comments;
+
+  public:
+    void add(const X86Instr &instr) { m_instrs.push_back(instr); }
+    void comment(const string &text);
+
+    vector<X86Instr> &instrs() { return m_instrs; }
+    bool              empty() { return m_instrs.empty(); }
+
+    void lower(AsmOutput &out);
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <core.h>
+#include <elf.h>
+
+#include <deque>
+
+/**
+ * @brief   Links i386 ELF objects into an executable. Symbols the objects
+ *          don't define are imported from the shared libc, calls to them go
+ *          through a small PLT. If nothing has to be imported the result is a
+ *          static executable.
+ *
+ *          The startup code (_start) is generated here as well, unless one of
+ *          the objects brings its own.
+ */
+class LinkerX86
+{
+  private:
+    struct InputObject
+    {
+        string            name;
+        string            data;
+        const Elf32_Shdr *sections;
+        int               sectionCount;
+        const Elf32_Sym  *symbols;
+        int               symbolCount;
+        const char       *strtab;
+        vector<int>       placement;    // Input section -> m_placements index
+    };
+
+    /* Where an input section ends up */
+    struct Placement
+    {
+        int      object;
+        int      section;
+        int      out;
+        uint32_t offset;
+    };
+
+    struct Definition
+    {
+        int object;
+        int symbol;
+    };
+
+    struct Import
+    {
+        string   name;
+        int      type;          // STT_FUNC or STT_OBJECT, as libc says
+        bool     plt = false;   // Called, so it needs a PLT entry
+        uint32_t pltAddr = 0;
+        uint32_t gotAddr = 0;
+    };
+
+    /* Output sections in file order, RW ones from DYNAMIC on */
+    enum OutputSections
+    {
+        OUT_INTERP,
+        OUT_HASH,
+        OUT_DYNSYM,
+        OUT_DYNSTR,
+        OUT_RELDYN,
+        OUT_PLT,
+        OUT_TEXT,
+        OUT_RODATA,
+        OUT_DYNAMIC,
+        OUT_GOT,
+        OUT_DATA,
+        OUT_BSS,
+        OUT_COUNT
+    };
+
+    struct OutputSection
+    {
+        const char *name;
+        uint32_t    type;
+        uint32_t    flags;
+        uint32_t    align;
+        string      bytes;
+        uint32_t    size = 0;       // bytes.size(), except for .bss
+        uint32_t    offset = 0;
+        uint32_t    addr = 0;
+    };
+
+    vector<string>                     m_libraryDirs;
+    deque<InputObject>                 m_objects;
+    vector<Placement>                  m_placements;
+    unordered_map<string, Definition>  m_globals;
+    unordered_map<string, uint32_t>    m_commons;   // Name -> .bss offset
+    vector<Import>                     m_imports;
+    unordered_map<string, int>         m_importIndex;
+    vector<Elf32_Rel>                  m_dynRelocs;
+    int                                m_absImportRefs = 0;
+    bool                               m_textRelocs = false;
+    OutputSection                      m_out[OUT_COUNT];
+
+    /* The two loaded segments, read/execute and read/write */
+    uint32_t                           m_rxSize;
+    uint32_t                           m_rwOffset;
+    uint32_t                           m_rwAddr;
+    uint32_t                           m_rwFileSize;
+    uint32_t                           m_rwMemSize;
+
+  private:
+    void     addStartup();
+    void     findImports();
+    void     readLibc(unordered_map<string, int> &exports);
+    void     placeSections();
+    void     buildDynamic();
+    void     layout(int phnum);
+    void     fillDynamic();
+    void     finishRelocations();
+    uint32_t symbolAddress(int object, int symbol, int &import);
+    void     relocate();
+    string   writeExecutable(int phnum, uint32_t entry);
+
+    const char *symbolName(const InputObject &obj, int symbol);
+
+  public:
+    LinkerX86();
+
+    void addLibraryDir(const string &dir);
+    void addObject(const string &name, string &&data);
+    void addObject(const string &path);
+    void link(const string &output);
+};
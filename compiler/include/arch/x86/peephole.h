@@ -0,0 +1,42 @@
+#pragma once
+
+#include <arch/x86/instructions.h>
+#include <core.h>
+
+/**
+ * @brief   Rewrites short sequences of a function's X86Code into shorter
+ *          ones. Every pattern of the table in peephole.cpp has the lowest
+ *          optimization level it runs at, the passes repeat until none of
+ *          them applies anymore.
+ *
+ *          Patterns that drop a register or the flags ask the liveness
+ *          computed at the start of the pass. A rewrite only changes it
+ *          inside the instructions it matched, so the rest of the pass can
+ *          keep using it.
+ */
+class PeepholeX86
+{
+  private:
+    vector<X86Instr> &m_instrs;
+    int               m_level;
+
+    vector<uint16_t> m_liveOut;    // Registers and flags live after each
+    vector<bool>     m_removed;
+    vector<bool>     m_targeted;   // Labels some jump goes to
+
+  private:
+    void computeLiveness();
+    bool pass();
+
+  public:
+    PeepholeX86(X86Code &code, int level);
+
+    int  next(int i, bool labels = false);
+    bool dead(int i, const X86Operand &reg);
+    bool flagsDead(int i);
+    void remove(int i) { m_removed[i] = true; }
+
+    X86Instr &operator[](int i) { return m_instrs[i]; }
+
+    int run();
+};
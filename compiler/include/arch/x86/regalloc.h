@@ -0,0 +1,55 @@
+#pragma once
+
+#include <arch/x86/instructions.h>
+#include <core.h>
+
+/**
+ * @brief   Linear scan register allocation over the X86Code of a function.
+ *          The generator computes its values in virtual registers (X86_VREG
+ *          and up), every one of them gets a live interval from a dataflow
+ *          liveness over the function. Going through them in the order they
+ *          start, each gets one of eax, ecx, edx, ebx, esi and edi that no
+ *          other interval holds and that the code doesn't need for itself
+ *          meanwhile (eax and edx of idiv, cl of a shift, what a call
+ *          overwrites).
+ *
+ *          When no register is left the interval that lives longest goes to
+ *          a stack slot: every instruction that uses it gets a new virtual
+ *          register that is loaded or stored around it, and the allocation
+ *          starts over.
+ */
+class RegAllocX86
+{
+  private:
+    struct Interval
+    {
+        int  start     = -1;
+        int  end       = -1;
+        bool bytes     = false;    // Used as a byte, esi and edi have none
+        bool spillable = true;     // Loads and stores of slots can't spill
+        int  hint      = -1;       // Register it is moved from or to
+        int  reg       = -1;       // What it got, -1 if it was spilled
+    };
+
+    vector<X86Instr> &m_instrs;
+    int               m_virtuals;
+    int               m_frameSize;
+    uint8_t           m_used = 0;
+
+    vector<Interval>    m_intervals;    // Indexed by virtual register
+    vector<vector<int>> m_busy;         // Per register, the instructions
+                                        // up to i that need it
+
+  private:
+    void computeIntervals();
+    bool conflicts(const Interval &interval, int reg);
+    bool scan(vector<int> &spilled);
+    void spill(const vector<int> &spilled);
+    void rewrite();
+
+  public:
+    RegAllocX86(X86Code &code, int virtuals, int frameSize);
+
+    int  run();
+    bool used(int reg) const { return m_used & (1 << reg); }
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <core.h>
+#include <stringview.h>
+
+struct X86Instr;
+
+/**
+ * @brief   Builds an operand in NASM syntax by appending to it. The text is
+ *          kept in the operand itself, only an operand that outgrows that (a
+ *          very long symbol name) allocates.
+ */
+class AsmOperand
+{
+  private:
+    char   m_inline[48];
+    string m_spill;     // Holds the text once it is longer than m_inline
+    size_t m_size = 0;
+
+  public:
+    AsmOperand() {}
+
+    AsmOperand &append(StringView text);
+    AsmOperand &append(char c);
+    AsmOperand &number(int64_t value);
+    AsmOperand &mem(StringView base);                   // [base]
+    AsmOperand &mem(StringView base, int64_t disp);     // [base+disp]
+    AsmOperand &label(int label);                       // .L<label>
+
+    operator StringView() const;
+};
+
+/**
+ * @brief   Receives the assembly the generator produces. The text output
+ *          writes NASM source (-S or an external assembler), the arch
+ *          assemblers encode it straight into an object file.
+ *
+ *          Operands are given in NASM order (destination first). The
+ *          generator hands over structured instructions (see
+ *          arch/x86/instructions.h), text is for hand written code.
+ */
+class AsmOutput
+{
+  public:
+    virtual ~AsmOutput() {}
+
+    virtual void section(const string &name) = 0;
+    virtual void global(const string &name) = 0;
+    virtual void externSymbol(const string &name) = 0;
+    virtual void label(StringView name) = 0;
+    virtual void instruction(StringView op, StringView dest = StringView(),
+                             StringView src = StringView()) = 0;
+    virtual void instruction(const X86Instr &instr) = 0;
+
+    /* Data items of size bytes each, values are numbers or symbol names */
+    virtual void data(int size, const vector<string> &values) = 0;
+    virtual void zeros(int size, int count) = 0;
+
+    virtual void comment(const string &text) {}
+    virtual void close() = 0;
+};
+
+/**
+ * @brief   Text for a file, collected in a chunk that is written out once it
+ *          fills up instead of with a stdio call for every line
+ */
+class AsmBuffer
+{
+  private:
+    FILE  *m_file;
+    char   m_chunk[1 << 16];
+    size_t m_used   = 0;
+    bool   m_failed = false;
+
+  public:
+    AsmBuffer(FILE *file) : m_file(file) {}
+
+    void append(StringView text);
+    void append(char c);
+    void number(int64_t value);
+    bool flush();       // False if anything could not be written
+};
+
+/// @brief  Writes the assembly as NASM source
+class TextAsmOutput : public AsmOutput
+{
+  private:
+    FILE     *m_file;
+    AsmBuffer m_buffer;
+
+  public:
+    TextAsmOutput(const string &path);
+    TextAsmOutput(FILE *file);
+
+    void section(const string &name);
+    void global(const string &name);
+    void externSymbol(const string &name);
+    void label(StringView name);
+    void instruction(StringView op, StringView dest = StringView(),
+                     StringView src = StringView());
+    void instruction(const X86Instr &instr);
+    void data(int size, const vector<string> &values);
+    void zeros(int size, int count);
+    void comment(const string &text);
+    void close();
+};
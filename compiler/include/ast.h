@@ -45,33 +45,68 @@ namespace AST
     };
 };
 
+/*
+ * The node's type is interned in g_typeTable, only the memory spot is kept
+ * per node. Children first and the small fields packed at the end keeps a
+ * node at 56 bytes.
+ */
 struct ast_node
 {
-    int              operation;
-    ast_node *left;
-    ast_node *mid;
-    ast_node *right;
-    int              value;
-    Type      type;  /* size from types.h */
+    ast_node   *left;
+    ast_node   *mid;
+    ast_node   *right;
+    int64_t     value;
+    MemorySpot *memSpot;
+    TypeId      typeId;
+    int         operation;
 
     /* These are to display line and char numbers of generator errors etc */
     int              line;
     int              c;
+
+    /* Interned in the type table of the active compilation, defined in
+     * context.h */
+    inline const Type &type() const;
+    Type               typeWithSpot() const;
+    inline void        setType(const Type &t);
+};
+
+/**
+ * @brief   Owns the ast nodes of a translation unit, release() frees all of
+ *          them at once. Nodes handed back with recycle() are reused first.
+ */
+class AstArena
+{
+private:
+    vector<ast_node *> m_chunks;
+    size_t             m_chunk = 0;    // Chunk we are allocating from
+    size_t             m_used  = 0;    // Nodes used in that chunk
+    vector<ast_node *> m_free;
+
+public:
+    ~AstArena();
+    ast_node *allocate();
+    void      recycle(ast_node *node);
+    void      release();
 };
 
+/* Ast arena of the active compilation, released after every input file */
+#define g_astArena (g_context->astArena)
+
 int tokenToAst(int token, Scanner &scanner);
-ast_node *mkAstUnary(int operation, ast_node *left, int value, Type type, int l, int c);
-ast_node *mkAstLeaf(int operation, int value, Type type, int l, int c);
+ast_node *mkAstUnary(int operation, ast_node *left, int64_t value, const Type &type, int l, int c);
+ast_node *mkAstLeaf(int operation, int64_t value, const Type &type, int l, int c);
 ast_node *mkAstNode(int operation, ast_node *left, 
                             ast_node *mid, ast_node *right,
-                            int value, Type type, int line, int c);
+                            int64_t value, const Type &type, int line, int c);
 
 /* Some good 'ol overloaded functions (no type) */
-ast_node *mkAstUnary(int operation, ast_node *left, int value,
+ast_node *mkAstUnary(int operation, ast_node *left, int64_t value,
                             int line, int c);
-ast_node *mkAstLeaf(int operation, int value, int line, int c);
+ast_node *mkAstLeaf(int operation, int64_t value, int line, int c);
 ast_node *mkAstNode(int operation, ast_node *left, 
                             ast_node *mid, ast_node *right,
-                            int value, int line, int c);
+                            int64_t value, int line, int c);
 
 ast_node *getRightLeaf(ast_node *tree);
+void      freeAstNode(ast_node *node);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <core.h>
+
+#include <deque>
+
+/* Interned identifier, equal atoms always mean equal strings */
+typedef uint32_t Atom;
+
+/* The atom of the empty string, used as 'no name' */
+#define NOATOM 0
+
+/**
+ * @brief   Interns identifiers so that the scanner, symbol table and type
+ *          list can compare names as integers.
+ */
+class AtomTable
+{
+private:
+    deque<string>  m_strings;   // Atom -> string, deque keeps references stable
+    vector<Atom>   m_slots;     // Open addressing hash table (NOATOM = empty)
+    vector<uint32_t> m_hashes;  // Hash of every atom to avoid rehashing on grow
+
+    static uint32_t hash(const char *s, size_t len);
+    void grow();
+
+public:
+    AtomTable();
+
+    Atom intern(const char *s, size_t len);
+    Atom intern(const string &s) { return intern(s.data(), s.size()); }
+    const string &str(Atom atom) { return m_strings[atom]; }
+    size_t size() { return m_strings.size(); }
+};
+
+/* Atom table of the active compilation */
+#define g_atoms (g_context->atoms)
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <core.h>
+
+struct CompileOptions;
+
+/**
+ * @brief   Results of earlier compilations, stored in a directory. An entry
+ *          is keyed on everything the result depends on: the preprocessed
+ *          source, the flags and the compiler binary itself. A hit gives back
+ *          the output and the warnings that compilation printed, so nothing
+ *          has to be scanned, parsed or generated again.
+ *
+ *          Entries are written under a temporary name and renamed into place,
+ *          so any number of compilers can share a directory.
+ */
+class CompileCache
+{
+  private:
+    string m_dir;
+    string m_entry;     // Path of the entry of this compilation
+
+  public:
+    CompileCache(const string &dir, const string &name, const string &source,
+                 const CompileOptions &options);
+
+    bool lookup(string &output, string &diagnostics);
+    void store(const string &output, const string &diagnostics);
+};
+
+const string &compilerIdentity();
+string        fileIdentity(const string &path);
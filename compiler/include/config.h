@@ -9,4 +9,11 @@
 #define UNION_MAX_ITEMS            1024
 #define ENUM_MAX_ITEMS             1024
 #define MAX_STRUCT_DESIGNATED_INIT 4096
-#define MAX_LINE_LENGTH            4096
\ No newline at end of file
+#define MAX_LINE_LENGTH            4096
+#define MEMORY_ARENA_CHUNK_SIZE    (64 * 1024)
+#define AST_ARENA_CHUNK_NODES      1024
+
+// Bigger strings or lists in a compile server request drop the connection
+#define SERVER_MAX_STRING          (256 * 1024 * 1024)
+#define SERVER_MAX_STRINGS         4096
+#define SERVER_READ_CHUNK          (64 * 1024)
\ No newline at end of file
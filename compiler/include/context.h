@@ -0,0 +1,71 @@
+#pragma once
+
+#include <ast.h>
+#include <atoms.h>
+#include <core.h>
+#include <errorhandler.h>
+#include <memtable.h>
+#include <symbols.h>
+#include <types.h>
+
+/**
+ * @brief   All the state of one compilation. Contexts don't share anything,
+ *          so several of them can compile at the same time (one per thread)
+ *          and a process can compile as often as it wants.
+ *
+ *          The parsers, the scanner, the symbol table, the error handler and
+ *          the generator are given their context. The rest still reaches it
+ *          through g_context, the context that is active on the calling
+ *          thread (see Activation). That is what the g_err, g_atoms,
+ *          g_memTable, g_typeList, g_typeTable and g_astArena names refer to,
+ *          they are used by:
+ *
+ *              - memory spots, which don't know their table (memtable.cpp)
+ *              - types and the AST helpers (types.cpp, ast.cpp, the
+ *                ast_node type accessors below)
+ *              - the preprocessor and precompiled headers
+ *              - the assembler, linker, object and assembly output, and the
+ *                free helpers of the x86 generator and register allocator
+ *              - the driver (main.cpp, safecc.cpp, server.cpp, memfile.cpp)
+ *
+ *          Every new user should take the context instead.
+ */
+class CompilationContext
+{
+  public:
+    AtomTable    atoms;
+    ErrorHandler errors;
+    TypeList     typeList;
+    TypeTable    typeTable;
+    MemoryTable  memTable;
+    SymbolTable  symtable;
+    AstArena     astArena;
+
+  public:
+    CompilationContext();
+
+    CompilationContext(const CompilationContext &) = delete;
+    CompilationContext &operator=(const CompilationContext &) = delete;
+
+    /* Makes a context the active one of this thread until it goes out of
+     * scope, the previously active context is restored then */
+    class Activation
+    {
+      private:
+        CompilationContext *m_previous;
+
+      public:
+        Activation(CompilationContext &ctx);
+        ~Activation();
+    };
+};
+
+inline const Type &ast_node::type() const
+{
+    return g_typeTable.get(typeId);
+}
+
+inline void ast_node::setType(const Type &t)
+{
+    typeId = g_typeTable.intern(t);
+}
@@ -18,6 +18,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <unordered_map>
 
 using namespace std;
 
@@ -26,6 +27,10 @@ using namespace std;
 
 int getFullbits(int x);
 
+/* The compilation that runs on this thread (see context.h) */
+class CompilationContext;
+extern thread_local CompilationContext *g_context;
+
 #ifdef MODE_DEBUG
 void debughandler(int sig);
 #define DEBUG(x)  std::cout << "\u001b[33;1mDEBUG\u001b[0m: " << x << "\n";
@@ -67,3 +72,8 @@ template <class T> int hasItem(vector<T> &items, T item)
 // This is just to make vscode happy
 #define SOURCE_DIR
 #endif
+
+#ifndef SAFECC_INCLUDE_DIR
+#error No include directory was specified when building
+#define SAFECC_INCLUDE_DIR
+#endif
@@ -2,6 +2,8 @@
 
 #include <core.h>
 #include <scanner.h>
+
+#include <stdexcept>
 struct Type;
 
 #define ESCAPE_RED     "\u001b[31;1m"
@@ -20,17 +22,25 @@ struct Type;
 struct ErrorInfo
 {
     Token tok;
-    string line;
     string func;
     string file;
     int lineNum;
     int charNum;
 };
 
+/* Thrown by the fatal errors after they are reported, ends the compilation */
+class CompileError : public runtime_error
+{
+  public:
+    CompileError(const string &msg) : runtime_error(msg) {}
+};
+
 class ErrorHandler
 {
   private:
+    CompilationContext &m_ctx;
     Scanner *m_scanner;
+    ostream *m_stream = &cerr;  // Where diagnostics go
     ErrorInfo m_errInfo;
     int m_justLoadedInfo = false;
 
@@ -45,8 +55,10 @@ class ErrorHandler
     void write(string str);
 
   public:
-    ErrorHandler();
+    ErrorHandler(CompilationContext &ctx);
     void setupLinehandler(Scanner &scan);
+    void copyFlags(const ErrorHandler &other);
+    void setStream(ostream &stream) { m_stream = &stream; }
     void loadErrorInfo(ErrorInfo ei);
     void unloadErrorInfo();
     void loadedErrorInfo();
@@ -54,9 +66,9 @@ class ErrorHandler
     ErrorInfo createErrorInfo();
     ErrorInfo createErrorInfo(int line, int c);
 
-    void fatal(string str);
-    void fatal(string str, int line, int c);
-    void fatalNL(string str);
+    [[noreturn]] void fatal(string str);
+    [[noreturn]] void fatal(string str, int line, int c);
+    [[noreturn]] void fatalNL(string str);
     void warning(string str);
     void warningNL(string str);
     void notice(string str);
@@ -66,24 +78,24 @@ class ErrorHandler
     void lineError(int l, int c, string color);
 
     void syntaxError(string str);
-    void expectedType(Type *l, Type *r);
+    void expectedType(const Type *l, const Type *r);
     void unexpectedToken(int token);
     void expectedToken(int token);
     void expectedToken(int token, int got);
     void expectedToken(int token, int token2, int got);
-    void unexpectedParamToFunc(string func, Type *t);
+    void unexpectedParamToFunc(string func, const Type *t);
 
-    void conversionError(Type *l, Type *r);
-    void conversionWarning(Type *l, Type *r);
-    void ptrConversionWarning(Type *l, Type *r);
+    void conversionError(const Type *l, const Type *r);
+    void conversionWarning(const Type *l, const Type *r);
+    void ptrConversionWarning(const Type *l, const Type *r);
 
-    void typeConversionError(Type *l, Type *r);
-    void unknownType(Type *l);
+    void typeConversionError(const Type *l, const Type *r);
+    void unknownType(const Type *l);
     void unknownType(string s);
     void unknownSymbol(string s);
     void tip(string s);
     void tipNL(string s);
-    void unknownStructItem(string s, Type t);
+    void unknownStructItem(string s, const Type &t);
     void incorrectAccessor(bool ptr);
     void pedanticWarning(string warn);
     
@@ -92,4 +104,5 @@ class ErrorHandler
     
 };
 
-extern ErrorHandler err;
\ No newline at end of file
+/* The error handler of the active compilation */
+#define g_err (g_context->errors)
\ No newline at end of file
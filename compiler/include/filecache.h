@@ -0,0 +1,32 @@
+#pragma once
+
+#include <core.h>
+
+#include <memory>
+#include <mutex>
+
+struct LexedFile;
+
+/**
+ * @brief   Keeps files (headers mostly) in memory, already split into
+ *          preprocessing tokens, so that compilations don't read and
+ *          tokenize them again. A cached file is only used while its size
+ *          and modification time still match. Shared by all compilations of
+ *          a process, it does its own locking.
+ */
+class FileCache
+{
+  private:
+    struct Entry
+    {
+        int64_t                     mtime;
+        int64_t                     size;
+        shared_ptr<const LexedFile> lexed;
+    };
+
+    mutex                         m_lock;
+    unordered_map<string, Entry>  m_files;
+
+  public:
+    shared_ptr<const LexedFile> read(const string &path);
+};
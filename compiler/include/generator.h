@@ -1,23 +1,25 @@
 #pragma once
 
+#include <asmoutput.h>
 #include <core.h>
 #include <ast.h>
+#include <symbols.h>
 
 class Generator
 {
 
 protected:
-    FILE        *m_outfile;
+    CompilationContext &m_ctx;
+    AsmOutput   *m_out;
     int         m_labelCount = 0;
+    int         m_optimize   = 0;   // The -O level
     Scanner     *m_scanner;         // Used only for debugging
 
+    /* Locals of the function being generated that have their address
+     * taken, the others may be kept in registers */
+    unordered_map<SymbolId, bool> m_addressTaken;
+
 protected:
-    void write(string instruction, string source, string destination);
-    void write(string instruction, int source, string destination);
-    void write(string instruction);
-    void write(string instruction, string destination);
-    void move(string instruction, string source, string destination);
-    
     int generateIf(ast_node *tree, int condLabel, int endLabel);
     int generateWhile(ast_node *tree);
     int generateDoWhile(ast_node *tree);
@@ -36,6 +38,9 @@ protected:
     
     int generateGoto(ast_node *tree);
 
+    void findAddressTaken(ast_node *tree);
+    bool promotable(SymbolId symbol);
+
     /* Arch dependant functions, get overwritten in arch/ARCH folder */
     virtual void freeReg(int reg) {}
     virtual void freeAllReg() {}
@@ -44,8 +49,9 @@ protected:
     virtual int genSub(int reg1, int reg2) {}
     virtual int genMul(int reg1, int reg2) {}
     virtual int genDiv(int reg1, int reg2) {}
-    virtual int genLoadVariable(int symbol, Type t) {}
-    virtual int genStoreValue(int reg, int memloc, Type t) {}
+    virtual int genLoadVariable(SymbolId symbol, const Type &t) {}
+    virtual int genStoreValue(int reg, SymbolId memloc, const Type &t) {}
+    virtual int genStoreVariable(int reg, SymbolId symbol, const Type &t) {}
     
     virtual int genCompare(int reg1, int reg2, bool clear=true) {}
     virtual int genCompareSet(int op, int reg1, int reg2) {}
@@ -53,20 +59,20 @@ protected:
     virtual int genFlagSet(int op, int reg) {}
     
     virtual int genLabel(int label) {}
-    virtual int genLabel(string label) {}
-    virtual int genGoto(string label) {}
+    virtual int genLabel(Atom label) {}
+    virtual int genGoto(Atom label) {}
     virtual int genJump(int label) {}
     virtual int genWidenRegister(int reg, int oldsize, int newsize, bool isSigned) {}
     virtual int genPushArgument(int reg, int argindex) {}
-    virtual int genFunctionCall(int symbolidx, int parameters, vector<int> data) {}
-    virtual int genReturnJump(int reg, int func) {}
-    virtual int genLoadLocation(int symbolidx) {}
+    virtual int genFunctionCall(SymbolId symbolidx, int parameters, vector<int> data) {}
+    virtual int genReturnJump(int reg, SymbolId func) {}
+    virtual int genLoadLocation(SymbolId symbolidx) {}
     virtual int genPtrAccess(int reg, int size) {}
-    virtual int genDirectMemLoad(int offset, int symbol, int reg, int size) {}
+    virtual int genDirectMemLoad(int offset, SymbolId symbol, int reg, int size) {}
     virtual int genNegate(int reg) {}
     virtual int genAccessStruct(int memreg, int idx, int size) {}
-    virtual int genIncrement(int symbol, int amount, int after) {}
-    virtual int genDecrement(int symbol, int amount, int after) {}
+    virtual int genIncrement(SymbolId symbol, int amount, int after) {}
+    virtual int genDecrement(SymbolId symbol, int amount, int after) {}
     virtual int genLeftShift(int reg1, int reg2) {}
     virtual int genRightShift(int reg1, int reg2) {}
     virtual int genModulus(int leftreg, int rightreg) {}
@@ -87,13 +93,14 @@ protected:
 public:
     virtual void genDebugComment(string s) {}
     virtual int genExtern(string name) {}
-    virtual int genFunctionPreamble(int funcInx) {}
-    virtual int genFunctionPostamble(int funcIdx) {}
+    virtual int genFunctionPreamble(SymbolId funcInx) {}
+    virtual int genFunctionPostamble(SymbolId funcIdx) {}
     virtual int genDataSection() {}
 
-    Generator(string &outfile);
+    Generator(CompilationContext &ctx, AsmOutput *out);
     void close();
     int generateFromAst(ast_node *tree, int reg, int parentOp, 
                         int condLabel=-1, int endLabel=-1);
     void setupInfileHandler(Scanner &scanner);
+    void setOptimization(int level) { m_optimize = level; }
 };
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <core.h>
+
+/**
+ * @brief   An anonymous file that only lives in memory (memfd). External
+ *          tools get to it through path(), the descriptor is inherited by the
+ *          processes system() and popen() start. Nothing is created in /tmp
+ *          so concurrent compilers can't race on file names.
+ */
+class MemFile
+{
+  private:
+    int m_fd;
+
+  public:
+    MemFile(const string &name);
+    ~MemFile();
+
+    MemFile(const MemFile &) = delete;
+    MemFile &operator=(const MemFile &) = delete;
+
+    int    fd() { return m_fd; }
+    string path();
+    FILE  *openWrite();
+    string contents();
+};
+
+string runCapture(const string &command, int &status);
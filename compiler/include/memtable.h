@@ -2,6 +2,28 @@
 
 #include <core.h>
 #include <errorhandler.h>
+#include <smallvector.h>
+
+class MemorySpot;
+
+/**
+ * @brief   Bump allocator for memory spots, release() destroys every spot
+ *          allocated from it at once and keeps the chunks for reuse
+ */
+class MemoryArena
+{
+private:
+    vector<char *>       m_chunks;
+    size_t               m_chunk = 0;    // Chunk we are allocating from
+    size_t               m_used  = 0;    // Bytes used in that chunk
+    vector<MemorySpot *> m_spots;
+
+public:
+    ~MemoryArena();
+    void *allocate(size_t size);
+    void release();
+    vector<MemorySpot *> &spots() { return m_spots; }
+};
 
 class MemorySpot
 {
@@ -19,7 +41,7 @@ private:
     int m_memId;
     int m_referencing = -1;
     int m_memLoc = MemLoc::STATIC;
-    list <int> m_referencedBy;
+    SmallVector<int, 4> m_referencedBy;
     string m_lastName;
     int m_accessGarbage = false;
     
@@ -31,6 +53,14 @@ public:
     MemorySpot(int memId);
     MemorySpot(MemorySpot *ms, bool deepCopy=false);
     MemorySpot(string s);
+
+    /* Spots come from the current arena of g_memTable and are never deleted
+     * one by one, the arena releases them all at once */
+    static void *operator new(size_t size);
+    static void *operator new(size_t size, MemoryArena &arena);
+    static void operator delete(void *ptr) {}
+    static void operator delete(void *ptr, MemoryArena &arena) {}
+
     void setName(string name);
     void addReferencingTo(MemorySpot *ms);
     void addReferencingTo(MemorySpot *ms, int op);
@@ -40,6 +70,7 @@ public:
     void destroyedMessage();
     void stopBeingReferencedBy(int id);
     void stopReferencing();
+    void forgetReleased();
     void copy(MemorySpot *ms);
     bool tryToUse(int op);
     void goodValues();
@@ -61,14 +92,26 @@ public:
 class MemoryTable
 {
 private:
-    list <MemorySpot*> m_table;
-    int m_memIDCounter = 0;
+    // Indexed by memId, removed spots leave a NULL behind so ids stay valid
+    vector<MemorySpot*> m_table;
+    vector<int>         m_freeIds;  // Ids of released function spots
+
+    MemoryArena  m_globalArena;     // Spots that outlive a function
+    MemoryArena  m_functionArena;   // Spots of the function being parsed
+    MemoryArena *m_arena = &m_globalArena;
     
 public:
     MemoryTable();
     int addMemorySpot(MemorySpot *ms);
     int removeMemorySpot(int memId);
     MemorySpot *findMemorySpot(int memId);
+    bool released(int memId) { return !m_table[memId]; }
+
+    MemoryArena &arena() { return *m_arena; }
+    MemoryArena &globalArena() { return m_globalArena; }
+    void beginFunction();
+    void endFunction();
 };
 
-extern MemoryTable g_memTable;
\ No newline at end of file
+/* Memory table of the active compilation */
+#define g_memTable (g_context->memTable)
\ No newline at end of file
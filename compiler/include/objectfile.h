@@ -0,0 +1,54 @@
+#pragma once
+
+#include <core.h>
+#include <elf.h>
+
+/**
+ * @brief   Builds an ELF32 relocatable object. Sections hold raw bytes,
+ *          symbols and relocations refer to them by index. The symbol table
+ *          is ordered (locals first) when the file is written.
+ */
+class ObjectFile
+{
+  public:
+    struct Section
+    {
+        string          name;
+        uint32_t        type;
+        uint32_t        flags;
+        uint32_t        align;
+        vector<uint8_t> bytes;
+        vector<Elf32_Rel> relocs;   // r_info holds our symbol index for now
+        int             symbol;     // The STT_SECTION symbol
+    };
+
+    struct Symbol
+    {
+        string   name;
+        int      section;   // SHN_UNDEF (0) if undefined
+        uint32_t value;
+        int      bind;
+        int      type;
+    };
+
+  private:
+    vector<Section> m_sections;
+    vector<Symbol>  m_symbols;
+    string          m_sourceFile;
+
+  public:
+    ObjectFile(const string &sourceFile);
+
+    int  addSection(const string &name, uint32_t type, uint32_t flags,
+                    uint32_t align);
+    int  addSymbol(const string &name, int section, uint32_t value, int bind,
+                   int type = STT_NOTYPE);
+    void addRelocation(int section, uint32_t offset, int symbol, int type);
+
+    /* Sections are numbered like in the file, from 1 */
+    Section &section(int idx) { return m_sections[idx - 1]; }
+    Symbol  &symbol(int idx) { return m_symbols[idx]; }
+
+    string contents();
+    void   write(const string &path);
+};
@@ -11,6 +11,7 @@ class Parser;
 class ExpressionParser
 {
   private:
+    CompilationContext &m_ctx;
     Scanner &  m_scanner;
     Parser &   m_parser;
     Generator &m_generator;
@@ -36,5 +37,6 @@ class ExpressionParser
     int              parseConstantExpr();
     ast_node *parsePostfixOperator(ast_node *tree, bool access);
     ast_node *parseBinaryOperation(int prev_prec, Type type);
-    ExpressionParser(Scanner &scanner, Parser &parser, Generator &gen);
+    ExpressionParser(CompilationContext &ctx, Scanner &scanner, Parser &parser,
+                     Generator &gen);
 };
\ No newline at end of file
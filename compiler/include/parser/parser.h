@@ -27,6 +27,7 @@ class Parser
 {
 
 private:
+    CompilationContext  &m_ctx;
     Scanner             &m_scanner;
     Generator           &m_generator;
     StatementParser     m_statementParser;
@@ -44,7 +45,7 @@ private:
     vector<Attribute> _parseParen(vector <Attribute> attributes);
 
 public:
-    Parser(Scanner &scanner, Generator &generator);
+    Parser(CompilationContext &ctx, Scanner &scanner, Generator &generator);
     ast_node *parserMain();
 
     friend class StatementParser;
@@ -13,6 +13,7 @@ class StatementParser
 {
 
   private:
+    CompilationContext &m_ctx;
     Scanner   &m_scanner;
     Parser    &m_parser;
     Generator &m_generator;
@@ -45,7 +46,7 @@ class StatementParser
     
     ast_node *comparison();
     ast_node *gotoStatement();
-    ast_node *parseLabel(string label);
+    ast_node *parseLabel(Atom label);
 
     ast_node *parseStatement(int parentTok=0);
     ast_node *parseDeclaration(Type t, int storageClass);
@@ -60,5 +61,6 @@ class StatementParser
     ast_node *declEnum(string s = "");
     ast_node *functionCall();
     ast_node *_parseBlock(int parentOp=0, ast_node *left=NULL);
-    StatementParser(Scanner &scanner, Parser &parser, Generator &gen);
+    StatementParser(CompilationContext &ctx, Scanner &scanner, Parser &parser,
+                    Generator &gen);
 };
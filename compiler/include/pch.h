@@ -0,0 +1,113 @@
+#pragma once
+
+#include <core.h>
+#include <types.h>
+
+#include <memory>
+
+class CompilationContext;
+class Preprocessor;
+struct CompileOptions;
+struct StructDef;
+
+/* Encodes the parts of the parser state a header leaves behind */
+class PchWriter
+{
+  private:
+    string                                 m_data;
+    unordered_map<const StructDef *, int>  m_structIds;
+
+  public:
+    void u32(uint32_t v) { m_data.append((const char *) &v, sizeof(v)); }
+    void i64(int64_t v) { m_data.append((const char *) &v, sizeof(v)); }
+    void str(const string &s);
+    void atom(Atom atom);
+    void type(const Type &t);
+
+    void addStruct(const StructDef *def);
+
+    const string &data() { return m_data; }
+};
+
+/* Decodes what PchWriter wrote into the active compilation, atoms are
+ * interned again since every compilation has its own atom table */
+class PchReader
+{
+  private:
+    const char         *m_pos;
+    const char         *m_end;
+    bool                m_ok = true;
+    vector<StructDef *> m_structs;
+
+  public:
+    PchReader(const char *data, size_t size) : m_pos(data), m_end(data + size)
+    {
+    }
+
+    bool        ok() { return m_ok; }
+    const char *pos() { return m_pos; }
+    void        read(void *buf, size_t size);
+    uint32_t u32();
+    uint32_t count();   // Number of elements that follow
+    int64_t  i64();
+    string   str();
+    Atom     atom();
+    Type     type();
+
+    void addStruct(StructDef *def) { m_structs.push_back(def); }
+};
+
+/**
+ * @brief   A precompiled header holds what a header leaves behind: its
+ *          macros, the files it included, the named types and the global
+ *          symbols with their attributes. A compilation that starts from it
+ *          begins parsing where the header left off, without preprocessing
+ *          or parsing the header again.
+ *
+ *          Made with --precompile and used with --include-pch. The file is
+ *          memory mapped once per process and shared by every compilation
+ *          that uses it. When the compiler, the options or one of the
+ *          headers changed since it was made it is not usable, compilations
+ *          include the header itself then.
+ */
+class PrecompiledHeader
+{
+  private:
+    struct Dependency
+    {
+        string  path;
+        int64_t size;
+        int64_t mtime;
+    };
+
+    struct Included
+    {
+        string path;
+        int    dirIdx;
+        bool   pragmaOnce;
+        string guard;
+    };
+
+    const char        *m_map  = NULL;
+    size_t             m_size = 0;
+    string             m_header;        // The header it was made from
+    string             m_compiler;      // See compilerIdentity()
+    string             m_options;       // What the options must match
+    vector<Dependency> m_dependencies;
+    string             m_macros;        // As #define lines
+    vector<Included>   m_included;
+    size_t             m_declarations = 0;  // Offset of types and symbols
+
+  public:
+    ~PrecompiledHeader();
+
+    static shared_ptr<const PrecompiledHeader> open(const string &path);
+    static void write(const string &path, const string &header,
+                      const CompileOptions &options, Preprocessor &pp,
+                      CompilationContext &ctx);
+
+    const string &header() const { return m_header; }
+    bool          usable(const CompileOptions &options) const;
+    void          restoreMacros(Preprocessor &pp) const;
+    void          restoreDeclarations(CompilationContext &ctx) const;
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atoms.h>
+#include <core.h>
+#include <filecache.h>
+
+#include <deque>
+
+enum PPTokenKinds
+{
+    PP_EOF = 0,
+    PP_IDENT,
+    PP_NUMBER,
+    PP_CHAR,
+    PP_STRING,
+    PP_PUNCT,
+    PP_OTHER    // A stray character (like '`' or '@')
+};
+
+/* The set of macros a token was expanded from, these won't expand again */
+struct HideSet
+{
+    Atom           name;
+    const HideSet *next;
+};
+
+struct PPFile;
+
+struct PPToken
+{
+    const char    *text;
+    int            len;
+    int            kind;
+    Atom           ident = NOATOM;  // Interned name of identifiers
+    bool           bol   = false;   // First token of its line
+    bool           space = false;   // Whitespace (or a comment) before it
+    bool           expanded = false; // Made by a macro expansion
+    PPFile        *file  = NULL;    // Expanded tokens get the location of
+    int            line  = 0;       // the macro invocation
+    int            col   = 0;
+    const HideSet *hide  = NULL;
+
+    bool is(const char *s) const;
+};
+
+/* A file split into tokens that don't refer to a compilation yet (no file
+ * or atoms), the FileCache shares these between compilations */
+struct LexedFile
+{
+    string          source;       // Without line splices, the tokens point
+    vector<PPToken> tokens;       // into it
+};
+
+shared_ptr<const LexedFile> lexFile(string &&source);
+
+/* A tokenized input file, files are only read and tokenized once */
+struct PPFile
+{
+    string          path;
+    int             dirIdx;       // Include dir it was found in (-1: none)
+    string          source;
+    shared_ptr<const LexedFile> lexed;  // Holds the source instead if the
+                                        // tokens came from the FileCache
+    vector<PPToken> tokens;       // Ends with a PP_EOF token
+    bool            pragmaOnce = false;
+    Atom            guard      = NOATOM;  // Include guard macro, if any
+    bool            stub       = false;   // Known from a precompiled header,
+                                          // read on the first real include
+};
+
+struct Macro
+{
+    vector<PPToken> body;
+    vector<Atom>    params;
+    bool            funcLike = false;
+    bool            variadic = false;
+};
+
+/* State of an #if group */
+struct PPConditional
+{
+    bool taken;     // A branch of this group has been included already
+    bool hadElse;
+    bool skipping;  // The current branch is skipped
+};
+
+/**
+ * @brief   The built-in preprocessor. It reads the input file (and its
+ *          includes) and produces the preprocessed text with gcc style line
+ *          markers, which the scanner can consume directly from memory.
+ */
+class Preprocessor
+{
+  private:
+    struct Cursor
+    {
+        PPFile       *file;
+        size_t        pos;
+        size_t        condBase;       // m_conds size when the file was entered
+        int           lineDelta = 0;  // Set by #line, added to the physical
+        const string *path = NULL;    // line, and the name it gives the file
+    };
+
+    FileCache                   *m_fileCache = NULL;
+    vector<string>               m_includeDirs;
+    vector<string>               m_forcedIncludes;
+    string                       m_cmdlineDefines;
+    string                       m_pchDefines;  // Macros of a precompiled
+                                                // header, as #define lines
+    string                       m_pchHeader;   // The header it stands for
+    unordered_map<string, PPFile *> m_files;
+    deque<PPFile>                m_fileStore;
+    unordered_map<Atom, Macro>   m_macros;
+    deque<HideSet>               m_hideSets;
+    deque<string>                m_strings;    // Text of synthesized tokens
+
+    vector<Cursor>               m_includeStack;
+    vector<PPToken>              m_pending;    // Expanded tokens, in reverse
+    vector<PPConditional>        m_conds;
+
+    /* Output state */
+    string                       m_out;
+    const string                *m_outPath = NULL;
+    int                          m_outLine = 0;
+    bool                         m_atLineStart = true;
+    bool                         m_lastExpanded = false;
+    char                         m_lastChar = 0;
+
+    Atom m_defined, m_hasInclude, m_hasIncludeNext, m_vaArgs;
+    Atom m_file, m_line, m_counter, m_includeLevel;
+    int  m_counterValue = 0;
+
+  private:
+    /* Tokenizer (pptokens.cpp) */
+    void     tokenize(PPFile *file);
+    void     bindTokens(vector<PPToken> &tokens, PPFile *file);
+    PPToken  makeToken(const string &text, const PPToken &pos);
+
+    /* Files and directives (preprocessor.cpp) */
+    PPFile  *loadFile(const string &path, int dirIdx);
+    PPFile  *readStub(PPFile *stub);
+    PPFile  *addFile(const string &path, int dirIdx, string &&source);
+    PPFile  *addFile(const string &path, int dirIdx,
+                     shared_ptr<const LexedFile> lexed);
+    PPFile  *findInclude(const string &name, bool quoted, int startDir,
+                         const PPFile *from);
+    void     pushFile(PPFile *file);
+    PPToken  readRaw();
+    void     unread(const PPToken &tok);
+    vector<PPToken> readLine();
+    void     directive(const PPToken &hash);
+    void     includeDirective(vector<PPToken> &line, bool next,
+                              const PPToken &hash);
+    void     lineDirective(vector<PPToken> &line, const PPToken &hash);
+    int      presumedLine(const PPToken &tok);
+    const string *presumedPath(const PPToken &tok);
+    string   includeName(vector<PPToken> &line, bool &quoted,
+                         const PPToken &hash);
+    void     skipGroup();
+    void     detectGuard(PPFile *file);
+    [[noreturn]] void error(const PPToken &tok, const string &msg);
+    void     warning(const PPToken &tok, const string &msg);
+
+    /* Macros (macros.cpp) */
+    void            defineMacro(vector<PPToken> &line, const PPToken &hash);
+    void            resolveDefined(vector<PPToken> &toks);
+    bool            expandMacro(PPToken &tok);
+    bool            expandBuiltin(PPToken &tok);
+    bool            isDefined(Atom name);
+    PPToken         numberToken(int64_t value, const PPToken &pos);
+    vector<PPToken> expandAll(vector<PPToken> tokens);
+    vector<PPToken> substitute(Atom name, const Macro &m,
+                               vector<vector<PPToken>> &args,
+                               const PPToken &invocation);
+    PPToken         stringize(const vector<PPToken> &arg,
+                              const PPToken &pos);
+    PPToken         paste(const PPToken &l, const PPToken &r);
+    const HideSet  *hideSetAdd(const HideSet *hs, Atom name);
+    const HideSet  *hideSetUnion(const HideSet *a, const HideSet *b);
+    const HideSet  *hideSetIntersect(const HideSet *a, const HideSet *b);
+    bool            hideSetHas(const HideSet *hs, Atom name);
+
+    /* #if expressions (ppexpr.cpp) */
+    bool     evalCondition(vector<PPToken> &line, const PPToken &hash);
+    int64_t  evalExpression(vector<PPToken> &toks, const PPToken &hash);
+
+    /* Output */
+    void     emit(const PPToken &tok);
+    void     emitMarker(const string &path, int line);
+
+  public:
+    Preprocessor();
+
+    void   addIncludeDir(const string &dir);
+    void   forceInclude(const string &path);
+    void   define(const string &definition);
+    void   setFileCache(FileCache *cache) { m_fileCache = cache; }
+    string preprocess(const string &path);
+    string preprocess(const string &path, string &&source);
+
+    /* What a precompiled header saves and restores (see pch.h) */
+    string               macroDefinitions();
+    const deque<PPFile> &files() { return m_fileStore; }
+    void restoreMacros(const string &definitions) { m_pchDefines = definitions; }
+    void restoreFile(const string &path, int dirIdx, bool pragmaOnce,
+                     Atom guard);
+    void markIncluded(const string &header) { m_pchHeader = header; }
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <core.h>
+#include <filecache.h>
+
+class CompilationContext;
+class Generator;
+
+/**
+ * @brief   SafeCC as a library. Every call compiles in its own context, so
+ *          calls can be made from several threads at once and as often as
+ *          needed in one process.
+ */
+struct CompileOptions
+{
+    bool assembly = false;          // NASM text instead of an ELF32 object
+
+    /* External preprocessor command, the built-in one if empty. Only used
+     * when compiling a file, in memory sources are always preprocessed by
+     * the built-in one. */
+    string         preprocessor;
+    vector<string> includeDirs;     // Searched before the default ones
+    vector<string> defines;         // NAME or NAME=VALUE, like -D
+
+    bool warningAsError     = false;
+    bool conversionWarnings = false;
+    bool noMemoryChecking   = false;
+
+    /* -O level, 0 leaves the code as it is generated (see PeepholeX86) */
+    int optimize = 0;
+
+    /* Headers read by earlier compilations, can be shared between threads */
+    FileCache *fileCache = NULL;
+
+    /* Directory of the CompileCache, results aren't cached if empty */
+    string cacheDir;
+
+    /* Precompiled header to start from (see pch.h), none if empty */
+    string pch;
+};
+
+struct CompileResult
+{
+    bool   success = false;
+    string output;          // The object or the assembly
+    string diagnostics;     // Errors and warnings, as the compiler prints them
+};
+
+CompileResult compile(const string &source, const string &name,
+                      const CompileOptions &options);
+CompileResult compileFile(const string &path, const CompileOptions &options);
+void          precompileHeader(const string &header, const string &outfile,
+                               const CompileOptions &options);
+
+/* The steps the command line uses to put several files in one object, these
+ * run in the active context and throw CompileError on errors */
+void   applyOptions(CompilationContext &ctx, const CompileOptions &options);
+string preprocessFile(const string &path, const CompileOptions &options,
+                      const string *source = NULL);
+void   compileInto(CompilationContext &ctx, Generator &generator,
+                   const CompileOptions &options, const string &path,
+                   const string *source = NULL);
@@ -2,6 +2,7 @@
 
 #include <token.h>
 #include <core.h>
+#include <atoms.h>
 
 #define SCANNER_IDENTIFIER_LIMMIT   100
 
@@ -10,6 +11,15 @@ enum Identifiers
     PRINT = 1
 };
 
+enum InputModes
+{
+    INPUT_MAPPED = 1,   // The file is mmap'ed
+    INPUT_SLURPED       // The file (or pipe) is read into memory in one go,
+                        // or the source was handed over in memory
+};
+
+int identifyKeyword(const char *ident, int len);
+
 /**
  * @brief   Scanner class implemented the lexical scanner of the compiler
  *  
@@ -18,6 +28,8 @@ class Scanner
 {
 
 private:
+    CompilationContext &m_ctx;
+
     int         m_line = 1;     // Line numbers start at 1 (you know because normal people start counting from 1)
     int         m_char = 0;
 
@@ -27,10 +39,21 @@ private:
     int         m_putback = 0;
     
     string      m_identBuf;
+    Atom        m_identAtom = NOATOM;
     string      m_ppFile;
 
     const char  *m_filename;
-    FILE        *m_infile;
+
+    /* The whole input file is kept resident and scanned from a pointer */
+    int         m_inputMode;
+    const char  *m_buf = NULL;
+    size_t      m_size = 0;
+    size_t      m_pos = 0;
+    string      m_slurped;      // Backing storage if the file couldn't be mapped
+
+    /* Start offset of every line, per (#line remapped) input file */
+    unordered_map<string, vector<int>>  m_lineIndex;
+    vector<int> *m_lineStarts;
     
 private:
     int next();
@@ -42,15 +65,18 @@ private:
     int scanhex(int c);
     int scanoct(int c);
     int scanbin(int c);
-    int scanStringLiteral();
+    int64_t scanStringLiteral();
     int scanChar();
     int charParser(int c);
     int scanIdentifier(int c);
-    int identifyKeyword(string keyword);
     int parsePPStatement();
+    void loadInput(int fd);
+    void init();
+    void markLineStart();
 
 public:
-    Scanner(const char *path);
+    Scanner(CompilationContext &ctx, const char *path);
+    Scanner(CompilationContext &ctx, const char *name, string &&source);
     ~Scanner();
 
     Token& token();
@@ -59,9 +85,10 @@ public:
     int curOffset();
     string curPPFile();
     string curFunction();
-    string curStrLine(int offset);
+    string getLine(const string &file, int line);
     string getStrFromTo(int from, int to);
     string &identifier();
+    Atom identAtom();
     int getTokenStart();
     void setIdentifier(string s);
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <core.h>
+#include <safecc.h>
+
+/**
+ * @brief   The compile server keeps running between compilations, so they
+ *          don't pay for starting the compiler and share the headers that
+ *          were read and tokenized before (see FileCache). Declarations are
+ *          still parsed by every compilation.
+ *
+ *          A client connects to the Unix socket, sends one request and reads
+ *          the result. Everything is little endian, strings are a u32 length
+ *          followed by the bytes:
+ *
+ *              request:  "SCC1" u32 flags, string path, string source,
+ *                        u32 n, n include dirs, u32 n, n defines
+ *              response: u32 success, string output, string diagnostics
+ *
+ *          The flags are the SERVER_* bits below, bits 8 to 15 hold the -O
+ *          level. A server started with --cache keeps the results in that
+ *          CompileCache directory.
+ *
+ *          At most -j requests (a thread per core by default) are compiled
+ *          at once, further clients wait until a worker is free. SIGINT and
+ *          SIGTERM stop the server once the running compilations are done.
+ */
+enum ServerFlags
+{
+    SERVER_ASSEMBLY       = 1 << 0,
+    SERVER_WERROR         = 1 << 1,
+    SERVER_WCONVERSION    = 1 << 2,
+    SERVER_NO_MEM_CHECK   = 1 << 3,
+    SERVER_OPTIMIZE_SHIFT = 8,
+};
+
+void          runServer(const string &socketPath, const string &cacheDir,
+                        int jobs);
+CompileResult compileRemote(const string &socketPath, const string &path,
+                            const CompileOptions &options);
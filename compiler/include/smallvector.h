@@ -0,0 +1,57 @@
+#pragma once
+
+#include <core.h>
+
+/**
+ * @brief   Vector that keeps its first N items inline and only allocates
+ *          once it grows past that, meant for lists that are nearly
+ *          always tiny (like the references to a memory spot)
+ */
+template <class T, int N> class SmallVector
+{
+private:
+    T         m_inline[N];
+    vector<T> m_spill;      // Holds all the items once there are more than N
+    size_t    m_size = 0;
+
+public:
+    T *begin() { return m_spill.empty() ? m_inline : m_spill.data(); }
+    T *end() { return begin() + m_size; }
+    size_t size() const { return m_size; }
+
+    void clear()
+    {
+        m_spill.clear();
+        m_size = 0;
+    }
+
+    void push_back(const T &item)
+    {
+        if (m_spill.empty() && m_size < N)
+        {
+            m_inline[m_size++] = item;
+            return;
+        }
+
+        if (m_spill.empty())
+            m_spill.assign(m_inline, m_inline + m_size);
+
+        m_spill.push_back(item);
+        m_size++;
+    }
+
+    /// @brief  Removes every occurence of item, like list::remove
+    void remove(const T &item)
+    {
+        m_size = std::remove(begin(), end(), item) - begin();
+        if (!m_spill.empty())
+            m_spill.resize(m_size);
+    }
+
+    template <class Pred> void removeIf(Pred pred)
+    {
+        m_size = std::remove_if(begin(), end(), pred) - begin();
+        if (!m_spill.empty())
+            m_spill.resize(m_size);
+    }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <core.h>
+
+/**
+ * @brief   Characters owned by someone else, what std::string_view is in
+ *          C++17. Passing one around never copies or allocates, the owner
+ *          has to outlive it.
+ */
+class StringView
+{
+private:
+    const char *m_data = "";
+    size_t      m_size = 0;
+
+public:
+    StringView() {}
+    StringView(const char *s) : m_data(s), m_size(strlen(s)) {}
+    StringView(const char *s, size_t size) : m_data(s), m_size(size) {}
+    StringView(const string &s) : m_data(s.data()), m_size(s.size()) {}
+
+    const char *data() const { return m_data; }
+    size_t      size() const { return m_size; }
+    bool        empty() const { return m_size == 0; }
+    char        operator[](size_t i) const { return m_data[i]; }
+    string      str() const { return string(m_data, m_size); }
+
+    bool operator==(StringView other) const
+    {
+        return m_size == other.m_size && !memcmp(m_data, other.m_data, m_size);
+    }
+
+    bool operator!=(StringView other) const { return !(*this == other); }
+};
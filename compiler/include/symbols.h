@@ -4,12 +4,21 @@
 #include <types.h>
 #include <attributes.h>
 
+#include <deque>
+
+class PchWriter;
+class PchReader;
+
 int tokenToSize(int tok);
 
-/// @note: maybe implement the symboltable with a hashmap
+/* Handle to a symbol, the index of the symbol in the symbol table's arena */
+typedef int64_t SymbolId;
+
+#define NOSYMBOL -1
+
 struct Symbol
 {
-    string name;  // Name of the symbol
+    Atom   name;  // Name of the symbol
     int    value; // Value of the symbol, could be
                   // the integer value if symType is set to VARIABLE
                   // but can also be array size if symType is ARRAY
@@ -35,24 +44,39 @@ struct Symbol
 
     int storageClass;
     vector<Attribute> attributes;
+
+    int scope; // Index of the scope that declared the symbol (0 is global)
 };
 
-class Scope : public vector<Symbol>
+#define GLOBALSCOPE 0
+
+/**
+ * @brief   A scope lists the symbols it declares, the hashmap resolves a
+ *          name to its symbol in O(1)
+ */
+class Scope : public vector<SymbolId>
 {
   private:
-    int m_index;
+    int                           m_index;
+    unordered_map<Atom, SymbolId> m_lookup;
 
   public:
     Scope() { m_index = 0; }
     Scope(int index) { m_index = index; }
     int index() { return m_index; }
+
+    void     add(SymbolId id, Atom name);
+    SymbolId find(Atom name);
+    void     rename(SymbolId id, Atom oldName, Atom newName);
 };
 
 class SymbolTable
 {
   private:
+    CompilationContext &m_ctx;
+    deque<Symbol>   m_symbols;  // Every symbol, deque keeps them in place
     vector<Scope *> m_scopeList;
-    int             m_currentFunctionIndex = -1;
+    SymbolId        m_currentFunctionIndex = NOSYMBOL;
     int             m_stringCount          = 0;
 
     int             m_staticVariableOffset = 0;
@@ -78,16 +102,16 @@ class SymbolTable
     };
 
   private:
-    int newSymbol();
-    int _addVariable(Symbol sym);
+    SymbolId newSymbol(Symbol &sym, Scope *scope);
+    SymbolId _addVariable(Symbol sym);
 
   public:
-    SymbolTable();
+    SymbolTable(CompilationContext &ctx);
     ~SymbolTable();
 
     /* HAS to be called everytime we parse a new function */
-    void changeCurFunc(int func);
-    int  currentFuncIdx();
+    void     changeCurFunc(SymbolId func);
+    SymbolId currentFuncIdx();
 
     struct Scope *_createScope();
     /* These will be called everytime a new scope is entered of left */
@@ -95,25 +119,26 @@ class SymbolTable
     bool isCurrentScopeGlobal();
     int  popScope(bool semantics=true, bool functionEnd=false);
 
-    vector<Symbol> getGlobalTable();
-    vector<Symbol> getStaticTable();
+    Scope &getGlobalTable();
 
-    int            findSymbol(string);
+    SymbolId       findSymbol(Atom sym);
     int            pushScopeById(int id);
-    int            findInCurrentScope(string s);
-    Symbol *getSymbol(int index);
-    int addSymbol(string symbol, int val, int symType, Type varType,
-                  int storageClass);
+    SymbolId       findInCurrentScope(Atom sym);
+    Symbol *getSymbol(SymbolId sym);
+    void    renameSymbol(SymbolId sym, Atom name);
+    SymbolId addSymbol(Atom symbol, int val, int symType, Type varType,
+                       int storageClass);
     /* To be able to pass NULL as vartype */
-    int           addSymbol(string sym, int val, int symType, int varType);
-    int           addSymbol(string sym, int val, int symType, int varType,
+    SymbolId      addSymbol(Atom sym, int val, int symType, int varType);
+    SymbolId      addSymbol(Atom sym, int val, int symType, int varType,
                             int storageClass);
-    int           pushSymbol(Symbol);
-    int           addString(string val);
-    Symbol createSymbol(string sym, int val, int symType,
+    SymbolId      pushSymbol(Symbol);
+    SymbolId      addString(string val);
+    Symbol createSymbol(Atom sym, int val, int symType,
                                Type varType, int storageClass);
-    int           addToFunction(Symbol s);
-};
+    SymbolId      addToFunction(Symbol s);
 
-/* Global symtable variable */
-extern SymbolTable g_symtable;
\ No newline at end of file
+    /* Precompiled headers (see pch.h), only the global scope is saved */
+    void saveGlobals(PchWriter &out);
+    void restoreGlobals(PchReader &in);
+};
@@ -3,44 +3,11 @@
 #include <core.h>
 #include <string>
 
-static const string toknames[]
-{
-    "EOF (end of file)", 
-    "+ (plus)", "- (minus)", "* (star)", "/ (slash)", "% (percent sign)",
-    "| (bitwise or)", "^ (bitwise xor)", "& (ampersant)", "<< (left shift)", ">> (right shift)",
-    
-    "== (equal to)", "!= (not equal to)", "< (less than)", "> (greater than)", 
-    "<= (less than or equal to)", ">= (greater than or equal to)",
-    "&& (logical and)", "|| (logical or)",
-    "! (logical not)", 
-    
-    "= (equalsign)", 
-    ": (colon)", "? (questionmark)",
-    
-    "++ (increment)", "-- (decrement)", "~ (bitwise negate)",
-
-    "integer literal", "string literal",
-    "identifier",
-    "; (semicolon)", "{ (left brace)", "} (right brace)", 
-    "( (left parenthesis)", ") (right parenthesis)", ", (comma)",
-    "[ (left bracket)", "] (right bracket)", ". (dot)",
-    
-    "void", "char", "short", "int", "long", "double", "float",
-    "unsigned", "signed", "const",
-    "if", "else", "while", "for", "do", "return", 
-    "sizeof",
-    "typedef", "struct", "union", "enum",
-    "auto", "static", "register", "extern",
-    "restrict", "attribute", "asm", "volatile",
-    "goto", "switch", "case", "default",
-    "break", "continue"
-};
-
 class Token
 {
 private:
     int     m_token = 0;
-    int     m_intValue = 0;
+    int64_t m_intValue = 0;
     
     int     m_startLine = 0;
     int     m_endLine = 0;
@@ -93,9 +60,9 @@ public:
     Token() {}
     Token(int tok) { m_intValue = tok; }
     int token();
-    int intValue();
+    int64_t intValue();
     Token *previousToken();
-    void set(int tok, int value, int line, int col);
+    void set(int tok, int64_t value, int line, int col);
     void set(int tok, int line, int col);
     
     int startLine();
@@ -1,47 +1,111 @@
 #pragma once
 
 #include <memtable.h>
+#include <atoms.h>
 
 /* forward declare ast_node to keep this header standalone */
 struct ast_node;
 struct StructItem;
+struct StructDef;
 struct Symbol;
+class PchWriter;
+class PchReader;
 
 #define BYTE  8
 #define WORD  16
 #define DWORD 32
 #define QWORD 64
 
-static string typeNames[] = {"nulltype", "void", "char",
-                             "short",    "int",  "long",
-                             "float", "double"};
+/* Read only view of the members of a struct or union, empty otherwise */
+class StructMembers
+{
+  private:
+    const StructDef *m_def = NULL;
+
+  public:
+    StructMembers() = default;
+    StructMembers(const StructDef *def) : m_def(def) {}
+
+    size_t            size() const;
+    const StructItem &operator[](size_t i) const;
+    const StructItem *begin() const;
+    const StructItem *end() const;
+    int               find(Atom name) const;
+
+    bool operator==(const StructMembers &o) const { return m_def == o.m_def; }
+    bool operator!=(const StructMembers &o) const { return m_def != o.m_def; }
+    const StructDef *def() const { return m_def; }
+};
 
 struct Type
 {
-    int  primType; // The primitive type
-    bool isSigned; // Whether the type is signed
-    int  size;     // Variable size (bytes)
+    int  primType = 0;     // The primitive type
+    bool isSigned = false; // Whether the type is signed
+    int  size     = 0;     // Variable size (bytes)
 
-    int ptrDepth; // The dimmention of the pointer (0 if not a pointer)
+    int ptrDepth = 0; // The dimmention of the pointer (0 if not a pointer)
 
-    string *name; // If the type is non primitive (typedef etc) then
-                  // the name will be stored here (can be null obviously)
-    int typeType; // The type of type (I know what a name)
-    bool isArray;
+    Atom name = NOATOM; // If the type is non primitive (typedef etc) then
+                        // the name will be stored here (can be NOATOM obviously)
+    int typeType = 0;   // The type of type (I know what a name)
+    bool isArray = false;
 
-    vector<struct StructItem> contents; // The contents of a type
+    StructMembers contents; // The contents of a type (shared, see StructDef)
 
-    bool incomplete; // Is the type incomplete (forward declare etc)
-    MemorySpot *memSpot;
+    bool incomplete = false; // Is the type incomplete (forward declare etc)
+    MemorySpot *memSpot = NULL;
 };
 
 struct StructItem
 {
     Type itemType; // The type of the item
     int         offset;   // The stack offset to this variable
-    string      name;
+    Atom        name;
+};
+
+/**
+ * @brief   The members of a struct or union. Every declaration creates one
+ *          and all Types of that aggregate point to it, member lookups go
+ *          through the name index.
+ */
+struct StructDef
+{
+    vector<StructItem>       items;
+    unordered_map<Atom, int> index; // member name -> position in items
+
+    void add(const StructItem &item);
 };
 
+inline size_t StructMembers::size() const
+{
+    return m_def ? m_def->items.size() : 0;
+}
+
+inline const StructItem &StructMembers::operator[](size_t i) const
+{
+    return m_def->items[i];
+}
+
+inline const StructItem *StructMembers::begin() const
+{
+    return m_def ? m_def->items.data() : NULL;
+}
+
+inline const StructItem *StructMembers::end() const
+{
+    return m_def ? m_def->items.data() + m_def->items.size() : NULL;
+}
+
+/// @brief  Returns the position of the member, -1 if there is none
+inline int StructMembers::find(Atom name) const
+{
+    if (!m_def)
+        return -1;
+
+    auto it = m_def->index.find(name);
+    return it == m_def->index.end() ? -1 : it->second;
+}
+
 #define CHAR_SIZE  (BYTE / 8)
 #define SHORT_SIZE (WORD / 8)
 #define INT_SIZE   (DWORD / 8)
@@ -92,18 +156,51 @@ class TypeList
 {
   private:
     // This list will hold named types like structs, unions and typedefs
-    list<Type> m_namedTypes;
+    unordered_map<Atom, Type> m_namedTypes;
+    deque<StructDef>          m_structs;
 
   public:
-    Type getType(string ident);
+    /* Numbers the names of anonymous structs, unions and enums */
+    int anonStructCount = 0;
+    int anonEnumCount   = 0;
+
+  public:
+    const Type &getType(Atom ident);
     void        addType(Type);
-    void        replace(string ident, Type t);
+    void        replace(Atom ident, Type t);
+    StructDef  *newStruct();
+
+    /* Precompiled headers (see pch.h) */
+    void save(PchWriter &out);
+    void restore(PchReader &in);
+};
+
+/* Named types of the active compilation */
+#define g_typeList (g_context->typeList)
+
+typedef uint32_t TypeId;
+
+/**
+ * @brief   Interns types so ast nodes can refer to them with a small id.
+ *          The memory spot is not part of a type's identity, interned types
+ *          never carry one.
+ */
+class TypeTable
+{
+  private:
+    deque<Type>                       m_types;
+    unordered_multimap<size_t, TypeId> m_index;
+
+  public:
+    TypeId      intern(const Type &t);
+    const Type &get(TypeId id) const { return m_types[id]; }
 };
 
-extern TypeList g_typeList;
+/* Type table of the active compilation */
+#define g_typeTable (g_context->typeTable)
 
 int              equalType(Type l, Type r);
-string           typeString(Type *t);
+string           typeString(const Type *t);
 Type      tokenToType(vector<int> &tokens);
 Type      guessType(int val, bool isSigned);
 ast_node *typeCompatible(ast_node *left, ast_node *right,
@@ -112,7 +209,7 @@ int              typeFits(Type *type, int value);
 int              truncateOverflow(Type type, int value);
 int              typeToSize(int type);
 void             dereference(Type *ptr);
-int              findStructItem(string item, Type t);
+int              findStructItem(Atom item, const Type &t);
 
 int getArraySize(Symbol *s);
-int getTypeSize(Symbol sym);
\ No newline at end of file
+int getTypeSize(Symbol &sym);
\ No newline at end of file
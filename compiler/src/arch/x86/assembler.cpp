@@ -0,0 +1,738 @@
+#include <arch/x86/assembler.h>
+#include <arch/x86/instructions.h>
+#include <context.h>
+#include <errorhandler.h>
+
+static bool fitsInt8(int32_t v)
+{
+    return v >= -128 && v <= 127;
+}
+
+static string trim(const string &s)
+{
+    size_t start = s.find_first_not_of(" \t");
+    if (start == string::npos)
+        return "";
+
+    return s.substr(start, s.find_last_not_of(" \t") - start + 1);
+}
+
+static bool isNumber(const string &s)
+{
+    return s.size() && (isdigit(s[0]) || (s[0] == '-' && s.size() > 1 &&
+                                          isdigit(s[1])));
+}
+
+/// @brief  The operand size of a two operand instruction
+static int operandSize(const string &op, int dest, int src)
+{
+    if (dest && src && dest != src)
+        g_err.fatalNL("Operand sizes of " + HL(op) + " don't match");
+
+    return dest ? dest : (src ? src : 4);
+}
+
+AssemblerX86::AssemblerX86(const string &path, const string &sourceFile)
+    : m_obj(sourceFile), m_path(path)
+{
+    m_text = m_obj.addSection(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                              16);
+    m_data = m_obj.addSection(".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 4);
+
+    // We never need an executable stack
+    m_obj.addSection(".note.GNU-stack", SHT_PROGBITS, 0, 1);
+
+    m_cur = m_text;
+}
+
+void AssemblerX86::emit8(uint8_t b)
+{
+    bytes().push_back(b);
+}
+
+void AssemblerX86::emit16(uint16_t w)
+{
+    emit8(w);
+    emit8(w >> 8);
+}
+
+void AssemblerX86::emit32(uint32_t d)
+{
+    emit16(d);
+    emit16(d >> 16);
+}
+
+/// @brief  Emits a 32 bit reference to symbol, the addend is stored in place
+void AssemblerX86::emitRef(const string &symbol, int32_t addend, bool relative)
+{
+    m_fixups.push_back({m_cur, offset(), symbol, relative});
+    emit32(addend);
+}
+
+void AssemblerX86::emitImm(const Operand &imm, int size)
+{
+    if (imm.symbol.size())
+    {
+        if (size != 4)
+            g_err.fatalNL("Symbol " + HL(imm.symbol) + " used as a " +
+                        to_string(size * 8) + " bit immediate");
+
+        emitRef(imm.symbol, imm.disp, false);
+    }
+    else if (size == 1)
+        emit8(imm.disp);
+    else if (size == 2)
+        emit16(imm.disp);
+    else
+        emit32(imm.disp);
+}
+
+void AssemblerX86::emitModRM(int regField, const Operand &rm)
+{
+    if (rm.kind == OP_REG)
+    {
+        emit8(0xc0 | regField << 3 | rm.reg);
+        return;
+    }
+
+    if (rm.kind != OP_MEM)
+        g_err.fatalNL("Expected a register or memory operand");
+
+    // Absolute address: [disp32]
+    if (rm.reg == -1)
+    {
+        emit8(regField << 3 | 5);
+        if (rm.symbol.size())
+            emitRef(rm.symbol, rm.disp, false);
+        else
+            emit32(rm.disp);
+        return;
+    }
+
+    if (rm.symbol.size())
+        g_err.fatalNL("Cannot address " + HL(rm.symbol) + " relative to a "
+                    "register");
+
+    // [ebp] has no mod 0 encoding, that one means [disp32]
+    int mod = 2;
+    if (rm.disp == 0 && rm.reg != X86_EBP)
+        mod = 0;
+    else if (fitsInt8(rm.disp))
+        mod = 1;
+
+    emit8(mod << 6 | regField << 3 | rm.reg);
+
+    // esp as a base needs a SIB byte
+    if (rm.reg == X86_ESP)
+        emit8(0x24);
+
+    if (mod == 1)
+        emit8(rm.disp);
+    else if (mod == 2)
+        emit32(rm.disp);
+}
+
+/// @brief  Local labels (starting with a '.') belong to the previous label,
+///         like in NASM
+string AssemblerX86::qualify(const string &name)
+{
+    if (name.size() && name[0] == '.')
+        return m_scope + name;
+
+    return name;
+}
+
+AssemblerX86::Operand AssemblerX86::parseOperand(string text)
+{
+    Operand op;
+    text = trim(text);
+    if (text.empty())
+        return op;
+
+    static const struct
+    {
+        const char *name;
+        int         size;
+    } sizes[] = {{"dword", 4}, {"word", 2}, {"byte", 1}};
+
+    for (auto &s : sizes)
+    {
+        size_t len = strlen(s.name);
+        if (!text.compare(0, len, s.name) && text.size() > len &&
+            (text[len] == ' ' || text[len] == '['))
+        {
+            op.size = s.size;
+            text    = trim(text.substr(len));
+            break;
+        }
+    }
+
+    if (text[0] == '[')
+    {
+        if (text.back() != ']')
+            g_err.fatalNL("Invalid memory operand: '" + text + "'");
+
+        op.kind   = OP_MEM;
+        string in = text.substr(1, text.size() - 2);
+
+        size_t pos = 0;
+        int    sign = 1;
+        while (pos < in.size())
+        {
+            size_t end = in.find_first_of("+-", pos);
+            if (end == string::npos)
+                end = in.size();
+
+            string term = trim(in.substr(pos, end - pos));
+            int    reg, size;
+
+            if (term.empty())
+                ;
+            else if (X86Operand::parseRegister(term, reg, size) && size == 4 && op.reg == -1)
+                op.reg = reg;
+            else if (isNumber(term))
+                op.disp += sign * (int32_t) strtoll(term.c_str(), NULL, 0);
+            else if (op.symbol.empty() && sign == 1)
+                op.symbol = qualify(term);
+            else
+                g_err.fatalNL("Invalid memory operand: '" + text + "'");
+
+            if (end < in.size())
+                sign = in[end] == '-' ? -1 : 1;
+            pos = end + 1;
+        }
+
+        return op;
+    }
+
+    if (X86Operand::parseRegister(text, op.reg, op.size))
+    {
+        op.kind = OP_REG;
+        return op;
+    }
+
+    if (isNumber(text))
+    {
+        op.kind = OP_IMM;
+        op.disp = strtoll(text.c_str(), NULL, 0);
+        return op;
+    }
+
+    op.kind   = OP_SYM;
+    op.symbol = qualify(text);
+    return op;
+}
+
+void AssemblerX86::section(const string &name)
+{
+    if (name == ".text")
+        m_cur = m_text;
+    else if (name == ".data")
+        m_cur = m_data;
+    else
+        g_err.fatalNL("Unsupported section: " + HL(name));
+}
+
+void AssemblerX86::global(const string &name)
+{
+    m_globals.push_back(name);
+}
+
+void AssemblerX86::externSymbol(const string &name)
+{
+    // Symbols that are never defined become external ones anyway
+}
+
+void AssemblerX86::label(StringView name)
+{
+    bool   local = name[0] == '.';
+    string full  = qualify(name.str());
+
+    if (!local)
+        m_scope = full;
+
+    if (!m_labels.insert({full, {m_cur, offset(), local}}).second)
+        g_err.fatalNL("Symbol " + HL(full) + " is defined more than once");
+
+    m_labelOrder.push_back(full);
+}
+
+void AssemblerX86::data(int size, const vector<string> &values)
+{
+    for (const string &v : values)
+    {
+        Operand item = parseOperand(v);
+        if (item.kind == OP_SYM)
+        {
+            item.kind = OP_IMM;
+            item.disp = 0;
+        }
+        else if (item.kind != OP_IMM)
+            g_err.fatalNL("Invalid data value: '" + v + "'");
+
+        if (size == 8)
+        {
+            int64_t value = strtoll(v.c_str(), NULL, 0);
+            emit32(value);
+            emit32(value >> 32);
+        }
+        else
+            emitImm(item, size);
+    }
+}
+
+void AssemblerX86::zeros(int size, int count)
+{
+    bytes().resize(bytes().size() + size * count, 0);
+}
+
+void AssemblerX86::instruction(StringView op, StringView dest, StringView src)
+{
+    // Operands can be part of the instruction string ("ret 0x4")
+    string mnemonic = op.str();
+    string first    = dest.str();
+    size_t space    = mnemonic.find_first_of(" \t");
+    if (space != string::npos && dest.empty())
+    {
+        first    = mnemonic.substr(space + 1);
+        mnemonic = mnemonic.substr(0, space);
+    }
+
+    int code, cond = 0;
+    if (!X86Instr::parseMnemonic(mnemonic, code, cond))
+        g_err.fatalNL("The built-in assembler does not support " +
+                      HL(mnemonic) + ", use an external one (-a)");
+
+    Operand d = parseOperand(first);
+    Operand s = parseOperand(src.str());
+    encode(code, cond, d, s);
+}
+
+/// @brief  The operand of a generated instruction, as if it was parsed
+AssemblerX86::Operand AssemblerX86::operand(const X86Operand &x)
+{
+    Operand op;
+    op.size = x.size;
+    op.reg  = x.reg;
+    op.disp = x.disp;
+
+    switch (x.kind)
+    {
+    case X86Operand::REG:
+        op.kind = OP_REG;
+        break;
+    case X86Operand::IMM:
+        op.kind = OP_IMM;
+        break;
+    case X86Operand::MEM:
+        op.kind = OP_MEM;
+        if (x.symbol != NOATOM)
+            op.symbol = g_atoms.str(x.symbol);
+        break;
+    case X86Operand::SYMBOL:
+        op.kind   = OP_SYM;
+        op.symbol = g_atoms.str(x.symbol);
+        break;
+    case X86Operand::LABEL:
+    {
+        AsmOperand name;
+        x.format(name);
+        op.kind   = OP_SYM;
+        op.symbol = qualify(StringView(name).str());
+        break;
+    }
+    }
+
+    return op;
+}
+
+/// @brief  Encodes a generated instruction, its operands are never text
+void AssemblerX86::instruction(const X86Instr &instr)
+{
+    Operand d = operand(instr.dest);
+    Operand s = operand(instr.src);
+    encode(instr.op, instr.cond, d, s);
+}
+
+void AssemblerX86::encodeMov(Operand &dest, Operand &src)
+{
+    int size = operandSize("mov", dest.size, src.size);
+    if (size == 2)
+        emit8(0x66);
+
+    if (src.kind == OP_REG && (dest.kind == OP_REG || dest.kind == OP_MEM))
+    {
+        emit8(size == 1 ? 0x88 : 0x89);
+        emitModRM(src.reg, dest);
+    }
+    else if (dest.kind == OP_REG && src.kind == OP_MEM)
+    {
+        emit8(size == 1 ? 0x8a : 0x8b);
+        emitModRM(dest.reg, src);
+    }
+    else if (dest.kind == OP_REG && (src.kind == OP_IMM || src.kind == OP_SYM))
+    {
+        emit8((size == 1 ? 0xb0 : 0xb8) + dest.reg);
+        emitImm(src, size);
+    }
+    else if (dest.kind == OP_MEM && src.kind == OP_IMM)
+    {
+        emit8(size == 1 ? 0xc6 : 0xc7);
+        emitModRM(0, dest);
+        emitImm(src, size);
+    }
+    else
+        g_err.fatalNL("Cannot encode this form of 'mov'");
+}
+
+void AssemblerX86::encodeAlu(int ext, Operand &dest, Operand &src)
+{
+    int size = operandSize(X86Instr::name(ext), dest.size, src.size);
+    if (size == 2)
+        emit8(0x66);
+
+    if (src.kind == OP_IMM)
+    {
+        if (size == 1)
+            emit8(0x80);
+        else if (src.symbol.empty() && fitsInt8(src.disp))
+        {
+            emit8(0x83);
+            size = 1;
+        }
+        else
+            emit8(0x81);
+
+        emitModRM(ext, dest);
+        emitImm(src, size);
+    }
+    else if (src.kind == OP_REG)
+    {
+        emit8(ext * 8 + (size == 1 ? 0 : 1));
+        emitModRM(src.reg, dest);
+    }
+    else if (dest.kind == OP_REG && src.kind == OP_MEM)
+    {
+        emit8(ext * 8 + (size == 1 ? 2 : 3));
+        emitModRM(dest.reg, src);
+    }
+    else
+        g_err.fatalNL("Cannot encode this form of an arithmetic instruction");
+}
+
+/// @brief  The one operand groups: opcode is the byte sized form, the next
+///         one takes word and dword operands
+void AssemblerX86::encodeUnary(uint8_t opcode, int ext, Operand &dest)
+{
+    int size = dest.size ? dest.size : 4;
+    if (size == 2)
+        emit8(0x66);
+
+    emit8(size == 1 ? opcode : opcode + 1);
+    emitModRM(ext, dest);
+}
+
+void AssemblerX86::encodeShift(int ext, Operand &dest, Operand &src)
+{
+    int size = dest.size ? dest.size : 4;
+    if (size == 2)
+        emit8(0x66);
+
+    int wide = size != 1;
+    if (src.kind == OP_REG && src.reg == 1 && src.size == 1)
+    {
+        emit8(0xd2 + wide);
+        emitModRM(ext, dest);
+    }
+    else if (src.kind == OP_IMM && src.disp == 1)
+    {
+        emit8(0xd0 + wide);
+        emitModRM(ext, dest);
+    }
+    else if (src.kind == OP_IMM)
+    {
+        emit8(0xc0 + wide);
+        emitModRM(ext, dest);
+        emit8(src.disp);
+    }
+    else
+        g_err.fatalNL("Shifts take 'cl' or an immediate as count");
+}
+
+/// @brief  jmp (cond -1), jcc or call (cond -2)
+void AssemblerX86::encodeJump(int cond, const Operand &target)
+{
+    if (target.kind == OP_SYM)
+    {
+        if (cond == -2)
+            emit8(0xe8);
+        else if (cond == -1)
+            emit8(0xe9);
+        else
+        {
+            emit8(0x0f);
+            emit8(0x80 + cond);
+        }
+
+        // The displacement is relative to the end of the instruction
+        emitRef(target.symbol, -4, true);
+    }
+    else if (cond < 0 && (target.kind == OP_REG || target.kind == OP_MEM))
+    {
+        emit8(0xff);
+        emitModRM(cond == -2 ? 2 : 4, target);
+    }
+    else
+        g_err.fatalNL("Invalid jump target");
+}
+
+void AssemblerX86::encode(int op, int cond, Operand &dest, Operand &src)
+{
+    // The arithmetic group is numbered by its /digit
+    if (op <= X86_CMP)
+        return encodeAlu(op, dest, src);
+
+    switch (op)
+    {
+    case X86_MOV:
+        return encodeMov(dest, src);
+
+    case X86_TEST:
+    {
+        int size = operandSize("test", dest.size, src.size);
+        if (size == 2)
+            emit8(0x66);
+
+        if (src.kind == OP_REG)
+        {
+            emit8(size == 1 ? 0x84 : 0x85);
+            emitModRM(src.reg, dest);
+        }
+        else
+        {
+            emit8(size == 1 ? 0xf6 : 0xf7);
+            emitModRM(0, dest);
+            emitImm(src, size);
+        }
+        return;
+    }
+
+    case X86_IMUL:
+        if (src.kind == OP_NONE)
+            return encodeUnary(0xf6, 5, dest);
+
+        if (dest.kind != OP_REG)
+            g_err.fatalNL("The destination of 'imul' must be a register");
+
+        if (dest.size == 2)
+            emit8(0x66);
+        emit8(0x0f);
+        emit8(0xaf);
+        emitModRM(dest.reg, src);
+        return;
+
+    case X86_NOT:
+        return encodeUnary(0xf6, 2, dest);
+    case X86_NEG:
+        return encodeUnary(0xf6, 3, dest);
+    case X86_MUL:
+        return encodeUnary(0xf6, 4, dest);
+    case X86_DIV:
+        return encodeUnary(0xf6, 6, dest);
+    case X86_IDIV:
+        return encodeUnary(0xf6, 7, dest);
+
+    case X86_INC:
+    case X86_DEC:
+    {
+        int ext = op == X86_DEC;
+        if (dest.kind == OP_REG && dest.size != 1)
+        {
+            if (dest.size == 2)
+                emit8(0x66);
+            emit8(0x40 + ext * 8 + dest.reg);
+        }
+        else
+            encodeUnary(0xfe, ext, dest);
+        return;
+    }
+
+    case X86_SHL:
+        return encodeShift(4, dest, src);
+    case X86_SHR:
+        return encodeShift(5, dest, src);
+    case X86_SAR:
+        return encodeShift(7, dest, src);
+
+    case X86_MOVZX:
+    case X86_MOVSX:
+        if (dest.kind != OP_REG || (src.size != 1 && src.size != 2))
+            g_err.fatalNL("Cannot encode this form of '" +
+                          string(X86Instr::name(op)) + "'");
+
+        if (dest.size == 2)
+            emit8(0x66);
+        emit8(0x0f);
+        emit8((op == X86_MOVZX ? 0xb6 : 0xbe) + (src.size == 2));
+        emitModRM(dest.reg, src);
+        return;
+
+    case X86_LEA:
+        if (dest.kind != OP_REG || src.kind != OP_MEM)
+            g_err.fatalNL("Cannot encode this form of 'lea'");
+
+        emit8(0x8d);
+        emitModRM(dest.reg, src);
+        return;
+
+    case X86_PUSH:
+        if (dest.kind == OP_REG)
+        {
+            if (dest.size == 2)
+                emit8(0x66);
+            emit8(0x50 + dest.reg);
+        }
+        else if (dest.kind == OP_IMM && dest.symbol.empty() &&
+                 fitsInt8(dest.disp))
+        {
+            emit8(0x6a);
+            emit8(dest.disp);
+        }
+        else if (dest.kind == OP_IMM || dest.kind == OP_SYM)
+        {
+            emit8(0x68);
+            emitImm(dest, 4);
+        }
+        else
+        {
+            emit8(0xff);
+            emitModRM(6, dest);
+        }
+        return;
+
+    case X86_POP:
+        if (dest.kind == OP_REG)
+        {
+            if (dest.size == 2)
+                emit8(0x66);
+            emit8(0x58 + dest.reg);
+        }
+        else
+        {
+            emit8(0x8f);
+            emitModRM(0, dest);
+        }
+        return;
+
+    case X86_JMP:
+        return encodeJump(-1, dest);
+    case X86_CALL:
+        return encodeJump(-2, dest);
+    case X86_JCC:
+        return encodeJump(cond, dest);
+
+    case X86_SETCC:
+        emit8(0x0f);
+        emit8(0x90 + cond);
+        emitModRM(0, dest);
+        return;
+
+    case X86_RET:
+        if (dest.kind == OP_IMM)
+        {
+            emit8(0xc2);
+            emit16(dest.disp);
+        }
+        else
+            emit8(0xc3);
+        return;
+
+    case X86_INT:
+        emit8(0xcd);
+        emit8(dest.disp);
+        return;
+
+    case X86_LEAVE:
+        return emit8(0xc9);
+    case X86_CDQ:
+        return emit8(0x99);
+    case X86_CWDE:
+        return emit8(0x98);
+    case X86_NOP:
+        return emit8(0x90);
+    case X86_HLT:
+        return emit8(0xf4);
+    }
+
+    g_err.fatalNL("The built-in assembler does not support " +
+                  HL(X86Instr::name(op)) + ", use an external one (-a)");
+}
+
+/// @brief  Resolves what can be resolved, the rest becomes symbols and
+///         relocations of the object
+ObjectFile &AssemblerX86::finish()
+{
+    unordered_map<string, int> symbols;
+
+    for (const string &name : m_labelOrder)
+    {
+        const Label &l = m_labels[name];
+        bool isGlobal  = hasItem(m_globals, name);
+
+        // Local labels are only needed inside this object
+        if (l.local && !isGlobal)
+            continue;
+
+        symbols[name] = m_obj.addSymbol(name, l.section, l.offset,
+                                        isGlobal ? STB_GLOBAL : STB_LOCAL);
+    }
+
+    for (const Fixup &f : m_fixups)
+    {
+        uint8_t *field = &m_obj.section(f.section).bytes[f.offset];
+        int32_t  addend;
+        memcpy(&addend, field, 4);
+
+        auto it = m_labels.find(f.symbol);
+        if (it != m_labels.end())
+        {
+            const Label &l = it->second;
+            addend += l.offset;
+
+            // A jump inside the section doesn't need the linker
+            if (f.relative && l.section == f.section)
+                addend -= f.offset;
+            else
+                m_obj.addRelocation(f.section, f.offset,
+                                    m_obj.section(l.section).symbol,
+                                    f.relative ? R_386_PC32 : R_386_32);
+
+            memcpy(field, &addend, 4);
+            continue;
+        }
+
+        // C names don't have dots, this is a local label that was never placed
+        if (f.symbol.find('.') != string::npos)
+            g_err.fatalNL("Undefined label " + HL(f.symbol));
+
+        auto sym = symbols.find(f.symbol);
+        if (sym == symbols.end())
+            sym = symbols
+                      .insert({f.symbol, m_obj.addSymbol(f.symbol, SHN_UNDEF, 0,
+                                                         STB_GLOBAL)})
+                      .first;
+
+        m_obj.addRelocation(f.section, f.offset, sym->second,
+                            f.relative ? R_386_PC32 : R_386_32);
+    }
+
+    return m_obj;
+}
+
+/// @brief  Finishes the object, it's only written if there's a path
+void AssemblerX86::close()
+{
+    finish();
+    if (m_path.size())
+        m_obj.write(m_path);
+}
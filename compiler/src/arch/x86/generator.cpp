@@ -1,4 +1,7 @@
 #include <arch/x86/generator.h>
+#include <arch/x86/peephole.h>
+#include <arch/x86/regalloc.h>
+#include <context.h>
 #include <errorhandler.h>
 #include <symbols.h>
 #include <types.h>
@@ -17,7 +20,7 @@ int _sizeToDataSize(int size)
     case LONGLONG_SIZE:
         return 3;
     default:
-        err.fatalNL("Unsupported data size: " + size);
+        g_err.fatalNL("Unsupported data size: " + size);
     }
 }
 
@@ -32,7 +35,7 @@ int _regFromSize(int size)
     case INT_SIZE:
         return 1;
     default:
-        err.warning("Could not translate operant size to register size (" +
+        g_err.warning("Could not translate operant size to register size (" +
                     to_string(size) + ")");
     
         return 1;
@@ -56,129 +59,179 @@ int _dataSizeFromRegSize(int regsize)
     return 0;
 }
 
-GeneratorX86::GeneratorX86(string outfile) : Generator(outfile)
+static const X86Operand eax = X86Operand::regOp(X86_EAX);
+static const X86Operand ecx = X86Operand::regOp(X86_ECX);
+static const X86Operand edx = X86Operand::regOp(X86_EDX);
+static const X86Operand esp = X86Operand::regOp(X86_ESP);
+static const X86Operand ebp = X86Operand::regOp(X86_EBP);
+
+/* What a function has to keep for its caller, if it uses them it saves
+ * them in its frame */
+static const int calleeSaved[] = {X86_EBX, X86_ESI, X86_EDI};
+
+GeneratorX86::GeneratorX86(CompilationContext &ctx, AsmOutput *out)
+    : Generator(ctx, out)
 {
     freeAllReg();
-    fprintf(m_outfile, "section .text\nglobal main\n");
+    m_out->section(".text");
+    m_out->global("main");
 }
 
-string GeneratorX86::getReg(int r)
+void GeneratorX86::emit(int op, const X86Operand &dest, const X86Operand &src)
 {
-    if (!m_usedRegisters[r])
-    {
-        err.warningNL("Register: " + m_dwordRegisters[r] + " is unused");
-        return m_dwordRegisters[r];
-    }
-    else
-    {
-        return m_registers[m_usedRegisters[r] - 1][r];
-    }
+    m_code.add(X86Instr(op, dest, src));
 }
 
-void GeneratorX86::freeAllReg()
+void GeneratorX86::emitCond(int op, int cond, const X86Operand &dest)
 {
-    m_spilledRegisters = 0;
-    for (int i = 0; i < SIZE(m_usedRegisters); i++)
-        m_usedRegisters[i] = 0;
+    X86Instr instr(op, dest);
+    instr.cond = cond;
+    m_code.add(instr);
 }
 
-void GeneratorX86::spillReg(int reg)
+/// @brief  A mov, unless it would move a register into itself
+void GeneratorX86::move(const X86Operand &dest, const X86Operand &src)
 {
-    write("push", getReg(reg));
+    if (dest != src)
+        emit(X86_MOV, dest, src);
 }
 
-void GeneratorX86::loadReg(int reg)
+/// @brief  Gives the virtual registers of the function physical ones and
+///         saves the registers it got that the caller wants back
+void GeneratorX86::allocateRegisters()
 {
-    write("pop", getReg(reg));
-}
+    RegAllocX86 alloc(m_code, m_usedRegisters.size(), m_frameSize);
+    int         frameSize = alloc.run();
 
-void GeneratorX86::freeReg(int reg)
-{
-    if (m_spilledRegisters && (m_spilledRegisters - 1) % REGAMOUNT == reg)
+    vector<X86Instr> &instrs = m_code.instrs();
+    vector<X86Instr>  saves, restores;
+    for (int reg : calleeSaved)
     {
-        loadReg(reg);
-        m_spilledRegisters--;
-        return;
+        if (!alloc.used(reg))
+            continue;
+
+        frameSize += 4;
+        X86Operand slot = X86Operand::mem(X86_EBP, -frameSize, 4);
+        saves.push_back(X86Instr(X86_MOV, slot, X86Operand::regOp(reg)));
+        restores.push_back(X86Instr(X86_MOV, X86Operand::regOp(reg), slot));
     }
-    
-    if (m_usedRegisters[reg] == 0)
+
+    instrs[m_frameInstr].src = X86Operand::imm(frameSize);
+
+    // The epilogue is at the end, insert there first so the prologue stays
+    // where it is
+    for (int i = instrs.size() - 1; i > m_frameInstr; i--)
     {
-        err.warningNL("Trying to free a register that is already free: " +
-                      m_dwordRegisters[reg]);
+        if (instrs[i].op == X86_LEAVE)
+            instrs.insert(instrs.begin() + i, restores.begin(), restores.end());
     }
-    m_usedRegisters[reg] = 0;
+    instrs.insert(instrs.begin() + m_frameInstr + 1, saves.begin(), saves.end());
+
+    m_usedRegisters.clear();
+    m_firstUsed = 0;
+    m_promoted.clear();
 }
 
-int GeneratorX86::allocReg()
+/// @brief  Lowers the code generated so far to the output
+void GeneratorX86::flushCode()
+{
+    if (m_optimize)
+        PeepholeX86(m_code, m_optimize).run();
+
+    m_code.lower(*m_out);
+}
+
+/// @brief  A register at the size it is in use with
+X86Operand GeneratorX86::getReg(int r)
 {
-    for (int i = 0; i < SIZE(m_usedRegisters); i++)
+    if (!m_usedRegisters[r])
     {
-        if (!m_usedRegisters[i])
-        {
-            /* Allocate dword register */
-            m_usedRegisters[i] = 1;
-            return i;
-        }
+        m_ctx.errors.warningNL("Register: r" + to_string(r) + " is unused");
+        return dwordReg(r);
     }
-    
-    int reg = m_spilledRegisters % REGAMOUNT;
-    m_spilledRegisters++;
-    spillReg(reg);
-    
-    return reg;
+
+    return X86Operand::regOp(X86_VREG + r, SPECIFYSIZE(m_usedRegisters[r]));
 }
 
-/**
- * @brief   Will allocate a specific register (will free it and return it
- * otherwise it will throw an error)
- *
- * @param   r the register to allocate (index)
- *
- * @return  @todo: explain this
- */
-int GeneratorX86::allocReg(int r)
+X86Operand GeneratorX86::dwordReg(int r)
 {
-    if (!m_usedRegisters[r])
+    return X86Operand::regOp(X86_VREG + r);
+}
+
+X86Operand GeneratorX86::loByteReg(int r)
+{
+    return X86Operand::regOp(X86_VREG + r, 1);
+}
+
+/// @brief  The memory a register points to
+X86Operand GeneratorX86::memAt(int r, int32_t disp, int size)
+{
+    return X86Operand::mem(X86_VREG + r, disp, size);
+}
+
+void GeneratorX86::freeAllReg()
+{
+    for (int i = m_firstUsed; i < m_usedRegisters.size(); i++)
+        m_usedRegisters[i] = 0;
+
+    m_firstUsed = m_usedRegisters.size();
+}
+
+void GeneratorX86::freeReg(int reg)
+{
+    if (m_usedRegisters[reg] == 0)
     {
-        m_usedRegisters[r] = 1;
-        return -1;
+        m_ctx.errors.warningNL("Trying to free a register that is already free: r" +
+                      to_string(reg));
     }
+    m_usedRegisters[reg] = 0;
+}
 
-    int r2 = allocReg();
-    write("mov", getReg(r), getReg(r2));
-    return r2;
+/// @brief  A new virtual register, used as a dword. Which physical register
+///         it ends up in is decided when the function is complete.
+int GeneratorX86::allocReg()
+{
+    m_usedRegisters.push_back(1);
+    return m_usedRegisters.size() - 1;
 }
 
-int GeneratorX86::genFunctionPreamble(int funcIdx)
+int GeneratorX86::genFunctionPreamble(SymbolId funcIdx)
 {
     // Clean all the registers
     freeAllReg();
 
-    Symbol *s = g_symtable.getSymbol(funcIdx);
+    Symbol *s = m_ctx.symtable.getSymbol(funcIdx);
 
     if (s->storageClass == SymbolTable::StorageClass::EXTERN)
-        fprintf(m_outfile, "global %s\n", s->name.c_str());
+        m_out->global(m_ctx.atoms.str(s->name));
 
-    fprintf(m_outfile, "%s:\n", s->name.c_str());
-    write("push", "ebp");
-    write("mov", "esp", "ebp");
-    write("sub", s->localVarAmount + 4, "esp");
+    emit(X86_LABEL, X86Operand::symbolOp(s->name));
+    emit(X86_PUSH, ebp);
+    emit(X86_MOV, ebp, esp);
+
+    // The size is final once the registers are allocated
+    m_frameSize  = s->localVarAmount + 4;
+    m_frameInstr = m_code.instrs().size();
+    emit(X86_SUB, esp, X86Operand::imm(m_frameSize));
     return -1;
 }
 
-int GeneratorX86::genFunctionPostamble(int funcIdx)
+int GeneratorX86::genFunctionPostamble(SymbolId funcIdx)
 {
     int            l;
-    Symbol *s = g_symtable.getSymbol(funcIdx);
+    Symbol *s = m_ctx.symtable.getSymbol(funcIdx);
     if ((l = s->returnLabelId) != -1)
         genLabel(l);
 
-    write("leave");
+    emit(X86_LEAVE);
 
     if (s->varType.typeType == TypeTypes::STRUCT && !s->varType.ptrDepth)
-        write("ret 0x4");
+        emit(X86_RET, X86Operand::imm(4));
     else
-        write("ret");
+        emit(X86_RET);
+
+    allocateRegisters();
+    flushCode();
     return -1;
 }
 
@@ -186,27 +239,27 @@ int GeneratorX86::genLoad(int value, int size)
 {
     int reg              = allocReg();
     m_usedRegisters[reg] = _regFromSize(size);
-    write("mov", value, getReg(reg));
+    emit(X86_MOV, getReg(reg), X86Operand::imm(value));
     return reg;
 }
 
 int GeneratorX86::genAdd(int r1, int r2)
 {
-    write("add", getReg(r2), getReg(r1));
+    emit(X86_ADD, getReg(r1), getReg(r2));
     freeReg(r2);
     return r1;
 }
 
 int GeneratorX86::genSub(int r1, int r2)
 {
-    write("sub", getReg(r2), getReg(r1));
+    emit(X86_SUB, getReg(r1), getReg(r2));
     freeReg(r2);
     return r1;
 }
 
 int GeneratorX86::genMul(int r1, int r2)
 {
-    write("imul", getReg(r2), getReg(r1));
+    emit(X86_IMUL, getReg(r1), getReg(r2));
     freeReg(r2);
     return r1;
 }
@@ -214,43 +267,20 @@ int GeneratorX86::genMul(int r1, int r2)
 int GeneratorX86::_genIDiv(int r1, int r2, bool quotient)
 {
     DEBUG("DIV")
-    bool r3 = false;
-    bool r4 = false;
-    
-    if (m_usedRegisters[EAX] && r1 != EAX)
-    {
-        r3 = true;
-        write("push", "eax");
-        write("mov", getReg(r1), "eax");
-    }
-    
-    if (m_usedRegisters[EDX])
-    {
-        r4 = true;
-        write("push", "edx");
-    }
 
-    write("push", getReg(r2));
+    // The dividend goes in edx:eax, the allocator keeps the divisor out of
+    // both
+    emit(X86_MOV, eax, getReg(r1));
+    emit(X86_CDQ);
+    emit(X86_IDIV, getReg(r2));
     freeReg(r2);
 
-    write("xor", "edx", "edx");
-    move("mov", getReg(r1), "eax");
-    write("cdq");
-    write("idiv", "dword [esp]");
-    
-    string ret = "edx";
-    if (quotient)
-        ret = "eax";
-    move("mov", ret, getReg(r1));
-    write("add", 4, "esp");
+    int out              = allocReg();
+    m_usedRegisters[out] = m_usedRegisters[r1];
+    freeReg(r1);
 
-    if (r4)
-        write("pop", "edx");
-
-    if (r3)
-        write("pop", "eax");
-    
-    return r1;
+    emit(X86_MOV, getReg(out), quotient ? eax : edx);
+    return out;
 }
 
 int GeneratorX86::genDiv(int r1, int r2)
@@ -258,17 +288,21 @@ int GeneratorX86::genDiv(int r1, int r2)
     return _genIDiv(r1, r2, true);
 }
 
-string variableAccess(int symbol, int offset = 0)
+/// @brief  The memory operand of a variable, size is 0 if the register it
+///         is used with decides
+static X86Operand variableAccess(SymbolTable &symtable, SymbolId symbol,
+                                 int offset = 0, int size = 0)
 {
-    Symbol *s = g_symtable.getSymbol(symbol);
+    Symbol *s = symtable.getSymbol(symbol);
 
-    // The variable is a local variable if the lower 8 bits of symbol contain a
-    // value
-    if (symbol & 0xFF && s->storageClass != SymbolTable::StorageClass::EXTERN)
+    // The variable is a local variable if it wasn't declared in global scope
+    if (s->scope != GLOBALSCOPE &&
+        s->storageClass != SymbolTable::StorageClass::EXTERN)
     {
         if (s->symType == SymbolTable::SymTypes::ARGUMENT)
         {
-            return "ebp+" + to_string(s->stackLoc * 4 + 8 + offset);
+            return X86Operand::mem(X86_EBP, s->stackLoc * 4 + 8 + offset,
+                                   size);
         }
         else
         {
@@ -280,79 +314,128 @@ string variableAccess(int symbol, int offset = 0)
             else if (s->varType.isArray /*&& !(s->varType.ptrDepth - 1) */)
                 offset += varSize - 4;
 
-            return "ebp-" + to_string(s->stackLoc + 4 + offset);
+            return X86Operand::mem(X86_EBP, -(s->stackLoc + 4 + offset),
+                                   size);
         }
     }
     else
-    {
-        return s->name + (offset ? ("+" + to_string(offset)) : "");
-    }
+        return X86Operand::global(s->name, offset, size);
 }
 
-int GeneratorX86::genLoadVariable(int symbol, Type t)
+int GeneratorX86::genLoadVariable(SymbolId symbol, const Type &t)
 {
     int reg = allocReg();
 
     // Clear the register if it is smaller then a DWORD
     // if (regs != 1)
-    //    write("xor", m_dwordRegisters[reg], m_dwordRegisters[reg]);
+    //    emit(X86_XOR, dwordReg(reg), dwordReg(reg));
     
-    Symbol *s = g_symtable.getSymbol(symbol);
+    Symbol *s = m_ctx.symtable.getSymbol(symbol);
 
     if (s->varType.isArray)
     {
         m_usedRegisters[reg] = 1;
-        write("lea", MEMACCESS(variableAccess(symbol)), getReg(reg));
+        emit(X86_LEA, getReg(reg), variableAccess(m_ctx.symtable, symbol));
     }
     else if (t.typeType == TypeTypes::STRUCT && !t.ptrDepth)
     {
-        write("lea", MEMACCESS(variableAccess(symbol)), getReg(reg));
+        emit(X86_LEA, getReg(reg), variableAccess(m_ctx.symtable, symbol));
     }
     else
     {
         int regs             = _regFromSize(t.size);
         m_usedRegisters[reg] = regs;
-        write("mov", MEMACCESS(variableAccess(symbol)), getReg(reg));
+
+        X86Operand var = variableReg(symbol);
+        if (var.is(X86Operand::NONE))
+            var = variableAccess(m_ctx.symtable, symbol);
+        else
+            var.size = SPECIFYSIZE(regs);
+
+        emit(X86_MOV, getReg(reg), var);
     }
 
     return reg;
 }
 
-int GeneratorX86::genStoreValue(int reg1, int memloc, Type t)
+/// @brief  The register a local that doesn't need memory lives in, at the
+///         size of its type. NONE if it stays in its stack slot.
+X86Operand GeneratorX86::variableReg(SymbolId symbol)
+{
+    if (!promotable(symbol))
+        return X86Operand();
+
+    Symbol    *s   = m_ctx.symtable.getSymbol(symbol);
+    X86Operand var = X86Operand::regOp(0, s->varType.size);
+
+    auto it = m_promoted.find(symbol);
+    if (it != m_promoted.end())
+    {
+        var.reg = X86_VREG + it->second;
+        return var;
+    }
+
+    var.reg            = X86_VREG + allocReg();
+    m_promoted[symbol] = var.reg - X86_VREG;
+
+    // Arguments are passed on the stack, they are loaded on entry
+    if (s->symType == SymbolTable::SymTypes::ARGUMENT)
+    {
+        vector<X86Instr> &instrs = m_code.instrs();
+        instrs.insert(instrs.begin() + m_frameInstr + 1,
+                      X86Instr(X86_MOV, var,
+                               variableAccess(m_ctx.symtable, symbol)));
+    }
+
+    return var;
+}
+
+/// @brief  Assigns to a local that lives in a register
+int GeneratorX86::genStoreVariable(int reg, SymbolId symbol, const Type &t)
+{
+    X86Operand var   = variableReg(symbol);
+    X86Operand value = getReg(reg);
+
+    value.size = var.size;
+    emit(X86_MOV, var, value);
+    return reg;
+}
+
+int GeneratorX86::genStoreValue(int reg1, SymbolId memloc, const Type &t)
 {
     if (t.typeType == TypeTypes::STRUCT && !t.ptrDepth)
     {
-        for (struct StructItem s : t.contents)
+        for (const struct StructItem &s : t.contents)
         {
             // mov [reg1 + offset] -> tmp
             // mov tmp -> [memloc + offset]symType ==
             // SymbolTable::SymTypes::ARRAY
             int tmp = allocReg();
-            write("mov", "[" + getReg(reg1) + "+" + to_string(s.offset) +"]", getReg(tmp));
-            write("mov", getReg(tmp), "[" + getReg(memloc) + "+" + to_string(s.offset) +"]");
+            emit(X86_MOV, getReg(tmp), memAt(reg1, s.offset));
+            emit(X86_MOV, memAt(memloc, s.offset), getReg(tmp));
             freeReg(tmp);
         }
     }
     else
-        write("mov", getReg(reg1), MEMACCESS(getReg(memloc)));
+        emit(X86_MOV, memAt(memloc), getReg(reg1));
     freeReg(memloc);
     return reg1;
 }
 
 int GeneratorX86::genExternSection()
 {
-    fprintf(m_outfile, "\n");
-    for (Symbol s : g_symtable.getGlobalTable())
+    for (SymbolId id : m_ctx.symtable.getGlobalTable())
     {
+        Symbol &s = *m_ctx.symtable.getSymbol(id);
         if (s.storageClass == SymbolTable::StorageClass::EXTERN)
         {
             if (s.used)
             {
                 if (!s.defined)
-                    fprintf(m_outfile, "extern %s\n", s.name.c_str());
+                    m_out->externSymbol(m_ctx.atoms.str(s.name));
 
                 else if (s.symType == SymbolTable::SymTypes::VARIABLE)
-                    fprintf(m_outfile, "global %s\n", s.name.c_str());
+                    m_out->global(m_ctx.atoms.str(s.name));
             }
         }
     }
@@ -360,70 +443,57 @@ int GeneratorX86::genExternSection()
 
 int GeneratorX86::genDataSection()
 {
+    flushCode();
     genExternSection();
     
-    fprintf(m_outfile, "\n\nsection\t.data\n");
-    for (Symbol s : g_symtable.getGlobalTable())
+    m_out->section(".data");
+    for (SymbolId id : m_ctx.symtable.getGlobalTable())
     {
-        if (s.symType == SymbolTable::SymTypes::VARIABLE &&
-            s.varType.typeType != TypeTypes::STRUCT && !s.varType.isArray && 
-            s.storageClass != SymbolTable::StorageClass::EXTERN)
-            fprintf(m_outfile, "\t%s\t%s %d\n", s.name.c_str(),
-                    m_initDataSize[_sizeToDataSize(s.varType.size)].c_str(),
-                    s.value);
-
-        else if (s.varType.isArray &&
-                 s.symType == SymbolTable::SymTypes::VARIABLE &&
-                 s.storageClass != SymbolTable::StorageClass::EXTERN)
+        Symbol &s = *m_ctx.symtable.getSymbol(id);
+        if (s.symType != SymbolTable::SymTypes::VARIABLE ||
+            s.storageClass == SymbolTable::StorageClass::EXTERN)
+            continue;
+
+        if (s.varType.typeType != TypeTypes::STRUCT && !s.varType.isArray)
+        {
+            m_out->label(m_ctx.atoms.str(s.name));
+            m_out->data(1 << _sizeToDataSize(s.varType.size),
+                        {to_string(s.value)});
+        }
+        else if (s.varType.isArray)
         {
             Type t = s.varType;
             dereference(&t);
+            int size = 1 << _sizeToDataSize(t.size);
 
-            fprintf(m_outfile, "\t%s\t%s ", s.name.c_str(),
-                    m_initDataSize[_sizeToDataSize(t.size)].c_str());
-            for (string s : s.inits)
-            {
-                fprintf(m_outfile, "%s, ", s.c_str());
-            }
+            m_out->label(m_ctx.atoms.str(s.name));
+            if (s.inits.size())
+                m_out->data(size, s.inits);
 
             if (s.inits.size() < s.value)
-            {
-                int amount = s.value - s.inits.size();
-                fprintf(m_outfile, "times %u %s 0", amount,
-                        m_initDataSize[_sizeToDataSize(t.size)].c_str());
-            }
-
-            fprintf(m_outfile, "\n");
+                m_out->zeros(size, s.value - s.inits.size());
         }
-        else if (s.symType == SymbolTable::SymTypes::VARIABLE &&
-                 s.varType.typeType == TypeTypes::STRUCT && 
-                 s.storageClass != SymbolTable::StorageClass::EXTERN)
+        else
         {
-            fprintf(m_outfile, "\t%s\n", s.name.c_str());
+            m_out->label(m_ctx.atoms.str(s.name));
 
             for (int i = 0; i < s.varType.contents.size(); i++)
             {
-                struct StructItem sItem = s.varType.contents[i];
-                if (i < s.inits.size())
-                    write("\t" + m_initDataSize[_sizeToDataSize(sItem.itemType.size)],
-                          s.inits[i]);
-
-                write("\t" + m_initDataSize[_sizeToDataSize(sItem.itemType.size)],
-                      0);
+                const struct StructItem &sItem = s.varType.contents[i];
+                int size = 1 << _sizeToDataSize(sItem.itemType.size);
+                m_out->data(size, {i < s.inits.size() ? s.inits[i] : "0"});
             }
         }
     }
 }
 
-/* SETcc instructions */
-static string setinstr[] = {"sete", "setne", "setl", "setg", "setle", "setge"};
-
-/* Inverted jump instructions */
-static string jmpinstr[] = {"je", "jne", "jl", "jg", "jle", "jge"};
+/* Conditions of the comparison operators, from AST::Types::EQUAL on */
+static const int conditions[] = {X86_CC_E, X86_CC_NE, X86_CC_L,
+                                 X86_CC_G, X86_CC_LE, X86_CC_GE};
 
 int GeneratorX86::genCompare(int reg1, int reg2, bool clearReg)
 {
-    write("cmp", getReg(reg2), getReg(reg1));
+    emit(X86_CMP, getReg(reg1), getReg(reg2));
     freeReg(reg2);
     
     if (!clearReg)
@@ -434,34 +504,35 @@ int GeneratorX86::genCompare(int reg1, int reg2, bool clearReg)
 }
 int GeneratorX86::genFlagJump(int op, int label)
 {
-    write(jmpinstr[op - AST::Types::EQUAL], LABEL(label));
+    emitCond(X86_JCC, conditions[op - AST::Types::EQUAL],
+             X86Operand::labelOp(label));
     return -1;
 }
 
 int GeneratorX86::genCompareSet(int op, int reg1, int reg2)
 {
-    write("cmp", getReg(reg2), getReg(reg1));
+    emit(X86_CMP, getReg(reg1), getReg(reg2));
     
     // mov reg2, 0 is used here instead of xor reg2, reg2 because
     // xor trashes the ZF flag in eflags and thus the result of the cmp 
-    write("mov", 0, getReg(reg2));
+    emit(X86_MOV, getReg(reg2), X86Operand::imm(0));
     
-    write(setinstr[op - AST::Types::EQUAL], m_loByteRegisters[reg2]);
+    emitCond(X86_SETCC, conditions[op - AST::Types::EQUAL], loByteReg(reg2));
     
-    write("movzx", m_loByteRegisters[reg2], getReg(reg2));
+    emit(X86_MOVZX, getReg(reg2), loByteReg(reg2));
     freeReg(reg1);
     return reg2;
 }
 
 int GeneratorX86::genJump(int label)
 {
-    write("jmp", LABEL(label));
+    emit(X86_JMP, X86Operand::labelOp(label));
     return -1;
 }
 
 int GeneratorX86::genLabel(int label)
 {
-    fprintf(m_outfile, ".L%d:\n", label);
+    emit(X86_LABEL, X86Operand::labelOp(label));
     return -1;
 }
 
@@ -481,14 +552,15 @@ int GeneratorX86::genWidenRegister(int reg, int oldsize, int newsize,
         newreg = 0;
         break;
     default:
-        err.fatalNL("Unsupported 'new' operant size: " + to_string(newsize));
+        m_ctx.errors.fatalNL("Unsupported 'new' operant size: " + to_string(newsize));
     }
 
+    X86Operand wide = X86Operand::regOp(X86_VREG + reg, newreg ? 2 : 4);
     if (isSigned)
-        write("movsx", getReg(reg), m_registers[newreg][reg]);
+        emit(X86_MOVSX, wide, getReg(reg));
 
     else
-        write("movzx", getReg(reg), m_registers[newreg][reg]);
+        emit(X86_MOVZX, wide, getReg(reg));
 
     m_usedRegisters[reg] = newreg + 1;
 
@@ -504,173 +576,89 @@ int GeneratorX86::genPushArgument(int reg, int argindex)
     // We don't want to widen the registers before pushing them because if we
     // would signedness would be destroyed when using non dword registers
 
-    write("push", m_dwordRegisters[reg]);
+    emit(X86_PUSH, dwordReg(reg));
     freeReg(reg);
     return -1;
 }
 
-int GeneratorX86::checkRegisters()
-{
-    for (int i = 0; i < SIZE(m_usedRegisters); i++)
-    {
-        if (m_usedRegisters[i] != 0)
-        {
-            err.warningNL("Register: " + m_dwordRegisters[i] + " (" +
-                          to_string(i) + ") is not free after functioncall ?");
-        }
-    }
-}
+/// @brief  Values that live across a call stay in their virtual registers,
+///         the allocator only gives them registers the call keeps
 vector <int> GeneratorX86::genSaveRegisters()
 {
-    vector <int> pushedRegisters;
-    for (int i = 0; i < SIZE(m_usedRegisters); i++)
-    {
-        if (m_usedRegisters[i])
-            spillReg(i);
-        
-        pushedRegisters.push_back(m_usedRegisters[i]);
-        m_usedRegisters[i] = 0;
-    }
-    
-    return pushedRegisters;
+    return vector<int>();
 }
 
-int GeneratorX86::genLoadRegisters(vector<int> data)
+int GeneratorX86::genFunctionCall(SymbolId symbolidx, int parameters, vector<int> data)
 {
-    for (int i = data.size() - 1; i >= 0; i--)
-    {
-        if (data[i])
-            loadReg(i);
-        m_usedRegisters[i] = data[i];
-    }
-    
-    return -1;
-}
-bool GeneratorX86::hasFreeReg()
-{
-    for (int i = 0; i < SIZE(m_usedRegisters); i++)
-        if (!m_usedRegisters[i])
-            return true;
-    
-    return false;
-}
 
-int GeneratorX86::genFunctionCall(int symbolidx, int parameters, vector<int> data)
-{
-
-    Symbol *s = g_symtable.getSymbol(symbolidx);
+    Symbol *s = m_ctx.symtable.getSymbol(symbolidx);
 
     if (s->varType.typeType == TypeTypes::STRUCT && !s->varType.ptrDepth)
     {
-        write("sub", s->varType.size, "esp");
-        write("push", "esp");
-        data = genSaveRegisters();
+        emit(X86_SUB, esp, X86Operand::imm(s->varType.size));
+        emit(X86_PUSH, esp);
     }
 
 
-    write("call", s->name);
+    emit(X86_CALL, X86Operand::symbolOp(s->name));
     /**
      * cdecl states that the caller should clean the stack so let's be nice
      * and do so
      */
-    write("add", parameters * 4, "esp");
-    for (int i = 0; i < data.size(); i++)
-        m_usedRegisters[i] = data[i];
-    
-    int out = EAX;
-    int offset = 0;
-    
-    if (s->varType.primType != PrimitiveTypes::VOID)
-    {
-        if(m_usedRegisters[EAX])
-        {
-            if (!hasFreeReg())
-            {
-                write("push", "eax");
-                offset = 4;
-            }
-            else
-            {
-                out = allocReg();
-                write("mov", "eax", getReg(out));
-            }
-        }
-        else
-        {
-            if (s->varType.typeType == TypeTypes::STRUCT)
-                m_usedRegisters[out] = 1;
-            else
-                m_usedRegisters[out] = _regFromSize(s->varType.size);
-        }
-        
-    }
-    
-    int pushAmount = 0;
-    for (int i = 0; i < data.size(); i++) 
-        if (data[i]) 
-            pushAmount++;
-    
-    for (int i = data.size() -1; i >= 0; i--)
-    {
-        if (data[i])
-        {
-            write("mov", "[esp+" + to_string(offset + ((pushAmount - i) * 4) - 4) + "]",
-                  getReg(i));
-        }
-    }
-    
-    if (offset)
-    {
-        out = allocReg();
-        write("mov", "[esp+" + to_string(offset + 4) + "]", getReg(out));
-    }
-        
+    emit(X86_ADD, esp, X86Operand::imm(parameters * 4));
+
+    if (s->varType.primType == PrimitiveTypes::VOID)
+        return -1;
+
+    int out = allocReg();
+    emit(X86_MOV, dwordReg(out), eax);
+
+    if (s->varType.typeType != TypeTypes::STRUCT)
+        m_usedRegisters[out] = _regFromSize(s->varType.size);
+
     return out;
 }
 
-int GeneratorX86::genReturnJump(int reg, int funcIdx)
+int GeneratorX86::genReturnJump(int reg, SymbolId funcIdx)
 {
-    if (g_symtable.getSymbol(funcIdx)->returnLabelId == -1)
-        g_symtable.getSymbol(funcIdx)->returnLabelId = label();
+    if (m_ctx.symtable.getSymbol(funcIdx)->returnLabelId == -1)
+        m_ctx.symtable.getSymbol(funcIdx)->returnLabelId = label();
 
-    Symbol *s = g_symtable.getSymbol(funcIdx);
+    Symbol *s = m_ctx.symtable.getSymbol(funcIdx);
 
     if (reg == -1)
-        return genJump(g_symtable.getSymbol(funcIdx)->returnLabelId);
+        return genJump(m_ctx.symtable.getSymbol(funcIdx)->returnLabelId);
 
     if (s->varType.typeType == TypeTypes::STRUCT && !s->varType.ptrDepth)
     {
         int ptrReg = allocReg();
         int tmpReg = allocReg();
-        write("mov", "dword [ebp + 8]", getReg(ptrReg));
-        for (struct StructItem s : s->varType.contents)
+        emit(X86_MOV, getReg(ptrReg), X86Operand::mem(X86_EBP, 8, 4));
+        for (const struct StructItem &s : s->varType.contents)
         {
-            string size = SPECIFYSIZE(_regFromSize(s.itemType.size));
-            write("mov",
-                  size + MEMACCESS(getReg(reg) + "+" + to_string(s.offset)),
-                  getReg(tmpReg));
-            write("mov", getReg(tmpReg),
-                  size + MEMACCESS(getReg(ptrReg) + "+" + to_string(s.offset)));
+            int size = SPECIFYSIZE(_regFromSize(s.itemType.size));
+            emit(X86_MOV, getReg(tmpReg), memAt(reg, s.offset, size));
+            emit(X86_MOV, memAt(ptrReg, s.offset, size), getReg(tmpReg));
         }
-        move("mov", getReg(ptrReg), "eax");
+        emit(X86_MOV, eax, getReg(ptrReg));
         freeReg(tmpReg);
+        freeReg(ptrReg);
     }
     else
     {
-        move("mov", getReg(reg), "eax");
+        emit(X86_MOV, eax, getReg(reg));
     }
     freeReg(reg);
-    allocReg(EAX);
 
-    genJump(g_symtable.getSymbol(funcIdx)->returnLabelId);
+    genJump(m_ctx.symtable.getSymbol(funcIdx)->returnLabelId);
 }
 
-int GeneratorX86::genLoadLocation(int symbolidx)
+int GeneratorX86::genLoadLocation(SymbolId symbolidx)
 {
-    Symbol *s   = g_symtable.getSymbol(symbolidx);
+    Symbol *s   = m_ctx.symtable.getSymbol(symbolidx);
     int            reg = allocReg();
 
-    write("lea", MEMACCESS(variableAccess(symbolidx)), getReg(reg));
+    emit(X86_LEA, getReg(reg), variableAccess(m_ctx.symtable, symbolidx));
 
     return reg;
 }
@@ -684,28 +672,28 @@ int GeneratorX86::genPtrAccess(int memreg, int size)
         size = PTR_SIZE;
     m_usedRegisters[reg] = _regFromSize(size);
 
-    write("mov",
-          SPECIFYSIZE(m_usedRegisters[reg]) + MEMACCESS(m_dwordRegisters[memreg]),
-          getReg(reg));
+    emit(X86_MOV, getReg(reg),
+         memAt(memreg, 0, SPECIFYSIZE(m_usedRegisters[reg])));
     freeReg(memreg);
     return reg;
 }
 
-int GeneratorX86::genDirectMemLoad(int offset, int symbol, int reg, int size)
+int GeneratorX86::genDirectMemLoad(int offset, SymbolId symbol, int reg, int size)
 {
-    Symbol *s = g_symtable.getSymbol(symbol);
-    string         str;
+    Symbol    *s = m_ctx.symtable.getSymbol(symbol);
+    X86Operand dest;
+    int        destSize = SPECIFYSIZE(_regFromSize(size));
 
     // Check whether a variable is local or not
-    if (symbol & 0xFF)
+    if (s->scope != GLOBALSCOPE)
     {
-        str = "ebp-" + to_string(s->stackLoc + 4 + offset);
+        dest = X86Operand::mem(X86_EBP, -(s->stackLoc + 4 + offset), destSize);
     }
     else
     {
-        str = s->name + "+" + to_string(offset);
+        dest = X86Operand::global(s->name, offset, destSize);
     }
-    write("mov", getReg(reg), SPECIFYSIZE(_regFromSize(size)) + MEMACCESS(str));
+    emit(X86_MOV, dest, getReg(reg));
 
     freeReg(reg);
 
@@ -714,36 +702,67 @@ int GeneratorX86::genDirectMemLoad(int offset, int symbol, int reg, int size)
 
 int GeneratorX86::genNegate(int reg)
 {
-    write("neg", getReg(reg));
+    emit(X86_NEG, getReg(reg));
     return reg;
 }
 
 int GeneratorX86::genAccessStruct(int memreg, int offset, int size)
 {
     int reg = allocReg();
-    write("mov", SPECIFYSIZE(_regFromSize(size)) + MEMACCESS(getReg(memreg) + "+" + to_string(offset)), getReg(reg));
+    emit(X86_MOV, getReg(reg),
+         memAt(memreg, offset, SPECIFYSIZE(_regFromSize(size))));
     return reg;
 }
 
-int GeneratorX86::genIncrement(int symbol, int amount, int after)
+/// @brief  ++ or -- (a negative amount) of a local that lives in a register,
+///         the value of the expression is copied out
+int GeneratorX86::stepVariable(const X86Operand &var, int amount, bool after)
 {
-    int reg = genLoadVariable(symbol, g_symtable.getSymbol(symbol)->varType);
+    int reg              = allocReg();
+    m_usedRegisters[reg] = _regFromSize(var.size);
+
+    if (after)
+        emit(X86_MOV, getReg(reg), var);
+
+    if (amount == 1)
+        emit(X86_INC, var);
+    else if (amount == -1)
+        emit(X86_DEC, var);
+    else if (amount > 0)
+        emit(X86_ADD, var, X86Operand::imm(amount));
+    else
+        emit(X86_SUB, var, X86Operand::imm(-amount));
+
+    if (!after)
+        emit(X86_MOV, getReg(reg), var);
+
+    return reg;
+}
+
+int GeneratorX86::genIncrement(SymbolId symbol, int amount, int after)
+{
+    X86Operand var = variableReg(symbol);
+    if (!var.is(X86Operand::NONE))
+        return stepVariable(var, amount, after);
+
+    int reg = genLoadVariable(symbol, m_ctx.symtable.getSymbol(symbol)->varType);
     int saveReg = -1;
     
     if (after)
     {
         saveReg = allocReg();
         m_usedRegisters[saveReg] = m_usedRegisters[reg];
-        write("mov", getReg(reg), getReg(saveReg));
+        emit(X86_MOV, getReg(saveReg), getReg(reg));
     }
     
     if (amount == 1)
-        write("inc", getReg(reg));
+        emit(X86_INC, getReg(reg));
     else
-        write("add", amount, getReg(reg));
+        emit(X86_ADD, getReg(reg), X86Operand::imm(amount));
     
     int s = m_usedRegisters[reg];
-    write("mov", getReg(reg), SPECIFYSIZE(s)+MEMACCESS(variableAccess(symbol)));
+    emit(X86_MOV, variableAccess(m_ctx.symtable, symbol, 0, SPECIFYSIZE(s)),
+         getReg(reg));
         
     if (after)
     {
@@ -754,25 +773,30 @@ int GeneratorX86::genIncrement(int symbol, int amount, int after)
     return reg;
 }
 
-int GeneratorX86::genDecrement(int symbol, int amount, int after)
+int GeneratorX86::genDecrement(SymbolId symbol, int amount, int after)
 {
-    int reg = genLoadVariable(symbol, g_symtable.getSymbol(symbol)->varType);
+    X86Operand var = variableReg(symbol);
+    if (!var.is(X86Operand::NONE))
+        return stepVariable(var, -amount, after);
+
+    int reg = genLoadVariable(symbol, m_ctx.symtable.getSymbol(symbol)->varType);
     int saveReg = -1;
     
-    if (amount == 1)
-        write("dec", getReg(reg));
-    else
-        write("sub", amount, getReg(reg));
-        
-    
     if (after)
     {
         saveReg = allocReg();
         m_usedRegisters[saveReg] = m_usedRegisters[reg];
-        write("mov", getReg(reg), getReg(saveReg));
+        emit(X86_MOV, getReg(saveReg), getReg(reg));
     }
     
-    write("mov", getReg(reg), SPECIFYSIZE(reg)+MEMACCESS(variableAccess(symbol)));
+    if (amount == 1)
+        emit(X86_DEC, getReg(reg));
+    else
+        emit(X86_SUB, getReg(reg), X86Operand::imm(amount));
+    
+    int s = m_usedRegisters[reg];
+    emit(X86_MOV, variableAccess(m_ctx.symtable, symbol, 0, SPECIFYSIZE(s)),
+         getReg(reg));
         
     if (after)
     {
@@ -784,19 +808,17 @@ int GeneratorX86::genDecrement(int symbol, int amount, int after)
 }
 int GeneratorX86::genLeftShift(int reg, int amount)
 {
-    allocReg(ECX);
-    move("mov", getReg(amount), "ecx");
+    emit(X86_MOV, ecx, getReg(amount));
     freeReg(amount);
-    write("shl", "cl", getReg(reg));
+    emit(X86_SHL, getReg(reg), X86Operand::regOp(X86_ECX, 1));
     return reg;
 }
 
 int GeneratorX86::genRightShift(int reg, int amount)
 {
-    allocReg(ECX);
-    move("mov", getReg(amount), "ecx");
+    emit(X86_MOV, ecx, getReg(amount));
     freeReg(amount);
-    write("shr", "cl", getReg(reg));
+    emit(X86_SHR, getReg(reg), X86Operand::regOp(X86_ECX, 1));
     return reg;
 }
 
@@ -818,52 +840,52 @@ void GeneratorX86::genDebugComment(string comment)
         }
     }
     
-    fprintf(m_outfile, "; %s\n", comment.c_str());
+    m_code.comment(comment);
 }
 
 int GeneratorX86::genAnd(int reg1, int reg2)
 {
-    write("and", getReg(reg2), getReg(reg1));
+    emit(X86_AND, getReg(reg1), getReg(reg2));
     freeReg(reg2);
     return reg1;
 }
 
 int GeneratorX86::genOr(int reg1, int reg2)
 {
-    write("or", getReg(reg2), getReg(reg1));
+    emit(X86_OR, getReg(reg1), getReg(reg2));
     freeReg(reg2);
     return reg1;
 }
 
 int GeneratorX86::genXor(int reg1, int reg2)
 {
-    write("xor", getReg(reg2), getReg(reg1));
+    emit(X86_XOR, getReg(reg1), getReg(reg2));
     freeReg(reg2);
     return reg1;
 }
 
 int GeneratorX86::genBinNegate(int reg1)
 {
-    write("not", getReg(reg1));
+    emit(X86_NOT, getReg(reg1));
     return reg1;
 }
 
 int GeneratorX86::genIsZero(int reg)
 {
-    write("test", getReg(reg), getReg(reg));
+    emit(X86_TEST, getReg(reg), getReg(reg));
     freeReg(reg);
     return -1;
 }
 
 int GeneratorX86::genLogAnd(int reg1, int reg2)
 {
-    write("and", getReg(reg2), getReg(reg1));
+    emit(X86_AND, getReg(reg1), getReg(reg2));
     freeReg(reg2);
     return reg1;
 }
 int GeneratorX86::genLogOr(int reg1, int reg2)
 {
-    write("or", getReg(reg2), getReg(reg1));
+    emit(X86_OR, getReg(reg1), getReg(reg2));
     freeReg(reg2);
     return reg1;
 }
@@ -871,23 +893,23 @@ int GeneratorX86::genLogOr(int reg1, int reg2)
 int GeneratorX86::genIsZeroSet(int reg1, bool setOnZero)
 {
     int reg2 = allocReg();
-    write("xor", getReg(reg2), getReg(reg2));
-    write("test", getReg(reg1), getReg(reg1));
-    write(setinstr[!setOnZero], m_loByteRegisters[reg2]);
-    write("movzx", m_loByteRegisters[reg2], getReg(reg2));
+    emit(X86_XOR, getReg(reg2), getReg(reg2));
+    emit(X86_TEST, getReg(reg1), getReg(reg1));
+    emitCond(X86_SETCC, setOnZero ? X86_CC_E : X86_CC_NE, loByteReg(reg2));
+    emit(X86_MOVZX, getReg(reg2), loByteReg(reg2));
     freeReg(reg1);
     return reg2;
 }
 
-int GeneratorX86::genLabel(string label)
+int GeneratorX86::genLabel(Atom label)
 {
-    fprintf(m_outfile, "%s\n", ("." + label + ":").c_str());
+    emit(X86_LABEL, X86Operand::gotoLabel(label));
     return -1;
 }
 
-int GeneratorX86::genGoto(string label)
+int GeneratorX86::genGoto(Atom label)
 {
-    write("jmp", "." + label);
+    emit(X86_JMP, X86Operand::gotoLabel(label));
     return -1;
 }
 
@@ -900,7 +922,7 @@ int GeneratorX86::genMoveReg(int reg, int toReg)
     if (toReg == reg)
         return toReg;
         
-    write("mov", getReg(reg), getReg(toReg));
+    emit(X86_MOV, getReg(toReg), getReg(reg));
     freeReg(reg);
     return toReg;
 }
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include <arch/x86/instructions.h>
+#include <asmoutput.h>
+#include <context.h>
+
+static const char *regs32[] = {"eax", "ecx", "edx", "ebx",
+                               "esp", "ebp", "esi", "edi"};
+static const char *regs16[] = {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"};
+static const char *regs8[]  = {"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"};
+
+/* Indexed by X86Opcodes, jcc and setcc get their condition appended */
+static const char *mnemonics[] = {
+    "add",   "or",   "adc",  "sbb",  "and",  "sub",   "xor",  "cmp",
+    "mov",   "movzx", "movsx", "lea",
+    "test",  "not",  "neg",  "mul",  "imul", "div",   "idiv",
+    "inc",   "dec",  "shl",  "shr",  "sar",
+    "push",  "pop",
+    "jmp",   "j",    "call", "ret",  "set",  "int",
+    "leave", "cdq",  "cwde", "nop",  "hlt",
+};
+
+/* Indexed by condition code, the first name is the one that is printed */
+static const char *conditions[][3] = {
+    {"o"},           {"no"},         {"b", "c", "nae"}, {"ae", "nb", "nc"},
+    {"e", "z"},      {"ne", "nz"},   {"be", "na"},      {"a", "nbe"},
+    {"s"},           {"ns"},         {"p", "pe"},       {"np", "po"},
+    {"l", "nge"},    {"ge", "nl"},   {"le", "ng"},      {"g", "nle"},
+};
+
+static const char *sizeNames[] = {NULL, "byte", "word", NULL, "dword"};
+
+X86Operand X86Operand::regOp(int reg, int size)
+{
+    X86Operand op;
+    op.kind = REG;
+    op.reg  = reg;
+    op.size = size;
+    return op;
+}
+
+X86Operand X86Operand::imm(int32_t value)
+{
+    X86Operand op;
+    op.kind = IMM;
+    op.disp = value;
+    return op;
+}
+
+X86Operand X86Operand::mem(int base, int32_t disp, int size)
+{
+    X86Operand op;
+    op.kind = MEM;
+    op.reg  = base;
+    op.disp = disp;
+    op.size = size;
+    return op;
+}
+
+X86Operand X86Operand::global(Atom symbol, int32_t disp, int size)
+{
+    X86Operand op = mem(-1, disp, size);
+    op.symbol     = symbol;
+    return op;
+}
+
+X86Operand X86Operand::symbolOp(Atom symbol)
+{
+    X86Operand op;
+    op.kind   = SYMBOL;
+    op.symbol = symbol;
+    return op;
+}
+
+X86Operand X86Operand::labelOp(int label)
+{
+    X86Operand op;
+    op.kind  = LABEL;
+    op.label = label;
+    return op;
+}
+
+X86Operand X86Operand::gotoLabel(Atom name)
+{
+    X86Operand op;
+    op.kind   = LABEL;
+    op.symbol = name;
+    return op;
+}
+
+/// @brief  Looks up a register by name, false if it isn't one
+bool X86Operand::parseRegister(StringView name, int &reg, int &size)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        if (name == regs32[i])
+            reg = i, size = 4;
+        else if (name == regs16[i])
+            reg = i, size = 2;
+        else if (name == regs8[i])
+            reg = i, size = 1;
+        else
+            continue;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool X86Operand::operator==(const X86Operand &other) const
+{
+    return kind == other.kind && size == other.size && reg == other.reg &&
+           disp == other.disp && label == other.label &&
+           symbol == other.symbol;
+}
+
+/// @brief  Writes the operand in NASM syntax
+void X86Operand::format(AsmOperand &out) const
+{
+    switch (kind)
+    {
+    case REG:
+        out.append(size == 1 ? regs8[reg]
+                             : (size == 2 ? regs16[reg] : regs32[reg]));
+        break;
+
+    case IMM:
+        out.number(disp);
+        break;
+
+    case MEM:
+        if (size)
+            out.append(sizeNames[size]).append(' ');
+
+        if (symbol != NOATOM && disp)
+            out.mem(g_atoms.str(symbol), disp);
+        else if (symbol != NOATOM)
+            out.mem(g_atoms.str(symbol));
+        else if (reg == -1)
+            out.append('[').number(disp).append(']');
+        else if (disp)
+            out.mem(regs32[reg], disp);
+        else
+            out.mem(regs32[reg]);
+        break;
+
+    case SYMBOL:
+        out.append(g_atoms.str(symbol));
+        break;
+
+    case LABEL:
+        if (label >= 0)
+            out.label(label);
+        else
+            out.append('.').append(g_atoms.str(symbol));
+        break;
+    }
+}
+
+void X86Instr::mnemonic(AsmOperand &out) const
+{
+    out.append(mnemonics[op]);
+    if (op == X86_JCC || op == X86_SETCC)
+        out.append(conditions[cond][0]);
+}
+
+const char *X86Instr::name(int op)
+{
+    return mnemonics[op];
+}
+
+/// @brief  Looks up a mnemonic as NASM spells it, false if it is unknown
+bool X86Instr::parseMnemonic(StringView name, int &op, int &cond)
+{
+    for (int i = 0; i < SIZE(mnemonics); i++)
+    {
+        if (i != X86_JCC && i != X86_SETCC && name == mnemonics[i])
+        {
+            op = i;
+            return true;
+        }
+    }
+
+    if (name == "sal")
+    {
+        op = X86_SHL;
+        return true;
+    }
+
+    // jcc and setcc, the condition follows the prefix
+    for (int prefixed : {X86_JCC, X86_SETCC})
+    {
+        StringView prefix = mnemonics[prefixed];
+        if (name.size() <= prefix.size() ||
+            StringView(name.data(), prefix.size()) != prefix)
+            continue;
+
+        StringView rest(name.data() + prefix.size(),
+                        name.size() - prefix.size());
+        for (int cc = 0; cc < SIZE(conditions); cc++)
+        {
+            for (const char *alias : conditions[cc])
+            {
+                if (alias && rest == alias)
+                {
+                    op   = prefixed;
+                    cond = cc;
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void X86Code::comment(const string &text)
+{
+    X86Instr instr(X86_COMMENT);
+    instr.dest.disp = m_comments.size();
+    m_comments.push_back(text);
+    m_instrs.push_back(instr);
+}
+
+/// @brief  Hands the code to the output and starts over empty
+void X86Code::lower(AsmOutput &out)
+{
+    for (const X86Instr &instr : m_instrs)
+    {
+        if (instr.op == X86_COMMENT)
+            out.comment(m_comments[instr.dest.disp]);
+        else if (instr.op == X86_LABEL)
+        {
+            AsmOperand name;
+            instr.dest.format(name);
+            out.label(name);
+        }
+        else
+            out.instruction(instr);
+    }
+
+    m_instrs.clear();
+    m_comments.clear();
+}
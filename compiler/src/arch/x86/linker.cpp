@@ -0,0 +1,863 @@
+#include <arch/x86/assembler.h>
+#include <arch/x86/linker.h>
+#include <context.h>
+#include <errorhandler.h>
+
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+#define BASE_ADDRESS 0x08048000
+#define SEGMENT_ALIGN 0x1000
+
+static const char *interpreter = "/lib/ld-linux.so.2";
+static const char *libcName    = "libc.so.6";
+
+/* Where the 32 bit libc lives on the usual distributions */
+static const char *defaultLibraryDirs[] = {
+    "/lib/i386-linux-gnu", "/usr/lib/i386-linux-gnu", "/lib32", "/usr/lib32",
+    "/lib",                "/usr/lib",
+};
+
+static const struct
+{
+    const char *name;
+    uint32_t    type;
+    uint32_t    flags;
+    uint32_t    align;
+} outputSections[] = {
+    {".interp", SHT_PROGBITS, SHF_ALLOC, 1},
+    {".hash", SHT_HASH, SHF_ALLOC, 4},
+    {".dynsym", SHT_DYNSYM, SHF_ALLOC, 4},
+    {".dynstr", SHT_STRTAB, SHF_ALLOC, 1},
+    {".rel.dyn", SHT_REL, SHF_ALLOC, 4},
+    {".plt", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16},
+    {".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16},
+    {".rodata", SHT_PROGBITS, SHF_ALLOC, 4},
+    {".dynamic", SHT_DYNAMIC, SHF_ALLOC | SHF_WRITE, 4},
+    {".got", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 4},
+    {".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 4},
+    {".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 4},
+};
+
+static uint32_t alignUp(uint32_t value, uint32_t align)
+{
+    return align > 1 ? (value + align - 1) / align * align : value;
+}
+
+template <class T> static void put(string &buf, uint32_t offset, const T &item)
+{
+    memcpy(&buf[offset], &item, sizeof(T));
+}
+
+template <class T> static void append(string &buf, const T &item)
+{
+    buf.append((const char *) &item, sizeof(T));
+}
+
+static uint32_t addString(string &table, const string &s)
+{
+    uint32_t off = table.size();
+    table += s;
+    table += '\0';
+    return off;
+}
+
+static bool readFile(const string &path, string &data)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+
+    stringstream ss;
+    ss << file.rdbuf();
+    data = ss.str();
+    return true;
+}
+
+/// @brief  The SysV ELF hash function
+static uint32_t elfHash(const char *name)
+{
+    uint32_t h = 0, g;
+    for (; *name; name++)
+    {
+        h = (h << 4) + (unsigned char) *name;
+        if ((g = h & 0xf0000000))
+            h ^= g >> 24;
+        h &= ~g;
+    }
+
+    return h;
+}
+
+LinkerX86::LinkerX86()
+{
+    for (int i = 0; i < OUT_COUNT; i++)
+    {
+        m_out[i].name  = outputSections[i].name;
+        m_out[i].type  = outputSections[i].type;
+        m_out[i].flags = outputSections[i].flags;
+        m_out[i].align = outputSections[i].align;
+    }
+}
+
+void LinkerX86::addLibraryDir(const string &dir)
+{
+    m_libraryDirs.push_back(dir);
+}
+
+const char *LinkerX86::symbolName(const InputObject &obj, int symbol)
+{
+    return obj.strtab + obj.symbols[symbol].st_name;
+}
+
+void LinkerX86::addObject(const string &path)
+{
+    string data;
+    if (!readFile(path, data))
+        g_err.fatalNL("Could not open file: '" + path + "'");
+
+    addObject(path, move(data));
+}
+
+void LinkerX86::addObject(const string &name, string &&data)
+{
+    m_objects.push_back({name, move(data)});
+    InputObject  &obj  = m_objects.back();
+    int           idx  = m_objects.size() - 1;
+    const string &file = obj.data;
+
+    const Elf32_Ehdr *eh = (const Elf32_Ehdr *) file.data();
+    if (file.size() < sizeof(Elf32_Ehdr) ||
+        memcmp(eh->e_ident, ELFMAG, SELFMAG) ||
+        eh->e_ident[EI_CLASS] != ELFCLASS32 || eh->e_machine != EM_386 ||
+        eh->e_type != ET_REL)
+        g_err.fatalNL(HL(name) + " is not an i386 relocatable object");
+
+    if (eh->e_shoff + eh->e_shnum * sizeof(Elf32_Shdr) > file.size())
+        g_err.fatalNL(HL(name) + " is malformed");
+
+    obj.sections     = (const Elf32_Shdr *) (file.data() + eh->e_shoff);
+    obj.sectionCount = eh->e_shnum;
+    obj.symbols      = NULL;
+    obj.symbolCount  = 0;
+    obj.placement.assign(obj.sectionCount, -1);
+
+    for (int i = 0; i < obj.sectionCount; i++)
+    {
+        const Elf32_Shdr &sh = obj.sections[i];
+        if (sh.sh_type != SHT_NOBITS && sh.sh_offset + sh.sh_size > file.size())
+            g_err.fatalNL(HL(name) + " is malformed");
+
+        if (sh.sh_type == SHT_RELA)
+            g_err.fatalNL(HL(name) + " uses RELA relocations, which i386 "
+                                   "objects shouldn't");
+
+        if (sh.sh_type == SHT_SYMTAB)
+        {
+            obj.symbols     = (const Elf32_Sym *) (file.data() + sh.sh_offset);
+            obj.symbolCount = sh.sh_size / sizeof(Elf32_Sym);
+            obj.strtab      = file.data() + obj.sections[sh.sh_link].sh_offset;
+        }
+    }
+
+    // Register what this object defines
+    for (int i = 1; i < obj.symbolCount; i++)
+    {
+        const Elf32_Sym &sym  = obj.symbols[i];
+        int              bind = ELF32_ST_BIND(sym.st_info);
+        if (bind == STB_LOCAL || sym.st_shndx == SHN_UNDEF)
+            continue;
+
+        const char *symName = symbolName(obj, i);
+        auto        it      = m_globals.find(symName);
+        if (it == m_globals.end())
+        {
+            m_globals[symName] = {idx, i};
+            continue;
+        }
+
+        const InputObject &prevObj = m_objects[it->second.object];
+        const Elf32_Sym   &prev    = prevObj.symbols[it->second.symbol];
+        bool prevStrong = ELF32_ST_BIND(prev.st_info) == STB_GLOBAL &&
+                          prev.st_shndx != SHN_COMMON;
+        bool strong     = bind == STB_GLOBAL && sym.st_shndx != SHN_COMMON;
+
+        if (strong && prevStrong)
+            g_err.fatalNL("Multiple definition of " + HL(symName) + " in " +
+                        HL(name) + " and " + HL(prevObj.name));
+
+        if (strong)
+            it->second = {idx, i};
+    }
+}
+
+/// @brief  Assembles the startup code, which hands main to libc
+void LinkerX86::addStartup()
+{
+    AssemblerX86 crt("", "crt");
+
+    crt.global("_start");
+    crt.label("_start");
+    crt.instruction("xor", "ebp", "ebp");
+    crt.instruction("pop", "esi");          // argc
+    crt.instruction("mov", "ecx", "esp");   // argv
+    crt.instruction("and", "esp", "-16");
+    crt.instruction("push", "eax");         // Keeps the stack aligned
+    crt.instruction("push", "esp");         // Stack end
+    crt.instruction("push", "edx");         // Set by the dynamic linker
+    crt.instruction("push", "0");           // fini
+    crt.instruction("push", "0");           // init
+    crt.instruction("push", "ecx");
+    crt.instruction("push", "esi");
+    crt.instruction("push", "main");
+    crt.instruction("call", "__libc_start_main");
+    crt.instruction("hlt");
+
+    addObject("crt", crt.finish().contents());
+}
+
+void LinkerX86::readLibc(unordered_map<string, int> &exports)
+{
+    vector<string> dirs = m_libraryDirs;
+    dirs.insert(dirs.end(), begin(defaultLibraryDirs), end(defaultLibraryDirs));
+
+    string file;
+    for (const string &dir : dirs)
+    {
+        if (!readFile(dir + "/" + libcName, file))
+            continue;
+
+        const Elf32_Ehdr *eh = (const Elf32_Ehdr *) file.data();
+        if (file.size() >= sizeof(Elf32_Ehdr) &&
+            !memcmp(eh->e_ident, ELFMAG, SELFMAG) &&
+            eh->e_ident[EI_CLASS] == ELFCLASS32 && eh->e_machine == EM_386 &&
+            eh->e_type == ET_DYN &&
+            eh->e_shoff + eh->e_shnum * sizeof(Elf32_Shdr) <= file.size())
+            break;
+
+        file.clear();
+    }
+
+    if (file.empty())
+        g_err.fatalNL("Could not find the 32 bit " + HL(libcName) + ", install "
+                    "it, add its directory with -L or link with -l ld");
+
+    const Elf32_Ehdr *eh       = (const Elf32_Ehdr *) file.data();
+    const Elf32_Shdr *sections = (const Elf32_Shdr *) (file.data() + eh->e_shoff);
+
+    for (int i = 0; i < eh->e_shnum; i++)
+    {
+        if (sections[i].sh_type != SHT_DYNSYM)
+            continue;
+
+        const Elf32_Sym *syms =
+            (const Elf32_Sym *) (file.data() + sections[i].sh_offset);
+        const char *strtab = file.data() + sections[sections[i].sh_link].sh_offset;
+
+        for (size_t s = 1; s < sections[i].sh_size / sizeof(Elf32_Sym); s++)
+        {
+            int bind = ELF32_ST_BIND(syms[s].st_info);
+            if (syms[s].st_shndx != SHN_UNDEF &&
+                (bind == STB_GLOBAL || bind == STB_WEAK))
+                exports[strtab + syms[s].st_name] = ELF32_ST_TYPE(syms[s].st_info);
+        }
+    }
+}
+
+/// @brief  Finds the symbols that have to come from libc, calls to them get a
+///         PLT entry and other references a dynamic relocation
+void LinkerX86::findImports()
+{
+    for (InputObject &obj : m_objects)
+    {
+        for (int i = 0; i < obj.sectionCount; i++)
+        {
+            const Elf32_Shdr &rs = obj.sections[i];
+            if (rs.sh_type != SHT_REL ||
+                !(obj.sections[rs.sh_info].sh_flags & SHF_ALLOC))
+                continue;
+
+            const Elf32_Rel *rels = (const Elf32_Rel *) (obj.data.data() +
+                                                         rs.sh_offset);
+            for (size_t r = 0; r < rs.sh_size / sizeof(Elf32_Rel); r++)
+            {
+                int type = ELF32_R_TYPE(rels[r].r_info);
+                int sym  = ELF32_R_SYM(rels[r].r_info);
+
+                if (type != R_386_NONE && type != R_386_32 &&
+                    type != R_386_PC32 && type != R_386_PLT32)
+                    g_err.fatalNL("Unsupported relocation type " +
+                                to_string(type) + " in " + HL(obj.name));
+
+                const Elf32_Sym &s = obj.symbols[sym];
+                if (type == R_386_NONE || s.st_shndx != SHN_UNDEF ||
+                    ELF32_ST_BIND(s.st_info) == STB_WEAK)
+                    continue;
+
+                string name = symbolName(obj, sym);
+                if (m_globals.count(name))
+                    continue;
+
+                auto it = m_importIndex.find(name);
+                if (it == m_importIndex.end())
+                {
+                    it = m_importIndex.insert({name, m_imports.size()}).first;
+                    m_imports.push_back({name, STT_NOTYPE});
+                }
+
+                if (type == R_386_32)
+                {
+                    m_absImportRefs++;
+                    if (!(obj.sections[rs.sh_info].sh_flags & SHF_WRITE))
+                        m_textRelocs = true;
+                }
+                else
+                    m_imports[it->second].plt = true;
+            }
+        }
+    }
+
+    if (m_imports.empty())
+        return;
+
+    unordered_map<string, int> exports;
+    readLibc(exports);
+
+    string missing;
+    for (Import &imp : m_imports)
+    {
+        auto it = exports.find(imp.name);
+        if (it == exports.end())
+            missing += "\n  " + HL(imp.name);
+        else
+            imp.type = it->second;
+    }
+
+    if (missing.size())
+        g_err.fatalNL("Undefined reference to:" + missing);
+}
+
+void LinkerX86::placeSections()
+{
+    for (size_t o = 0; o < m_objects.size(); o++)
+    {
+        InputObject &obj = m_objects[o];
+        for (int i = 0; i < obj.sectionCount; i++)
+        {
+            const Elf32_Shdr &sh = obj.sections[i];
+            if (!(sh.sh_flags & SHF_ALLOC) ||
+                (sh.sh_type != SHT_PROGBITS && sh.sh_type != SHT_NOBITS))
+                continue;
+
+            if (sh.sh_flags & SHF_TLS)
+                g_err.fatalNL("Thread local storage (in " + HL(obj.name) +
+                            ") is not supported");
+
+            int out = OUT_RODATA;
+            if (sh.sh_type == SHT_NOBITS)
+                out = OUT_BSS;
+            else if (sh.sh_flags & SHF_EXECINSTR)
+                out = OUT_TEXT;
+            else if (sh.sh_flags & SHF_WRITE)
+                out = OUT_DATA;
+
+            OutputSection &os = m_out[out];
+            uint32_t offset   = alignUp(os.size, sh.sh_addralign);
+            os.align          = max(os.align, (uint32_t) sh.sh_addralign);
+            os.size           = offset + sh.sh_size;
+
+            if (out != OUT_BSS)
+            {
+                os.bytes.resize(offset, '\0');
+                os.bytes.append(obj.data, sh.sh_offset, sh.sh_size);
+            }
+
+            obj.placement[i] = m_placements.size();
+            m_placements.push_back({(int) o, i, out, offset});
+        }
+    }
+
+    // Common symbols get their space in .bss
+    for (auto &def : m_globals)
+    {
+        const Elf32_Sym &s = m_objects[def.second.object].symbols[def.second.symbol];
+        if (s.st_shndx != SHN_COMMON)
+            continue;
+
+        OutputSection &bss = m_out[OUT_BSS];
+        m_commons[def.first] = alignUp(bss.size, s.st_value);
+        bss.align            = max(bss.align, (uint32_t) s.st_value);
+        bss.size             = m_commons[def.first] + s.st_size;
+    }
+}
+
+/// @brief  Builds the tables the dynamic linker reads, addresses are filled
+///         in after the layout
+void LinkerX86::buildDynamic()
+{
+    if (m_imports.empty())
+        return;
+
+    string &dynstr = m_out[OUT_DYNSTR].bytes;
+    string &dynsym = m_out[OUT_DYNSYM].bytes;
+    dynstr.assign(1, '\0');
+    dynsym.assign(sizeof(Elf32_Sym), '\0');
+    addString(dynstr, libcName);
+
+    int pltEntries = 0;
+    for (const Import &imp : m_imports)
+    {
+        Elf32_Sym sym = {};
+        sym.st_name   = addString(dynstr, imp.name);
+        sym.st_info   = ELF32_ST_INFO(STB_GLOBAL, imp.type);
+        append(dynsym, sym);
+        pltEntries += imp.plt;
+    }
+
+    // A single bucket per symbol, the chains stay short enough
+    uint32_t         count = m_imports.size() + 1;
+    vector<uint32_t> buckets(count), chains(count);
+    for (uint32_t i = 1; i < count; i++)
+    {
+        uint32_t b = elfHash(m_imports[i - 1].name.c_str()) % count;
+        chains[i]  = buckets[b];
+        buckets[b] = i;
+    }
+
+    string &hash = m_out[OUT_HASH].bytes;
+    append(hash, count);
+    append(hash, count);
+    hash.append((const char *) buckets.data(), count * 4);
+    hash.append((const char *) chains.data(), count * 4);
+
+    m_out[OUT_INTERP].bytes = string(interpreter) + '\0';
+    m_out[OUT_PLT].bytes.assign(pltEntries * 8, '\0');
+    m_out[OUT_GOT].bytes.assign(pltEntries * 4, '\0');
+    m_out[OUT_RELDYN].bytes.assign(
+        (pltEntries + m_absImportRefs) * sizeof(Elf32_Rel), '\0');
+
+    int dynamicEntries = 12 + m_textRelocs;
+    m_out[OUT_DYNAMIC].bytes.assign(dynamicEntries * sizeof(Elf32_Dyn), '\0');
+
+    for (int i = OUT_INTERP; i < OUT_COUNT; i++)
+        if (i != OUT_TEXT && i != OUT_RODATA && i != OUT_DATA && i != OUT_BSS)
+            m_out[i].size = m_out[i].bytes.size();
+}
+
+void LinkerX86::layout(int phnum)
+{
+    uint32_t offset = sizeof(Elf32_Ehdr) + phnum * sizeof(Elf32_Phdr);
+
+    for (int i = 0; i < OUT_DYNAMIC; i++)
+    {
+        if (!m_out[i].size)
+            continue;
+
+        offset          = alignUp(offset, m_out[i].align);
+        m_out[i].offset = offset;
+        m_out[i].addr   = BASE_ADDRESS + offset;
+        offset += m_out[i].size;
+    }
+    m_rxSize = offset;
+
+    // The RW segment starts on a new page, at the same offset in the page as
+    // in the file so it can be mapped directly
+    m_rwOffset = offset;
+    m_rwAddr   = BASE_ADDRESS + alignUp(offset, SEGMENT_ALIGN) +
+               offset % SEGMENT_ALIGN;
+
+    for (int i = OUT_DYNAMIC; i < OUT_BSS; i++)
+    {
+        if (!m_out[i].size)
+            continue;
+
+        offset          = alignUp(offset, m_out[i].align);
+        m_out[i].offset = offset;
+        m_out[i].addr   = m_rwAddr + offset - m_rwOffset;
+        offset += m_out[i].size;
+    }
+    m_rwFileSize = offset - m_rwOffset;
+
+    OutputSection &bss = m_out[OUT_BSS];
+    bss.offset  = offset;
+    bss.addr    = alignUp(m_rwAddr + m_rwFileSize, bss.align);
+    m_rwMemSize = bss.addr + bss.size - m_rwAddr;
+}
+
+void LinkerX86::fillDynamic()
+{
+    if (m_imports.empty())
+        return;
+
+    int entry = 0;
+    for (Import &imp : m_imports)
+    {
+        if (!imp.plt)
+            continue;
+
+        imp.pltAddr = m_out[OUT_PLT].addr + entry * 8;
+        imp.gotAddr = m_out[OUT_GOT].addr + entry * 4;
+
+        // jmp [got entry], padded with a two byte nop
+        string &plt = m_out[OUT_PLT].bytes;
+        uint8_t stub[8] = {0xff, 0x25, 0, 0, 0, 0, 0x66, 0x90};
+        memcpy(stub + 2, &imp.gotAddr, 4);
+        memcpy(&plt[entry * 8], stub, 8);
+        entry++;
+    }
+
+    string  &dyn = m_out[OUT_DYNAMIC].bytes;
+    uint32_t pos = 0;
+    auto     add = [&](int32_t tag, uint32_t value) {
+        Elf32_Dyn d;
+        d.d_tag      = tag;
+        d.d_un.d_val = value;
+        put(dyn, pos, d);
+        pos += sizeof(d);
+    };
+
+    add(DT_NEEDED, 1);  // libc is the first string
+    add(DT_HASH, m_out[OUT_HASH].addr);
+    add(DT_STRTAB, m_out[OUT_DYNSTR].addr);
+    add(DT_SYMTAB, m_out[OUT_DYNSYM].addr);
+    add(DT_STRSZ, m_out[OUT_DYNSTR].size);
+    add(DT_SYMENT, sizeof(Elf32_Sym));
+    add(DT_REL, m_out[OUT_RELDYN].addr);
+    add(DT_RELSZ, m_out[OUT_RELDYN].size);
+    add(DT_RELENT, sizeof(Elf32_Rel));
+    add(DT_DEBUG, 0);
+
+    // Everything is bound at startup, so there's no lazy PLT machinery
+    if (m_textRelocs)
+        add(DT_TEXTREL, 0);
+    add(DT_FLAGS, DF_BIND_NOW | (m_textRelocs ? DF_TEXTREL : 0));
+    add(DT_NULL, 0);
+}
+
+/// @brief  The address a symbol ends up at. For imports, import is set and
+///         the PLT entry is returned (0 if it has none).
+uint32_t LinkerX86::symbolAddress(int object, int symbol, int &import)
+{
+    const InputObject &obj = m_objects[object];
+    const Elf32_Sym   &s   = obj.symbols[symbol];
+    import                 = -1;
+
+    if (ELF32_ST_BIND(s.st_info) != STB_LOCAL)
+    {
+        const char *name = symbolName(obj, symbol);
+        auto        def  = m_globals.find(name);
+        if (def == m_globals.end())
+        {
+            auto imp = m_importIndex.find(name);
+            if (imp == m_importIndex.end())
+                return 0;   // An undefined weak symbol
+
+            import = imp->second;
+            return m_imports[import].pltAddr;
+        }
+
+        if (def->second.object != object || def->second.symbol != symbol)
+            return symbolAddress(def->second.object, def->second.symbol, import);
+    }
+
+    switch (s.st_shndx)
+    {
+    case SHN_UNDEF:
+        return 0;
+    case SHN_ABS:
+        return s.st_value;
+    case SHN_COMMON:
+        return m_out[OUT_BSS].addr + m_commons[symbolName(obj, symbol)];
+    }
+
+    if (s.st_shndx >= obj.sectionCount || obj.placement[s.st_shndx] == -1)
+        g_err.fatalNL("Symbol " + HL(symbolName(obj, symbol)) + " in " +
+                    HL(obj.name) + " is in a section that isn't linked");
+
+    const Placement &p = m_placements[obj.placement[s.st_shndx]];
+    return m_out[p.out].addr + p.offset + s.st_value;
+}
+
+void LinkerX86::relocate()
+{
+    for (size_t o = 0; o < m_objects.size(); o++)
+    {
+        InputObject &obj = m_objects[o];
+        for (int i = 0; i < obj.sectionCount; i++)
+        {
+            const Elf32_Shdr &rs = obj.sections[i];
+            if (rs.sh_type != SHT_REL || obj.placement[rs.sh_info] == -1)
+                continue;
+
+            const Placement &p   = m_placements[obj.placement[rs.sh_info]];
+            OutputSection   &out = m_out[p.out];
+            if (p.out == OUT_BSS)
+                g_err.fatalNL("Relocation in .bss of " + HL(obj.name));
+
+            const Elf32_Rel *rels = (const Elf32_Rel *) (obj.data.data() +
+                                                         rs.sh_offset);
+            for (size_t r = 0; r < rs.sh_size / sizeof(Elf32_Rel); r++)
+            {
+                int      type  = ELF32_R_TYPE(rels[r].r_info);
+                uint32_t place = p.offset + rels[r].r_offset;
+                if (type == R_386_NONE)
+                    continue;
+
+                if (place + 4 > out.bytes.size())
+                    g_err.fatalNL("Relocation outside of its section in " +
+                                HL(obj.name));
+
+                uint32_t P = out.addr + place;
+                int32_t  A;
+                memcpy(&A, &out.bytes[place], 4);
+
+                int      import;
+                uint32_t S = symbolAddress(o, ELF32_R_SYM(rels[r].r_info),
+                                           import);
+                uint32_t value;
+
+                if (type == R_386_32)
+                {
+                    // The dynamic linker adds the address, A stays in place
+                    if (import != -1)
+                    {
+                        m_dynRelocs.push_back(
+                            {P, ELF32_R_INFO(import + 1, R_386_32)});
+                        continue;
+                    }
+                    value = S + A;
+                }
+                else
+                    value = S + A - P;
+
+                put(out.bytes, place, value);
+            }
+        }
+    }
+}
+
+void LinkerX86::finishRelocations()
+{
+    for (size_t i = 0; i < m_imports.size(); i++)
+        if (m_imports[i].plt)
+            m_dynRelocs.push_back(
+                {m_imports[i].gotAddr, ELF32_R_INFO(i + 1, R_386_GLOB_DAT)});
+
+    string &rel = m_out[OUT_RELDYN].bytes;
+    if (m_dynRelocs.size() * sizeof(Elf32_Rel) != rel.size())
+        g_err.fatalNL("Dynamic relocation count mismatch");
+
+    if (rel.size())
+        memcpy(&rel[0], m_dynRelocs.data(), rel.size());
+}
+
+string LinkerX86::writeExecutable(int phnum, uint32_t entry)
+{
+    bool dynamic = m_imports.size();
+
+    // Section contents
+    string file(m_rwOffset + m_rwFileSize, '\0');
+    for (int i = 0; i < OUT_BSS; i++)
+        if (m_out[i].size)
+            file.replace(m_out[i].offset, m_out[i].size, m_out[i].bytes);
+
+    // Program headers
+    vector<Elf32_Phdr> phdrs;
+    auto segment = [&](uint32_t type, uint32_t offset, uint32_t addr,
+                       uint32_t filesz, uint32_t memsz, uint32_t flags,
+                       uint32_t align) {
+        Elf32_Phdr ph = {type, offset, addr, addr, filesz, memsz, flags, align};
+        phdrs.push_back(ph);
+    };
+
+    uint32_t phsize = phnum * sizeof(Elf32_Phdr);
+    if (dynamic)
+    {
+        segment(PT_PHDR, sizeof(Elf32_Ehdr), BASE_ADDRESS + sizeof(Elf32_Ehdr),
+                phsize, phsize, PF_R, 4);
+        segment(PT_INTERP, m_out[OUT_INTERP].offset, m_out[OUT_INTERP].addr,
+                m_out[OUT_INTERP].size, m_out[OUT_INTERP].size, PF_R, 1);
+    }
+
+    segment(PT_LOAD, 0, BASE_ADDRESS, m_rxSize, m_rxSize, PF_R | PF_X,
+            SEGMENT_ALIGN);
+    if (m_rwMemSize)
+        segment(PT_LOAD, m_rwOffset, m_rwAddr, m_rwFileSize, m_rwMemSize,
+                PF_R | PF_W, SEGMENT_ALIGN);
+
+    if (dynamic)
+        segment(PT_DYNAMIC, m_out[OUT_DYNAMIC].offset, m_out[OUT_DYNAMIC].addr,
+                m_out[OUT_DYNAMIC].size, m_out[OUT_DYNAMIC].size,
+                PF_R | PF_W, 4);
+
+    segment(PT_GNU_STACK, 0, 0, 0, 0, PF_R | PF_W, 16);
+
+    if ((int) phdrs.size() != phnum)
+        g_err.fatalNL("Program header count mismatch");
+
+    for (size_t i = 0; i < phdrs.size(); i++)
+        put(file, sizeof(Elf32_Ehdr) + i * sizeof(Elf32_Phdr), phdrs[i]);
+
+    // Section headers, only for the tools, the loader doesn't need them
+    vector<Elf32_Shdr> headers(1);
+    string             shstrtab(1, '\0');
+    int                shIndex[OUT_COUNT] = {};
+
+    for (int i = 0; i < OUT_COUNT; i++)
+    {
+        if (!m_out[i].size)
+            continue;
+
+        shIndex[i]      = headers.size();
+        Elf32_Shdr sh   = {};
+        sh.sh_name      = addString(shstrtab, m_out[i].name);
+        sh.sh_type      = m_out[i].type;
+        sh.sh_flags     = m_out[i].flags;
+        sh.sh_addr      = m_out[i].addr;
+        sh.sh_offset    = m_out[i].offset;
+        sh.sh_size      = m_out[i].size;
+        sh.sh_addralign = m_out[i].align;
+        headers.push_back(sh);
+    }
+
+    if (dynamic)
+    {
+        headers[shIndex[OUT_HASH]].sh_link      = shIndex[OUT_DYNSYM];
+        headers[shIndex[OUT_HASH]].sh_entsize   = 4;
+        headers[shIndex[OUT_DYNSYM]].sh_link    = shIndex[OUT_DYNSTR];
+        headers[shIndex[OUT_DYNSYM]].sh_info    = 1;
+        headers[shIndex[OUT_DYNSYM]].sh_entsize = sizeof(Elf32_Sym);
+        headers[shIndex[OUT_RELDYN]].sh_link    = shIndex[OUT_DYNSYM];
+        headers[shIndex[OUT_RELDYN]].sh_entsize = sizeof(Elf32_Rel);
+        headers[shIndex[OUT_DYNAMIC]].sh_link   = shIndex[OUT_DYNSTR];
+        headers[shIndex[OUT_DYNAMIC]].sh_entsize = sizeof(Elf32_Dyn);
+    }
+
+    // Symbol table with the symbols of the objects, locals first
+    string symtab(sizeof(Elf32_Sym), '\0');
+    string strtab(1, '\0');
+    int    firstGlobal = 1;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass)
+            firstGlobal = symtab.size() / sizeof(Elf32_Sym);
+
+        for (size_t o = 0; o < m_objects.size(); o++)
+        {
+            const InputObject &obj = m_objects[o];
+            for (int i = 1; i < obj.symbolCount; i++)
+            {
+                const Elf32_Sym &s    = obj.symbols[i];
+                int              bind = ELF32_ST_BIND(s.st_info);
+                int              type = ELF32_ST_TYPE(s.st_info);
+                const char      *name = symbolName(obj, i);
+
+                if ((bind == STB_LOCAL) == (bool) pass || !*name ||
+                    type == STT_SECTION || type == STT_FILE ||
+                    s.st_shndx == SHN_UNDEF)
+                    continue;
+
+                // Only the definition that won
+                if (bind != STB_LOCAL)
+                {
+                    const Definition &def = m_globals[name];
+                    if (def.object != (int) o || def.symbol != i)
+                        continue;
+                }
+
+                int       import;
+                Elf32_Sym sym = s;
+                sym.st_name   = addString(strtab, name);
+                sym.st_value  = symbolAddress(o, i, import);
+
+                if (s.st_shndx == SHN_COMMON)
+                    sym.st_shndx = shIndex[OUT_BSS];
+                else if (s.st_shndx != SHN_ABS)
+                    sym.st_shndx = shIndex[m_placements[obj.placement[s.st_shndx]].out];
+
+                append(symtab, sym);
+            }
+        }
+    }
+
+    auto table = [&](const char *name, uint32_t type, const string &data) {
+        Elf32_Shdr sh   = {};
+        sh.sh_name      = addString(shstrtab, name);
+        sh.sh_type      = type;
+        sh.sh_offset    = file.size();
+        sh.sh_size      = data.size();
+        sh.sh_addralign = type == SHT_SYMTAB ? 4 : 1;
+        file += data;
+        headers.push_back(sh);
+    };
+
+    table(".symtab", SHT_SYMTAB, symtab);
+    headers.back().sh_link    = headers.size();
+    headers.back().sh_info    = firstGlobal;
+    headers.back().sh_entsize = sizeof(Elf32_Sym);
+    table(".strtab", SHT_STRTAB, strtab);
+    table(".shstrtab", SHT_STRTAB, shstrtab + ".shstrtab" + '\0');
+
+    file.resize(alignUp(file.size(), 4), '\0');
+
+    Elf32_Ehdr eh = {};
+    memcpy(eh.e_ident, ELFMAG, SELFMAG);
+    eh.e_ident[EI_CLASS]   = ELFCLASS32;
+    eh.e_ident[EI_DATA]    = ELFDATA2LSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_type      = ET_EXEC;
+    eh.e_machine   = EM_386;
+    eh.e_version   = EV_CURRENT;
+    eh.e_entry     = entry;
+    eh.e_phoff     = sizeof(Elf32_Ehdr);
+    eh.e_shoff     = file.size();
+    eh.e_ehsize    = sizeof(Elf32_Ehdr);
+    eh.e_phentsize = sizeof(Elf32_Phdr);
+    eh.e_phnum     = phnum;
+    eh.e_shentsize = sizeof(Elf32_Shdr);
+    eh.e_shnum     = headers.size();
+    eh.e_shstrndx  = headers.size() - 1;
+    put(file, 0, eh);
+
+    for (const Elf32_Shdr &sh : headers)
+        append(file, sh);
+
+    return file;
+}
+
+void LinkerX86::link(const string &output)
+{
+    if (!m_globals.count("_start"))
+        addStartup();
+
+    findImports();
+    placeSections();
+    buildDynamic();
+
+    bool dynamic = m_imports.size();
+    bool rw      = m_out[OUT_DATA].size || m_out[OUT_BSS].size || dynamic;
+    int  phnum   = 2 + rw + dynamic * 3;
+
+    layout(phnum);
+    fillDynamic();
+    relocate();
+    finishRelocations();
+
+    int               import;
+    const Definition &start = m_globals["_start"];
+    string file = writeExecutable(phnum, symbolAddress(start.object,
+                                                       start.symbol, import));
+
+    FILE *f = fopen(output.c_str(), "wb");
+    if (f == NULL)
+        g_err.fatalNL("Could not open file: '" + output + "'");
+
+    if (fwrite(file.data(), 1, file.size(), f) != file.size() || fclose(f))
+        g_err.fatalNL("Could not write executable: '" + output + "'");
+
+    mode_t mask = umask(0);
+    umask(mask);
+    chmod(output.c_str(), 0777 & ~mask);
+}
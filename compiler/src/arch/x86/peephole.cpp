@@ -0,0 +1,760 @@
+#include <arch/x86/peephole.h>
+
+/* Liveness bits, the registers are 1 << their number */
+#define FLAGS    (1 << 8)
+#define ALL_LIVE 0x1ff
+
+static uint16_t bit(int reg)
+{
+    return 1 << reg;
+}
+
+/* What a function hands back and the registers it keeps for its caller */
+static const uint16_t returnLive = bit(X86_EAX) | bit(X86_EDX) |
+                                   bit(X86_EBX) | bit(X86_ESI) |
+                                   bit(X86_EDI) | bit(X86_ESP) | bit(X86_EBP);
+
+/* The stack and frame pointer are never given up */
+static const uint16_t alwaysLive = bit(X86_ESP) | bit(X86_EBP);
+
+/// @brief  The register an operand names or, for memory, its base
+static uint16_t regsOf(const X86Operand &op)
+{
+    if (op.is(X86Operand::REG))
+        return bit(op.size == 1 ? op.reg & 3 : op.reg);
+    else if (op.is(X86Operand::MEM) && op.reg >= 0)
+        return bit(op.reg);
+
+    return 0;
+}
+
+/// @brief  Equal operands, a memory operand without a size matches the
+///         same address with one
+static bool sameLocation(const X86Operand &a, const X86Operand &b)
+{
+    if (a.is(X86Operand::MEM) && b.is(X86Operand::MEM))
+        return a.reg == b.reg && a.disp == b.disp && a.symbol == b.symbol;
+
+    return a == b;
+}
+
+static bool isPseudo(int op)
+{
+    return op == X86_LABEL || op == X86_COMMENT;
+}
+
+/// @brief  The registers and flags an instruction reads and the ones it
+///         overwrites completely
+static void effects(const X86Instr &instr, uint16_t &use, uint16_t &def)
+{
+    const X86Operand &dest = instr.dest;
+    const X86Operand &src  = instr.src;
+    use = def = 0;
+
+    switch (instr.op)
+    {
+    case X86_MOV:
+    case X86_MOVZX:
+    case X86_MOVSX:
+    case X86_LEA:
+    case X86_POP:
+    case X86_SETCC:
+        use = regsOf(src);
+
+        // Writing part of a register keeps the rest of it
+        if (dest.is(X86Operand::REG) && dest.size == 4)
+            def = regsOf(dest);
+        else
+            use |= regsOf(dest);
+
+        if (instr.op == X86_SETCC)
+            use |= FLAGS;
+        else if (instr.op == X86_POP)
+            use |= bit(X86_ESP);
+        break;
+
+    case X86_CMP:
+    case X86_TEST:
+        use = regsOf(dest) | regsOf(src);
+        def = FLAGS;
+        break;
+
+    case X86_ADD:
+    case X86_OR:
+    case X86_ADC:
+    case X86_SBB:
+    case X86_AND:
+    case X86_SUB:
+    case X86_XOR:
+        def = FLAGS;
+
+        // xor eax, eax doesn't care what eax was
+        if ((instr.op == X86_XOR || instr.op == X86_SUB) && dest == src &&
+            dest.is(X86Operand::REG) && dest.size == 4)
+            def |= regsOf(dest);
+        else
+            use = regsOf(dest) | regsOf(src);
+
+        if (instr.op == X86_ADC || instr.op == X86_SBB)
+            use |= FLAGS;
+        break;
+
+    case X86_NOT:
+        use = regsOf(dest);
+        break;
+
+    case X86_NEG:
+    case X86_INC:
+    case X86_DEC:
+        use = regsOf(dest);
+        def = FLAGS;
+        break;
+
+    // A shift by 0 leaves the flags alone
+    case X86_SHL:
+    case X86_SHR:
+    case X86_SAR:
+        use = regsOf(dest) | regsOf(src);
+        break;
+
+    case X86_IMUL:
+        if (!src.is(X86Operand::NONE))
+        {
+            use = regsOf(dest) | regsOf(src);
+            def = FLAGS;
+            break;
+        }
+    // Fallthrough, the one operand form works on edx:eax
+    case X86_MUL:
+    case X86_DIV:
+    case X86_IDIV:
+        use = regsOf(dest) | bit(X86_EAX) | bit(X86_EDX);
+        def = bit(X86_EAX) | bit(X86_EDX) | FLAGS;
+        break;
+
+    case X86_CDQ:
+        use = bit(X86_EAX);
+        def = bit(X86_EDX);
+        break;
+    case X86_CWDE:
+        use = bit(X86_EAX);
+        break;
+
+    case X86_PUSH:
+        use = regsOf(dest) | bit(X86_ESP);
+        break;
+    case X86_CALL:
+        use = regsOf(dest) | bit(X86_ESP);
+        def = bit(X86_EAX) | bit(X86_ECX) | bit(X86_EDX) | FLAGS;
+        break;
+    case X86_RET:
+        use = returnLive;
+        break;
+    case X86_LEAVE:
+        use = bit(X86_EBP);
+        break;
+
+    case X86_JMP:
+        use = regsOf(dest);
+        break;
+    case X86_JCC:
+        use = FLAGS;
+        break;
+    case X86_INT:
+        use = ALL_LIVE;
+        break;
+    }
+}
+
+/*
+ * The patterns. Each gets the index of an instruction and looks at the ones
+ * that follow it, it returns true if it changed something.
+ */
+
+/// @brief  mov eax, eax
+static bool selfMove(PeepholeX86 &p, int i)
+{
+    if (p[i].op != X86_MOV || !p[i].dest.is(X86Operand::REG) ||
+        p[i].dest != p[i].src)
+        return false;
+
+    p.remove(i);
+    return true;
+}
+
+/// @brief  mov eax, ebx / mov ebx, eax: the second one copies what is
+///         already there
+static bool moveBack(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    if (j == -1 || p[i].op != X86_MOV || p[j].op != X86_MOV)
+        return false;
+
+    X86Instr &a = p[i];
+    X86Instr &b = p[j];
+    if (!sameLocation(a.dest, b.src) || !sameLocation(a.src, b.dest))
+        return false;
+
+    // mov eax, [eax] moved the address the value came from
+    if (a.dest.is(X86Operand::REG) && (regsOf(a.dest) & regsOf(a.src)))
+        return false;
+
+    p.remove(j);
+    return true;
+}
+
+/// @brief  mov [x], eax / mov ebx, [x]: the value is still in eax
+static bool storeForward(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    if (j == -1 || p[i].op != X86_MOV || p[j].op != X86_MOV)
+        return false;
+
+    X86Instr &store = p[i];
+    X86Instr &load  = p[j];
+    if (!store.dest.is(X86Operand::MEM) || !store.src.is(X86Operand::REG) ||
+        !load.dest.is(X86Operand::REG) ||
+        !sameLocation(store.dest, load.src) ||
+        load.dest.size != store.src.size)
+        return false;
+
+    if (load.dest == store.src)
+        p.remove(j);
+    else
+        load.src = store.src;
+    return true;
+}
+
+/// @brief  push eax / pop ebx, what spilling leaves behind when nothing
+///         needed the register in between
+static bool pushPop(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    if (j == -1 || p[i].op != X86_PUSH || p[j].op != X86_POP)
+        return false;
+
+    X86Operand &pushed = p[i].dest;
+    X86Operand &popped = p[j].dest;
+    if (!popped.is(X86Operand::REG) || popped.size != 4 ||
+        popped.reg == X86_ESP || pushed.isReg(X86_ESP) ||
+        !((pushed.is(X86Operand::REG) && pushed.size == 4) ||
+          pushed.is(X86Operand::IMM)))
+        return false;
+
+    if (pushed != popped)
+        p[j] = X86Instr(X86_MOV, popped, pushed);
+    else
+        p.remove(j);
+
+    p.remove(i);
+    return true;
+}
+
+/// @brief  jmp .L1 / .L1: falls through anyway
+static bool jumpToNext(PeepholeX86 &p, int i)
+{
+    if ((p[i].op != X86_JMP && p[i].op != X86_JCC) ||
+        !p[i].dest.is(X86Operand::LABEL))
+        return false;
+
+    for (int j = p.next(i, true); j != -1 && p[j].op == X86_LABEL;
+         j = p.next(j, true))
+    {
+        if (p[j].dest == p[i].dest)
+        {
+            p.remove(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// @brief  je .L1 / jmp .L2 / .L1: jne .L2
+static bool jumpOverJump(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    if (j == -1 || p[i].op != X86_JCC || p[j].op != X86_JMP ||
+        !p[i].dest.is(X86Operand::LABEL) || !p[j].dest.is(X86Operand::LABEL))
+        return false;
+
+    for (int k = p.next(j, true); k != -1 && p[k].op == X86_LABEL;
+         k = p.next(k, true))
+    {
+        if (p[k].dest == p[i].dest)
+        {
+            // Conditions come in pairs, the lowest bit negates them
+            p[i].cond ^= 1;
+            p[i].dest = p[j].dest;
+            p.remove(j);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// @brief  sete cl / movzx ecx, cl / test ecx, ecx / jne .L1: the jump can
+///         use the flags the sete used. cmp ecx, 0 tests the same.
+static bool compareFusion(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    int k = j == -1 ? -1 : p.next(j);
+    int l = k == -1 ? -1 : p.next(k);
+    if (l == -1)
+        return false;
+
+    X86Instr &set  = p[i];
+    X86Instr &zx   = p[j];
+    X86Instr &test = p[k];
+    X86Instr &jump = p[l];
+    bool isTest = (test.op == X86_TEST && test.src == zx.dest) ||
+                  (test.op == X86_CMP && test.src == X86Operand::imm(0));
+    if (set.op != X86_SETCC || zx.op != X86_MOVZX || !isTest ||
+        jump.op != X86_JCC || zx.src != set.dest ||
+        !zx.dest.is(X86Operand::REG) || regsOf(zx.dest) != regsOf(zx.src) ||
+        test.dest != zx.dest ||
+        (jump.cond != X86_CC_E && jump.cond != X86_CC_NE) ||
+        !p.dead(l, zx.dest))
+        return false;
+
+    // jne jumps when the condition held, je when it didn't
+    jump.cond = jump.cond == X86_CC_NE ? set.cond : set.cond ^ 1;
+    p.remove(i);
+    p.remove(j);
+    p.remove(k);
+    return true;
+}
+
+/// @brief  mov eax, x / mov ebx, eax: mov ebx, x if eax isn't used anymore
+static bool copyPropagation(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    if (j == -1 || p[j].op != X86_MOV)
+        return false;
+
+    X86Instr &a = p[i];
+    X86Instr &b = p[j];
+    if ((a.op != X86_MOV && a.op != X86_MOVZX && a.op != X86_MOVSX &&
+         a.op != X86_LEA) ||
+        !a.dest.is(X86Operand::REG) || b.src != a.dest ||
+        (b.dest.is(X86Operand::MEM) && (regsOf(b.dest) & regsOf(a.dest))) ||
+        !p.dead(j, a.dest))
+        return false;
+
+    if (b.dest.is(X86Operand::REG))
+    {
+        a.dest = b.dest;
+        p.remove(j);
+        return true;
+    }
+
+    // A store can only take a register or a constant
+    if (a.op != X86_MOV ||
+        !(a.src.is(X86Operand::REG) || a.src.is(X86Operand::IMM)))
+        return false;
+
+    b.src       = a.src;
+    b.dest.size = a.dest.size;
+    p.remove(i);
+    return true;
+}
+
+/// @brief  mov ebx, 4 / add eax, ebx: add eax, 4
+static bool immediateOperand(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    if (j == -1 || p[i].op != X86_MOV || !p[i].dest.is(X86Operand::REG) ||
+        !p[i].src.is(X86Operand::IMM) || !p.dead(j, p[i].dest))
+        return false;
+
+    X86Instr &b = p[j];
+    if (b.op > X86_CMP || b.src != p[i].dest ||
+        (regsOf(b.dest) & regsOf(b.src)))
+        return false;
+
+    b.src = p[i].src;
+    if (b.dest.is(X86Operand::MEM))
+        b.dest.size = p[i].dest.size;
+
+    p.remove(i);
+    return true;
+}
+
+/// @brief  mov eax, [x] / push eax: push dword [x]
+static bool pushOperand(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    if (j == -1 || p[j].op != X86_PUSH || !p[i].dest.is(X86Operand::REG) ||
+        p[i].dest.size != 4 || p[j].dest != p[i].dest || !p.dead(j, p[i].dest))
+        return false;
+
+    X86Operand src = p[i].src;
+    if (p[i].op == X86_MOV && src.is(X86Operand::MEM))
+        src.size = 4;
+    else if (p[i].op == X86_LEA && src.reg == -1 && src.symbol != NOATOM &&
+             !src.disp)
+        src = X86Operand::symbolOp(src.symbol);
+    else if (p[i].op != X86_MOV)
+        return false;
+
+    p[j].dest = src;
+    p.remove(i);
+    return true;
+}
+
+/// @brief  xor ecx, ecx / test eax, eax / sete cl / movzx ecx, cl: the movzx
+///         clears the rest of ecx already
+static bool zeroBeforeSet(PeepholeX86 &p, int i)
+{
+    const X86Instr &zero = p[i];
+
+    bool isXor = zero.op == X86_XOR && zero.dest == zero.src;
+    bool isMov = zero.op == X86_MOV && zero.src == X86Operand::imm(0);
+    if (!(isXor || isMov) || !zero.dest.is(X86Operand::REG) ||
+        zero.dest.size != 4 || (isXor && !p.flagsDead(i)))
+        return false;
+
+    // The compare may sit in between
+    uint16_t reg = regsOf(zero.dest);
+    int      j   = p.next(i);
+    if (j != -1 && (p[j].op == X86_CMP || p[j].op == X86_TEST) &&
+        !((regsOf(p[j].dest) | regsOf(p[j].src)) & reg))
+        j = p.next(j);
+
+    int k = j == -1 ? -1 : p.next(j);
+    if (k == -1 || p[j].op != X86_SETCC || regsOf(p[j].dest) != reg ||
+        p[k].op != X86_MOVZX || p[k].src != p[j].dest ||
+        p[k].dest != zero.dest)
+        return false;
+
+    p.remove(i);
+    return true;
+}
+
+/// @brief  add eax, 0
+static bool addZero(PeepholeX86 &p, int i)
+{
+    if ((p[i].op != X86_ADD && p[i].op != X86_SUB) ||
+        !p[i].src.is(X86Operand::IMM) || p[i].src.disp || !p.flagsDead(i))
+        return false;
+
+    p.remove(i);
+    return true;
+}
+
+/// @brief  lea eax, [x] / add eax, 4: lea eax, [x+4]
+static bool leaAdd(PeepholeX86 &p, int i)
+{
+    int j = p.next(i);
+    if (j == -1 || p[i].op != X86_LEA ||
+        (p[j].op != X86_ADD && p[j].op != X86_SUB) ||
+        p[j].dest != p[i].dest || !p[j].src.is(X86Operand::IMM) ||
+        !p.flagsDead(j))
+        return false;
+
+    p[i].src.disp += p[j].op == X86_ADD ? p[j].src.disp : -p[j].src.disp;
+    p.remove(j);
+    return true;
+}
+
+/// @brief  The memory operand of instruction j that is based on the register
+///         instruction i computes, NULL if the register can't go away
+static X86Operand *foldableAddress(PeepholeX86 &p, int i, int j)
+{
+    X86Instr &b = p[j];
+
+    bool load = b.op == X86_MOV || b.op == X86_MOVZX || b.op == X86_MOVSX ||
+                b.op == X86_LEA;
+    if (b.op > X86_CMP && !load && b.op != X86_TEST && b.op != X86_PUSH)
+        return NULL;
+
+    uint16_t    reg   = regsOf(p[i].dest);
+    X86Operand *mem   = &b.dest;
+    X86Operand *other = &b.src;
+    if (!(b.dest.is(X86Operand::MEM) && regsOf(b.dest) == reg))
+        swap(mem, other);
+
+    if (!mem->is(X86Operand::MEM) || regsOf(*mem) != reg)
+        return NULL;
+
+    // The address isn't needed anymore when nothing reads the register after
+    // this or the load replaces it: mov eax, [eax]
+    bool replaced = load && other == &b.dest && b.dest.size == 4 &&
+                    regsOf(b.dest) == reg;
+    if (!replaced && ((regsOf(*other) & reg) || !p.dead(j, p[i].dest)))
+        return NULL;
+
+    return mem;
+}
+
+/// @brief  lea eax, [x] / mov ebx, [eax+4]: mov ebx, [x+4]
+static bool addressFold(PeepholeX86 &p, int i)
+{
+    int         j   = p.next(i);
+    X86Operand *mem = NULL;
+    if (j == -1 || p[i].op != X86_LEA || !(mem = foldableAddress(p, i, j)))
+        return false;
+
+    X86Operand folded = p[i].src;
+    folded.disp += mem->disp;
+    folded.size = mem->size;
+    *mem        = folded;
+    p.remove(i);
+    return true;
+}
+
+/// @brief  add eax, 4 / mov ebx, [eax]: mov ebx, [eax+4]
+static bool displacementFold(PeepholeX86 &p, int i)
+{
+    int         j   = p.next(i);
+    X86Operand *mem = NULL;
+    if (j == -1 || (p[i].op != X86_ADD && p[i].op != X86_SUB) ||
+        !p[i].dest.is(X86Operand::REG) || p[i].dest.size != 4 ||
+        !p[i].src.is(X86Operand::IMM) || !p.flagsDead(i) ||
+        !(mem = foldableAddress(p, i, j)))
+        return false;
+
+    mem->disp += p[i].op == X86_ADD ? p[i].src.disp : -p[i].src.disp;
+    p.remove(i);
+    return true;
+}
+
+/// @brief  An instruction whose result nothing reads
+static bool deadCode(PeepholeX86 &p, int i)
+{
+    const X86Instr &instr = p[i];
+    switch (instr.op)
+    {
+    case X86_MOV:
+    case X86_MOVZX:
+    case X86_MOVSX:
+    case X86_LEA:
+    case X86_SETCC:
+        break;
+
+    case X86_CMP:
+    case X86_TEST:
+        if (!p.flagsDead(i))
+            return false;
+
+        p.remove(i);
+        return true;
+
+    case X86_ADD:
+    case X86_OR:
+    case X86_AND:
+    case X86_SUB:
+    case X86_XOR:
+    case X86_NEG:
+    case X86_INC:
+    case X86_DEC:
+        if (!p.flagsDead(i))
+            return false;
+        break;
+
+    default:
+        return false;
+    }
+
+    if (!instr.dest.is(X86Operand::REG) || !p.dead(i, instr.dest))
+        return false;
+
+    p.remove(i);
+    return true;
+}
+
+struct Pattern
+{
+    int level;      // Lowest -O level it runs at
+    bool (*apply)(PeepholeX86 &p, int i);
+};
+
+static const Pattern patterns[] = {
+    {1, selfMove},
+    {1, moveBack},
+    {1, storeForward},
+    {1, pushPop},
+    {1, jumpToNext},
+    {1, jumpOverJump},
+    {1, compareFusion},
+    {1, copyPropagation},
+    {1, zeroBeforeSet},
+    {1, deadCode},
+
+    // These move values and addresses into the instructions using them
+    {2, immediateOperand},
+    {2, pushOperand},
+    {2, addZero},
+    {2, leaAdd},
+    {2, addressFold},
+    {2, displacementFold},
+};
+
+PeepholeX86::PeepholeX86(X86Code &code, int level)
+    : m_instrs(code.instrs()), m_level(level)
+{
+}
+
+/// @brief  The instruction after i, comments are skipped. Labels end the
+///         sequence unless they are asked for, -1 if there is none.
+int PeepholeX86::next(int i, bool labels)
+{
+    for (i++; i < (int) m_instrs.size(); i++)
+    {
+        if (m_removed[i] || m_instrs[i].op == X86_COMMENT)
+            continue;
+
+        // A label nothing jumps to doesn't split the code
+        if (m_instrs[i].op == X86_LABEL && !labels)
+        {
+            if (m_targeted[i])
+                return -1;
+            continue;
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+/// @brief  True if nothing reads the register after instruction i
+bool PeepholeX86::dead(int i, const X86Operand &reg)
+{
+    return !(m_liveOut[i] & regsOf(reg));
+}
+
+bool PeepholeX86::flagsDead(int i)
+{
+    return !(m_liveOut[i] & FLAGS);
+}
+
+static int64_t labelKey(const X86Operand &label)
+{
+    return label.label >= 0 ? label.label : -(int64_t) label.symbol - 1;
+}
+
+/// @brief  Standard backwards dataflow, repeated until the loops agree
+void PeepholeX86::computeLiveness()
+{
+    int n = m_instrs.size();
+
+    // Symbols are entered from outside
+    unordered_map<int64_t, int> labels;
+    m_targeted.assign(n, false);
+    for (int i = 0; i < n; i++)
+    {
+        if (m_instrs[i].op != X86_LABEL)
+            continue;
+
+        if (m_instrs[i].dest.is(X86Operand::LABEL))
+            labels[labelKey(m_instrs[i].dest)] = i;
+        else
+            m_targeted[i] = true;
+    }
+
+    // Where jumps go, -1 if it isn't known
+    vector<int> targets(n, -1);
+    for (int i = 0; i < n; i++)
+    {
+        const X86Instr &instr = m_instrs[i];
+        if ((instr.op == X86_JMP || instr.op == X86_JCC) &&
+            instr.dest.is(X86Operand::LABEL))
+        {
+            auto it = labels.find(labelKey(instr.dest));
+            if (it != labels.end())
+            {
+                targets[i]              = it->second;
+                m_targeted[it->second] = true;
+            }
+        }
+    }
+
+    vector<uint16_t> liveIn(n + 1, 0);
+    liveIn[n] = ALL_LIVE;
+    m_liveOut.assign(n, 0);
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = n - 1; i >= 0; i--)
+        {
+            const X86Instr &instr = m_instrs[i];
+
+            uint16_t out = alwaysLive;
+            if (instr.op != X86_JMP && instr.op != X86_RET)
+                out |= liveIn[i + 1];
+            if (instr.op == X86_JMP || instr.op == X86_JCC)
+                out |= targets[i] == -1 ? ALL_LIVE : liveIn[targets[i]];
+
+            uint16_t use, def;
+            effects(instr, use, def);
+
+            // setcc only writes the low byte, but the movzx after it the
+            // whole register
+            const X86Instr *after = i + 1 < n ? &m_instrs[i + 1] : NULL;
+            if (instr.op == X86_SETCC && after && after->op == X86_MOVZX &&
+                after->src == instr.dest && after->dest.size == 4 &&
+                regsOf(after->dest) == regsOf(instr.dest))
+            {
+                use &= ~regsOf(instr.dest);
+                def |= regsOf(instr.dest);
+            }
+
+            uint16_t in = use | (out & ~def);
+            m_liveOut[i] = out;
+            if (in != liveIn[i])
+            {
+                liveIn[i] = in;
+                changed   = true;
+            }
+        }
+    }
+}
+
+/// @brief  Tries every pattern on every instruction once. An instruction
+///         that was rewritten gets no other patterns in the same pass, the
+///         liveness after it may have changed.
+bool PeepholeX86::pass()
+{
+    computeLiveness();
+    m_removed.assign(m_instrs.size(), false);
+
+    bool changed = false;
+    for (int i = 0; i < (int) m_instrs.size(); i++)
+    {
+        if (m_removed[i] || isPseudo(m_instrs[i].op))
+            continue;
+
+        for (const Pattern &pattern : patterns)
+        {
+            if (pattern.level <= m_level && pattern.apply(*this, i))
+            {
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    int n = 0;
+    for (int i = 0; i < (int) m_instrs.size(); i++)
+    {
+        if (!m_removed[i])
+            m_instrs[n++] = m_instrs[i];
+    }
+    m_instrs.erase(m_instrs.begin() + n, m_instrs.end());
+
+    return changed;
+}
+
+/// @brief  Optimizes the code, returns the number of instructions it saved
+int PeepholeX86::run()
+{
+    int before = m_instrs.size();
+    while (pass())
+        ;
+
+    return before - m_instrs.size();
+}
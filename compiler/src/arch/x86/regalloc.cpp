@@ -0,0 +1,515 @@
+#include <arch/x86/regalloc.h>
+#include <context.h>
+#include <errorhandler.h>
+
+/* The registers that are handed out. The ones a function has to keep for
+ * its caller come last, they have to be saved once they are used. */
+static const int allocatable[] = {X86_EAX, X86_ECX, X86_EDX,
+                                  X86_EBX, X86_ESI, X86_EDI};
+
+enum Access
+{
+    READ  = 1,
+    WRITE = 2,
+};
+
+/* A set of registers, physical and virtual ones, indexed by their number */
+typedef vector<uint64_t> RegSet;
+
+static bool has(const RegSet &set, int reg)
+{
+    return set[reg >> 6] >> (reg & 63) & 1;
+}
+
+static void put(RegSet &set, int reg)
+{
+    set[reg >> 6] |= (uint64_t) 1 << (reg & 63);
+}
+
+/// @brief  xor eax, eax and sub eax, eax don't care what eax was
+static bool zeroes(const X86Instr &instr)
+{
+    return (instr.op == X86_XOR || instr.op == X86_SUB) &&
+           instr.dest.is(X86Operand::REG) && instr.dest == instr.src;
+}
+
+/// @brief  How an instruction uses the register it names as destination.
+///         Writing part of a virtual register counts as writing all of it,
+///         the generator never reads the rest afterwards.
+static int destAccess(const X86Instr &instr)
+{
+    switch (instr.op)
+    {
+    case X86_MOV:
+    case X86_MOVZX:
+    case X86_MOVSX:
+    case X86_LEA:
+    case X86_POP:
+    case X86_SETCC:
+        return WRITE;
+
+    case X86_CMP:
+    case X86_TEST:
+    case X86_PUSH:
+    case X86_JMP:
+    case X86_CALL:
+    case X86_MUL:
+    case X86_DIV:
+    case X86_IDIV:
+        return READ;
+
+    case X86_IMUL:
+        return instr.src.is(X86Operand::NONE) ? READ : READ | WRITE;
+
+    default:
+        return zeroes(instr) ? WRITE : READ | WRITE;
+    }
+}
+
+/// @brief  Calls f(reg, access) for the registers an instruction reads and
+///         writes, the ones it uses without naming them included
+template <typename F> static void accesses(const X86Instr &instr, F f)
+{
+    const X86Operand &dest = instr.dest;
+    const X86Operand &src  = instr.src;
+
+    if (dest.is(X86Operand::REG))
+        f(dest.reg, destAccess(instr));
+    else if (dest.is(X86Operand::MEM) && dest.reg >= 0)
+        f(dest.reg, READ);
+
+    if ((src.is(X86Operand::REG) || src.is(X86Operand::MEM)) &&
+        src.reg >= 0 && !zeroes(instr))
+        f(src.reg, READ);
+
+    switch (instr.op)
+    {
+    case X86_IMUL:
+        if (!src.is(X86Operand::NONE))
+            break;
+    // Fallthrough, the one operand form works on edx:eax
+    case X86_MUL:
+    case X86_DIV:
+    case X86_IDIV:
+        f(X86_EAX, READ | WRITE);
+        f(X86_EDX, READ | WRITE);
+        break;
+
+    case X86_CDQ:
+        f(X86_EAX, READ);
+        f(X86_EDX, WRITE);
+        break;
+    case X86_CWDE:
+        f(X86_EAX, READ | WRITE);
+        break;
+
+    case X86_CALL:
+        f(X86_EAX, WRITE);
+        f(X86_ECX, WRITE);
+        f(X86_EDX, WRITE);
+        break;
+    }
+}
+
+static bool endsBlock(int op)
+{
+    return op == X86_JMP || op == X86_JCC || op == X86_RET;
+}
+
+static int64_t labelKey(const X86Operand &label)
+{
+    return label.label >= 0 ? label.label : -(int64_t) label.symbol - 1;
+}
+
+RegAllocX86::RegAllocX86(X86Code &code, int virtuals, int frameSize)
+    : m_instrs(code.instrs()), m_virtuals(virtuals), m_frameSize(frameSize)
+{
+    m_intervals.resize(virtuals);
+}
+
+/// @brief  The live intervals of the virtual registers and where the code
+///         needs the physical ones, from a liveness over the basic blocks
+void RegAllocX86::computeIntervals()
+{
+    int n = m_instrs.size();
+
+    // A block starts at every label and after every jump
+    vector<int>                 starts;
+    unordered_map<int64_t, int> labels;
+    for (int i = 0; i < n; i++)
+    {
+        if (!i || m_instrs[i].op == X86_LABEL || endsBlock(m_instrs[i - 1].op))
+            starts.push_back(i);
+
+        if (m_instrs[i].op == X86_LABEL && m_instrs[i].dest.is(X86Operand::LABEL))
+            labels[labelKey(m_instrs[i].dest)] = starts.size() - 1;
+    }
+
+    int         blocks = starts.size();
+    vector<int> ends(blocks);
+    for (int b = 0; b < blocks; b++)
+        ends[b] = b + 1 < blocks ? starts[b + 1] - 1 : n - 1;
+
+    vector<vector<int>> successors(blocks);
+    for (int b = 0; b < blocks; b++)
+    {
+        const X86Instr &last = m_instrs[ends[b]];
+        if (last.op == X86_JMP || last.op == X86_JCC)
+        {
+            auto it = labels.find(labelKey(last.dest));
+            if (it != labels.end())
+                successors[b].push_back(it->second);
+        }
+
+        if (last.op != X86_JMP && last.op != X86_RET && b + 1 < blocks)
+            successors[b].push_back(b + 1);
+    }
+
+    // Most values are used in the block that computes them, only the
+    // others and the physical registers take part in the dataflow
+    vector<int> home(m_virtuals, -1);
+    vector<int> index(X86_VREG + m_virtuals, -1);
+    vector<int> indexed;
+    for (int reg = 0; reg < X86_VREG; reg++)
+    {
+        index[reg] = reg;
+        indexed.push_back(reg);
+    }
+
+    for (int b = 0; b < blocks; b++)
+    {
+        for (int i = starts[b]; i <= ends[b]; i++)
+        {
+            accesses(m_instrs[i], [&](int reg, int access) {
+                if (reg < X86_VREG || index[reg] != -1)
+                    return;
+
+                int &block = home[reg - X86_VREG];
+                if (block == -1 && !(access & READ))
+                    block = b;
+                else if (block != b)
+                {
+                    index[reg] = indexed.size();
+                    indexed.push_back(reg);
+                }
+            });
+        }
+    }
+
+    // What each block reads before writing it and what it writes
+    int            words = (indexed.size() + 63) / 64;
+    vector<RegSet> use(blocks, RegSet(words)), def(blocks, RegSet(words));
+    for (int b = 0; b < blocks; b++)
+    {
+        for (int i = starts[b]; i <= ends[b]; i++)
+        {
+            accesses(m_instrs[i], [&](int reg, int access) {
+                if ((access & READ) && index[reg] != -1 &&
+                    !has(def[b], index[reg]))
+                    put(use[b], index[reg]);
+            });
+            accesses(m_instrs[i], [&](int reg, int access) {
+                if ((access & WRITE) && index[reg] != -1)
+                    put(def[b], index[reg]);
+            });
+        }
+    }
+
+    vector<RegSet> liveIn(blocks, RegSet(words)), liveOut(liveIn);
+    bool           changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int b = blocks - 1; b >= 0; b--)
+        {
+            RegSet &out = liveOut[b];
+            for (int s : successors[b])
+                for (int w = 0; w < words; w++)
+                    out[w] |= liveIn[s][w];
+
+            for (int w = 0; w < words; w++)
+            {
+                uint64_t in = use[b][w] | (out[w] & ~def[b][w]);
+                if (in != liveIn[b][w])
+                {
+                    liveIn[b][w] = in;
+                    changed      = true;
+                }
+            }
+        }
+    }
+
+    // The intervals span every instruction a register is named in and the
+    // blocks it is live through
+    m_intervals.resize(m_virtuals);
+    for (Interval &interval : m_intervals)
+    {
+        interval.start = interval.end = interval.hint = interval.reg = -1;
+        interval.bytes = false;
+    }
+
+    auto extend = [&](int reg, int i) {
+        if (reg < X86_VREG)
+            return;
+
+        Interval &interval = m_intervals[reg - X86_VREG];
+        if (interval.start == -1 || i < interval.start)
+            interval.start = i;
+        if (i > interval.end)
+            interval.end = i;
+    };
+
+    for (int i = 0; i < n; i++)
+    {
+        const X86Instr &instr = m_instrs[i];
+        accesses(instr, [&](int reg, int) { extend(reg, i); });
+
+        for (const X86Operand *op : {&instr.dest, &instr.src})
+        {
+            if (op->is(X86Operand::REG) && op->isVirtual() && op->size == 1)
+                m_intervals[op->reg - X86_VREG].bytes = true;
+        }
+
+        // A value moved from or to a register would like to be in it
+        if (instr.op == X86_MOV && instr.dest.is(X86Operand::REG) &&
+            instr.src.is(X86Operand::REG))
+        {
+            if (instr.dest.isVirtual() && !instr.src.isVirtual())
+                m_intervals[instr.dest.reg - X86_VREG].hint = instr.src.reg;
+            else if (instr.src.isVirtual() && !instr.dest.isVirtual())
+                m_intervals[instr.src.reg - X86_VREG].hint = instr.dest.reg;
+        }
+    }
+
+    for (int b = 0; b < blocks; b++)
+    {
+        for (int w = 0; w < words; w++)
+        {
+            for (uint64_t bits = liveIn[b][w]; bits; bits &= bits - 1)
+                extend(indexed[w * 64 + __builtin_ctzll(bits)], starts[b]);
+            for (uint64_t bits = liveOut[b][w]; bits; bits &= bits - 1)
+                extend(indexed[w * 64 + __builtin_ctzll(bits)], ends[b]);
+        }
+    }
+
+    // Where the code needs a physical register: it holds something that is
+    // read later or the instruction writes it
+    vector<uint8_t> busy(n);
+    for (int b = 0; b < blocks; b++)
+    {
+        uint8_t live = liveOut[b][0];
+        for (int i = ends[b]; i >= starts[b]; i--)
+        {
+            uint8_t reads = 0, writes = 0;
+            accesses(m_instrs[i], [&](int reg, int access) {
+                if (reg >= X86_VREG)
+                    return;
+                if (access & READ)
+                    reads |= 1 << reg;
+                if (access & WRITE)
+                    writes |= 1 << reg;
+            });
+
+            busy[i] = live | writes;
+            live    = reads | (live & ~writes);
+        }
+    }
+
+    m_busy.assign(X86_VREG, vector<int>(n + 1, 0));
+    for (int reg : allocatable)
+    {
+        for (int i = 0; i < n; i++)
+            m_busy[reg][i + 1] = m_busy[reg][i] + (busy[i] >> reg & 1);
+    }
+}
+
+/// @brief  True if the code needs the register while the interval lives
+bool RegAllocX86::conflicts(const Interval &interval, int reg)
+{
+    // An interval that is never read still gets written at its start
+    int end = max(interval.end, interval.start + 1);
+    return m_busy[reg][end] != m_busy[reg][interval.start];
+}
+
+/// @brief  Assigns the registers, false if some intervals didn't get one
+bool RegAllocX86::scan(vector<int> &spilled)
+{
+    vector<int> order;
+    for (int v = 0; v < m_virtuals; v++)
+    {
+        if (m_intervals[v].start != -1)
+            order.push_back(v);
+    }
+
+    stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return m_intervals[a].start < m_intervals[b].start;
+    });
+
+    vector<int> active;
+    for (int v : order)
+    {
+        Interval &cur = m_intervals[v];
+
+        // The intervals that ended give their registers back, the last
+        // instruction of one may write the first of the next
+        active.erase(remove_if(active.begin(), active.end(),
+                               [&](int a) {
+                                   return m_intervals[a].end <= cur.start;
+                               }),
+                     active.end());
+
+        auto fits = [&](int reg) {
+            return (!cur.bytes || reg < X86_ESP) && !conflicts(cur, reg);
+        };
+        auto taken = [&](int reg) {
+            for (int a : active)
+                if (m_intervals[a].reg == reg)
+                    return true;
+            return false;
+        };
+
+        if (cur.hint != -1 && cur.hint != X86_ESP && cur.hint != X86_EBP &&
+            fits(cur.hint) && !taken(cur.hint))
+            cur.reg = cur.hint;
+
+        for (int reg : allocatable)
+        {
+            if (cur.reg == -1 && fits(reg) && !taken(reg))
+                cur.reg = reg;
+        }
+
+        if (cur.reg == -1)
+        {
+            // Whichever lives longest goes to the stack, of this one and
+            // those that have a register it could use
+            int victim = -1;
+            for (int a : active)
+            {
+                const Interval &other = m_intervals[a];
+                if (other.spillable && fits(other.reg) &&
+                    (victim == -1 || other.end > m_intervals[victim].end))
+                    victim = a;
+            }
+
+            if (victim != -1 &&
+                (!cur.spillable || m_intervals[victim].end > cur.end))
+            {
+                cur.reg                  = m_intervals[victim].reg;
+                m_intervals[victim].reg = -1;
+                active.erase(find(active.begin(), active.end(), victim));
+                spilled.push_back(victim);
+            }
+            else if (cur.spillable)
+            {
+                spilled.push_back(v);
+                continue;
+            }
+            else
+                g_err.fatalNL("Ran out of registers");
+        }
+
+        active.push_back(v);
+    }
+
+    return spilled.empty();
+}
+
+/// @brief  Moves the spilled registers to stack slots. The instructions
+///         that use one get a register of their own for it, it is loaded
+///         before them and stored after them.
+void RegAllocX86::spill(const vector<int> &spilled)
+{
+    unordered_map<int, int> slots;
+    for (int v : spilled)
+    {
+        m_frameSize += 4;
+        slots[X86_VREG + v] = -m_frameSize;
+    }
+
+    vector<X86Instr> code;
+    code.reserve(m_instrs.size() + spilled.size() * 4);
+    for (const X86Instr &instr : m_instrs)
+    {
+        X86Instr         out = instr;
+        vector<X86Instr> stores;
+        for (int reg : {instr.dest.reg, instr.src.reg})
+        {
+            auto slot = slots.find(reg);
+            // Both operands may name it, the first one replaced it in both
+            if (slot == slots.end() ||
+                (out.dest.reg != reg && out.src.reg != reg))
+                continue;
+
+            int access = 0;
+            accesses(instr, [&](int r, int a) {
+                if (r == reg)
+                    access |= a;
+            });
+
+            X86Operand mem = X86Operand::mem(X86_EBP, slot->second, 4);
+            X86Operand tmp = X86Operand::regOp(X86_VREG + m_virtuals++);
+            m_intervals.emplace_back();
+            m_intervals.back().spillable = false;
+
+            if (access & READ)
+                code.push_back(X86Instr(X86_MOV, tmp, mem));
+            if (access & WRITE)
+                stores.push_back(X86Instr(X86_MOV, mem, tmp));
+
+            if (out.dest.reg == reg)
+                out.dest.reg = tmp.reg;
+            if (out.src.reg == reg)
+                out.src.reg = tmp.reg;
+        }
+
+        code.push_back(out);
+        code.insert(code.end(), stores.begin(), stores.end());
+    }
+
+    m_instrs.swap(code);
+}
+
+/// @brief  Puts the registers the intervals got into the code
+void RegAllocX86::rewrite()
+{
+    int n = 0;
+    for (X86Instr &instr : m_instrs)
+    {
+        for (X86Operand *op : {&instr.dest, &instr.src})
+        {
+            if (op->isVirtual())
+            {
+                op->reg = m_intervals[op->reg - X86_VREG].reg;
+                m_used |= 1 << op->reg;
+            }
+        }
+
+        // A move between values that got the same register
+        if (instr.op == X86_MOV && instr.dest.is(X86Operand::REG) &&
+            instr.dest == instr.src)
+            continue;
+
+        m_instrs[n++] = instr;
+    }
+
+    m_instrs.erase(m_instrs.begin() + n, m_instrs.end());
+}
+
+/// @brief  Allocates the registers, returns the frame size with the spill
+///         slots it needed
+int RegAllocX86::run()
+{
+    vector<int> spilled;
+    while (true)
+    {
+        computeIntervals();
+        if (scan(spilled))
+            break;
+
+        spill(spilled);
+        spilled.clear();
+    }
+
+    rewrite();
+    return m_frameSize;
+}
@@ -1,21 +1,88 @@
 #include <ast.h>
+#include <context.h>
 #include <core.h>
 #include <errorhandler.h>
 
+AstArena::~AstArena()
+{
+    release();
+    for (ast_node *chunk : m_chunks)
+        ::operator delete(chunk);
+}
+
+ast_node *AstArena::allocate()
+{
+    if (m_free.size())
+    {
+        ast_node *node = m_free.back();
+        m_free.pop_back();
+        return node;
+    }
+
+    if (m_chunks.empty() || m_used == AST_ARENA_CHUNK_NODES)
+    {
+        if (!m_chunks.empty())
+            m_chunk++;
+
+        if (m_chunk == m_chunks.size())
+            m_chunks.push_back((ast_node *) ::operator new(
+                sizeof(ast_node) * AST_ARENA_CHUNK_NODES));
+
+        m_used = 0;
+    }
+
+    return new (&m_chunks[m_chunk][m_used++]) ast_node();
+}
+
+/// @brief  The node stays constructed, mkAstNode overwrites every field
+void AstArena::recycle(ast_node *node)
+{
+    m_free.push_back(node);
+}
+
+/// @brief  Destroys every node, the chunks are kept for the next input file
+void AstArena::release()
+{
+    for (size_t i = 0; i < m_chunks.size() && i <= m_chunk; i++)
+    {
+        size_t used = i == m_chunk ? m_used : AST_ARENA_CHUNK_NODES;
+        for (size_t j = 0; j < used; j++)
+            m_chunks[i][j].~ast_node();
+    }
+
+    m_free.clear();
+    m_chunk = 0;
+    m_used  = 0;
+}
+
+/// @brief  Hands a temporary node back to the arena so it can be reused
+void freeAstNode(ast_node *node)
+{
+    g_astArena.recycle(node);
+}
+
+/// @brief  Returns a copy of the node's type with its memory spot filled in
+Type ast_node::typeWithSpot() const
+{
+    Type t    = type();
+    t.memSpot = memSpot;
+    return t;
+}
+
 /// @brief  Creates a abstract syntax tree nodes
 ast_node *mkAstNode(int operation, ast_node *left, 
                             ast_node *mid, ast_node *right,
-                            int value, Type type, int line, int c)
+                            int64_t value, const Type &type, int line, int c)
 {
-    ast_node *node = new (ast_node);
-    /// @todo maybe check for allocation failures
+    ast_node *node = g_astArena.allocate();
 
     node->operation = operation;
     node->left      = left;
     node->mid       = mid;
     node->right     = right;
     node->value     = value;
-    node->type      = type;
+    node->memSpot   = type.memSpot;
+    node->typeId    = g_typeTable.intern(type);
 
     node->line      = line;
     node->c         = c;
@@ -25,7 +92,7 @@ ast_node *mkAstNode(int operation, ast_node *left,
 
 ast_node *mkAstNode(int operation, ast_node *left, 
                             ast_node *mid, ast_node *right,
-                            int value, int line, int c)
+                            int64_t value, int line, int c)
 {
     Type t;
     t.primType = 0;
@@ -33,12 +100,12 @@ ast_node *mkAstNode(int operation, ast_node *left,
 }
 
 /// @brief  Creates an endpoint for the AST
-ast_node *mkAstLeaf(int operation, int value, Type type, int line, int c)
+ast_node *mkAstLeaf(int operation, int64_t value, const Type &type, int line, int c)
 {
     return mkAstNode(operation, NULL, NULL, NULL, value, type, line, c);
 }
 
-ast_node *mkAstLeaf(int operation, int value, int line, int c)
+ast_node *mkAstLeaf(int operation, int64_t value, int line, int c)
 {
     Type t;
     t.primType = 0;
@@ -46,13 +113,13 @@ ast_node *mkAstLeaf(int operation, int value, int line, int c)
 }
 
 /// @brief  Creates a unary branch of the AST
-ast_node *mkAstUnary(int operation, ast_node *left, int value,
-                            Type type, int line, int c)
+ast_node *mkAstUnary(int operation, ast_node *left, int64_t value,
+                            const Type &type, int line, int c)
 {
     return mkAstNode(operation, left, NULL, NULL, value, type, line, c);
 }
 
-ast_node *mkAstUnary(int operation, ast_node *left, int value,
+ast_node *mkAstUnary(int operation, ast_node *left, int64_t value,
                             int line, int c)
 {
     Type t;
@@ -66,7 +133,7 @@ int tokenToAst(int token, Scanner &scanner)
     if (token > Token::Tokens::T_EOF && token < Token::Tokens::INTLIT)
         return token;
 
-    err.unexpectedToken(token);
+    g_err.unexpectedToken(token);
     exit(1);
 }
 
@@ -0,0 +1,71 @@
+#include <atoms.h>
+
+#define ATOM_INITIAL_SLOTS 4096
+
+AtomTable::AtomTable()
+{
+    m_slots.resize(ATOM_INITIAL_SLOTS, NOATOM);
+
+    // Atom 0 is the empty string so a zeroed name means 'no name'
+    m_strings.emplace_back();
+    m_hashes.push_back(hash("", 0));
+}
+
+/// @brief  FNV-1a, identifiers are short so this is hard to beat
+uint32_t AtomTable::hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void AtomTable::grow()
+{
+    m_slots.assign(m_slots.size() * 2, NOATOM);
+    size_t mask = m_slots.size() - 1;
+
+    for (Atom atom = 1; atom < m_strings.size(); atom++)
+    {
+        size_t i = m_hashes[atom] & mask;
+        while (m_slots[i] != NOATOM)
+            i = (i + 1) & mask;
+
+        m_slots[i] = atom;
+    }
+}
+
+Atom AtomTable::intern(const char *s, size_t len)
+{
+    if (!len)
+        return NOATOM;
+
+    uint32_t h    = hash(s, len);
+    size_t   mask = m_slots.size() - 1;
+    size_t   i    = h & mask;
+
+    while (m_slots[i] != NOATOM)
+    {
+        Atom atom = m_slots[i];
+        const string &str = m_strings[atom];
+        if (m_hashes[atom] == h && str.size() == len &&
+            !memcmp(str.data(), s, len))
+            return atom;
+
+        i = (i + 1) & mask;
+    }
+
+    Atom atom = m_strings.size();
+    m_strings.emplace_back(s, len);
+    m_hashes.push_back(h);
+    m_slots[i] = atom;
+
+    // Keep the load factor under a half
+    if (m_strings.size() * 2 > m_slots.size())
+        grow();
+
+    return atom;
+}
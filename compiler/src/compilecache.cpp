@@ -0,0 +1,182 @@
+#include <compilecache.h>
+#include <safecc.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+
+/* Bump when the layout of the entries or what goes into the key changes */
+#define CACHE_MAGIC "SCCCACHE2"
+
+/**
+ * @brief   128 bits of key from two unrelated hashes: 64-bit FNV-1a and a
+ *          polynomial hash modulo the prime 2^61 - 1. Sources that collide in
+ *          one have no reason to collide in the other, so a collision of the
+ *          whole key is not a concern.
+ */
+class KeyHasher
+{
+  private:
+    static constexpr uint64_t PRIME = (1ull << 61) - 1;
+    static constexpr uint64_t BASE  = 0x1d8e4e27c47d124full;   // < PRIME
+
+    uint64_t m_lo = 14695981039346656037ull;    // FNV-1a
+    uint64_t m_hi = 0;                          // Polynomial
+
+    /// @brief  a * b modulo PRIME, both below PRIME
+    static uint64_t mulMod(uint64_t a, uint64_t b)
+    {
+        unsigned __int128 r = (unsigned __int128) a * b;
+        uint64_t          x = (uint64_t) (r & PRIME) + (uint64_t) (r >> 61);
+
+        x = (x & PRIME) + (x >> 61);
+        return x >= PRIME ? x - PRIME : x;
+    }
+
+  public:
+    void add(const void *data, size_t len)
+    {
+        const unsigned char *p = (const unsigned char *) data;
+        for (size_t i = 0; i < len; i++)
+        {
+            m_lo = (m_lo ^ p[i]) * 1099511628211ull;
+
+            // Bytes count from 1, so leading zero bytes still change the key
+            m_hi = mulMod(m_hi, BASE) + p[i] + 1;
+            if (m_hi >= PRIME)
+                m_hi -= PRIME;
+        }
+    }
+
+    // Strings are added with their length, so that fields can't run together
+    void add(const string &s)
+    {
+        uint64_t len = s.size();
+        add(&len, sizeof(len));
+        add(s.data(), s.size());
+    }
+
+    string hex()
+    {
+        char buf[33];
+        snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long) m_hi,
+                 (unsigned long long) m_lo);
+        return buf;
+    }
+};
+
+/// @brief  Path, size and modification time of a file, changes whenever the
+///         file does
+string fileIdentity(const string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st))
+        return path;
+
+    return path + ":" + to_string(st.st_size) + ":" +
+           to_string(st.st_mtim.tv_sec) + "." + to_string(st.st_mtim.tv_nsec);
+}
+
+/// @brief  Identifies the running compiler, a rebuilt compiler must not use
+///         the results of the old one
+const string &compilerIdentity()
+{
+    static const string identity = []() {
+        char    exe[4096];
+        ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        if (len <= 0)
+            return string(__DATE__ " " __TIME__);
+
+        exe[len] = '\0';
+        return fileIdentity(exe);
+    }();
+
+    return identity;
+}
+
+static bool readAll(const string &path, string &data)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    data.clear();
+    char    chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0)
+        data.append(chunk, n);
+    ::close(fd);
+
+    return n == 0;
+}
+
+CompileCache::CompileCache(const string &dir, const string &name,
+                           const string &source, const CompileOptions &options)
+    : m_dir(dir)
+{
+    KeyHasher key;
+    key.add(CACHE_MAGIC);
+    key.add(compilerIdentity());
+
+    char flags[] = {options.assembly, options.warningAsError,
+                    options.conversionWarnings, options.noMemoryChecking,
+                    (char) options.optimize};
+    key.add(flags, sizeof(flags));
+
+    // The declarations of a precompiled header aren't in the source
+    key.add(options.pch.size() ? fileIdentity(options.pch) : "");
+
+    // The name ends up in the diagnostics and the object
+    key.add(name);
+    key.add(source);
+
+    m_entry = m_dir + "/" + key.hex();
+}
+
+/// @brief  The stored result of an identical compilation, false if there is
+///         none (or it can't be read)
+bool CompileCache::lookup(string &output, string &diagnostics)
+{
+    string data;
+    if (!readAll(m_entry, data))
+        return false;
+
+    // CACHE_MAGIC, u64 size of the output, the output, the diagnostics
+    size_t   header = sizeof(CACHE_MAGIC) + sizeof(uint64_t);
+    uint64_t size;
+    if (data.size() < header || memcmp(data.data(), CACHE_MAGIC,
+                                       sizeof(CACHE_MAGIC)))
+        return false;
+
+    memcpy(&size, &data[sizeof(CACHE_MAGIC)], sizeof(size));
+    if (size > data.size() - header)
+        return false;
+
+    output.assign(data, header, size);
+    diagnostics.assign(data, header + size, string::npos);
+    return true;
+}
+
+/// @brief  Stores the result for the next identical compilation. This is
+///         only a cache, a result that can't be stored is simply left out
+void CompileCache::store(const string &output, const string &diagnostics)
+{
+    mkdir(m_dir.c_str(), 0777);
+
+    string tmp = m_entry + ".tmp" + to_string(getpid()) + "." +
+                 to_string(hash<thread::id>()(this_thread::get_id()));
+
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL)
+        return;
+
+    string   data(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    uint64_t size = output.size();
+    data.append((const char *) &size, sizeof(size));
+    data += output;
+    data += diagnostics;
+
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (fclose(f) || !ok || rename(tmp.c_str(), m_entry.c_str()))
+        unlink(tmp.c_str());
+}
@@ -0,0 +1,18 @@
+#include <context.h>
+
+thread_local CompilationContext *g_context = NULL;
+
+CompilationContext::CompilationContext() : errors(*this), symtable(*this)
+{
+}
+
+CompilationContext::Activation::Activation(CompilationContext &ctx)
+    : m_previous(g_context)
+{
+    g_context = &ctx;
+}
+
+CompilationContext::Activation::~Activation()
+{
+    g_context = m_previous;
+}
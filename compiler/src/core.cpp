@@ -19,3 +19,16 @@ int getFullbits(int x)
     }
     return r;
 }
+
+#ifdef MODE_DEBUG
+void debughandler(int sig)
+{
+    fprintf(stderr, "Debug handler called for sig: %i\n", sig);
+
+    void *array[30];
+    size_t size = backtrace(array, 30);
+
+    backtrace_symbols_fd(array, size, 2);
+    exit(1);
+}
+#endif
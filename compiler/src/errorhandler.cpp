@@ -1,12 +1,11 @@
+#include <context.h>
 #include <core.h>
 #include <errorhandler.h>
 #include <symbols.h>
 #include <token.h>
 #include <types.h>
 
-ErrorHandler err = ErrorHandler();
-
-ErrorHandler::ErrorHandler()
+ErrorHandler::ErrorHandler(CompilationContext &ctx) : m_ctx(ctx)
 {
 }
 
@@ -15,9 +14,18 @@ void ErrorHandler::setupLinehandler(Scanner &scanner)
     m_scanner = &scanner;
 }
 
+/// @brief  Takes over the command line flags of another handler
+void ErrorHandler::copyFlags(const ErrorHandler &other)
+{
+    f_warningAsError    = other.f_warningAsError;
+    f_conversionWarn    = other.f_conversionWarn;
+    f_ptrConversionWarn = other.f_ptrConversionWarn;
+    f_noMemChecking     = other.f_noMemChecking;
+}
+
 void ErrorHandler::write(string str)
 {
-    std::cerr << str << "\n";
+    *m_stream << str << "\n";
 }
 
 void ErrorHandler::lineError(ErrorInfo errInfo, string hl_color)
@@ -31,14 +39,17 @@ void ErrorHandler::lineError(ErrorInfo errInfo, string hl_color)
     write("On line " + HL(to_string(errInfo.lineNum)) + " column " +
           HL(to_string(errInfo.charNum)));
     
+    string line = m_scanner->getLine(errInfo.file, errInfo.lineNum);
     int tokstart = errInfo.charNum;
     if (tokstart)
         tokstart--;
+    if (tokstart > line.size())
+        tokstart = line.size();
         
-    int tokend = errInfo.line.size();
+    int tokend = line.size();
     write("");
-    write(to_string(errInfo.lineNum) + "| " + errInfo.line.substr(0, tokstart) + hl_color +
-          errInfo.line.substr(tokstart, errInfo.line.size()) + ESCAPE_END);
+    write(to_string(errInfo.lineNum) + "| " + line.substr(0, tokstart) + hl_color +
+          line.substr(tokstart, line.size()) + ESCAPE_END);
     write(string(tokstart + to_string(errInfo.lineNum).size() + 2, ' ') + hl_color +
           string(tokend - tokstart, '^') + ESCAPE_END);
 
@@ -73,7 +84,7 @@ void ErrorHandler::fatal(string str)
     debughandler(0);
 #endif
 
-    exit(1);
+    throw CompileError(str);
 }
 
 void ErrorHandler::fatal(string str, int l, int c)
@@ -81,14 +92,14 @@ void ErrorHandler::fatal(string str, int l, int c)
     write(FATAL_PREFIX + str);
     lineError(l, c, ESCAPE_RED);
     write("Compilation ended");
-    exit(1);
+    throw CompileError(str);
 }
 
 void ErrorHandler::fatalNL(string str)
 {
     write(FATAL_PREFIX + str);
     write("Compilation ended");
-    exit(1);
+    throw CompileError(str);
 }
 
 void ErrorHandler::warningNL(string str)
@@ -146,38 +157,38 @@ void ErrorHandler::expectedToken(int token, int token2, int got)
           tokToStr(token2) + "' but instead got: '" + tokToStr(got) + "'");
 }
 
-void ErrorHandler::conversionWarning(Type *l, Type *r)
+void ErrorHandler::conversionWarning(const Type *l, const Type *r)
 {
     if (f_conversionWarn)
         warning("Converting " + typeString(l) + " to " + typeString(r));
 }
 
-void ErrorHandler::ptrConversionWarning(Type *l, Type *r)
+void ErrorHandler::ptrConversionWarning(const Type *l, const Type *r)
 {
     if (f_ptrConversionWarn)
         warning("Converting " + typeString(l) + " to " + typeString(r));
 }
 
-void ErrorHandler::expectedType(Type *l, Type *r)
+void ErrorHandler::expectedType(const Type *l, const Type *r)
 {
     // @wth: why do we need to string() this highlight ???
     fatal("Expected type: " + HL("'" + typeString(l) + "'") +
           " but instead got " + HL("'" + typeString(r) + "'"));
 }
 
-void ErrorHandler::unexpectedParamToFunc(string func, Type *t)
+void ErrorHandler::unexpectedParamToFunc(string func, const Type *t)
 {
     fatal("Unexpected parameter to function: " + HL("'" + func + "'") +
           " of type: " + HL(typeString(t)));
 }
 
-void ErrorHandler::typeConversionError(Type *l, Type *r)
+void ErrorHandler::typeConversionError(const Type *l, const Type *r)
 {
     fatal("Cannot convert " + HL(typeString(l)) + " to " + HL(typeString(r)) +
           " without a cast");
 }
 
-void ErrorHandler::unknownType(Type *l)
+void ErrorHandler::unknownType(const Type *l)
 {
     fatal("Unknown type: " + HL(typeString(l)));
 }
@@ -203,22 +214,22 @@ void ErrorHandler::tip(string s)
     lineError(ESCAPE_GREEN);
 }
 
-void ErrorHandler::unknownStructItem(string s, Type t)
+void ErrorHandler::unknownStructItem(string s, const Type &t)
 {
     fatal("Unknown struct item: " + HL("'" + s + "'") + " in struct " +
-          HL("'" + *t.name + "'"));
+          HL("'" + m_ctx.atoms.str(t.name) + "'"));
 }
 
 void ErrorHandler::incorrectAccessor(bool ptr)
 {
-    err.fatal("Invalid " + HL((ptr ? "'->'" : "'.'")) +
-              " accessor to struct, did you mean to use " +
-              HL((ptr ? "'.'" : "'->'")) + "?");
+    fatal("Invalid " + HL((ptr ? "'->'" : "'.'")) +
+          " accessor to struct, did you mean to use " +
+          HL((ptr ? "'.'" : "'->'")) + "?");
 }
 
 void ErrorHandler::pedanticWarning(string s)
 {
-    err.warning(s);
+    warning(s);
 }
 
 ErrorInfo ErrorHandler::createErrorInfo()
@@ -231,7 +242,6 @@ ErrorInfo ErrorHandler::createErrorInfo(int line, int c)
 {
     ErrorInfo ret;
     ret.tok     = m_scanner->token();
-    ret.line    = m_scanner->curStrLine(m_scanner->curOffset() - c);
     ret.lineNum = line;
     ret.charNum = c;
     ret.func    = m_scanner->curFunction();
@@ -263,10 +273,10 @@ ErrorInfo ErrorHandler::getLoadedErrorInfo()
 
 void ErrorHandler::memWarn(string s)
 {
-    err.warning("Memory warnign: " + s);
+    warning("Memory warnign: " + s);
 }
 
 void ErrorHandler::memNotice(string s)
 {
-    err.notice("Memory notice: " + s);
+    notice("Memory notice: " + s);
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include <filecache.h>
+#include <preprocessor.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/// @brief  Reads and tokenizes a regular file, NULL if it doesn't exist or
+///         can't be read
+shared_ptr<const LexedFile> FileCache::read(const string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) || !S_ISREG(st.st_mode))
+        return NULL;
+
+    int64_t mtime = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+    {
+        lock_guard<mutex> guard(m_lock);
+        auto              it = m_files.find(path);
+        if (it != m_files.end() && it->second.mtime == mtime &&
+            it->second.size == st.st_size)
+            return it->second.lexed;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    string  data;
+    char    chunk[1 << 16];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) > 0)
+        data.append(chunk, n);
+    ::close(fd);
+
+    // Sized by what was read, a file that changed meanwhile misses next time
+    int64_t                     size  = data.size();
+    shared_ptr<const LexedFile> lexed = lexFile(move(data));
+
+    lock_guard<mutex> guard(m_lock);
+    m_files[path] = {mtime, size, lexed};
+    return lexed;
+}
@@ -0,0 +1,242 @@
+#include <arch/x86/instructions.h>
+#include <asmoutput.h>
+#include <context.h>
+#include <errorhandler.h>
+
+static const char *dataDirective(int size)
+{
+    switch (size)
+    {
+    case 1:
+        return "db";
+    case 2:
+        return "dw";
+    case 4:
+        return "dd";
+    case 8:
+        return "dq";
+    default:
+        g_err.fatalNL("Unsupported data size: " + to_string(size));
+    }
+}
+
+/// @brief  Writes value in decimal to buf, which holds at least 20 chars
+static size_t formatNumber(char *buf, int64_t value)
+{
+    char     digits[20];
+    size_t   count = 0;
+    uint64_t v     = value < 0 ? -(uint64_t) value : value;
+
+    do
+    {
+        digits[count++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    size_t len = 0;
+    if (value < 0)
+        buf[len++] = '-';
+    while (count)
+        buf[len++] = digits[--count];
+
+    return len;
+}
+
+AsmOperand &AsmOperand::append(StringView text)
+{
+    if (m_spill.empty() && m_size + text.size() <= sizeof(m_inline))
+        memcpy(m_inline + m_size, text.data(), text.size());
+    else
+    {
+        if (m_spill.empty())
+            m_spill.assign(m_inline, m_size);
+        m_spill.append(text.data(), text.size());
+    }
+
+    m_size += text.size();
+    return *this;
+}
+
+AsmOperand &AsmOperand::append(char c)
+{
+    return append(StringView(&c, 1));
+}
+
+AsmOperand &AsmOperand::number(int64_t value)
+{
+    char buf[20];
+    return append(StringView(buf, formatNumber(buf, value)));
+}
+
+AsmOperand &AsmOperand::mem(StringView base)
+{
+    return append('[').append(base).append(']');
+}
+
+AsmOperand &AsmOperand::mem(StringView base, int64_t disp)
+{
+    append('[').append(base);
+    if (disp >= 0)
+        append('+');
+    return number(disp).append(']');
+}
+
+AsmOperand &AsmOperand::label(int label)
+{
+    return append(".L").number(label);
+}
+
+AsmOperand::operator StringView() const
+{
+    if (m_spill.size())
+        return StringView(m_spill);
+
+    return StringView(m_inline, m_size);
+}
+
+void AsmBuffer::append(StringView text)
+{
+    if (m_used + text.size() > sizeof(m_chunk))
+    {
+        flush();
+
+        // Text that doesn't fit in a chunk at all is written as is
+        if (text.size() > sizeof(m_chunk))
+        {
+            if (fwrite(text.data(), 1, text.size(), m_file) != text.size())
+                m_failed = true;
+            return;
+        }
+    }
+
+    memcpy(m_chunk + m_used, text.data(), text.size());
+    m_used += text.size();
+}
+
+void AsmBuffer::append(char c)
+{
+    if (m_used == sizeof(m_chunk))
+        flush();
+
+    m_chunk[m_used++] = c;
+}
+
+void AsmBuffer::number(int64_t value)
+{
+    char buf[20];
+    append(StringView(buf, formatNumber(buf, value)));
+}
+
+bool AsmBuffer::flush()
+{
+    if (m_used && fwrite(m_chunk, 1, m_used, m_file) != m_used)
+        m_failed = true;
+
+    m_used = 0;
+    return !m_failed;
+}
+
+TextAsmOutput::TextAsmOutput(const string &path)
+    : m_file(fopen(path.c_str(), "w")), m_buffer(m_file)
+{
+    if (m_file == NULL)
+        g_err.fatal("Could not open file: '" + path + "'");
+}
+
+TextAsmOutput::TextAsmOutput(FILE *file) : m_file(file), m_buffer(file)
+{
+}
+
+void TextAsmOutput::section(const string &name)
+{
+    m_buffer.append("\nsection ");
+    m_buffer.append(name);
+    m_buffer.append('\n');
+}
+
+void TextAsmOutput::global(const string &name)
+{
+    m_buffer.append("global ");
+    m_buffer.append(name);
+    m_buffer.append('\n');
+}
+
+void TextAsmOutput::externSymbol(const string &name)
+{
+    m_buffer.append("extern ");
+    m_buffer.append(name);
+    m_buffer.append('\n');
+}
+
+void TextAsmOutput::label(StringView name)
+{
+    m_buffer.append(name);
+    m_buffer.append(":\n");
+}
+
+void TextAsmOutput::instruction(StringView op, StringView dest, StringView src)
+{
+    m_buffer.append('\t');
+    m_buffer.append(op);
+
+    if (dest.size())
+    {
+        m_buffer.append('\t');
+        m_buffer.append(dest);
+    }
+
+    if (src.size())
+    {
+        m_buffer.append(dest.size() ? ", " : "\t, ");
+        m_buffer.append(src);
+    }
+
+    m_buffer.append('\n');
+}
+
+void TextAsmOutput::instruction(const X86Instr &instr)
+{
+    AsmOperand op, dest, src;
+    instr.mnemonic(op);
+    instr.dest.format(dest);
+    instr.src.format(src);
+    instruction(op, dest, src);
+}
+
+void TextAsmOutput::data(int size, const vector<string> &values)
+{
+    m_buffer.append('\t');
+    m_buffer.append(dataDirective(size));
+    m_buffer.append('\t');
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (i)
+            m_buffer.append(", ");
+        m_buffer.append(values[i]);
+    }
+
+    m_buffer.append('\n');
+}
+
+void TextAsmOutput::zeros(int size, int count)
+{
+    m_buffer.append("\ttimes ");
+    m_buffer.number(count);
+    m_buffer.append(' ');
+    m_buffer.append(dataDirective(size));
+    m_buffer.append(" 0\n");
+}
+
+void TextAsmOutput::comment(const string &text)
+{
+    m_buffer.append("; ");
+    m_buffer.append(text);
+    m_buffer.append('\n');
+}
+
+void TextAsmOutput::close()
+{
+    bool written = m_buffer.flush();
+    if (fclose(m_file) == EOF || !written)
+        g_err.fatal("Could not close file");
+}
@@ -1,3 +1,4 @@
+#include <context.h>
 #include <errorhandler.h>
 #include <generator.h>
 #include <symbols.h>
@@ -86,11 +87,11 @@ int Generator::generateDoWhile(ast_node *tree)
 
 int Generator::generateArgumentPush(ast_node *tree)
 {
-    if (tree->right->type.typeType == TypeTypes::STRUCT && !tree->right->type.ptrDepth)
+    if (tree->right->type().typeType == TypeTypes::STRUCT && !tree->right->type().ptrDepth)
     {
         int reg = generateFromAst(tree->right, -1, tree->operation);
         
-        vector<struct StructItem> sitems = tree->right->type.contents;
+        const StructMembers &sitems = tree->right->type().contents;
         for (int i = sitems.size() - 1; i >= 0; i--)
         {
             int right = genAccessStruct(reg, sitems[i].offset, sitems[i].itemType.size);
@@ -118,14 +119,63 @@ static int countDepth(ast_node *tree)
     return i;
 }
 
+/// @brief  Marks the symbols the function takes the address of
+void Generator::findAddressTaken(ast_node *tree)
+{
+    if (!tree)
+        return;
+
+    if (tree->operation == AST::Types::LOADLOCATION && !tree->left)
+        m_addressTaken[tree->value] = true;
+
+    // Identifiers of struct type get loaded as the address of their slot
+    else if (tree->operation == AST::Types::IDENTIFIER &&
+             tree->type().typeType == TypeTypes::STRUCT &&
+             !tree->type().ptrDepth)
+        m_addressTaken[tree->value] = true;
+
+    findAddressTaken(tree->left);
+    findAddressTaken(tree->mid);
+    findAddressTaken(tree->right);
+}
+
+/// @brief  True if a variable can live in a register instead of memory: a
+///         local scalar nothing takes the address of
+bool Generator::promotable(SymbolId symbol)
+{
+    Symbol *s = m_ctx.symtable.getSymbol(symbol);
+
+    if (!m_optimize || s->scope == GLOBALSCOPE ||
+        (s->symType != SymbolTable::SymTypes::VARIABLE &&
+         s->symType != SymbolTable::SymTypes::ARGUMENT))
+        return false;
+
+    if (s->storageClass == SymbolTable::StorageClass::STATIC ||
+        s->storageClass == SymbolTable::StorageClass::EXTERN)
+        return false;
+
+    if (s->varType.isArray || s->varType.size > INT_SIZE ||
+        (s->varType.typeType == TypeTypes::STRUCT && !s->varType.ptrDepth))
+        return false;
+
+    return m_addressTaken.find(symbol) == m_addressTaken.end();
+}
+
 int Generator::generateAssignment(ast_node *tree)
 {
     ast_node *left;
     int l = tree->left->line;
     int c = tree->left->c;
     
+    if (tree->left->operation == AST::Types::IDENTIFIER &&
+        promotable(tree->left->value))
+    {
+        int rreg = generateFromAst(tree->right, 0, AST::Types::ASSIGN);
+        return genStoreVariable(rreg, tree->left->value, tree->type());
+    }
+
     if (tree->left->operation == AST::Types::IDENTIFIER)
-        left = mkAstLeaf(AST::Types::LOADLOCATION, tree->left->value, tree->type, l, c);
+        left = mkAstLeaf(AST::Types::LOADLOCATION, tree->left->value, tree->typeWithSpot(), l, c);
     else if (tree->left->operation == AST::Types::PTRACCESS)
         left = tree->left->left;
     else
@@ -133,8 +183,12 @@ int Generator::generateAssignment(ast_node *tree)
 
     int lreg = generateFromAst(left, 0, AST::Types::ASSIGN);
     int rreg = generateFromAst(tree->right, 0, AST::Types::ASSIGN);
+
+    // The load location node only lived for this assignment
+    if (tree->left->operation == AST::Types::IDENTIFIER)
+        freeAstNode(left);
     
-    return genStoreValue(rreg, lreg, tree->type);
+    return genStoreValue(rreg, lreg, tree->type());
 }
 
 int Generator::generateSwitch(ast_node *tree, int condLabel)
@@ -165,7 +219,7 @@ int Generator::generateSwitch(ast_node *tree, int condLabel)
             continue;
         }
         
-        int compReg = genLoad(caseIter->value, tree->left->type.size);
+        int compReg = genLoad(caseIter->value, tree->left->type().size);
         caseLabel = label();
         caseLabels.push_back(caseLabel);
         
@@ -200,10 +254,11 @@ int Generator::generateSwitch(ast_node *tree, int condLabel)
 
 int Generator::generateGoto(ast_node *tree)
 {
-    Symbol *s = g_symtable.getSymbol(tree->value);
+    Symbol *s = m_ctx.symtable.getSymbol(tree->value);
     
     if (!s->defined)
-        err.fatal("Label " + HL(s->name) + " undefined", tree->line, tree->c);
+        m_ctx.errors.fatal("Label " + HL(m_ctx.atoms.str(s->name)) + " undefined",
+                  tree->line, tree->c);
     
     genGoto(s->name);
 }
@@ -271,6 +326,8 @@ int Generator::generateFromAst(ast_node *tree, int reg, int parentOp,
     case AST::Types::SWITCH:
         return generateSwitch(tree, condLabel);
     case AST::Types::FUNCTION:
+        m_addressTaken.clear();
+        findAddressTaken(tree->left);
         genFunctionPreamble(tree->value);
         generateFromAst(tree->left, -1, tree->operation, condLabel, endLabel);
         genFunctionPostamble(tree->value);
@@ -285,8 +342,7 @@ int Generator::generateFromAst(ast_node *tree, int reg, int parentOp,
         DEBUG("tree l " << tree->left << " r " << tree->right)
         return genIncrement(tree->left->value, tree->right->value, tree->value);
     case AST::Types::DECREMENT:
-        leftreg = generateFromAst(tree->left, -1, tree->operation, condLabel, endLabel);
-        return genDecrement(leftreg, tree->right->value, tree->value);
+        return genDecrement(tree->left->value, tree->right->value, tree->value);
     case AST::Types::ASSIGN:
         leftreg = generateAssignment(tree);
         if (parentOp == 0)
@@ -300,7 +356,7 @@ int Generator::generateFromAst(ast_node *tree, int reg, int parentOp,
         return generateBinaryComparison(tree, tree->operation);
     
     case AST::Types::LABEL:
-        genLabel(g_symtable.getSymbol(tree->value)->name);
+        genLabel(m_ctx.symtable.getSymbol(tree->value)->name);
         return generateFromAst(tree->left, 0, tree->operation, condLabel, endLabel);
     
     case AST::Types::TERNARY:
@@ -310,7 +366,7 @@ int Generator::generateFromAst(ast_node *tree, int reg, int parentOp,
         DEBUG("GENERATING FUNC CALL")
         {
             vector <int> data;
-            if (!(tree->type.typeType == TypeTypes::STRUCT && !tree->type.ptrDepth))
+            if (!(tree->type().typeType == TypeTypes::STRUCT && !tree->type().ptrDepth))
                 data = genSaveRegisters();
             generateFromAst(tree->left, -1, tree->operation);
             return genFunctionCall(tree->value, countDepth(tree), data);    
@@ -356,15 +412,15 @@ int Generator::generateFromAst(ast_node *tree, int reg, int parentOp,
         return genBinNegate(leftreg);
     
     case AST::Types::INTLIT:
-        return genLoad(tree->value, tree->type.size);
+        return genLoad(tree->value, tree->type().size);
     case AST::Types::IDENTIFIER:
-        return genLoadVariable(tree->value, tree->type);
+        return genLoadVariable(tree->value, tree->type());
     case AST::Types::WIDEN:
-        return genWidenRegister(leftreg, tree->value, tree->type.size,
-                                tree->type.isSigned);
+        return genWidenRegister(leftreg, tree->value, tree->type().size,
+                                tree->type().isSigned);
 
     case AST::Types::PTRACCESS:
-        return genPtrAccess(leftreg, tree->type.size);
+        return genPtrAccess(leftreg, tree->type().size);
         
     case AST::Types::EQUAL:
     case AST::Types::NOTEQUAL:
@@ -389,7 +445,7 @@ int Generator::generateFromAst(ast_node *tree, int reg, int parentOp,
     
     case AST::Types::DIRECTMEMLOAD:
         return genDirectMemLoad(tree->value, tree->mid->value, rightreg,
-                                tree->type.size);
+                                tree->type().size);
 
     case AST::Types::NEGATE:
         return genNegate(leftreg);
@@ -403,82 +459,49 @@ int Generator::generateFromAst(ast_node *tree, int reg, int parentOp,
     
     case AST::Types::CONTINUE:
         if (condLabel == -1)
-            err.fatal("Continue statements are only allowed inside for and while loops", tree->line, tree->c);
+            m_ctx.errors.fatal("Continue statements are only allowed inside for and while loops", tree->line, tree->c);
         
         genJump(condLabel);
         return -1;
     
     case AST::Types::BREAK:
         if (endLabel == -1)
-            err.fatal("Break statements are only allowed inside switch, for and while loops", tree->line, tree->c);
+            m_ctx.errors.fatal("Break statements are only allowed inside switch, for and while loops", tree->line, tree->c);
         
         genJump(endLabel);
         return -1;
     
     case AST::Types::PUSHSCOPE:
-        g_symtable.pushScopeById(tree->value);
+        m_ctx.symtable.pushScopeById(tree->value);
         return -1;
     
     case AST::Types::POPSCOPE:
-        g_symtable.popScope(false);
+        m_ctx.symtable.popScope(false);
         return -1;
     
     case AST::Types::PADDING:
-        err.warning("yea you should probably not be seeing this");
+        m_ctx.errors.warning("yea you should probably not be seeing this");
         return -1;
 
     default:
         // This is more of a debugging check then a release thing because
         // we should normally never get here unless something is unimplemented
         // or seriously wrong (ei memory bug)
-        err.fatal("Unknown AST operator " + to_string(tree->operation), tree->line, tree->c);
+        m_ctx.errors.fatal("Unknown AST operator " + to_string(tree->operation), tree->line, tree->c);
     }
 }
 
-Generator::Generator(string &outfile)
+Generator::Generator(CompilationContext &ctx, AsmOutput *out)
+    : m_ctx(ctx), m_out(out)
 {
-    m_outfile = fopen(outfile.c_str(), "w");
-
-    if (m_outfile == NULL)
-        err.fatal("Could not open file: '" + outfile + "'");
 }
 
 void Generator::close()
 {
-    int ex = fclose(m_outfile);
-    if (ex == EOF)
-        err.fatal("Could not close file");
-}
-
-void Generator::write(string instruction, string source, string destination)
-{
-    fprintf(m_outfile, "\t%s\t%s, %s\n", instruction.c_str(),
-            destination.c_str(), source.c_str());
-}
-
-void Generator::write(string instruction, string destination)
-{
-    fprintf(m_outfile, "\t%s\t%s\n", instruction.c_str(), destination.c_str());
-}
-
-void Generator::write(string instruction)
-{
-    fprintf(m_outfile, "\t%s\n", instruction.c_str());
-}
-
-void Generator::write(string instruction, int source, string destination)
-{
-    write(instruction, to_string(source), destination);
+    m_out->close();
 }
 
 void Generator::setupInfileHandler(Scanner &scanner)
 {
     m_scanner = &scanner;
-}
-
-void Generator::move(string instr, string source_reg, string dest_reg)
-{
-    /* Little optimization, do not move same reg in same reg */
-    if (source_reg.compare(dest_reg))
-        write(instr, source_reg, dest_reg);
 }
\ No newline at end of file
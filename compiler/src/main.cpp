@@ -1,60 +1,189 @@
+#include <arch/x86/assembler.h>
 #include <arch/x86/generator.h>
+#include <arch/x86/linker.h>
+#include <context.h>
 #include <core.h>
 #include <errorhandler.h>
 #include <getopt.h>
+#include <memfile.h>
 #include <parser/parser.h>
-#include <scanner.h>
-#include <symbols.h>
-#include <token.h>
+#include <safecc.h>
+#include <server.h>
 
-#ifdef MODE_DEBUG
-#include <execinfo.h>
-#include <signal.h>
-#include <stdio.h>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-void debughandler(int sig)
+/* What the command line asked for */
+struct Options
 {
-    fprintf(stderr, "Debug handler called for sig: %i\n", sig);
+    string outfile;
+    string assembler;       // External assembler, the built-in one if empty
+    string linker;          // External linker, the built-in one if empty
+    string remote;          // Socket of the compile server to use
+    int    jobs = 0;        // Files compiled at once with -j, 0 without -j
+
+    CompileOptions compile; // Assembly and fileCache are set per use
 
-    void *array[30];
-    size_t size = backtrace(array, 30);
+    int f_onlyCompile    = false;
+    int f_noLink         = false;
+    int f_onlyPreProcess = false;
+    int f_precompile     = false;
+};
 
-    backtrace_symbols_fd(array, size, 2);
-    exit(1);
+static bool isObject(const string &file)
+{
+    return file.size() > 2 && file.substr(file.size() - 2) == ".o";
 }
 
-#endif
+/// @brief  Replaces the extension of a file name (or appends one)
+static string withExtension(const string &file, const string &ext)
+{
+    size_t dot   = file.rfind('.');
+    size_t slash = file.rfind('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash))
+        return file + ext;
+    return file.substr(0, dot) + ext;
+}
 
-// Simple random string generator, takes length parameter
-string randomString(int l)
+/// @brief  Writes the output of a compilation to a file
+static void writeFile(const string &path, const string &data)
 {
-    srand(time(NULL));
-    
-    string s;
-    for (int i = 0; i < l; i++)
-        s += 'a' + rand() % 26;
-    return s;
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == NULL)
+        g_err.fatalNL("Could not open file: '" + path + "'");
+
+    if (fwrite(data.data(), 1, data.size(), f) != data.size() || fclose(f))
+        g_err.fatalNL("Could not write file: '" + path + "'");
 }
 
-int main(int argc, char *const *argv)
+/// @brief  Runs the external assembler on assembly text in asmMem, the
+///         object is written to target
+static void assemble(const Options &opts, MemFile &asmMem, const string &target)
 {
-#ifdef MODE_DEBUG
-    signal(SIGABRT, debughandler);
-    signal(SIGSEGV, debughandler);
-#endif
+    int status = system((opts.assembler + " -F dwarf -g -felf -o " + target +
+                         " " + asmMem.path()).c_str());
+
+    if (status)
+        g_err.fatalNL("Failed to assemble binary");
+}
+
+/**
+ * @brief   Compiles one input file on its own through the library (or the
+ *          compile server), as -j does. With -S or -c the result is written
+ *          to outfile, otherwise the object is returned for the linker.
+ */
+static string compileUnit(const Options &opts, const string &infile,
+                          const string &outfile)
+{
+    static mutex diagnosticsLock;
+
+    CompileOptions options = opts.compile;
+    options.assembly       = opts.f_onlyCompile || opts.assembler.size();
+
+    CompileResult result = opts.remote.size()
+                               ? compileRemote(opts.remote, infile, options)
+                               : compileFile(infile, options);
+    {
+        lock_guard<mutex> lock(diagnosticsLock);
+        cerr << result.diagnostics;
+    }
+
+    if (!result.success)
+        throw CompileError("Compiling " + infile + " failed");
+
+    if (opts.f_onlyCompile || (opts.f_noLink && opts.assembler.empty()))
+    {
+        writeFile(outfile, result.output);
+        return "";
+    }
+
+    if (opts.assembler.size())
+    {
+        MemFile asmMem("asm");
+        writeFile(asmMem.path(), result.output);
+
+        if (opts.f_noLink)
+        {
+            assemble(opts, asmMem, outfile);
+            return "";
+        }
+
+        MemFile objMem("object");
+        assemble(opts, asmMem, objMem.path());
+        return objMem.contents();
+    }
+
+    return result.output;
+}
+
+/**
+ * @brief   Compiles the input files on opts.jobs threads. Every file gets its
+ *          own object, they are returned in the order of the input files so
+ *          the linker merges them the same way every time.
+ */
+static vector<string> compileParallel(CompilationContext &ctx,
+                                      const Options &opts,
+                                      const vector<string> &infiles,
+                                      const vector<string> &outfiles)
+{
+    vector<string> objects(infiles.size());
+    atomic<size_t> next(0);
+    atomic<bool>   failed(false);
+
+    // Every worker reports its own errors, the files after a failed one are
+    // still compiled so all the errors show up at once. The library compiles
+    // each file in a context of its own, the workers only need the command
+    // line's one for g_err when writing or assembling the result.
+    auto worker = [&]() {
+        CompilationContext::Activation activation(ctx);
+
+        size_t i;
+        while ((i = next++) < infiles.size())
+        {
+            try
+            {
+                objects[i] = compileUnit(opts, infiles[i], outfiles[i]);
+            }
+            catch (const CompileError &)
+            {
+                failed = true;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    int            count = min((size_t) opts.jobs, infiles.size());
+    for (int i = 1; i < count; i++)
+        threads.emplace_back(worker);
+
+    worker();
+    for (thread &t : threads)
+        t.join();
+
+    if (failed)
+        throw CompileError("Compilation failed");
+
+    return objects;
+}
+
+static int run(int argc, char *const *argv)
+{
+    CompilationContext             ctx;
+    CompilationContext::Activation activation(ctx);
 
     int opt;
     int option_index = 0;
-    string outfile = "";
-    string linkfile = "/tmp/" + randomString(8) + ".o";
-    string asmfile = "/tmp/" + randomString(8) + ".S";
-    string ppfile = "/tmp/" + randomString(8) + ".c";
-    string assembler = "nasm";
-    string linker = "ld";
-    string preprocessor = "gcc";
+    Options opts;
+    bool outfileGiven = false;
+    string server;
     string arch = "i386";
+    vector<string> libraryDirs;
+    vector<string> infiles;     // C files to compile
+    vector<string> objects;     // Objects given on the command line
     
-    string ppFlags = " -E -I" SOURCE_DIR "/includes " " -include " SOURCE_DIR "/includes/gnucompat.h";
     string linkFlags =
         "-m elf_i386 -dynamic-linker /lib/ld-linux.so.2 "
         "/usr/lib/gcc/x86_64-linux-gnu/6/32/crtbeginS.o "
@@ -66,29 +195,31 @@ int main(int argc, char *const *argv)
         "/usr/lib/gcc/x86_64-linux-gnu/6/32/crtendS.o "
         "/usr/lib/gcc/x86_64-linux-gnu/6/../../../../lib32/crtn.o";
     
-    
-    int f_onlyCompile = false;
-    int f_noLink = false;
-    int f_onlyPreProcess = false;
-    
-    static struct option long_options[] = 
+    struct option long_options[] = 
     {
         /* Flags */
-        {"Wconversion", no_argument, &err.f_conversionWarn, 1},
-        {"Werror", no_argument, &err.f_warningAsError, 1},
-        {"Compile", no_argument, &f_onlyCompile, 'S'},
-        {"NoLink", no_argument, &f_noLink, 'c'},
-        {"Preprocessor", no_argument, &f_onlyPreProcess, 'E'},
-        {"No-Memory-Check", no_argument, &err.f_noMemChecking, 1},
+        {"Wconversion", no_argument, &ctx.errors.f_conversionWarn, 1},
+        {"Werror", no_argument, &ctx.errors.f_warningAsError, 1},
+        {"Compile", no_argument, &opts.f_onlyCompile, 'S'},
+        {"NoLink", no_argument, &opts.f_noLink, 'c'},
+        {"Preprocessor", no_argument, &opts.f_onlyPreProcess, 'E'},
+        {"No-Memory-Check", no_argument, &ctx.errors.f_noMemChecking, 1},
+        {"precompile", no_argument, &opts.f_precompile, 1},
         
         /* Arguments */
         {"output", required_argument, 0, 'o'},
-        {"assembler", optional_argument, 0, 'a'},
-        {"linker", optional_argument, 0, 'l'},
+        {"assembler", required_argument, 0, 'a'},
+        {"linker", required_argument, 0, 'l'},
+        {"external-preprocessor", required_argument, 0, 'P'},
+        {"jobs", required_argument, 0, 'j'},
+        {"server", required_argument, 0, 's'},
+        {"remote", required_argument, 0, 'r'},
+        {"cache", required_argument, 0, 'C'},
+        {"include-pch", required_argument, 0, 'H'},
         {0, 0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "o:a:l:P:cSE", long_options,
+    while ((opt = getopt_long(argc, argv, "o:a:l:L:P:j:O::cSE", long_options,
                               &option_index)) != -1)
     {
         switch (opt)
@@ -96,96 +227,265 @@ int main(int argc, char *const *argv)
         case 0:
             break; /* set a flag */
         case 'o':
-            outfile = string(optarg);
+            opts.outfile = string(optarg);
+            outfileGiven = true;
             break;
         case 'c':
-            f_noLink = true;
+            opts.f_noLink = true;
             break;
         case 'S':
-            f_onlyCompile = true;
+            opts.f_onlyCompile = true;
             break;
         case 'E':
-            f_onlyPreProcess = true;
+            opts.f_onlyPreProcess = true;
+            break;
+        case 'P':
+            opts.compile.preprocessor = string(optarg);
+            break;
+        case 'a':
+            opts.assembler = string(optarg);
+            break;
+        case 'l':
+            opts.linker = string(optarg);
+            break;
+        case 'L':
+            libraryDirs.push_back(optarg);
+            break;
+        case 'O':
+            opts.compile.optimize = optarg ? max(atoi(optarg), 0) : 1;
+            break;
+        case 'j':
+            opts.jobs = atoi(optarg);
+            if (opts.jobs <= 0)
+                opts.jobs = thread::hardware_concurrency();
+            break;
+        case 's':
+            server = optarg;
+            break;
+        case 'r':
+            opts.remote = optarg;
+            break;
+        case 'C':
+            opts.compile.cacheDir = optarg;
+            break;
+        case 'H':
+            opts.compile.pch = optarg;
             break;
         default:
-            err.fatalNL("Usage: Compiler -o <OUTFILE> <INFILES>");
+            g_err.fatalNL("Usage: Compiler -o <OUTFILE> <INFILES>");
         }
     }
     
 
+    opts.compile.warningAsError     = ctx.errors.f_warningAsError;
+    opts.compile.conversionWarnings = ctx.errors.f_conversionWarn;
+    opts.compile.noMemoryChecking   = ctx.errors.f_noMemChecking;
+
+    if (server.size())
+    {
+        int jobs = opts.jobs ? opts.jobs : thread::hardware_concurrency();
+        runServer(server, opts.compile.cacheDir, max(jobs, 1));
+        return 0;
+    }
+
+    // The server compiles every file on its own, like -j
+    if (opts.remote.size())
+    {
+        if (opts.compile.preprocessor.size())
+            g_err.fatalNL("--remote always uses the built-in preprocessor of "
+                          "the server, it can't be used with -P");
+        if (opts.compile.pch.size())
+            g_err.fatalNL("--remote can't be used with --include-pch, the "
+                          "server may not see the same files");
+
+        opts.jobs = max(opts.jobs, 1);
+    }
+
+    // The cache stores the result of a single file, so every file is
+    // compiled on its own as well
+    if (opts.compile.cacheDir.size())
+        opts.jobs = max(opts.jobs, 1);
+
     if (optind >= argc)
     {
-        err.fatalNL("Error infiles expected\nUsage: Compiler -o <outfile> "
+        g_err.fatalNL("Error infiles expected\nUsage: Compiler -o <outfile> "
                     "<infiles>");
     }
     
+    string &outfile = opts.outfile;
     if (outfile == "")
     {
         outfile = string(argv[optind]);
         outfile = outfile.substr(0, outfile.size() - 2);
     }
-    
-    if (f_noLink)
-        linkfile = outfile;
-    
-    if (f_onlyCompile)
-        asmfile = outfile;
-    
-    if (f_onlyPreProcess)
-        ppfile = outfile;
 
-    DEBUG("ASM: " << asmfile)
-    DEBUG("PP: " << ppfile)
-    GeneratorX86 generator(asmfile);
+    // Objects aren't compiled, they go straight to the linker
     for (; optind < argc; optind++)
     {
-        system((preprocessor + ppFlags + " -o " + ppfile + " " + argv[optind]).c_str());
-        
-        if (f_onlyPreProcess)
+        if (isObject(argv[optind]))
+            objects.push_back(argv[optind]);
+        else
+            infiles.push_back(argv[optind]);
+    }
+
+    if (opts.f_onlyPreProcess)
+    {
+        if (infiles.empty())
             return 0;
-        
-        Scanner scanner(ppfile.c_str());
-        err.setupLinehandler(scanner);
-        generator.setupInfileHandler(scanner);
 
-        Parser parser(scanner, generator);
+        writeFile(outfile, preprocessFile(infiles[0], opts.compile));
+        return 0;
+    }
+
+    // Every header gets its own precompiled header, next to it unless -o
+    // names the one output
+    if (opts.f_precompile)
+    {
+        for (const string &header : infiles)
+        {
+            precompileHeader(header,
+                             outfileGiven && infiles.size() == 1
+                                 ? outfile
+                                 : header + ".pch",
+                             opts.compile);
+        }
+        return 0;
+    }
 
-        scanner.scan();
+    /* Intermediate results stay in memory, external tools read and write
+     * them through memfd descriptors instead of files in /tmp */
+    unique_ptr<MemFile>   asmMem;
+    unique_ptr<MemFile>   objMem;
+    AssemblerX86         *assemblerX86 = NULL;
+    unique_ptr<AsmOutput> asmOutput;
+    vector<string>        compiled;     // Our objects, in input order
+    vector<string>        names;        // What the linker calls them
 
-        ast_node *t = parser.parserMain();
-        generator.generateFromAst(t, -1, 0);
+    // -j compiles every file on its own, -S and -c write a file per input
+    if (opts.jobs)
+    {
+        bool           separate = opts.f_onlyCompile || opts.f_noLink;
+        vector<string> outfiles;
+        for (const string &infile : infiles)
+        {
+            names.push_back(withExtension(infile, ".o"));
+            outfiles.push_back(infiles.size() == 1 ? outfile
+                               : withExtension(infile, opts.f_onlyCompile
+                                                           ? ".S"
+                                                           : ".o"));
+        }
+
+        if (separate && outfileGiven && infiles.size() > 1)
+            g_err.fatalNL("-o can't be used with -S or -c and several input "
+                          "files, every file gets its own output with -j");
+
+        compiled = compileParallel(ctx, opts, infiles, outfiles);
+        if (separate)
+            return 0;
     }
+    else
+    {
+        // Assembly text is only written for -S or an external assembler
+        if (opts.f_onlyCompile)
+            asmOutput.reset(new TextAsmOutput(outfile));
+        else if (opts.assembler.size())
+        {
+            asmMem.reset(new MemFile("asm"));
+            asmOutput.reset(new TextAsmOutput(asmMem->openWrite()));
+        }
+        else
+        {
+            assemblerX86 = new AssemblerX86(opts.f_noLink ? outfile : "",
+                                            infiles.size() ? infiles[0] : "");
+            asmOutput.reset(assemblerX86);
+        }
 
-    generator.genDataSection();
-    generator.close();
+        GeneratorX86 generator(ctx, asmOutput.get());
+        generator.setOptimization(opts.compile.optimize);
+        for (const string &infile : infiles)
+            compileInto(ctx, generator, opts.compile, infile);
 
-    remove(ppfile.c_str());
+        generator.genDataSection();
+        generator.close();
 
-    int status = 0;
+        if (opts.f_onlyCompile)
+            return 0;
 
-    if (f_onlyCompile)
-        goto end;
+        if (opts.assembler.size())
+        {
+            if (opts.f_noLink)
+            {
+                assemble(opts, *asmMem, outfile);
+                return 0;
+            }
 
-    status =
-        system((assembler + " -F dwarf -g -felf -o " + linkfile + " " + asmfile).c_str());
+            objMem.reset(new MemFile("object"));
+            assemble(opts, *asmMem, objMem->path());
+            compiled.push_back(objMem->contents());
+        }
+        else if (!opts.f_noLink)
+            compiled.push_back(assemblerX86->object().contents());
 
-    if (status)
-        err.fatalNL("Failed to assemble binary");
+        if (opts.f_noLink)
+            return 0;
 
-    remove(asmfile.c_str());
+        names.push_back(outfile + ".o");
+    }
 
-    if (f_noLink)
-        goto end;
+    if (opts.linker.size())
+    {
+        // The external linker reads our objects through their descriptors
+        vector<unique_ptr<MemFile>> files;
+        string                      paths;
+        for (const string &object : compiled)
+        {
+            files.emplace_back(new MemFile("object"));
+            FILE *f = files.back()->openWrite();
+            fwrite(object.data(), 1, object.size(), f);
+            fclose(f);
+            paths += files.back()->path() + " ";
+        }
 
-    status = system(
-        (linker + " " + linkfile + " -o " + outfile + " " + linkFlags).c_str());
+        for (const string &object : objects)
+            paths += object + " ";
 
-    if (status)
-        err.fatalNL("Failed to link binary");
+        int status = system((opts.linker + " " + paths + "-o " + outfile + " " +
+                             linkFlags).c_str());
 
-    remove(linkfile.c_str());
+        if (status)
+            g_err.fatalNL("Failed to link binary");
+    }
+    else
+    {
+        LinkerX86 linkerX86;
+        for (const string &dir : libraryDirs)
+            linkerX86.addLibraryDir(dir);
 
-end:;
+        for (size_t i = 0; i < compiled.size(); i++)
+            linkerX86.addObject(names[i], move(compiled[i]));
+        for (const string &object : objects)
+            linkerX86.addObject(object);
+
+        linkerX86.link(outfile);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *const *argv)
+{
+#ifdef MODE_DEBUG
+    signal(SIGABRT, debughandler);
+    signal(SIGSEGV, debughandler);
+#endif
+
+    // Errors were already reported when CompileError reaches here
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const CompileError &)
+    {
+        return 1;
+    }
+}
@@ -0,0 +1,84 @@
+#include <context.h>
+#include <errorhandler.h>
+#include <memfile.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+MemFile::MemFile(const string &name)
+{
+    m_fd = memfd_create(name.c_str(), 0);
+
+    // No memfd (old kernel), an unlinked temporary file behaves the same
+    if (m_fd == -1)
+    {
+        char path[] = "/tmp/safeccXXXXXX";
+        m_fd        = mkstemp(path);
+        if (m_fd != -1)
+            unlink(path);
+    }
+
+    if (m_fd == -1)
+        g_err.fatalNL("Could not create in-memory file " + HL(name));
+}
+
+MemFile::~MemFile()
+{
+    ::close(m_fd);
+}
+
+/// @brief  The path the file can be opened with, by us or a child process
+string MemFile::path()
+{
+    return "/proc/self/fd/" + to_string(m_fd);
+}
+
+/// @brief  A stream that writes from the start of the file, closing it
+///         leaves the file itself open
+FILE *MemFile::openWrite()
+{
+    FILE *f = fdopen(dup(m_fd), "w");
+    if (f == NULL)
+        g_err.fatalNL("Could not open in-memory file");
+
+    ftruncate(m_fd, 0);
+    return f;
+}
+
+string MemFile::contents()
+{
+    struct stat st;
+    if (fstat(m_fd, &st))
+        g_err.fatalNL("Could not read in-memory file");
+
+    string  data(st.st_size, '\0');
+    ssize_t done = 0;
+    while (done < st.st_size)
+    {
+        ssize_t n = pread(m_fd, &data[done], st.st_size - done, done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+
+    data.resize(done);
+    return data;
+}
+
+/// @brief  Runs a shell command and returns what it wrote to stdout
+string runCapture(const string &command, int &status)
+{
+    FILE *p = popen(command.c_str(), "r");
+    if (p == NULL)
+        g_err.fatalNL("Could not run " + HL(command));
+
+    string data;
+    char   buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), p)))
+        data.append(buf, n);
+
+    status = pclose(p);
+    return data;
+}
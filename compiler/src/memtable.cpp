@@ -1,9 +1,66 @@
 #include <ast.h>
+#include <context.h>
 #include <errorhandler.h>
 #include <memtable.h>
 #include <types.h>
 
-MemoryTable g_memTable = MemoryTable();
+
+MemoryArena::~MemoryArena()
+{
+    release();
+    for (char *chunk : m_chunks)
+        free(chunk);
+}
+
+void *MemoryArena::allocate(size_t size)
+{
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+    if (size > MEMORY_ARENA_CHUNK_SIZE)
+        g_err.fatal("Memory spot does not fit an arena chunk");
+
+    if (m_chunks.empty() || m_used + size > MEMORY_ARENA_CHUNK_SIZE)
+    {
+        if (!m_chunks.empty())
+            m_chunk++;
+
+        if (m_chunk == m_chunks.size())
+        {
+            char *chunk = (char *) malloc(MEMORY_ARENA_CHUNK_SIZE);
+            if (!chunk)
+                g_err.fatal("Out of memory");
+
+            m_chunks.push_back(chunk);
+        }
+        m_used = 0;
+    }
+
+    void *ptr = m_chunks[m_chunk] + m_used;
+    m_used += size;
+    m_spots.push_back((MemorySpot *) ptr);
+    return ptr;
+}
+
+/// @brief  Destroys every spot in the arena, the chunks are kept around so the
+///         next function reuses the same memory
+void MemoryArena::release()
+{
+    for (MemorySpot *ms : m_spots)
+        ms->~MemorySpot();
+
+    m_spots.clear();
+    m_chunk = 0;
+    m_used  = 0;
+}
+
+void *MemorySpot::operator new(size_t size)
+{
+    return g_memTable.arena().allocate(size);
+}
+
+void *MemorySpot::operator new(size_t size, MemoryArena &arena)
+{
+    return arena.allocate(size);
+}
 
 MemorySpot::MemorySpot()
 {
@@ -70,8 +127,9 @@ void MemorySpot::addReferencingTo(MemorySpot *ms, int op)
             ref = ms->memId();
     }
     
-    if (ref != -1)
-        addReferencingTo(g_memTable.findMemorySpot(ref));
+    MemorySpot *target = NULL;
+    if (ref != -1 && (target = g_memTable.findMemorySpot(ref)))
+        addReferencingTo(target);
     
     ms->checkDestroy();
 }
@@ -90,9 +148,10 @@ void MemorySpot::stopBeingReferencedBy(int id)
 {
     m_referencedBy.remove(id);
 
-    string lastref = g_memTable.findMemorySpot(id)->name();
+    MemorySpot *last    = g_memTable.findMemorySpot(id);
+    string      lastref = last ? last->name() : "";
     if (!m_referencedBy.size() && m_memLoc == MemLoc::HEAP)
-        err.memWarn("Memory leak, memory is allocated at the heap but never "
+        g_err.memWarn("Memory leak, memory is allocated at the heap but never "
                     "freed\n"
                     "The last reference (" +
                     lastref + ") just went out of scope");
@@ -103,6 +162,16 @@ void MemorySpot::stopReferencing()
     m_referencing = -1;
 }
 
+/// @brief  Drops the references to spots that were released, their ids are
+///         about to be handed out again
+void MemorySpot::forgetReleased()
+{
+    if (m_referencing != -1 && g_memTable.released(m_referencing))
+        m_referencing = -1;
+
+    m_referencedBy.removeIf([](int id) { return g_memTable.released(id); });
+}
+
 void MemorySpot::copy(MemorySpot *ms)
 {
     if (ms)
@@ -115,7 +184,9 @@ bool MemorySpot::_destroyHeap(string s)
                          " was destroyed by a memory deallocator";
     for (int id : m_referencedBy)
     {
-        g_memTable.findMemorySpot(id)->m_accessGarbage = true;
+        MemorySpot *ms = g_memTable.findMemorySpot(id);
+        if (ms)
+            ms->m_accessGarbage = true;
     }
     // g_memTable.removeMemorySpot(m_memId);
     return false;
@@ -123,12 +194,13 @@ bool MemorySpot::_destroyHeap(string s)
 
 void MemorySpot::destroyedMessage()
 {
-    if (m_referencing != -1)
-        g_memTable.findMemorySpot(m_referencing)->destroyedMessage();
+    MemorySpot *ms = NULL;
+    if (m_referencing != -1 && (ms = g_memTable.findMemorySpot(m_referencing)))
+        ms->destroyedMessage();
     else
     {
-        err.loadErrorInfo(m_destroyedErrInfo);
-        err.memNotice(m_destroyedMessage);    
+        g_err.loadErrorInfo(m_destroyedErrInfo);
+        g_err.memNotice(m_destroyedMessage);    
     }
 }
 
@@ -138,7 +210,7 @@ bool MemorySpot::tryToUse(int op)
     if (m_referencing != -1)
     {
         ms = g_memTable.findMemorySpot(m_referencing);
-        DEBUGR("refencing: " << m_referencing << " name: " << ms->name())
+        DEBUGR("refencing: " << m_referencing)
     }
     
     switch (op)
@@ -146,15 +218,15 @@ bool MemorySpot::tryToUse(int op)
     case AST::Types::PTRACCESS:
     
         if (!m_isInit || (ms && !ms->isInit()))
-            err.memWarn("Trying to access memory that is not initialised");
+            g_err.memWarn("Trying to access memory that is not initialised");
         if (m_isNullInit || (ms && ms->isNullInit()))
-            err.memWarn("Trying to access null-initialised memory");
+            g_err.memWarn("Trying to access null-initialised memory");
         if (m_accessGarbage || (ms && ms->accessingGarbage()))
         {
             if (ms)
                 ms->destroyedMessage();
             
-            err.memWarn("Trying to access memory that points to garbage");
+            g_err.memWarn("Trying to access memory that points to garbage");
         }
         break;
     }
@@ -165,14 +237,16 @@ bool MemorySpot::tryToUse(int op)
 bool MemorySpot::destroy(string s, bool printMessage)
 {
     bool ret           = false;
-    m_destroyedErrInfo = err.createErrorInfo();
+    m_destroyedErrInfo = g_err.createErrorInfo();
 
     if (m_memLoc == MemLoc::HEAP)
         return _destroyHeap(s);
 
-    if (m_referencing != -1 && !m_accessGarbage)
+    MemorySpot *referencing = NULL;
+    if (m_referencing != -1 && !m_accessGarbage &&
+        (referencing = g_memTable.findMemorySpot(m_referencing)))
     {
-        g_memTable.findMemorySpot(m_referencing)->stopBeingReferencedBy(m_memId);
+        referencing->stopBeingReferencedBy(m_memId);
     }
 
     if (m_referencedBy.size())
@@ -183,7 +257,8 @@ bool MemorySpot::destroy(string s, bool printMessage)
         int i = 0;
         for (int id : m_referencedBy)
         {
-            m_destroyedMessage += HL(g_memTable.findMemorySpot(id)->name());
+            MemorySpot *ms = g_memTable.findMemorySpot(id);
+            m_destroyedMessage += HL(ms ? ms->name() : "");
             if (i != m_referencedBy.size() - 1)
                 m_destroyedMessage += ", ";
             i++;
@@ -191,12 +266,14 @@ bool MemorySpot::destroy(string s, bool printMessage)
         
         // Trying to destory memory object that is still referenced
         if (printMessage)
-            err.memWarn(m_destroyedMessage);
+            g_err.memWarn(m_destroyedMessage);
         
         // Since this is just a warning lets deref those too
         for (int id : m_referencedBy)
         {
-            g_memTable.findMemorySpot(id)->setAccessGarbage(true);
+            MemorySpot *ms = g_memTable.findMemorySpot(id);
+            if (ms)
+                ms->setAccessGarbage(true);
         }
         m_referencedBy.clear();
     }
@@ -211,34 +288,67 @@ MemoryTable::MemoryTable()
 
 int MemoryTable::addMemorySpot(MemorySpot *ms)
 {
+    if (!m_freeIds.empty())
+    {
+        ms->setMemId(m_freeIds.back());
+        m_freeIds.pop_back();
+        m_table[ms->memId()] = ms;
+        return ms->memId();
+    }
+
+    ms->setMemId(m_table.size());
     m_table.push_back(ms);
-    ms->setMemId(m_memIDCounter++);
+    return ms->memId();
 }
 
 int MemoryTable::removeMemorySpot(int memId)
 {
-    for (auto i = m_table.begin(); i != m_table.end(); i++)
-    {
-        if ((*i)->memId() == memId)
-        {
-            m_table.erase(i);
-            return 0;
-        }
-    }
-    return -1;
+    if (memId < 0 || memId >= (int) m_table.size() || !m_table[memId])
+        return -1;
+
+    m_table[memId] = NULL;
+    return 0;
 }
 
+/// @brief  Returns NULL if the spot was released together with its function
 MemorySpot *MemoryTable::findMemorySpot(int memId)
 {
-    for (auto i = m_table.begin(); i != m_table.end(); i++)
+    if (memId < 0 || memId >= (int) m_table.size())
+        g_err.fatal("Could not find memory spot in table " + to_string(memId));
+
+    return m_table[memId];
+}
+
+/// @brief  Spots created from here on belong to the function being parsed
+void MemoryTable::beginFunction()
+{
+    m_arena = &m_functionArena;
+}
+
+/// @brief  Releases the spots of the function and hands their ids to the next
+///         one, so the table only grows as large as the largest function.
+///         Spots that outlive the function forget their references to them.
+void MemoryTable::endFunction()
+{
+    size_t freed = m_freeIds.size();
+    for (MemorySpot *ms : m_functionArena.spots())
     {
-        if ((*i)->memId() == memId)
+        int id = ms->memId();
+        if (id >= 0 && id < (int) m_table.size() && m_table[id] == ms)
         {
-            return *i;
+            m_table[id] = NULL;
+            m_freeIds.push_back(id);
         }
     }
 
-    err.fatal("Could not find memory spot in table " + to_string(memId));
+    if (m_freeIds.size() != freed)
+    {
+        for (MemorySpot *ms : m_globalArena.spots())
+            ms->forgetReleased();
+    }
+
+    m_functionArena.release();
+    m_arena = &m_globalArena;
 }
 
 void MemorySpot::goodValues()
@@ -0,0 +1,205 @@
+#include <context.h>
+#include <errorhandler.h>
+#include <objectfile.h>
+
+ObjectFile::ObjectFile(const string &sourceFile) : m_sourceFile(sourceFile)
+{
+}
+
+int ObjectFile::addSection(const string &name, uint32_t type, uint32_t flags,
+                           uint32_t align)
+{
+    m_sections.push_back({name, type, flags, align});
+
+    int idx                  = m_sections.size();
+    m_sections.back().symbol = addSymbol("", idx, 0, STB_LOCAL, STT_SECTION);
+    return idx;
+}
+
+int ObjectFile::addSymbol(const string &name, int section, uint32_t value,
+                          int bind, int type)
+{
+    m_symbols.push_back({name, section, value, bind, type});
+    return m_symbols.size() - 1;
+}
+
+void ObjectFile::addRelocation(int sec, uint32_t offset, int symbol, int type)
+{
+    Elf32_Rel rel;
+    rel.r_offset = offset;
+    rel.r_info   = ELF32_R_INFO(symbol, type);
+    section(sec).relocs.push_back(rel);
+}
+
+static uint32_t addString(string &table, const string &s)
+{
+    uint32_t off = table.size();
+    table += s;
+    table += '\0';
+    return off;
+}
+
+static void align(string &buf, uint32_t alignment)
+{
+    if (alignment > 1)
+        buf.resize((buf.size() + alignment - 1) / alignment * alignment, '\0');
+}
+
+template <class T> static void append(string &buf, const T &item)
+{
+    buf.append((const char *) &item, sizeof(T));
+}
+
+/// @brief  The object file as it would be written to disk
+string ObjectFile::contents()
+{
+    vector<Elf32_Shdr> headers(1);
+    string             shstrtab(1, '\0');
+    string             strtab(1, '\0');
+    string             out(sizeof(Elf32_Ehdr), '\0');
+
+    for (Section &sec : m_sections)
+    {
+        Elf32_Shdr sh = {};
+        sh.sh_name      = addString(shstrtab, sec.name);
+        sh.sh_type      = sec.type;
+        sh.sh_flags     = sec.flags;
+        sh.sh_addralign = sec.align;
+
+        align(out, sec.align);
+        sh.sh_offset = out.size();
+        sh.sh_size   = sec.bytes.size();
+        out.append((const char *) sec.bytes.data(), sec.bytes.size());
+        headers.push_back(sh);
+    }
+
+    // Symbol table: null, file, locals and then the globals
+    vector<int> newIndex(m_symbols.size());
+    string      symtab(sizeof(Elf32_Sym) * 2, '\0');
+
+    Elf32_Sym file = {};
+    file.st_name   = addString(strtab, m_sourceFile);
+    file.st_info   = ELF32_ST_INFO(STB_LOCAL, STT_FILE);
+    file.st_shndx  = SHN_ABS;
+    memcpy(&symtab[sizeof(Elf32_Sym)], &file, sizeof(file));
+
+    int count = 2, firstGlobal = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass)
+            firstGlobal = count;
+
+        for (size_t i = 0; i < m_symbols.size(); i++)
+        {
+            const Symbol &s = m_symbols[i];
+            if ((s.bind == STB_LOCAL) == (bool) pass)
+                continue;
+
+            Elf32_Sym sym = {};
+            if (s.name.size())
+                sym.st_name = addString(strtab, s.name);
+            sym.st_value = s.value;
+            sym.st_info  = ELF32_ST_INFO(s.bind, s.type);
+            sym.st_shndx = s.section;
+            append(symtab, sym);
+            newIndex[i] = count++;
+        }
+    }
+
+    int symtabIdx = headers.size() + count_if(m_sections.begin(),
+                                              m_sections.end(),
+                                              [](const Section &s) {
+                                                  return s.relocs.size();
+                                              });
+
+    for (size_t i = 0; i < m_sections.size(); i++)
+    {
+        Section &sec = m_sections[i];
+        if (sec.relocs.empty())
+            continue;
+
+        Elf32_Shdr sh = {};
+        sh.sh_name      = addString(shstrtab, ".rel" + sec.name);
+        sh.sh_type      = SHT_REL;
+        sh.sh_flags     = SHF_INFO_LINK;
+        sh.sh_link      = symtabIdx;
+        sh.sh_info      = i + 1;
+        sh.sh_addralign = 4;
+        sh.sh_entsize   = sizeof(Elf32_Rel);
+
+        align(out, 4);
+        sh.sh_offset = out.size();
+        for (Elf32_Rel rel : sec.relocs)
+        {
+            rel.r_info = ELF32_R_INFO(newIndex[ELF32_R_SYM(rel.r_info)],
+                                      ELF32_R_TYPE(rel.r_info));
+            append(out, rel);
+        }
+        sh.sh_size = out.size() - sh.sh_offset;
+        headers.push_back(sh);
+    }
+
+    Elf32_Shdr sh = {};
+    sh.sh_name      = addString(shstrtab, ".symtab");
+    sh.sh_type      = SHT_SYMTAB;
+    sh.sh_link      = symtabIdx + 1;
+    sh.sh_info      = firstGlobal;
+    sh.sh_addralign = 4;
+    sh.sh_entsize   = sizeof(Elf32_Sym);
+    align(out, 4);
+    sh.sh_offset = out.size();
+    sh.sh_size   = symtab.size();
+    out += symtab;
+    headers.push_back(sh);
+
+    sh           = {};
+    sh.sh_name   = addString(shstrtab, ".strtab");
+    sh.sh_type   = SHT_STRTAB;
+    sh.sh_addralign = 1;
+    sh.sh_offset = out.size();
+    sh.sh_size   = strtab.size();
+    out += strtab;
+    headers.push_back(sh);
+
+    sh           = {};
+    sh.sh_name   = addString(shstrtab, ".shstrtab");
+    sh.sh_type   = SHT_STRTAB;
+    sh.sh_addralign = 1;
+    sh.sh_offset = out.size();
+    sh.sh_size   = shstrtab.size();
+    out += shstrtab;
+    headers.push_back(sh);
+
+    align(out, 4);
+    Elf32_Ehdr eh = {};
+    memcpy(eh.e_ident, ELFMAG, SELFMAG);
+    eh.e_ident[EI_CLASS]   = ELFCLASS32;
+    eh.e_ident[EI_DATA]    = ELFDATA2LSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_type      = ET_REL;
+    eh.e_machine   = EM_386;
+    eh.e_version   = EV_CURRENT;
+    eh.e_shoff     = out.size();
+    eh.e_ehsize    = sizeof(Elf32_Ehdr);
+    eh.e_shentsize = sizeof(Elf32_Shdr);
+    eh.e_shnum     = headers.size();
+    eh.e_shstrndx  = headers.size() - 1;
+    memcpy(&out[0], &eh, sizeof(eh));
+
+    for (const Elf32_Shdr &h : headers)
+        append(out, h);
+
+    return out;
+}
+
+void ObjectFile::write(const string &path)
+{
+    string out = contents();
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == NULL)
+        g_err.fatalNL("Could not open file: '" + path + "'");
+
+    if (fwrite(out.data(), 1, out.size(), f) != out.size() || fclose(f))
+        g_err.fatalNL("Could not write object file: '" + path + "'");
+}
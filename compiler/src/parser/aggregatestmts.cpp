@@ -1,26 +1,26 @@
 #include <config.h>
+#include <context.h>
 #include <core.h>
 #include <errorhandler.h>
 #include <parser/parser.h>
 #include <parser/statementparser.h>
 #include <symbols.h>
 
-int anonStructCount = 0;
-
 ast_node *StatementParser::structInit(ast_node *tree, ast_node *ident,
                                       ast_node *right, Symbol *sym, int idx)
 {
     int offset = sym->varType.size - sym->varType.contents[idx].offset -
                  sym->varType.contents[idx].itemType.size;
 
-    if (g_symtable.isCurrentScopeGlobal())
+    if (m_ctx.symtable.isCurrentScopeGlobal())
     {
         if (right->operation == AST::Types::INTLIT)
             sym->inits.push_back(to_string(right->value));
         else if (right->operation == AST::Types::IDENTIFIER)
-            sym->inits.push_back(g_symtable.getSymbol(right->value)->name);
+            sym->inits.push_back(
+                m_ctx.atoms.str(m_ctx.symtable.getSymbol(right->value)->name));
         else
-            err.fatal("Global array does not support initializer");
+            m_ctx.errors.fatal("Global array does not support initializer");
     }
     else
     {
@@ -49,9 +49,9 @@ ast_node *StatementParser::parseStructInit(Type structType, Symbol sym)
     {
         left = m_parser.m_exprParser.parseBinaryOperation(0, structType);
 
-        if (left->type.typeType != STRUCT ||
-            left->type.name->compare(*structType.name))
-            err.expectedType(&structType, &left->type);
+        if (left->type().typeType != STRUCT ||
+            left->type().name != structType.name)
+            m_ctx.errors.expectedType(&structType, &left->type());
 
         int l = m_scanner.curLine();
         int c = m_scanner.curChar();
@@ -74,11 +74,11 @@ ast_node *StatementParser::parseStructInit(Type structType, Symbol sym)
                 m_parser.match(Token::Tokens::DOT);
                 m_parser.match(Token::Tokens::IDENTIFIER);
 
-                int itemIdx = findStructItem(m_scanner.identifier(),
+                int itemIdx = findStructItem(m_scanner.identAtom(),
                                              sym.varType);
 
                 if (inits[itemIdx])
-                    err.warning("Overwritten previously assigned initializer");
+                    m_ctx.errors.warning("Overwritten previously assigned initializer");
                 else
                     inits[itemIdx] = true;
 
@@ -97,7 +97,7 @@ ast_node *StatementParser::parseStructInit(Type structType, Symbol sym)
             delete[] inits;
 
             if (i == MAX_STRUCT_DESIGNATED_INIT)
-                err.fatal("Maximum designated initialsers is " +
+                m_ctx.errors.fatal("Maximum designated initialsers is " +
                           to_string(MAX_STRUCT_DESIGNATED_INIT));
         }
         else
@@ -115,12 +115,12 @@ ast_node *StatementParser::parseStructInit(Type structType, Symbol sym)
             }
 
             if (m_scanner.token().token() != Token::Tokens::R_BRACE)
-                err.fatal("Struct initialiser overflow");
+                m_ctx.errors.fatal("Struct initialiser overflow");
         }
         m_scanner.scan();
     }
 
-    int id       = g_symtable.pushSymbol(sym);
+    SymbolId id  = m_ctx.symtable.pushSymbol(sym);
     ident->value = id;
 
     DEBUG("leaving")
@@ -138,7 +138,7 @@ ast_node *StatementParser::declStruct(int storageClass, string _s)
     structType.typeType   = TypeTypes::STRUCT;
     structType.isArray    = false;
     bool   redecl         = false;
-    string s              = "anonymous" + to_string(anonStructCount++);
+    string s              = "anonymous" + to_string(m_ctx.typeList.anonStructCount++);
     bool   stringChanged  = false;
 
     if (_s.size())
@@ -151,15 +151,15 @@ ast_node *StatementParser::declStruct(int storageClass, string _s)
         stringChanged = true;
     }
 
-    structType.name = new string(s);
+    structType.name = m_ctx.atoms.intern(s);
 
-    if (!stringChanged && g_typeList.getType(*structType.name).typeType != 0)
+    if (!stringChanged && m_ctx.typeList.getType(structType.name).typeType != 0)
     {
         DEBUG("redecl of: " << s)
         redecl = true;
 
-        if (!g_typeList.getType(*structType.name).incomplete)
-            err.fatal("trying to initialise an already initialized struct");
+        if (!m_ctx.typeList.getType(structType.name).incomplete)
+            m_ctx.errors.fatal("trying to initialise an already initialized struct");
     }
 
     if (m_scanner.token().token() == Token::Tokens::SEMICOLON)
@@ -169,7 +169,7 @@ ast_node *StatementParser::declStruct(int storageClass, string _s)
 
         // Double forward declare ??
         if (!redecl)
-            g_typeList.addType(structType);
+            m_ctx.typeList.addType(structType);
 
         return mkAstLeaf(AST::Types::PADDING, 0, structType, 0, 0);
     }
@@ -179,11 +179,12 @@ ast_node *StatementParser::declStruct(int storageClass, string _s)
         return mkAstLeaf(AST::Types::PADDING, 0, structType, 0, 0);
 
     if (!redecl)
-        g_typeList.addType(structType);
+        m_ctx.typeList.addType(structType);
 
     m_parser.match(Token::Tokens::L_BRACE);
 
-    int offset = 0;
+    int        offset  = 0;
+    StructDef *members = m_ctx.typeList.newStruct();
 
     struct StructItem sItem;
 
@@ -195,7 +196,7 @@ ast_node *StatementParser::declStruct(int storageClass, string _s)
     {
         sItem.itemType = m_parser.parseType();
         if (sItem.itemType.typeType == 0)
-            err.unknownType(&sItem.itemType);
+            m_ctx.errors.unknownType(&sItem.itemType);
 
         while (m_scanner.token().token() == Token::Tokens::STAR)
         {
@@ -204,7 +205,7 @@ ast_node *StatementParser::declStruct(int storageClass, string _s)
         }
 
         m_parser.match(Token::Tokens::IDENTIFIER);
-        sItem.name = m_scanner.identifier();
+        sItem.name = m_scanner.identAtom();
 
         switch (sItem.itemType.size)
         {
@@ -246,7 +247,7 @@ ast_node *StatementParser::declStruct(int storageClass, string _s)
 
         offset += sItem.itemType.size;
 
-        structType.contents.push_back(sItem);
+        members->add(sItem);
 
         m_parser.match(Token::Tokens::SEMICOLON);
 
@@ -254,14 +255,15 @@ ast_node *StatementParser::declStruct(int storageClass, string _s)
             break;
     }
     if (i == STRUCT_MAX_ITEMS)
-        err.fatal("Too many items in struct (max 1023)");
+        m_ctx.errors.fatal("Too many items in struct (max 1023)");
 
 noItems:;
-    structType.size = offset;
+    structType.size     = offset;
+    structType.contents = members;
 
     m_scanner.scan();
 
-    g_typeList.replace(*structType.name, structType);
+    m_ctx.typeList.replace(structType.name, structType);
 
     return mkAstLeaf(AST::PADDING, 0, structType, 0, 0);
 }
@@ -277,7 +279,7 @@ ast_node *StatementParser::declUnion(int sc, string _s)
     unionType.isArray    = false;
     bool redecl          = false;
 
-    string s = "anonymous" + to_string(anonStructCount++);
+    string s = "anonymous" + to_string(m_ctx.typeList.anonStructCount++);
     if (_s.size())
         s = _s;
 
@@ -287,15 +289,15 @@ ast_node *StatementParser::declUnion(int sc, string _s)
         m_scanner.scan();
     }
 
-    unionType.name = new string(s);
+    unionType.name = m_ctx.atoms.intern(s);
 
     if (s.compare("<anonymous>") &&
-        g_typeList.getType(*unionType.name).typeType != 0)
+        m_ctx.typeList.getType(unionType.name).typeType != 0)
     {
         redecl = true;
 
-        if (!g_typeList.getType(*unionType.name).incomplete)
-            err.fatal("trying to initialise an already initialized struct");
+        if (!m_ctx.typeList.getType(unionType.name).incomplete)
+            m_ctx.errors.fatal("trying to initialise an already initialized struct");
     }
 
     if (m_scanner.token().token() == Token::Tokens::SEMICOLON)
@@ -305,7 +307,7 @@ ast_node *StatementParser::declUnion(int sc, string _s)
 
         // Double forward declare ??
         if (!redecl)
-            g_typeList.addType(unionType);
+            m_ctx.typeList.addType(unionType);
 
         return mkAstLeaf(AST::Types::PADDING, 0, 0, 0);
     }
@@ -314,6 +316,7 @@ ast_node *StatementParser::declUnion(int sc, string _s)
 
     struct StructItem sItem;
     int               largestSize = 0;
+    StructDef        *members     = m_ctx.typeList.newStruct();
 
     if (m_scanner.token().token() == Token::Token::R_BRACE)
         goto noItems;
@@ -328,13 +331,13 @@ ast_node *StatementParser::declUnion(int sc, string _s)
             string ident = m_scanner.identifier();
             m_scanner.scan();
             if (m_scanner.token().token() == Token::Tokens::L_BRACE)
-                sItem.itemType = m_parser._declAggregateType(tok, ident)->type;
+                sItem.itemType = m_parser._declAggregateType(tok, ident)->typeWithSpot();
             else
-                err.unknownType(&sItem.itemType);
+                m_ctx.errors.unknownType(&sItem.itemType);
         }
 
         m_parser.match(Token::Tokens::IDENTIFIER);
-        sItem.name   = m_scanner.identifier();
+        sItem.name   = m_scanner.identAtom();
         sItem.offset = 0;
 
         if (m_scanner.token().token() == Token::Tokens::L_BRACKET)
@@ -351,7 +354,7 @@ ast_node *StatementParser::declUnion(int sc, string _s)
         if (sItem.itemType.size > largestSize)
             largestSize = sItem.itemType.size;
 
-        unionType.contents.push_back(sItem);
+        members->add(sItem);
 
         m_parser.match(Token::Tokens::SEMICOLON);
 
@@ -359,17 +362,18 @@ ast_node *StatementParser::declUnion(int sc, string _s)
             break;
     }
     if (i == STRUCT_MAX_ITEMS)
-        err.fatal("Too many items in union (max 1023)");
+        m_ctx.errors.fatal("Too many items in union (max 1023)");
 
 noItems:;
-    unionType.size = largestSize;
+    unionType.size     = largestSize;
+    unionType.contents = members;
 
     m_scanner.scan();
 
     if (redecl)
-        g_typeList.replace(*unionType.name, unionType);
+        m_ctx.typeList.replace(unionType.name, unionType);
     else
-        g_typeList.addType(unionType);
+        m_ctx.typeList.addType(unionType);
 
     return mkAstLeaf(AST::PADDING, 0, unionType, 0, 0);
 }
@@ -2,11 +2,10 @@
 #include <parser/parser.h>
 #include <core.h>
 #include <config.h>
+#include <context.h>
 #include <errorhandler.h>
 #include <symbols.h>
 
-int anonEnumCount = 0;
-
 ast_node *StatementParser::declEnum(string _s)
 {
     Type enumType = INTTYPE;
@@ -15,29 +14,29 @@ ast_node *StatementParser::declEnum(string _s)
     enumItem.varType.typeType = TypeTypes::CONSTANT;
     bool redecl = false;
     int lastnum = 0;
-    string s = "anonymousEnum" + to_string(anonEnumCount++);
+    string s = "anonymousEnum" + to_string(m_ctx.typeList.anonEnumCount++);
     if (_s.size())
         s = _s;
     
     if (m_scanner.token().token() == Token::Tokens::IDENTIFIER)
     {
-        enumType.name = new string(m_scanner.identifier());
+        enumType.name = m_scanner.identAtom();
         m_scanner.scan();
     }
     else
-        enumType.name = new string(s);
+        enumType.name = m_ctx.atoms.intern(s);
         
     enumType.typeType = TypeTypes::ENUM;
     
     if (m_scanner.token().token() == Token::Tokens::SEMICOLON)
     {
-        err.pedanticWarning("ISO C forbids forward references to enum types");
+        m_ctx.errors.pedanticWarning("ISO C forbids forward references to enum types");
         enumType.incomplete = true;
     }
     
-    g_typeList.addType(enumType);
+    m_ctx.typeList.addType(enumType);
     
-    if (g_typeList.getType(*enumType.name).typeType != 0)
+    if (m_ctx.typeList.getType(enumType.name).typeType != 0)
         redecl = true;
     
     m_parser.match(Token::Tokens::L_BRACE);
@@ -48,7 +47,7 @@ ast_node *StatementParser::declEnum(string _s)
     for (int i = 0; i < ENUM_MAX_ITEMS; i++)
     {
         m_parser.match(Token::Tokens::IDENTIFIER);
-        enumItem.name = m_scanner.identifier();
+        enumItem.name = m_scanner.identAtom();
         
         if (m_scanner.token().token() == Token::Tokens::EQUALSIGN)
         {
@@ -57,7 +56,7 @@ ast_node *StatementParser::declEnum(string _s)
         }
         
         enumItem.value = lastnum++;
-        g_symtable.pushSymbol(enumItem);
+        m_ctx.symtable.pushSymbol(enumItem);
         
         if (m_scanner.token().token() == Token::Tokens::R_BRACE)
             break;
@@ -71,16 +70,16 @@ noItems:;
     return mkAstLeaf(AST::Types::PADDING, 0, 0, 0);
 }
 
-int evaluateConstant(ast_node *tree)
+static int evaluateConstant(ErrorHandler &err, ast_node *tree)
 {
     int leftreg = 0;
     int rightreg = 0;
     
     if (tree->left)
-        leftreg = evaluateConstant(tree->left);
+        leftreg = evaluateConstant(err, tree->left);
     
     if (tree->right)
-        rightreg = evaluateConstant(tree->right);
+        rightreg = evaluateConstant(err, tree->right);
         
     switch (tree->operation)
     {
@@ -103,6 +102,6 @@ int evaluateConstant(ast_node *tree)
 int ExpressionParser::parseConstantExpr()
 {
     ast_node *opp = parseBinaryOperation(0, INTTYPE);
-    int val = evaluateConstant(opp);
+    int val = evaluateConstant(m_ctx.errors, opp);
     return val;
 }
\ No newline at end of file
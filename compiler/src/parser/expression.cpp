@@ -1,11 +1,12 @@
+#include <context.h>
 #include <errorhandler.h>
 #include <parser/parser.h>
 #include <symbols.h>
 #include <types.h>
 
-ExpressionParser::ExpressionParser(Scanner &scanner, Parser &parser,
-                                   Generator &gen)
-    : m_scanner(scanner), m_parser(parser), m_generator(gen)
+ExpressionParser::ExpressionParser(CompilationContext &ctx, Scanner &scanner,
+                                   Parser &parser, Generator &gen)
+    : m_ctx(ctx), m_scanner(scanner), m_parser(parser), m_generator(gen)
 {
 }
 
@@ -13,13 +14,15 @@ ast_node *ExpressionParser::parseSizeof()
 {
     m_scanner.scan();
 
-    ast_node *ptr = parseLeft(&NULLTYPE);
+    // parseLeft may change the type, NULLTYPE is shared
+    Type      none = NULLTYPE;
+    ast_node *ptr  = parseLeft(&none);
     int       size;
 
     if (ptr->operation == AST::Types::IDENTIFIER)
-        size = getTypeSize(*g_symtable.getSymbol(ptr->value));
+        size = getTypeSize(*m_ctx.symtable.getSymbol(ptr->value));
     else
-        size = ptr->type.size;
+        size = ptr->type().size;
 
     int l = m_scanner.curLine();
     int c = m_scanner.curChar();
@@ -67,8 +70,9 @@ ast_node *ExpressionParser::parseTypeCast(Type *ltype)
 
         m_parser.match(Token::Tokens::R_PAREN);
 
-        ret       = parseBinaryOperation(0, NULLTYPE);
-        ret->type = type;
+        ret          = parseBinaryOperation(0, NULLTYPE);
+        ret->memSpot = type.memSpot;
+        ret->setType(type);
         return ret;
 
     default:
@@ -94,8 +98,8 @@ ast_node *ExpressionParser::parsePrimary(Type *ltype)
 {
     ast_node *node;
     Symbol *  s;
-    int       id;
-    int       val;
+    SymbolId  id;
+    int64_t   val;
     int       tok = m_scanner.token().token();
 
     switch (tok)
@@ -113,11 +117,11 @@ ast_node *ExpressionParser::parsePrimary(Type *ltype)
         if (!typeFits(ltype, val))
         {
             /* Truncate */
-            err.warning("Value exceeds " + typeString(ltype) +
+            m_ctx.errors.warning("Value exceeds " + typeString(ltype) +
                         "'s bounds (value: " + to_string(val) + ")");
 
             val = truncateOverflow(*ltype, val);
-            err.notice("Truncated value to '" + to_string(val) + "'");
+            m_ctx.errors.notice("Truncated value to '" + to_string(val) + "'");
         }
 
         if (ltype->ptrDepth)
@@ -130,12 +134,12 @@ ast_node *ExpressionParser::parsePrimary(Type *ltype)
         break;
 
     case Token::Tokens::IDENTIFIER:
-        id = g_symtable.findSymbol(m_scanner.identifier());
+        id = m_ctx.symtable.findSymbol(m_scanner.identAtom());
         if (id == -1 ||
-            g_symtable.getSymbol(id)->symType == SymbolTable::SymTypes::LABEL)
+            m_ctx.symtable.getSymbol(id)->symType == SymbolTable::SymTypes::LABEL)
             return NULL;
 
-        s = g_symtable.getSymbol(id);
+        s = m_ctx.symtable.getSymbol(id);
 
         if (s->varType.typeType == TypeTypes::CONSTANT)
         {
@@ -156,7 +160,7 @@ ast_node *ExpressionParser::parsePrimary(Type *ltype)
         m_scanner.scan();
 
         // Scan's can mess up the symtable (due to strings)
-        s = g_symtable.getSymbol(id);
+        s = m_ctx.symtable.getSymbol(id);
 
         if (m_scanner.token().token() == Token::Tokens::L_PAREN)
         {
@@ -170,10 +174,10 @@ ast_node *ExpressionParser::parsePrimary(Type *ltype)
 
     case Token::Tokens::STRINGLIT:
         val = m_scanner.token().intValue();
-        s   = g_symtable.getSymbol(val);
+        s   = m_ctx.symtable.getSymbol(val);
 
         if (s == NULL)
-            err.fatal("Could not find string literal in symbol table");
+            m_ctx.errors.fatal("Could not find string literal in symbol table");
 
         node = mkAstLeaf(AST::Types::IDENTIFIER, val, s->varType,
                          m_scanner.curLine(), m_scanner.curChar());
@@ -193,7 +197,7 @@ ast_node *ExpressionParser::parsePrimary(Type *ltype)
             break;
         }
 
-        err.unexpectedToken(m_scanner.token().token());
+        m_ctx.errors.unexpectedToken(m_scanner.token().token());
     }
 
     return node;
@@ -204,7 +208,7 @@ ast_node *ExpressionParser::parsePrimary(Type *ltype)
 ast_node *ExpressionParser::parsePrefixOperator(Type *ltype)
 {
     ast_node *node = NULL;
-    int       id;
+    SymbolId  id;
     Type      type;
     ast_node *left = NULL;
     ast_node *tmp  = NULL;
@@ -218,16 +222,16 @@ ast_node *ExpressionParser::parsePrefixOperator(Type *ltype)
 
         if (node->operation != AST::Types::IDENTIFIER &&
             (node->operation != AST::Types::ADD &&
-             node->type.typeType == TypeTypes::STRUCT))
-            err.fatal("Lvalue required as argument to unary '&'");
+             node->type().typeType == TypeTypes::STRUCT))
+            m_ctx.errors.fatal("Lvalue required as argument to unary '&'");
 
         if (node->operation == AST::Types::ADD)
             left = node;
 
-        else if ((id = g_symtable.findSymbol(m_scanner.identifier())) == -1)
-            err.fatal("Invalid operand to unary '&'");
+        else if ((id = m_ctx.symtable.findSymbol(m_scanner.identAtom())) == -1)
+            m_ctx.errors.fatal("Invalid operand to unary '&'");
 
-        type = node->type;
+        type = node->typeWithSpot();
         type.ptrDepth++;
         type.size = PTR_SIZE;
 
@@ -241,18 +245,18 @@ ast_node *ExpressionParser::parsePrefixOperator(Type *ltype)
 
         node = parseLeft(ltype);
 
-        if (!node->type.ptrDepth)
-            err.fatal("Unsupported type to unary: " +
-                      typeString((&node->type)) + " (expected pointer type)");
+        if (!node->type().ptrDepth)
+            m_ctx.errors.fatal("Unsupported type to unary: " +
+                      typeString((&node->type())) + " (expected pointer type)");
 
-        type = node->type;
+        type = node->typeWithSpot();
         if (type.memSpot)
             type.memSpot->tryToUse(AST::Types::PTRACCESS);
 
         dereference(&type);
 
         if (type.typeType == TypeTypes::STRUCT && !type.ptrDepth)
-            node->type = type;
+            node->setType(type);
         // else
         node = mkAstUnary(AST::Types::PTRACCESS, node, 0, type, node->line,
                           node->c);
@@ -263,10 +267,10 @@ ast_node *ExpressionParser::parsePrefixOperator(Type *ltype)
         m_scanner.scan();
         node = parseLeft(ltype);
 
-        if ((!node->type.isSigned) || node->type.ptrDepth)
-            err.fatal("Cannot negate type " + HL(typeString((&node->type))));
+        if ((!node->type().isSigned) || node->type().ptrDepth)
+            m_ctx.errors.fatal("Cannot negate type " + HL(typeString((&node->type()))));
 
-        node = mkAstUnary(AST::Types::NEGATE, node, 0, node->type, node->line,
+        node = mkAstUnary(AST::Types::NEGATE, node, 0, node->typeWithSpot(), node->line,
                           node->c);
 
         break;
@@ -276,11 +280,11 @@ ast_node *ExpressionParser::parsePrefixOperator(Type *ltype)
 
         node = parseLeft(ltype);
 
-        if (node->type.ptrDepth || node->type.typeType != TypeTypes::VARIABLE)
-            err.fatal("Cannot preform bitwise not on " +
-                      HL(typeString(&node->type)));
+        if (node->type().ptrDepth || node->type().typeType != TypeTypes::VARIABLE)
+            m_ctx.errors.fatal("Cannot preform bitwise not on " +
+                      HL(typeString(&node->type())));
 
-        node = mkAstUnary(AST::Types::NOT, node, 0, node->type, node->line,
+        node = mkAstUnary(AST::Types::NOT, node, 0, node->typeWithSpot(), node->line,
                           node->c);
 
         break;
@@ -288,7 +292,7 @@ ast_node *ExpressionParser::parsePrefixOperator(Type *ltype)
     case Token::Tokens::LOGNOT:
         m_scanner.scan();
         node = parseLeft(ltype);
-        node = mkAstUnary(AST::Types::LOGNOT, node, 0, node->type, node->line,
+        node = mkAstUnary(AST::Types::LOGNOT, node, 0, node->typeWithSpot(), node->line,
                           node->c);
 
         break;
@@ -298,20 +302,20 @@ ast_node *ExpressionParser::parsePrefixOperator(Type *ltype)
         node = parseLeft(ltype);
 
         if (node->operation != AST::Types::IDENTIFIER)
-            err.fatal("Cannot increment a non-lvalue object");
+            m_ctx.errors.fatal("Cannot increment a non-lvalue object");
 
         left = mkAstLeaf(AST::Types::INTLIT, 1, INTTYPE, node->line, node->c);
 
         tmp = checkArithmetic(node, left, Token::Tokens::PLUS);
         if (tmp)
         {
-            if (node->type.ptrDepth)
+            if (node->type().ptrDepth)
                 left = tmp;
         }
 
         // If value is 1 it means increment after value return
         // if it is 0 it means increment before value return
-        node = mkAstNode(AST::Types::INCREMENT, node, NULL, left, 0, node->type,
+        node = mkAstNode(AST::Types::INCREMENT, node, NULL, left, 0, node->typeWithSpot(),
                          node->line, node->c);
 
         break;
@@ -321,20 +325,20 @@ ast_node *ExpressionParser::parsePrefixOperator(Type *ltype)
         node = parseLeft(ltype);
 
         if (node->operation != AST::Types::IDENTIFIER)
-            err.fatal("Cannot decrement a non-lvalue object");
+            m_ctx.errors.fatal("Cannot decrement a non-lvalue object");
 
         left = mkAstLeaf(AST::Types::INTLIT, 1, INTTYPE, node->line, node->c);
 
         tmp = checkArithmetic(node, left, Token::Tokens::MINUS);
         if (tmp)
         {
-            if (node->type.ptrDepth)
+            if (node->type().ptrDepth)
                 left = tmp;
         }
 
         // If value is 1 it means increment after value return
         // if it is 0 it means increment before value return
-        node = mkAstNode(AST::Types::DECREMENT, node, NULL, left, 0, node->type,
+        node = mkAstNode(AST::Types::DECREMENT, node, NULL, left, 0, node->typeWithSpot(),
                          node->line, node->c);
 
         break;
@@ -362,10 +366,10 @@ ast_node *ExpressionParser::parseArrayAccess(ast_node *primary, bool access)
     ast_node *idx;
     Type      type;
 
-    if (!primary->type.ptrDepth)
+    if (!primary->type().ptrDepth)
     {
-        err.fatal("Unsupported type to array accessor " +
-                  typeString((&primary->type)) + " expected pointer type");
+        m_ctx.errors.fatal("Unsupported type to array accessor " +
+                  typeString((&primary->type())) + " expected pointer type");
     }
 
     idx = parseBinaryOperation(0, DEFAULTTYPE);
@@ -375,16 +379,16 @@ ast_node *ExpressionParser::parseArrayAccess(ast_node *primary, bool access)
 
     m_parser.match(Token::Tokens::R_BRACKET);
 
-    type = primary->type;
+    type = primary->typeWithSpot();
     dereference(&type);
 
-    right = mkAstLeaf(AST::Types::INTLIT, type.size, idx->type,
+    right = mkAstLeaf(AST::Types::INTLIT, type.size, idx->typeWithSpot(),
                       m_scanner.curLine(), m_scanner.curChar());
 
-    idx = mkAstNode(AST::Types::MULTIPLY, idx, NULL, right, 0, primary->type,
+    idx = mkAstNode(AST::Types::MULTIPLY, idx, NULL, right, 0, primary->typeWithSpot(),
                     m_scanner.curLine(), m_scanner.curChar());
 
-    primary = mkAstNode(AST::Types::ADD, primary, NULL, idx, 0, primary->type,
+    primary = mkAstNode(AST::Types::ADD, primary, NULL, idx, 0, primary->typeWithSpot(),
                         m_scanner.curLine(), m_scanner.curChar());
 
     if (access)
@@ -413,23 +417,24 @@ ast_node *ExpressionParser::parseStructAccess(ast_node *prim, bool access)
         ptraccess = true;
     }
 
-    if (prim->type.typeType != TypeTypes::STRUCT)
-        err.fatal("cannot preform struct access on non-aggregate type");
+    if (prim->type().typeType != TypeTypes::STRUCT)
+        m_ctx.errors.fatal("cannot preform struct access on non-aggregate type");
 
-    if (ptraccess && !prim->type.ptrDepth)
-        err.incorrectAccessor(ptraccess);
-    if (!ptraccess && prim->type.ptrDepth)
-        err.incorrectAccessor(ptraccess);
+    if (ptraccess && !prim->type().ptrDepth)
+        m_ctx.errors.incorrectAccessor(ptraccess);
+    if (!ptraccess && prim->type().ptrDepth)
+        m_ctx.errors.incorrectAccessor(ptraccess);
 
     m_scanner.scan();
     if (m_scanner.token().token() != Token::Tokens::IDENTIFIER)
-        err.expectedToken(Token::Tokens::IDENTIFIER);
+        m_ctx.errors.expectedToken(Token::Tokens::IDENTIFIER);
 
-    Type t      = prim->type;
-    int  idx    = findStructItem(m_scanner.identifier(), t);
-    int  offset = t.contents[idx].offset;
-    int  size   = t.contents[idx].itemType.size;
-    t           = t.contents[idx].itemType;
+    const Type       &ptype = prim->type();
+    const StructItem &item =
+        ptype.contents[findStructItem(m_scanner.identAtom(), ptype)];
+    int  offset = item.offset;
+    int  size   = item.itemType.size;
+    Type t      = item.itemType;
 
     int       l          = m_scanner.curLine();
     int       c          = m_scanner.curChar();
@@ -457,32 +462,32 @@ ast_node *ExpressionParser::checkArithmetic(ast_node *left, ast_node *right,
 
     ast_node *ret = NULL;
 
-    if ((left->type.typeType == TypeTypes::STRUCT && !left->type.ptrDepth) ||
-        (right->type.typeType == TypeTypes::STRUCT && !right->type.ptrDepth))
-        err.fatal("Cannot preform binary arithmetic on structs");
+    if ((left->type().typeType == TypeTypes::STRUCT && !left->type().ptrDepth) ||
+        (right->type().typeType == TypeTypes::STRUCT && !right->type().ptrDepth))
+        m_ctx.errors.fatal("Cannot preform binary arithmetic on structs");
 
-    if (left->type.ptrDepth || right->type.ptrDepth)
+    if (left->type().ptrDepth || right->type().ptrDepth)
     {
         if (!isArithmetic(tok))
             return NULL;
 
         if (tok != Token::Tokens::MINUS && tok != Token::Tokens::PLUS)
         {
-            err.fatal("Pointer arithmetic only allows + and - to be used ");
+            m_ctx.errors.fatal("Pointer arithmetic only allows + and - to be used ");
         }
-        else if (left->type.ptrDepth && right->type.ptrDepth &&
+        else if (left->type().ptrDepth && right->type().ptrDepth &&
                  tok == Token::Tokens::PLUS)
         {
-            err.fatal("Pointer arithmetic only allows - to be used between "
+            m_ctx.errors.fatal("Pointer arithmetic only allows - to be used between "
                       "pointers");
         }
 
-        if (!(left->type.ptrDepth && right->type.ptrDepth))
+        if (!(left->type().ptrDepth && right->type().ptrDepth))
         {
             // Scaling
 
-            ast_node *ptr  = left->type.ptrDepth ? left : right;
-            ast_node *nptr = left->type.ptrDepth ? right : left;
+            ast_node *ptr  = left->type().ptrDepth ? left : right;
+            ast_node *nptr = left->type().ptrDepth ? right : left;
             Type      t;
 
             t.isArray           = false;
@@ -490,10 +495,13 @@ ast_node *ExpressionParser::checkArithmetic(ast_node *left, ast_node *right,
             t.ptrDepth          = 0;
             t.primType          = PrimitiveTypes::INT;
             t.size              = PTR_SIZE;
-            nptr->type.size     = PTR_SIZE;
-            nptr->type.primType = PrimitiveTypes::INT;
 
-            ret = mkAstLeaf(AST::Types::INTLIT, ptr->type.size, t, left->line,
+            Type ntype     = nptr->type();
+            ntype.size     = PTR_SIZE;
+            ntype.primType = PrimitiveTypes::INT;
+            nptr->setType(ntype);
+
+            ret = mkAstLeaf(AST::Types::INTLIT, ptr->type().size, t, left->line,
                             left->c);
             return mkAstNode(AST::Types::MULTIPLY, ret, NULL, nptr, 0,
                              left->line, left->c);
@@ -511,14 +519,14 @@ ast_node *ExpressionParser::parsePostfixOperator(ast_node *tree, bool access)
     switch (m_scanner.token().token())
     {
     case Token::Tokens::L_BRACKET:
-        if (tree->type.memSpot)
-            tree->type.memSpot->tryToUse(AST::Types::PTRACCESS);
+        if (tree->memSpot)
+            tree->memSpot->tryToUse(AST::Types::PTRACCESS);
         tree = parseArrayAccess(tree, access);
         break;
 
     case Token::Tokens::MINUS:
-        if (tree->type.memSpot)
-            tree->type.memSpot->tryToUse(AST::Types::PTRACCESS);
+        if (tree->memSpot)
+            tree->memSpot->tryToUse(AST::Types::PTRACCESS);
     case Token::Tokens::DOT:
         tree = parseStructAccess(tree, access);
         break;
@@ -527,17 +535,17 @@ ast_node *ExpressionParser::parsePostfixOperator(ast_node *tree, bool access)
         m_scanner.scan();
 
         if (tree->operation != AST::Types::IDENTIFIER)
-            err.fatal("Cannot increment a non-lvalue object");
+            m_ctx.errors.fatal("Cannot increment a non-lvalue object");
 
         left = mkAstLeaf(AST::Types::INTLIT, 1, INTTYPE, tree->line, tree->c);
 
         tmp = checkArithmetic(tree, left, Token::Tokens::PLUS);
-        if (tmp && tree->type.ptrDepth)
+        if (tmp && tree->type().ptrDepth)
             left = tmp;
 
         // If value is 1 it means increment after value return
         // if it is 0 it means increment before value return
-        tree = mkAstNode(AST::Types::INCREMENT, tree, NULL, left, 1, tree->type,
+        tree = mkAstNode(AST::Types::INCREMENT, tree, NULL, left, 1, tree->typeWithSpot(),
                          tree->line, tree->c);
 
         break;
@@ -546,20 +554,20 @@ ast_node *ExpressionParser::parsePostfixOperator(ast_node *tree, bool access)
         m_scanner.scan();
 
         if (tree->operation != AST::Types::IDENTIFIER)
-            err.fatal("Cannot decrement a non-lvalue object");
+            m_ctx.errors.fatal("Cannot decrement a non-lvalue object");
 
         left = mkAstLeaf(AST::Types::INTLIT, 1, INTTYPE, tree->line, tree->c);
 
         tmp = checkArithmetic(tree, left, Token::Tokens::MINUS);
         if (tmp)
         {
-            if (tree->type.ptrDepth)
+            if (tree->type().ptrDepth)
                 left = tmp;
         }
 
         // If value is 1 it means increment after value return
         // if it is 0 it means increment before value return
-        tree = mkAstNode(AST::Types::DECREMENT, tree, NULL, left, 1, tree->type,
+        tree = mkAstNode(AST::Types::DECREMENT, tree, NULL, left, 1, tree->typeWithSpot(),
                          tree->line, tree->c);
 
         break;
@@ -636,6 +644,7 @@ ast_node *ExpressionParser::parseBinaryOperator(int prevPrec, Type *type,
     ast_node *left;
     ast_node *right;
     ast_node *complexAssignment = NULL;
+    Type      lvalueType;
 
     left = parseLeft(type);
 
@@ -650,9 +659,10 @@ ast_node *ExpressionParser::parseBinaryOperator(int prevPrec, Type *type,
 
     if (tok == Token::Tokens::EQUALSIGN || complexAssignment)
     {
-        type = &left->type;
+        lvalueType = left->typeWithSpot();
+        type       = &lvalueType;
         if (!isLvalue(left->operation))
-            err.fatal("lvalue expected to the left of the assignment");
+            m_ctx.errors.fatal("lvalue expected to the left of the assignment");
     }
 
     while (getOperatorPrecedence(tok) > prevPrec)
@@ -660,12 +670,15 @@ ast_node *ExpressionParser::parseBinaryOperator(int prevPrec, Type *type,
         m_scanner.scan();
 
         if (tok == Token::Tokens::QUESTIONMARK)
-            right = parseTernaryCondition(&left->type);
+        {
+            Type ternaryType = left->typeWithSpot();
+            right = parseTernaryCondition(&ternaryType);
+        }
         else
             right = parseBinaryOperator(OperatorPrecedence[tok], type, prevTok);
 
         if (!right)
-            err.unknownSymbol(m_scanner.identifier());
+            m_ctx.errors.unknownSymbol(m_scanner.identifier());
 
         if (tok == Token::Tokens::EQUALSIGN)
         {
@@ -673,11 +686,11 @@ ast_node *ExpressionParser::parseBinaryOperator(int prevPrec, Type *type,
                 if (type->memSpot)
                     type->memSpot->setNullInit(true);
             
-            if (right->type.memSpot && type->memSpot)
+            if (right->memSpot && type->memSpot)
             {
                 type->memSpot->setIsInit(true);
                 type->memSpot->setNullInit(false);
-                type->memSpot->addReferencingTo(right->type.memSpot,
+                type->memSpot->addReferencingTo(right->memSpot,
                                                 right->operation);
             }
         }
@@ -685,7 +698,7 @@ ast_node *ExpressionParser::parseBinaryOperator(int prevPrec, Type *type,
         ast_node *tmp = checkArithmetic(left, right, tok);
         if (tmp)
         {
-            if (left->type.ptrDepth)
+            if (left->type().ptrDepth)
                 right = tmp;
             else
                 left = tmp;
@@ -718,13 +731,13 @@ ast_node *ExpressionParser::parseBinaryOperator(int prevPrec, Type *type,
             // Type: x = y = 4;
             tmp         = left->right;
             left->right = mkAstNode(tokenToAst(tok, m_scanner), tmp, NULL,
-                                    right, 0, left->type, l, c);
+                                    right, 0, left->typeWithSpot(), l, c);
         }
         else
         {
             // Type: x = 4;
             left = mkAstNode(tokenToAst(tok, m_scanner), left, NULL, right, 0,
-                             left->type, l, c);
+                             left->typeWithSpot(), l, c);
         }
 
         tok = m_scanner.token().token();
@@ -776,7 +789,7 @@ ast_node *ExpressionParser::parseBinaryOperation(int prev_prec, Type type)
         tmp = typeCompatible(pad, node, true);
         if (tmp)
             node = tmp;
-        delete pad;
+        freeAstNode(pad);
     }
 
     return node;
@@ -790,7 +803,7 @@ int ExpressionParser::getOperatorPrecedence(int token)
 {
     int prec = OperatorPrecedence[token];
     if (prec == 0)
-        err.unexpectedToken(token);
+        m_ctx.errors.unexpectedToken(token);
 
     return prec;
 }
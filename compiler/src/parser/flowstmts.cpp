@@ -1,3 +1,4 @@
+#include <context.h>
 #include <parser/parser.h>
 #include <symbols.h>
 #include <token.h>
@@ -53,7 +54,7 @@ static ast_node *checkPadding(ast_node *tree)
 {
     if (tree->operation == AST::Types::PADDING)
     {
-        delete tree;
+        freeAstNode(tree);
         return NULL;
     }
     
@@ -68,7 +69,7 @@ ast_node *StatementParser::forStatement()
     int l = m_scanner.curLine();
     int c = m_scanner.curChar();
 
-    int id = g_symtable.newScope();
+    int id = m_ctx.symtable.newScope();
     ast_node *forInit = parseStatement();
     forInit = checkPadding(forInit);
     m_parser.match(Token::Tokens::SEMICOLON);
@@ -93,7 +94,7 @@ ast_node *StatementParser::forStatement()
     
     ast_node *pop = mkAstLeaf(AST::Types::POPSCOPE, 0, 0, 0);
     tree = mkAstNode(AST::Types::GLUE, tree, NULL, pop, 0, 0, 0);
-    g_symtable.popScope();
+    m_ctx.symtable.popScope();
 
     return tree;
 }
@@ -102,18 +103,18 @@ ast_node *StatementParser::gotoStatement()
 {
     m_scanner.scan();
     m_parser.matchNoScan(Token::Tokens::IDENTIFIER);
-    string labelstr = m_scanner.identifier();
+    Atom labelstr = m_scanner.identAtom();
     m_scanner.scan();
     
-    int id;
+    SymbolId id;
     Symbol sym;
-    if ((id = g_symtable.findSymbol(labelstr)) == -1)
+    if ((id = m_ctx.symtable.findSymbol(labelstr)) == -1)
     {
-        sym = g_symtable.createSymbol(labelstr, 0, SymbolTable::SymTypes::LABEL,
+        sym = m_ctx.symtable.createSymbol(labelstr, 0, SymbolTable::SymTypes::LABEL,
                                       NULLTYPE, 0);
-        id = g_symtable.addToFunction(sym);
+        id = m_ctx.symtable.addToFunction(sym);
     }
-    g_symtable.getSymbol(id)->used = true;
+    m_ctx.symtable.getSymbol(id)->used = true;
     
     ast_node *go = mkAstLeaf(AST::Types::GOTO, id, m_scanner.curLine(), 
                                        m_scanner.curChar());
@@ -128,7 +129,7 @@ bool isLabelStatement(int op)
     return true;
 }
 
-ast_node *StatementParser::parseLabel(string label)
+ast_node *StatementParser::parseLabel(Atom label)
 {
     m_scanner.scan();
     
@@ -138,18 +139,18 @@ ast_node *StatementParser::parseLabel(string label)
         left = NULL;
     
     if (left && !isLabelStatement(left->operation))
-        err.fatal("Label must be placed in front of valid statement\n");
+        m_ctx.errors.fatal("Label must be placed in front of valid statement\n");
     
-    int id;
+    SymbolId id;
     Symbol sym;
-    if ((id = g_symtable.findSymbol(label)) == -1)
+    if ((id = m_ctx.symtable.findSymbol(label)) == -1)
     {
-        sym = g_symtable.createSymbol(label, 0, SymbolTable::SymTypes::LABEL,
+        sym = m_ctx.symtable.createSymbol(label, 0, SymbolTable::SymTypes::LABEL,
                                       NULLTYPE, 0);
-        id = g_symtable.addToFunction(sym);
+        id = m_ctx.symtable.addToFunction(sym);
     }
     
-    Symbol *s = g_symtable.getSymbol(id);
+    Symbol *s = m_ctx.symtable.getSymbol(id);
     s->defined = true;
 
     int l = m_scanner.curLine();
@@ -220,7 +221,7 @@ ast_node *StatementParser::switchStatement()
     m_parser.match(Token::Tokens::L_PAREN);
     expr = m_parser.m_exprParser.parseBinaryOperation(0, NULLTYPE);
     
-    int id = g_symtable.newScope();
+    int id = m_ctx.symtable.newScope();
     ast_node *push = mkAstLeaf(AST::Types::PUSHSCOPE, id, 0, 0);
     expr = mkAstNode(AST::Types::GLUE, expr, NULL, push, 0, 0, 0);
     
@@ -232,7 +233,7 @@ ast_node *StatementParser::switchStatement()
     tree = mkAstNode(AST::Types::SWITCH, expr, NULL, body, 0,
                      m_scanner.curLine(), m_scanner.curChar());
     
-    g_symtable.popScope();
+    m_ctx.symtable.popScope();
     ast_node *pop = mkAstLeaf(AST::Types::POPSCOPE, 0, 0, 0);
     return mkAstNode(AST::Types::GLUE, tree, NULL, pop, 0, 0, 0);
 }
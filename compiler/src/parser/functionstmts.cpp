@@ -1,3 +1,4 @@
+#include <context.h>
 #include <core.h>
 #include <errorhandler.h>
 #include <parser/parser.h>
@@ -16,24 +17,26 @@ vector<Type> extractTypes(vector<Symbol> arguments)
 
 ast_node *StatementParser::returnStatement()
 {
-    Symbol *fsym = g_symtable.getSymbol(g_symtable.currentFuncIdx());
+    Symbol *fsym = m_ctx.symtable.getSymbol(m_ctx.symtable.currentFuncIdx());
 
     m_scanner.scan();
     ast_node *tree = m_parser.m_exprParser.parseBinaryOperation(0,
                                                                        fsym->varType);
     
     if (!tree)
-        err.unknownSymbol(m_scanner.identifier());
+        m_ctx.errors.unknownSymbol(m_scanner.identifier());
     
-    if (tree->type.memSpot)
+    if (tree->memSpot)
     {
         if (!fsym->varType.memSpot)
-            fsym->varType.memSpot = new MemorySpot(tree->type.memSpot, true);
+            fsym->varType.memSpot = new (m_ctx.memTable.globalArena())
+                MemorySpot(tree->memSpot, true);
         
-        fsym->varType.memSpot->setName("the return value of " + fsym->name);
+        fsym->varType.memSpot->setName("the return value of " +
+                                       m_ctx.atoms.str(fsym->name));
     }
     
-    return mkAstUnary(AST::Types::RETURN, tree, g_symtable.currentFuncIdx(),
+    return mkAstUnary(AST::Types::RETURN, tree, m_ctx.symtable.currentFuncIdx(),
                       m_scanner.curLine(), m_scanner.curChar());
 }
 
@@ -44,7 +47,7 @@ void StatementParser::parseVariableArgParam(Symbol *argsym)
     m_parser.match(Token::Tokens::DOT);
 
     if (m_scanner.token().token() != Token::Tokens::R_PAREN)
-        err.expectedToken(Token::Tokens::R_PAREN);
+        m_ctx.errors.expectedToken(Token::Tokens::R_PAREN);
 
     argsym->variableArg = true;
 }
@@ -52,24 +55,25 @@ void StatementParser::parseVariableArgParam(Symbol *argsym)
 ast_node *StatementParser::functionDecl(Type type, int sc)
 {
     int presetFunc = true;
-    int nameIdx    = g_symtable.findSymbol(m_scanner.identifier());
+    SymbolId nameIdx = m_ctx.symtable.findSymbol(m_scanner.identAtom());
 
     if (nameIdx == -1)
     {
-        nameIdx    = g_symtable.addSymbol(m_scanner.identifier(), 0,
+        nameIdx    = m_ctx.symtable.addSymbol(m_scanner.identAtom(), 0,
                                        SymbolTable::SymTypes::FUNCTION, type, sc);
         presetFunc = false;
     }
 
     // Functions can only be declared in global scope
-    if (!g_symtable.isCurrentScopeGlobal())
-        err.fatal("Function '" + g_symtable.getSymbol(nameIdx)->name +
+    if (!m_ctx.symtable.isCurrentScopeGlobal())
+        m_ctx.errors.fatal("Function '" +
+                  m_ctx.atoms.str(m_ctx.symtable.getSymbol(nameIdx)->name) +
                   "' is not "
                   "declared in global scope\nC doesn't allow nested "
                   "functions!");
 
     // Changes every time we parse a new function
-    g_symtable.changeCurFunc(nameIdx);
+    m_ctx.symtable.changeCurFunc(nameIdx);
 
     m_parser.match(Token::Tokens::L_PAREN);
 
@@ -89,19 +93,19 @@ ast_node *StatementParser::functionDecl(Type type, int sc)
         argsym.stackLoc = i;
         if (m_scanner.token().token() == Token::Tokens::DOT)
         {
-            parseVariableArgParam(g_symtable.getSymbol(nameIdx));
+            parseVariableArgParam(m_ctx.symtable.getSymbol(nameIdx));
             break;
         }
 
         argtype = m_parser.parseType();
         if (argtype.typeType == 0)
-            err.unknownType(m_scanner.identifier());
+            m_ctx.errors.unknownType(m_scanner.identifier());
 
-        if (presetFunc && g_symtable.getSymbol(nameIdx)->arguments.size() == i ||
+        if (presetFunc && m_ctx.symtable.getSymbol(nameIdx)->arguments.size() == i ||
             presetFunc && !equalType(argtype,
-                                     g_symtable.getSymbol(nameIdx)->arguments[i]))
+                                     m_ctx.symtable.getSymbol(nameIdx)->arguments[i]))
         {
-            err.fatal("Function was previously declared with different "
+            m_ctx.errors.fatal("Function was previously declared with different "
                       "argument types");
         }
 
@@ -109,7 +113,7 @@ ast_node *StatementParser::functionDecl(Type type, int sc)
 
         if (m_scanner.token().token() == Token::Tokens::IDENTIFIER)
         {
-            argsym.name = m_scanner.identifier();
+            argsym.name = m_scanner.identAtom();
             m_scanner.scan();
             
             if (m_scanner.token().token() == Token::Tokens::L_BRACKET)
@@ -143,16 +147,16 @@ ast_node *StatementParser::functionDecl(Type type, int sc)
 
 noargs:;
 
-    function = g_symtable.getSymbol(nameIdx);
+    function = m_ctx.symtable.getSymbol(nameIdx);
     if (presetFunc && function->arguments.size() != arguments.size())
-        err.fatal("Function was previously declared with different argument "
+        m_ctx.errors.fatal("Function was previously declared with different argument "
                   "types");
 
     m_scanner.scan();
 
     if (!presetFunc)
     {
-        function            = g_symtable.getSymbol(nameIdx);
+        function            = m_ctx.symtable.getSymbol(nameIdx);
         function->arguments = extractTypes(arguments);
     }
 
@@ -162,8 +166,10 @@ noargs:;
     if (m_scanner.token().token() == Token::Tokens::ASM)
         m_scanner.scanUntil(Token::Tokens::SEMICOLON);
 
+    // A declaration, errors after it are in the global scope again
     if (m_scanner.token().token() == Token::Tokens::SEMICOLON)
     {
+        m_ctx.symtable.changeCurFunc(NOSYMBOL);
         return mkAstLeaf(AST::Types::PADDING, 0, m_scanner.curLine(),
                          m_scanner.curChar());
     }
@@ -175,8 +181,11 @@ noargs:;
     }
     
     function->defined = true;
+
+    // The memory spots of the body are released again by popScope()
+    m_ctx.memTable.beginFunction();
     ast_node *body = parseBlock(arguments);
-    ErrorInfo errInfo = err.createErrorInfo();
+    ErrorInfo errInfo = m_ctx.errors.createErrorInfo();
     m_parser.match(Token::Tokens::R_BRACE);
 
     /* Generate the machine code */
@@ -185,15 +194,16 @@ noargs:;
                                            m_scanner.curChar()),
                                 -1, 0);
     
-    err.loadErrorInfo(errInfo);
-    g_symtable.popScope(true, true);
+    m_ctx.errors.loadErrorInfo(errInfo);
+    m_ctx.symtable.popScope(true, true);
+    m_ctx.symtable.changeCurFunc(NOSYMBOL);
     return NULL;
 }
 
 /// @brief  Generates a ast tree for a functioncall
 ast_node *StatementParser::functionCall()
 {
-    int              id;
+    SymbolId         id;
     Symbol *s;   
     ast_node *tree = NULL;
     ast_node *arg  = NULL;
@@ -203,13 +213,13 @@ ast_node *StatementParser::functionCall()
     int              i = -1;
     vector<int> removeMem;
 
-    if ((id = g_symtable.findSymbol(m_scanner.identifier())) == -1)
+    if ((id = m_ctx.symtable.findSymbol(m_scanner.identAtom())) == -1)
     {
-        err.fatal("Function '" + m_scanner.identifier() +
+        m_ctx.errors.fatal("Function '" + m_scanner.identifier() +
                   "' has not yet been declared");
     }
     
-    s = g_symtable.getSymbol(id);
+    s = m_ctx.symtable.getSymbol(id);
     Type returnType = s->varType;
     s->used = true;
     if (returnType.ptrDepth)
@@ -238,39 +248,41 @@ ast_node *StatementParser::functionCall()
     if (m_scanner.token().token() == Token::Token::R_PAREN)
         goto noarg;
 
-    for (i = 0; i < g_symtable.getSymbol(id)->arguments.size(); i++)
+    for (i = 0; i < m_ctx.symtable.getSymbol(id)->arguments.size(); i++)
     {
-        arg = m_parser.m_exprParser.parseBinaryOperation(0, g_symtable.getSymbol(id)->arguments[i]);
+        arg = m_parser.m_exprParser.parseBinaryOperation(0, m_ctx.symtable.getSymbol(id)->arguments[i]);
         if (!arg)
-            err.unknownSymbol(m_scanner.identifier());
+            m_ctx.errors.unknownSymbol(m_scanner.identifier());
         
         if (count(removeMem.begin(), removeMem.end(), i))
         {
-            if (arg->type.memSpot && arg->type.memSpot->references() != -1)
+            if (arg->memSpot && arg->memSpot->references() != -1)
             {
-                int id = arg->type.memSpot->references();
-                g_memTable.findMemorySpot(id)->destroy("");
+                int id = arg->memSpot->references();
+                MemorySpot *ms = m_ctx.memTable.findMemorySpot(id);
+                if (ms)
+                    ms->destroy("");
             }
-            else if (arg->type.memSpot)
+            else if (arg->memSpot)
             {
-                arg->type.memSpot->setAccessGarbage(true);
+                arg->memSpot->setAccessGarbage(true);
             }
             else
             {
-                err.memWarn("Trying to remove non-heap allocated object from heap?");
+                m_ctx.errors.memWarn("Trying to remove non-heap allocated object from heap?");
             }
         }
 #if 0
-        if (arg->type.typeType == TypeTypes::STRUCT && !arg->type.ptrDepth)
+        if (arg->type().typeType == TypeTypes::STRUCT && !arg->type().ptrDepth)
         {
-            for (int j = 0; j < arg->type.contents.size(); j++)
+            for (int j = 0; j < arg->type().contents.size(); j++)
             {
                 int l      = m_scanner.curLine();
                 int c      = m_scanner.curChar();
-                int offset = arg->type.contents[j].offset;
-                type       = arg->type.contents[j].itemType;
+                int offset = arg->type().contents[j].offset;
+                type       = arg->type().contents[j].itemType;
                 off = mkAstLeaf(AST::Types::INTLIT, offset, INTTYPE, l, c);
-                tmp = mkAstNode(AST::Types::ADD, arg, NULL, off, 0, arg->type,
+                tmp = mkAstNode(AST::Types::ADD, arg, NULL, off, 0, arg->typeWithSpot(),
                                 l, c);
                 tmp = mkAstUnary(AST::Types::PTRACCESS, tmp, type.size, type, l,
                                  c);
@@ -285,9 +297,9 @@ ast_node *StatementParser::functionCall()
 
         if (m_scanner.token().token() == Token::Tokens::R_PAREN)
         {
-            if (i < g_symtable.getSymbol(id)->arguments.size() - 1)
-                err.fatal("Expected more parameters to function '" +
-                          g_symtable.getSymbol(id)->name + "'");
+            if (i < m_ctx.symtable.getSymbol(id)->arguments.size() - 1)
+                m_ctx.errors.fatal("Expected more parameters to function '" +
+                          m_ctx.atoms.str(m_ctx.symtable.getSymbol(id)->name) + "'");
             break;
         }
 
@@ -295,24 +307,24 @@ ast_node *StatementParser::functionCall()
     }
 
     if (m_scanner.token().token() != Token::Tokens::R_PAREN &&
-        g_symtable.getSymbol(id)->variableArg)
+        m_ctx.symtable.getSymbol(id)->variableArg)
     {
         for (; i < MAX_ARGUMENTS_TO_FUNCTION; i++)
         {
             arg = m_parser.m_exprParser.parseBinaryOperation(0, NULLTYPE);
             if (!arg)
-                err.unknownSymbol(m_scanner.identifier());
-            if (arg->type.typeType == TypeTypes::STRUCT && !arg->type.ptrDepth)
+                m_ctx.errors.unknownSymbol(m_scanner.identifier());
+            if (arg->type().typeType == TypeTypes::STRUCT && !arg->type().ptrDepth)
             {
-                for (int j = 0; j < arg->type.contents.size(); j++)
+                for (int j = 0; j < arg->type().contents.size(); j++)
                 {
                     int l      = m_scanner.curLine();
                     int c      = m_scanner.curChar();
-                    int offset = arg->type.contents[j].offset;
-                    type       = arg->type.contents[j].itemType;
+                    int offset = arg->type().contents[j].offset;
+                    type       = arg->type().contents[j].itemType;
                     off  = mkAstLeaf(AST::Types::INTLIT, offset, INTTYPE, l, c);
                     tmp  = mkAstNode(AST::Types::ADD, arg, NULL, off, 0,
-                                    arg->type, l, c);
+                                    arg->typeWithSpot(), l, c);
                     tmp  = mkAstUnary(AST::Types::PTRACCESS, tmp, type.size,
                                      type, l, c);
                     tree = mkAstNode(AST::Types::FUNCTIONARGUMENT, tree, NULL,
@@ -330,14 +342,14 @@ ast_node *StatementParser::functionCall()
         }
     }
     else if (m_scanner.token().token() != Token::Tokens::R_PAREN)
-        err.fatal("Too many arguments to function '" +
-                  g_symtable.getSymbol(id)->name + "'");
+        m_ctx.errors.fatal("Too many arguments to function '" +
+                  m_ctx.atoms.str(m_ctx.symtable.getSymbol(id)->name) + "'");
 
 noarg:;
 
-    if (i < (int)g_symtable.getSymbol(id)->arguments.size() - 1)
-        err.fatal("Expected more paramters to funcion '" +
-                  g_symtable.getSymbol(id)->name + "'");
+    if (i < (int)m_ctx.symtable.getSymbol(id)->arguments.size() - 1)
+        m_ctx.errors.fatal("Expected more paramters to funcion '" +
+                  m_ctx.atoms.str(m_ctx.symtable.getSymbol(id)->name) + "'");
 
     m_scanner.scan();
     return mkAstUnary(AST::Types::FUNCTIONCALL, tree, id, returnType,
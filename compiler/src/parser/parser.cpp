@@ -1,15 +1,15 @@
+#include <context.h>
 #include <errorhandler.h>
 #include <parser/parser.h>
 #include <parser/statementparser.h>
 #include <symbols.h>
 #include <types.h>
 
-Parser::Parser(Scanner &scanner, Generator &gen)
-    : m_scanner(scanner), m_generator(gen),
-      m_statementParser(scanner, *this, gen),
-      m_exprParser(scanner, *this, gen)
+Parser::Parser(CompilationContext &ctx, Scanner &scanner, Generator &gen)
+    : m_ctx(ctx), m_scanner(scanner), m_generator(gen),
+      m_statementParser(ctx, scanner, *this, gen),
+      m_exprParser(ctx, scanner, *this, gen)
 {
-    m_scanner = scanner;
 }
 
 ast_node *Parser::_declAggregateType(int tok, string s)
@@ -42,13 +42,11 @@ Type Parser::parseType()
                 
         if (m_scanner.token().token() == Token::Tokens::L_BRACE)
         {
-            t = _declAggregateType(tok)->type;
-            t.memSpot = NULL;
-            return t;
+            return _declAggregateType(tok)->type();
         }
         
     case Token::Tokens::IDENTIFIER:
-        t = g_typeList.getType(m_scanner.identifier());
+        t = m_ctx.typeList.getType(m_scanner.identAtom());
         if (t.typeType == 0)
             return t;
 
@@ -91,7 +89,7 @@ void Parser::match(int tok)
         m_scanner.scan();
 
     else
-        err.expectedToken(tok, m_scanner.token().token());
+        m_ctx.errors.expectedToken(tok, m_scanner.token().token());
 }
 
 void Parser::match(int tok, int tok2)
@@ -100,7 +98,7 @@ void Parser::match(int tok, int tok2)
         m_scanner.scan();
 
     else
-        err.expectedToken(tok, tok2, m_scanner.token().token());
+        m_ctx.errors.expectedToken(tok, tok2, m_scanner.token().token());
 }
 
 void Parser::match(int tok, int tok2, string error)
@@ -109,13 +107,13 @@ void Parser::match(int tok, int tok2, string error)
         m_scanner.scan();
 
     else
-        err.fatal(error);
+        m_ctx.errors.fatal(error);
 }
 
 void Parser::matchNoScan(int tok)
 {
     if (m_scanner.token().token() != tok)
-        err.expectedToken(tok, m_scanner.token().token());
+        m_ctx.errors.expectedToken(tok, m_scanner.token().token());
 }
 
 vector<Attribute> Parser::_parseParen(vector <Attribute> attributes)
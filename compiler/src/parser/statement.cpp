@@ -1,11 +1,12 @@
+#include <context.h>
 #include <errorhandler.h>
 #include <parser/parser.h>
 #include <symbols.h>
 #include <types.h>
 
-StatementParser::StatementParser(Scanner &scanner, Parser &parser,
-                                 Generator &gen)
-    : m_scanner(scanner), m_parser(parser), m_generator(gen)
+StatementParser::StatementParser(CompilationContext &ctx, Scanner &scanner,
+                                 Parser &parser, Generator &gen)
+    : m_ctx(ctx), m_scanner(scanner), m_parser(parser), m_generator(gen)
 {
 }
 
@@ -37,13 +38,13 @@ ast_node *StatementParser::parseTypedef()
     {
         m_scanner.scan();
         if (m_scanner.token().token() == Token::Tokens::L_BRACE)
-            t = m_parser._declAggregateType(tok, ident)->type;
+            t = m_parser._declAggregateType(tok, ident)->typeWithSpot();
         else
-            err.unknownType(ident);
+            m_ctx.errors.unknownType(ident);
     }
 
-    t.name = new string(m_scanner.identifier());
-    g_typeList.addType(t);
+    t.name = m_scanner.identAtom();
+    m_ctx.typeList.addType(t);
 
     m_scanner.scan();
 
@@ -54,7 +55,7 @@ ast_node *StatementParser::parseTypedef()
     if (m_scanner.token().token() == Token::Tokens::L_PAREN || 
         m_scanner.token().token() == Token::Tokens::ATTRIBUTE)
     {
-        err.warning("Sorry unimplemented");
+        m_ctx.errors.warning("Sorry unimplemented");
         m_scanner.scanUntil(Token::Tokens::SEMICOLON);
     }
 
@@ -115,7 +116,7 @@ loop:;
         node = returnStatement();
         break;
     case Token::Tokens::T_EOF:
-        err.fatal("EOF read while block was not terminated with a '}'");
+        m_ctx.errors.fatal("EOF read while block was not terminated with a '}'");
 
     case Token::Tokens::R_BRACE:
         break;
@@ -128,14 +129,14 @@ loop:;
         if (parentTok == Token::Tokens::SWITCH)
             node = switchCaseStatement();
         else
-            err.fatal("Case labels are only allowed inside switch statements");
+            m_ctx.errors.fatal("Case labels are only allowed inside switch statements");
         break;
     
     case Token::Tokens::DEFAULT:
         if (parentTok == Token::Tokens::SWITCH)
             node = switchDefaultStatement();
         else
-            err.fatal("Default labels are only allowed inside switch statements");
+            m_ctx.errors.fatal("Default labels are only allowed inside switch statements");
         break;
     
     case Token::Tokens::CONTINUE:
@@ -184,7 +185,7 @@ loop:;
                 break;
             }
 
-            err.unknownType(m_scanner.identifier());
+            m_ctx.errors.unknownType(m_scanner.identifier());
         }
         
 
@@ -215,7 +216,7 @@ loop:;
             break;
         }
         
-        string ident = m_scanner.identifier();
+        Atom ident = m_scanner.identAtom();
         m_scanner.scan();
         if (m_scanner.token().token() == Token::Tokens::COLON)
         {
@@ -223,7 +224,7 @@ loop:;
             break;
         }
         
-        err.unknownSymbol(ident);
+        m_ctx.errors.unknownSymbol(m_ctx.atoms.str(ident));
     }
 
     if (node && node->operation != AST::Types::PADDING)
@@ -265,7 +266,7 @@ ast_node *StatementParser::_parseBlock(int parentOp, ast_node *left)
         // Padding nodes shouldn't be added to the ast tree
         if (tree && tree->operation == AST::Types::PADDING)
         {
-            delete tree;
+            freeAstNode(tree);
             tree = NULL;
         }
 
@@ -292,14 +293,14 @@ ast_node *StatementParser::parseBlock(vector<Symbol> arguments)
     /* Each block should start with a { */
     m_parser.match(Token::Tokens::L_BRACE);
 
-    g_symtable.newScope();
+    m_ctx.symtable.newScope();
 
     for (Symbol s : arguments)
     {
         if (!s.varType.memSpot)
             s.varType.memSpot = new MemorySpot();
         s.varType.memSpot->goodValues();
-        g_symtable.pushSymbol(s);
+        m_ctx.symtable.pushSymbol(s);
     }
 
     ast_node *tree = _parseBlock();
@@ -328,7 +329,7 @@ ast_node *StatementParser::parseBlock(int parentOp, bool newScope)
     
     if (newScope)
     {
-        id = g_symtable.newScope();
+        id = m_ctx.symtable.newScope();
         tree = mkAstLeaf(AST::Types::PUSHSCOPE, id, 0, 0);
     }
     
@@ -337,7 +338,7 @@ ast_node *StatementParser::parseBlock(int parentOp, bool newScope)
     
     if (newScope)
     {
-        g_symtable.popScope();
+        m_ctx.symtable.popScope();
         ast_node *pop = mkAstLeaf(AST::Types::POPSCOPE, 0, 0, 0);
         tree = mkAstNode(AST::Types::GLUE, tree, NULL, pop, 0, 0, 0);
     }
@@ -1,4 +1,5 @@
 #include <config.h>
+#include <context.h>
 #include <errorhandler.h>
 #include <parser/parser.h>
 #include <symbols.h>
@@ -36,22 +37,23 @@ ast_node *StatementParser::parseArrayInit(Type   type,
         {
             if (arraySize != MAX_ARRAY_INIT && i > sym.value)
             {
-                err.warning("Initializer overflow");
+                m_ctx.errors.warning("Initializer overflow");
                 continue;
             }
 
             right = m_parser.m_exprParser.parseBinaryOperation(0, type);
 
-            if (g_symtable.isCurrentScopeGlobal())
+            if (m_ctx.symtable.isCurrentScopeGlobal())
             {
                 if (right->operation == AST::Types::INTLIT)
                     sym.inits.push_back(to_string(right->value));
 
                 else if (right->operation == AST::Types::IDENTIFIER)
-                    sym.inits.push_back(g_symtable.getSymbol(right->value)->name);
+                    sym.inits.push_back(
+                        m_ctx.atoms.str(m_ctx.symtable.getSymbol(right->value)->name));
 
                 else
-                    err.fatal("Global array does not support initializer");
+                    m_ctx.errors.fatal("Global array does not support initializer");
             }
             else
             {
@@ -70,11 +72,11 @@ ast_node *StatementParser::parseArrayInit(Type   type,
             else if (tok == Token::Tokens::R_BRACE)
                 break;
             else
-                err.unexpectedToken(Token::Tokens::COMMA);
+                m_ctx.errors.unexpectedToken(Token::Tokens::COMMA);
         }
 
         if (tok == Token::Tokens::COMMA)
-            err.fatal("Initializers overflow, expected " +
+            m_ctx.errors.fatal("Initializers overflow, expected " +
                       to_string(arraySize) + " initializers");
 
         // Reversing the array in memory
@@ -82,31 +84,31 @@ ast_node *StatementParser::parseArrayInit(Type   type,
 
         while (tmp != NULL)
         {
-            tmp->value = (sym.value - 1 - tmp->value) * (tmp->type.size);
+            tmp->value = (sym.value - 1 - tmp->value) * (tmp->type().size);
             tmp        = tmp->left;
         }
 
-        int id       = g_symtable.pushSymbol(sym);
+        SymbolId id  = m_ctx.symtable.pushSymbol(sym);
         ident->value = id;
     }
     else if (m_scanner.token().token() == Token::Tokens::STRINGLIT)
     {
         right = m_parser.m_exprParser.parseBinaryOperation(0, sym.varType);
-        Symbol *init = g_symtable.getSymbol(right->value);
+        Symbol *init = m_ctx.symtable.getSymbol(right->value);
 
         if (sym.value == -1)
             sym.value = init->value;
 
         else if (sym.value < init->value)
-            err.warning("String overflows array initializers");
+            m_ctx.errors.warning("String overflows array initializers");
 
         // Just reset the string name etc
-        init->name    = sym.name;
+        m_ctx.symtable.renameSymbol(right->value, sym.name);
         init->varType = sym.varType;
         init->value   = sym.value;
     }
     else
-        err.fatal("Invalid initializer");
+        m_ctx.errors.fatal("Invalid initializer");
 
     return mkAstUnary(AST::Types::INITIALIZER, tree, 0, m_scanner.curLine(),
                       m_scanner.curChar());
@@ -117,14 +119,14 @@ ast_node *StatementParser::parseVarInit(Type   type,
 {
     ast_node *tree;
     ast_node *right;
-    int id;
+    SymbolId id;
     
     // Apparently the ISO c standard has no problem with this
     #if 0
     if (m_scanner.token().token() == Token::Tokens::STRINGLIT ||
         m_scanner.token().token() == Token::Tokens::L_BRACE)
     {
-        err.fatal("Invalid initializer")
+        m_ctx.errors.fatal("Invalid initializer")
     }
     
     #endif
@@ -132,25 +134,25 @@ ast_node *StatementParser::parseVarInit(Type   type,
     right = m_parser.m_exprParser.parseBinaryOperation(0, type);
 
     if (!right)
-        err.unknownSymbol(m_scanner.identifier());
+        m_ctx.errors.unknownSymbol(m_scanner.identifier());
         
     if (right->operation == AST::Types::INTLIT)
     {
         if (right->value == 0)
-            right->type.memSpot->setNullInit(true);
-        if (g_symtable.isCurrentScopeGlobal())
+            right->memSpot->setNullInit(true);
+        if (m_ctx.symtable.isCurrentScopeGlobal())
         {
             // Simply set it as a initializer value in the symbol table
             sym.value = right->value;
-            g_symtable.pushSymbol(sym);
+            m_ctx.symtable.pushSymbol(sym);
             return mkAstLeaf(AST::Types::PADDING, 0, type, 0, 0);
         }
     }
 
-    if (right->type.memSpot)
-        sym.varType.memSpot->addReferencingTo(right->type.memSpot, right->operation);   
+    if (right->memSpot)
+        sym.varType.memSpot->addReferencingTo(right->memSpot, right->operation);   
 
-    id   = g_symtable.pushSymbol(sym);
+    id   = m_ctx.symtable.pushSymbol(sym);
     tree = mkAstLeaf(AST::Types::IDENTIFIER, id, type, right->line, right->c);
 
     return mkAstNode(AST::Types::ASSIGN, tree, NULL, right, 0, type, right->line,
@@ -175,14 +177,15 @@ ast_node *StatementParser::variableDecl(Type type, int sc)
     type.memSpot->setName(m_scanner.identifier());
 
     Symbol s;
-    s.name         = m_scanner.identifier();
+    s.name         = m_scanner.identAtom();
     s.varType      = type;
     s.storageClass = sc;
     s.used = false;
     s.defined = false;
 
-    if (g_symtable.findInCurrentScope(s.name) != -1)
-        err.fatal("Redefinition of symbol " + HL("'" + s.name + "'"));
+    if (m_ctx.symtable.findInCurrentScope(s.name) != -1)
+        m_ctx.errors.fatal("Redefinition of symbol " +
+                  HL("'" + m_ctx.atoms.str(s.name) + "'"));
 
     if (m_scanner.token().token() == Token::Tokens::L_BRACKET)
     {
@@ -211,10 +214,10 @@ ast_node *StatementParser::variableDecl(Type type, int sc)
     {
         if (s.varType.isArray && s.value == -1 && 
             sc != SymbolTable::StorageClass::EXTERN)
-            err.fatal("Cannot declare array without size specifier and "
+            m_ctx.errors.fatal("Cannot declare array without size specifier and "
                       "initializer");
 
-        g_symtable.pushSymbol(s);
+        m_ctx.symtable.pushSymbol(s);
 
         return mkAstLeaf(AST::Types::PADDING, 0, type, 0, 0);
     }
@@ -226,11 +229,11 @@ ast_node *StatementParser::variableDecl(Type type, int sc)
         s.defined = true;
 
         if (sc == SymbolTable::StorageClass::EXTERN &&
-            !g_symtable.isCurrentScopeGlobal())
-            err.fatal("Has both 'extern' and initializer");
+            !m_ctx.symtable.isCurrentScopeGlobal())
+            m_ctx.errors.fatal("Has both 'extern' and initializer");
 
         else if (sc == SymbolTable::StorageClass::EXTERN)
-            err.warning("Has both 'extern' and initializer");
+            m_ctx.errors.warning("Has both 'extern' and initializer");
 
         if (s.varType.isArray)
         {
@@ -265,10 +268,10 @@ ast_node *StatementParser::variableAssignment(ast_node *lvalue)
     int l = lvalue->line;
     int c = lvalue->c;
     
-    right = m_parser.m_exprParser.parseBinaryOperation(0, lvalue->type);
+    right = m_parser.m_exprParser.parseBinaryOperation(0, lvalue->typeWithSpot());
 
     ast_node *tree = mkAstNode(AST::Types::ASSIGN, lvalue, NULL, right, 0,
-                                      lvalue->type, m_scanner.curLine(),
+                                      lvalue->typeWithSpot(), m_scanner.curLine(),
                                       m_scanner.curChar());
     return tree;
 }
\ No newline at end of file
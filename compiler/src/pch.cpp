@@ -0,0 +1,341 @@
+#include <compilecache.h>
+#include <context.h>
+#include <errorhandler.h>
+#include <pch.h>
+#include <preprocessor.h>
+#include <safecc.h>
+
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Bump when the layout of the file changes */
+#define PCH_MAGIC "SCCPCH1"
+
+void PchWriter::str(const string &s)
+{
+    u32(s.size());
+    m_data += s;
+}
+
+void PchWriter::atom(Atom atom)
+{
+    str(g_atoms.str(atom));
+}
+
+void PchWriter::addStruct(const StructDef *def)
+{
+    int id = m_structIds.size();
+    m_structIds.emplace(def, id);
+}
+
+void PchWriter::type(const Type &t)
+{
+    auto def = m_structIds.find(t.contents.def());
+
+    i64(t.primType);
+    u32(t.isSigned);
+    i64(t.size);
+    i64(t.ptrDepth);
+    atom(t.name);
+    i64(t.typeType);
+    u32(t.isArray);
+    i64(def == m_structIds.end() ? -1 : def->second);
+    u32(t.incomplete);
+
+    // Declarations only leave fresh spots behind, their state is all we need
+    u32(t.memSpot != NULL);
+    if (t.memSpot)
+    {
+        str(t.memSpot->name());
+        u32(t.memSpot->isInit());
+        u32(t.memSpot->isNullInit());
+    }
+}
+
+void PchReader::read(void *buf, size_t size)
+{
+    if (!m_ok || size > (size_t)(m_end - m_pos))
+    {
+        m_ok = false;
+        memset(buf, 0, size);
+        return;
+    }
+
+    memcpy(buf, m_pos, size);
+    m_pos += size;
+}
+
+uint32_t PchReader::u32()
+{
+    uint32_t v;
+    read(&v, sizeof(v));
+    return v;
+}
+
+int64_t PchReader::i64()
+{
+    int64_t v;
+    read(&v, sizeof(v));
+    return v;
+}
+
+/// @brief  Every element takes at least a byte, a bigger count means the file
+///         is damaged
+uint32_t PchReader::count()
+{
+    uint32_t n = u32();
+    if (n > (size_t)(m_end - m_pos))
+        m_ok = false;
+
+    return m_ok ? n : 0;
+}
+
+string PchReader::str()
+{
+    uint32_t len = count();
+    string   s(m_pos, len);
+    m_pos += len;
+    return s;
+}
+
+Atom PchReader::atom()
+{
+    return g_atoms.intern(str());
+}
+
+Type PchReader::type()
+{
+    Type t;
+    t.primType   = i64();
+    t.isSigned   = u32();
+    t.size       = i64();
+    t.ptrDepth   = i64();
+    t.name       = atom();
+    t.typeType   = i64();
+    t.isArray    = u32();
+    int64_t def  = i64();
+    t.incomplete = u32();
+
+    if (def >= (int64_t) m_structs.size())
+        m_ok = false;
+    else if (def >= 0)
+        t.contents = StructMembers(m_structs[def]);
+
+    if (u32() && m_ok)
+    {
+        t.memSpot = new (g_memTable.globalArena()) MemorySpot(str());
+        t.memSpot->setIsInit(u32());
+        t.memSpot->setNullInit(u32());
+    }
+
+    return t;
+}
+
+/// @brief  The options that change what a header leaves behind
+static string optionsKey(const CompileOptions &options)
+{
+    string key = options.noMemoryChecking ? "nomemcheck" : "";
+    for (const string &dir : options.includeDirs)
+        key += "\n-I" + dir;
+    for (const string &define : options.defines)
+        key += "\n-D" + define;
+
+    return key;
+}
+
+PrecompiledHeader::~PrecompiledHeader()
+{
+    if (m_map)
+        munmap((void *) m_map, m_size);
+}
+
+/// @brief  Maps a precompiled header, every file is only mapped once per
+///         process (until it changes on disk)
+shared_ptr<const PrecompiledHeader> PrecompiledHeader::open(const string &path)
+{
+    static mutex lock;
+    static unordered_map<string, pair<string, shared_ptr<PrecompiledHeader>>>
+        loaded;
+
+    string            identity = fileIdentity(path);
+    lock_guard<mutex> guard(lock);
+
+    auto it = loaded.find(path);
+    if (it != loaded.end() && it->second.first == identity)
+        return it->second.second;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        g_err.fatalNL("Unable to open precompiled header " + HL(path));
+
+    struct stat st;
+    fstat(fd, &st);
+
+    shared_ptr<PrecompiledHeader> pch(new PrecompiledHeader());
+    pch->m_size = st.st_size;
+    void *map   = mmap(NULL, pch->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        g_err.fatalNL("Unable to map precompiled header " + HL(path));
+
+    pch->m_map = (const char *) map;
+
+    // Another compiler may lay out the rest differently, only the header
+    // it was made from is read then
+    PchReader in(pch->m_map, pch->m_size);
+    char      magic[sizeof(PCH_MAGIC)];
+    in.read(magic, sizeof(magic));
+    bool valid      = in.ok() && !memcmp(magic, PCH_MAGIC, sizeof(magic));
+    pch->m_header   = in.str();
+    pch->m_compiler = in.str();
+
+    if (valid && pch->m_compiler == compilerIdentity())
+    {
+        pch->m_options = in.str();
+
+        pch->m_dependencies.resize(in.count());
+        for (Dependency &dep : pch->m_dependencies)
+        {
+            dep.path  = in.str();
+            dep.size  = in.i64();
+            dep.mtime = in.i64();
+        }
+
+        pch->m_macros = in.str();
+
+        pch->m_included.resize(in.count());
+        for (Included &inc : pch->m_included)
+        {
+            inc.path       = in.str();
+            inc.dirIdx     = in.i64();
+            inc.pragmaOnce = in.u32();
+            inc.guard      = in.str();
+        }
+
+        pch->m_declarations = in.pos() - pch->m_map;
+    }
+
+    if (!valid || !in.ok())
+        g_err.fatalNL(HL(path) + " is not a precompiled header");
+
+    loaded[path] = {identity, pch};
+    return pch;
+}
+
+static int64_t modificationTime(const struct stat &st)
+{
+    return st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+}
+
+/// @brief  False if the compiler, the options or one of the headers changed
+///         since the precompiled header was made
+bool PrecompiledHeader::usable(const CompileOptions &options) const
+{
+    if (m_compiler != compilerIdentity() || options.preprocessor.size() ||
+        m_options != optionsKey(options))
+        return false;
+
+    for (const Dependency &dep : m_dependencies)
+    {
+        struct stat st;
+        if (stat(dep.path.c_str(), &st) || st.st_size != dep.size ||
+            modificationTime(st) != dep.mtime)
+            return false;
+    }
+
+    return true;
+}
+
+/// @brief  Defines the macros of the header and makes the files it included
+///         known, so their guards skip them without reading them
+void PrecompiledHeader::restoreMacros(Preprocessor &pp) const
+{
+    pp.restoreMacros(m_macros);
+    for (const Included &inc : m_included)
+        pp.restoreFile(inc.path, inc.dirIdx, inc.pragmaOnce,
+                       inc.guard.size() ? g_atoms.intern(inc.guard) : NOATOM);
+}
+
+void PrecompiledHeader::restoreDeclarations(CompilationContext &ctx) const
+{
+    PchReader in(m_map + m_declarations, m_size - m_declarations);
+    ctx.typeList.restore(in);
+    ctx.symtable.restoreGlobals(in);
+
+    if (!in.ok())
+        g_err.fatalNL("The precompiled header of " + HL(m_header) +
+                      " is damaged");
+}
+
+/// @brief  Saves what the preprocessor and the parser were left with after
+///         the header, which must only declare things
+void PrecompiledHeader::write(const string &path, const string &header,
+                              const CompileOptions &options, Preprocessor &pp,
+                              CompilationContext &ctx)
+{
+    for (SymbolId id : ctx.symtable.getGlobalTable())
+    {
+        Symbol *s = ctx.symtable.getSymbol(id);
+        if (s->symType == SymbolTable::SymTypes::FUNCTION && s->defined)
+            g_err.fatalNL("Function " + HL(ctx.atoms.str(s->name)) +
+                          " is defined in " + HL(header) +
+                          ", a precompiled header can only declare functions");
+    }
+
+    PchWriter out;
+    out.str(header);
+    out.str(compilerIdentity());
+    out.str(optionsKey(options));
+
+    vector<const PPFile *> files;
+    for (const PPFile &file : pp.files())
+    {
+        // Skip <built-in>, <command-line> and the like
+        if (file.path.size() && file.path[0] != '<' && !file.stub)
+            files.push_back(&file);
+    }
+
+    out.u32(files.size());
+    for (const PPFile *file : files)
+    {
+        struct stat st;
+        if (stat(file->path.c_str(), &st))
+            g_err.fatalNL("Could not stat " + HL(file->path));
+
+        out.str(file->path);
+        out.i64(st.st_size);
+        out.i64(modificationTime(st));
+    }
+
+    out.str(pp.macroDefinitions());
+
+    out.u32(files.size());
+    for (const PPFile *file : files)
+    {
+        out.str(file->path);
+        out.i64(file->dirIdx);
+        out.u32(file->pragmaOnce);
+        out.str(file->guard ? ctx.atoms.str(file->guard) : "");
+    }
+
+    ctx.typeList.save(out);
+    ctx.symtable.saveGlobals(out);
+
+    // Compilations may have the old file mapped, it is replaced instead of
+    // being overwritten
+    string tmp = path + ".tmp" + to_string(getpid());
+    FILE  *f   = fopen(tmp.c_str(), "wb");
+    if (f == NULL)
+        g_err.fatalNL("Could not open file: '" + path + "'");
+
+    bool ok = fwrite(PCH_MAGIC, sizeof(PCH_MAGIC), 1, f) == 1 &&
+              fwrite(out.data().data(), 1, out.data().size(), f) ==
+                  out.data().size();
+    if (fclose(f) || !ok || rename(tmp.c_str(), path.c_str()))
+    {
+        unlink(tmp.c_str());
+        g_err.fatalNL("Could not write file: '" + path + "'");
+    }
+}
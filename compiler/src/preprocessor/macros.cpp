@@ -0,0 +1,452 @@
+#include <context.h>
+#include <core.h>
+#include <errorhandler.h>
+#include <preprocessor.h>
+
+/*
+ * Macro expansion follows Prosser's algorithm: every token remembers the
+ * macros it came from (its hide set) and never expands one of those again.
+ * Expanded tokens are pushed back on the input, so rescanning is just
+ * reading on.
+ */
+
+bool Preprocessor::hideSetHas(const HideSet *hs, Atom name)
+{
+    for (; hs; hs = hs->next)
+        if (hs->name == name)
+            return true;
+
+    return false;
+}
+
+const HideSet *Preprocessor::hideSetAdd(const HideSet *hs, Atom name)
+{
+    if (hideSetHas(hs, name))
+        return hs;
+
+    m_hideSets.push_back({name, hs});
+    return &m_hideSets.back();
+}
+
+const HideSet *Preprocessor::hideSetUnion(const HideSet *a, const HideSet *b)
+{
+    for (; a; a = a->next)
+        b = hideSetAdd(b, a->name);
+
+    return b;
+}
+
+const HideSet *Preprocessor::hideSetIntersect(const HideSet *a,
+                                              const HideSet *b)
+{
+    const HideSet *ret = NULL;
+    for (; a; a = a->next)
+        if (hideSetHas(b, a->name))
+            ret = hideSetAdd(ret, a->name);
+
+    return ret;
+}
+
+bool Preprocessor::isDefined(Atom name)
+{
+    return m_macros.count(name) || name == m_file || name == m_line ||
+           name == m_counter || name == m_includeLevel ||
+           name == m_hasInclude || name == m_hasIncludeNext;
+}
+
+PPToken Preprocessor::numberToken(int64_t value, const PPToken &pos)
+{
+    return makeToken(to_string(value), pos);
+}
+
+void Preprocessor::defineMacro(vector<PPToken> &line, const PPToken &hash)
+{
+    if (line.size() < 2 || line[1].kind != PP_IDENT)
+        error(hash, "Macro name expected after #define");
+
+    Macro  m;
+    Atom   name = line[1].ident;
+    size_t i    = 2;
+
+    // A function like macro has its '(' right after the name
+    if (i < line.size() && line[i].is("(") && !line[i].space)
+    {
+        m.funcLike = true;
+        for (i++; i < line.size() && !line[i].is(")"); i++)
+        {
+            if (line[i].is(","))
+                continue;
+
+            if (line[i].is("..."))
+            {
+                m.variadic = true;
+                m.params.push_back(m_vaArgs);
+            }
+            else if (line[i].kind == PP_IDENT)
+            {
+                m.params.push_back(line[i].ident);
+
+                // GNU named variadic parameter: 'args...'
+                if (i + 1 < line.size() && line[i + 1].is("..."))
+                {
+                    m.variadic = true;
+                    i++;
+                }
+            }
+            else
+                error(hash, "Invalid macro parameter list");
+        }
+
+        if (i == line.size())
+            error(hash, "Missing ')' in macro parameter list");
+        i++;
+    }
+
+    m.body.assign(line.begin() + i, line.end());
+    if (m.body.size())
+        m.body[0].space = false;
+
+    m_macros[name] = move(m);
+}
+
+/// @brief  Replaces 'defined X' and 'defined(X)' with 1 or 0, as well as
+///         __has_include(...)
+void Preprocessor::resolveDefined(vector<PPToken> &toks)
+{
+    vector<PPToken> out;
+    for (size_t i = 0; i < toks.size(); i++)
+    {
+        const PPToken &tok = toks[i];
+
+        if (tok.ident == m_defined)
+        {
+            bool paren = i + 1 < toks.size() && toks[i + 1].is("(");
+            size_t id  = i + 1 + paren;
+            if (id >= toks.size() || toks[id].kind != PP_IDENT)
+                error(tok, "Macro name expected after 'defined'");
+
+            out.push_back(numberToken(isDefined(toks[id].ident), tok));
+            i = id + paren;
+        }
+        else if (tok.ident == m_hasInclude || tok.ident == m_hasIncludeNext)
+        {
+            size_t end = i + 1;
+            while (end < toks.size() && !toks[end].is(")"))
+                end++;
+
+            if (i + 1 >= toks.size() || !toks[i + 1].is("(") ||
+                end == toks.size())
+                error(tok, "Malformed " + HL(g_atoms.str(tok.ident)));
+
+            // Reuse the #include name parsing, it skips the first token
+            vector<PPToken> name(toks.begin() + i + 1, toks.begin() + end);
+            bool            quoted = false;
+            string          file   = includeName(name, quoted, tok);
+
+            PPFile *cur      = m_includeStack.back().file;
+            int     startDir = 0;
+            if (tok.ident == m_hasIncludeNext && cur->dirIdx >= 0)
+                startDir = cur->dirIdx + 1;
+
+            bool found = findInclude(file, quoted, startDir, cur) != NULL;
+            out.push_back(numberToken(found, tok));
+            i = end;
+        }
+        else
+            out.push_back(tok);
+    }
+
+    toks.swap(out);
+}
+
+/// @brief  __FILE__, __LINE__ and friends
+bool Preprocessor::expandBuiltin(PPToken &tok)
+{
+    PPToken ret;
+
+    if (tok.ident == m_file)
+        ret = makeToken("\"" + *m_includeStack.back().path + "\"", tok);
+    else if (tok.ident == m_line)
+        ret = numberToken(presumedLine(tok), tok);
+    else if (tok.ident == m_counter)
+        ret = numberToken(m_counterValue++, tok);
+    else if (tok.ident == m_includeLevel)
+        ret = numberToken(m_includeStack.size() - 1, tok);
+    else
+        return false;
+
+    unread(ret);
+    return true;
+}
+
+/// @brief  Fully expands a list of tokens on its own (macro arguments and
+///         #if lines)
+vector<PPToken> Preprocessor::expandAll(vector<PPToken> tokens)
+{
+    vector<PPToken> saved;
+    saved.swap(m_pending);
+
+    PPToken eof;
+    eof.text = "";
+    eof.len  = 0;
+    eof.kind = PP_EOF;
+    m_pending.push_back(eof);
+    m_pending.insert(m_pending.end(), tokens.rbegin(), tokens.rend());
+
+    vector<PPToken> out;
+    for (;;)
+    {
+        PPToken tok = readRaw();
+        if (tok.kind == PP_EOF)
+            break;
+
+        if (tok.kind == PP_IDENT && expandMacro(tok))
+            continue;
+
+        out.push_back(tok);
+    }
+
+    m_pending.swap(saved);
+    return out;
+}
+
+PPToken Preprocessor::stringize(const vector<PPToken> &arg, const PPToken &pos)
+{
+    string s = "\"";
+    for (size_t i = 0; i < arg.size(); i++)
+    {
+        const PPToken &tok = arg[i];
+        if (i && tok.space)
+            s += ' ';
+
+        if (tok.kind == PP_STRING || tok.kind == PP_CHAR)
+        {
+            for (int j = 0; j < tok.len; j++)
+            {
+                if (tok.text[j] == '"' || tok.text[j] == '\\')
+                    s += '\\';
+                s += tok.text[j];
+            }
+        }
+        else
+            s.append(tok.text, tok.len);
+    }
+    s += "\"";
+
+    return makeToken(s, pos);
+}
+
+PPToken Preprocessor::paste(const PPToken &l, const PPToken &r)
+{
+    return makeToken(string(l.text, l.len) + string(r.text, r.len), l);
+}
+
+static int paramIndex(const Macro &m, const PPToken &tok)
+{
+    if (tok.kind != PP_IDENT)
+        return -1;
+
+    for (size_t i = 0; i < m.params.size(); i++)
+        if (m.params[i] == tok.ident)
+            return i;
+
+    return -1;
+}
+
+/// @brief  Appends the tokens of an argument, the first one takes over the
+///         spacing of the parameter it replaces
+static void appendArg(vector<PPToken> &out, const vector<PPToken> &arg,
+                      const PPToken &param)
+{
+    size_t start = out.size();
+    out.insert(out.end(), arg.begin(), arg.end());
+    if (out.size() > start)
+        out[start].space = param.space;
+}
+
+/// @brief  Replaces the parameters in the macro body, handles # and ##
+vector<PPToken> Preprocessor::substitute(Atom name, const Macro &m,
+                                         vector<vector<PPToken>> &args,
+                                         const PPToken &invocation)
+{
+    const vector<PPToken> &body = m.body;
+    vector<PPToken>        out;
+    int                    vaIdx = m.variadic ? m.params.size() - 1 : -1;
+
+    for (size_t i = 0; i < body.size(); i++)
+    {
+        const PPToken &tok = body[i];
+        bool pasteNext     = i + 1 < body.size() && body[i + 1].is("##");
+
+        // #param
+        if (tok.is("#") && i + 1 < body.size() &&
+            paramIndex(m, body[i + 1]) != -1)
+        {
+            out.push_back(stringize(args[paramIndex(m, body[i + 1])], tok));
+            i++;
+            continue;
+        }
+
+        // GNU: ', ## __VA_ARGS__' drops the comma without variadic arguments
+        if (tok.is(",") && pasteNext && i + 2 < body.size() && vaIdx != -1 &&
+            paramIndex(m, body[i + 2]) == vaIdx)
+        {
+            if (args[vaIdx].size())
+            {
+                out.push_back(tok);
+                appendArg(out, args[vaIdx], body[i + 2]);
+            }
+            i += 2;
+            continue;
+        }
+
+        // lhs ## rhs, the lhs is already in out
+        if (tok.is("##") && i + 1 < body.size())
+        {
+            const PPToken &rhs = body[++i];
+            int            p   = paramIndex(m, rhs);
+
+            if (p != -1 && args[p].empty())
+                continue;
+
+            const PPToken &first = p != -1 ? args[p][0] : rhs;
+            if (out.empty())
+                out.push_back(first);
+            else
+                out.back() = paste(out.back(), first);
+
+            if (p != -1)
+                out.insert(out.end(), args[p].begin() + 1, args[p].end());
+            continue;
+        }
+
+        int p = paramIndex(m, tok);
+        if (p == -1)
+        {
+            out.push_back(tok);
+            continue;
+        }
+
+        // An operand of ## isn't expanded
+        if (pasteNext)
+        {
+            if (args[p].empty())
+            {
+                // Pasting with an empty argument results in the rhs, skip
+                // the ## and let the rhs go through normally
+                i++;
+                if (i + 1 < body.size())
+                {
+                    const PPToken &rhs = body[++i];
+                    int            rp  = paramIndex(m, rhs);
+                    if (rp == -1)
+                        out.push_back(rhs);
+                    else
+                        appendArg(out, args[rp], rhs);
+                }
+            }
+            else
+                appendArg(out, args[p], tok);
+            continue;
+        }
+
+        appendArg(out, expandAll(args[p]), tok);
+    }
+
+    return out;
+}
+
+/// @brief  Expands the macro tok names (if it does), the result is pushed
+///         back on the input. Returns false if tok isn't expanded.
+bool Preprocessor::expandMacro(PPToken &tok)
+{
+    if (hideSetHas(tok.hide, tok.ident))
+        return false;
+
+    auto it = m_macros.find(tok.ident);
+    if (it == m_macros.end())
+        return expandBuiltin(tok);
+
+    const Macro   &m    = it->second;
+    Atom           name = tok.ident;
+    const HideSet *hs;
+    vector<PPToken> out;
+
+    if (!m.funcLike)
+    {
+        // The body of an object like macro can paste tokens as well
+        vector<vector<PPToken>> noArgs;
+        hs  = hideSetAdd(tok.hide, name);
+        out = substitute(name, m, noArgs, tok);
+    }
+    else
+    {
+        PPToken next = readRaw();
+        if (!next.is("("))
+        {
+            unread(next);
+            return false;
+        }
+
+        vector<vector<PPToken>> args(1);
+        int                     depth = 0;
+        PPToken                 arg;
+
+        for (;;)
+        {
+            arg = readRaw();
+            if (arg.kind == PP_EOF)
+                error(tok, "Unterminated argument list invoking macro " +
+                               HL(g_atoms.str(name)));
+
+            if (arg.is(")") && !depth)
+                break;
+
+            if (arg.is("("))
+                depth++;
+            else if (arg.is(")"))
+                depth--;
+            else if (arg.is(",") && !depth &&
+                     !(m.variadic && args.size() == m.params.size()))
+            {
+                args.emplace_back();
+                continue;
+            }
+
+            args.back().push_back(arg);
+        }
+
+        // FOO() passes one empty argument
+        if (m.params.empty() && args.size() == 1 && args[0].empty())
+            args.clear();
+
+        // The variadic arguments may be left out completely
+        if (m.variadic && args.size() + 1 == m.params.size())
+            args.emplace_back();
+
+        if (args.size() != m.params.size())
+            error(tok, "Macro " + HL(g_atoms.str(name)) + " expects " +
+                           to_string(m.params.size()) + " arguments, got " +
+                           to_string(args.size()));
+
+        hs  = hideSetAdd(hideSetIntersect(tok.hide, arg.hide), name);
+        out = substitute(name, m, args, tok);
+    }
+
+    for (size_t i = 0; i < out.size(); i++)
+    {
+        PPToken &t = out[i];
+        t.hide     = hideSetUnion(t.hide, hs);
+        t.file     = tok.file;
+        t.line     = tok.line;
+        t.col      = tok.col;
+        t.bol      = false;
+        t.expanded = true;
+    }
+
+    if (out.size())
+        out[0].space = tok.space;
+
+    m_pending.insert(m_pending.end(), out.rbegin(), out.rend());
+    return true;
+}
@@ -0,0 +1,314 @@
+#include <core.h>
+#include <errorhandler.h>
+#include <preprocessor.h>
+
+/*
+ * Evaluates the (fully expanded) expression of an #if or #elif. Values are
+ * intmax_t or uintmax_t, like the standard asks.
+ */
+
+namespace
+{
+
+struct PPValue
+{
+    int64_t value;
+    bool    isUnsigned;
+};
+
+class PPExpression
+{
+  private:
+    vector<PPToken> &m_toks;
+    size_t           m_pos = 0;
+    int              m_skip = 0;   // > 0 while evaluating a dead branch
+    const char      *m_error = NULL;
+
+  public:
+    PPExpression(vector<PPToken> &toks) : m_toks(toks) {}
+
+    const char *error() { return m_error; }
+    bool        atEnd() { return m_pos == m_toks.size(); }
+
+    PPValue parse(int minPrec);
+
+  private:
+    bool    accept(const char *op);
+    PPValue primary();
+    PPValue unary();
+    PPValue fail(const char *msg);
+};
+
+/* Binary operators by precedence, higher binds stronger */
+struct PPOperator
+{
+    const char *op;
+    int         prec;
+};
+
+const PPOperator operators[] = {
+    {"*", 10},  {"/", 10},  {"%", 10}, {"+", 9},  {"-", 9},  {"<<", 8},
+    {">>", 8},  {"<", 7},   {">", 7},  {"<=", 7}, {">=", 7}, {"==", 6},
+    {"!=", 6},  {"&", 5},   {"^", 4},  {"|", 3},  {"&&", 2}, {"||", 1},
+};
+
+PPValue PPExpression::fail(const char *msg)
+{
+    if (!m_error)
+        m_error = msg;
+
+    m_pos = m_toks.size();
+    return {0, false};
+}
+
+bool PPExpression::accept(const char *op)
+{
+    if (m_pos < m_toks.size() && m_toks[m_pos].is(op))
+    {
+        m_pos++;
+        return true;
+    }
+    return false;
+}
+
+static int64_t charValue(const PPToken &tok)
+{
+    const char *p = tok.text;
+    while (*p != '\'')
+        p++;
+    p++;
+
+    if (*p != '\\')
+        return (unsigned char) *p;
+
+    p++;
+    switch (*p)
+    {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'a': return '\a';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case 'x': return strtol(p + 1, NULL, 16);
+    }
+
+    if (*p >= '0' && *p <= '7')
+        return strtol(p, NULL, 8);
+
+    return (unsigned char) *p;
+}
+
+PPValue PPExpression::primary()
+{
+    if (m_pos == m_toks.size())
+        return fail("Expected value in #if expression");
+
+    const PPToken &tok = m_toks[m_pos++];
+
+    if (tok.is("("))
+    {
+        PPValue v = parse(0);
+        if (!accept(")"))
+            return fail("Missing ')' in #if expression");
+        return v;
+    }
+
+    if (tok.kind == PP_NUMBER)
+    {
+        string   text(tok.text, tok.len);
+        char    *end;
+        uint64_t v = strtoull(text.c_str(), &end, 0);
+
+        bool isUnsigned = false;
+        for (; *end; end++)
+        {
+            if (*end == 'u' || *end == 'U')
+                isUnsigned = true;
+            else if (*end != 'l' && *end != 'L')
+                return fail("Invalid number in #if expression");
+        }
+        return {(int64_t) v, isUnsigned || v > INT64_MAX};
+    }
+
+    if (tok.kind == PP_CHAR)
+        return {charValue(tok), false};
+
+    // Identifiers left after expansion are 0
+    if (tok.kind == PP_IDENT)
+        return {0, false};
+
+    return fail("Invalid token in #if expression");
+}
+
+PPValue PPExpression::unary()
+{
+    if (accept("+"))
+        return unary();
+
+    if (accept("-"))
+    {
+        PPValue v = unary();
+        return {(int64_t) (0 - (uint64_t) v.value), v.isUnsigned};
+    }
+
+    if (accept("~"))
+    {
+        PPValue v = unary();
+        return {~v.value, v.isUnsigned};
+    }
+
+    if (accept("!"))
+        return {!unary().value, false};
+
+    return primary();
+}
+
+PPValue PPExpression::parse(int minPrec)
+{
+    PPValue l = unary();
+
+    while (m_pos < m_toks.size())
+    {
+        const PPToken &tok = m_toks[m_pos];
+
+        if (tok.is("?") && minPrec == 0)
+        {
+            m_pos++;
+
+            bool cond = l.value != 0;
+            if (!cond)
+                m_skip++;
+            PPValue a = parse(0);
+            if (!cond)
+                m_skip--;
+
+            if (!accept(":"))
+                return fail("Expected ':' in #if expression");
+
+            if (cond)
+                m_skip++;
+            PPValue b = parse(0);
+            if (cond)
+                m_skip--;
+
+            l = cond ? a : b;
+            l.isUnsigned = a.isUnsigned || b.isUnsigned;
+            continue;
+        }
+
+        const PPOperator *op = NULL;
+        for (const PPOperator &o : operators)
+        {
+            if (tok.is(o.op))
+            {
+                op = &o;
+                break;
+            }
+        }
+
+        if (!op || op->prec <= minPrec)
+            break;
+
+        m_pos++;
+
+        // The right side of a decided && or || isn't evaluated
+        bool dead = (!strcmp(op->op, "&&") && !l.value) ||
+                    (!strcmp(op->op, "||") && l.value);
+        if (dead)
+            m_skip++;
+        PPValue r = parse(op->prec);
+        if (dead)
+            m_skip--;
+
+        bool     u  = l.isUnsigned || r.isUnsigned;
+        uint64_t ul = l.value, ur = r.value;
+        int64_t  sl = l.value, sr = r.value;
+        string   o  = op->op;
+        PPValue  v  = {0, u};
+
+        if ((o == "/" || o == "%") && !r.value)
+        {
+            if (!m_skip)
+                return fail("Division by zero in #if expression");
+            l = v;
+            continue;
+        }
+
+        if (o == "*")
+            v.value = u ? ul * ur : sl * sr;
+        else if (o == "/")
+            v.value = u ? ul / ur : sl / sr;
+        else if (o == "%")
+            v.value = u ? ul % ur : sl % sr;
+        else if (o == "+")
+            v.value = ul + ur;
+        else if (o == "-")
+            v.value = ul - ur;
+        else if (o == "<<")
+            v = {(int64_t) (ul << (ur & 63)), l.isUnsigned};
+        else if (o == ">>")
+            v = {l.isUnsigned ? (int64_t) (ul >> (ur & 63)) : sl >> (ur & 63),
+                 l.isUnsigned};
+        else if (o == "<")
+            v = {u ? ul < ur : sl < sr, false};
+        else if (o == ">")
+            v = {u ? ul > ur : sl > sr, false};
+        else if (o == "<=")
+            v = {u ? ul <= ur : sl <= sr, false};
+        else if (o == ">=")
+            v = {u ? ul >= ur : sl >= sr, false};
+        else if (o == "==")
+            v = {ul == ur, false};
+        else if (o == "!=")
+            v = {ul != ur, false};
+        else if (o == "&")
+            v.value = ul & ur;
+        else if (o == "^")
+            v.value = ul ^ ur;
+        else if (o == "|")
+            v.value = ul | ur;
+        else if (o == "&&")
+            v = {l.value && r.value, false};
+        else if (o == "||")
+            v = {l.value || r.value, false};
+
+        l = v;
+    }
+
+    return l;
+}
+
+} // namespace
+
+int64_t Preprocessor::evalExpression(vector<PPToken> &toks,
+                                     const PPToken &hash)
+{
+    PPExpression expr(toks);
+    PPValue      v = expr.parse(0);
+
+    if (!expr.error() && !expr.atEnd())
+        error(hash, "Unexpected token in #if expression");
+
+    if (expr.error())
+        error(hash, expr.error());
+
+    return v.value;
+}
+
+/// @brief  Evaluates the condition of an #if or #elif line
+bool Preprocessor::evalCondition(vector<PPToken> &line, const PPToken &hash)
+{
+    vector<PPToken> toks(line.begin() + 1, line.end());
+    if (toks.empty())
+        error(hash, "#if with no expression");
+
+    // 'defined' must be handled before its operand gets expanded, macros
+    // that expand to 'defined' are resolved after expansion
+    resolveDefined(toks);
+    toks = expandAll(toks);
+    resolveDefined(toks);
+
+    return evalExpression(toks, hash) != 0;
+}
@@ -0,0 +1,284 @@
+#include <context.h>
+#include <core.h>
+#include <preprocessor.h>
+
+/* Punctuators, longest first so the first match is the longest one */
+static const char *punctuators[] = {
+    "<<=", ">>=", "...", "->", "++", "--", "<<", ">>", "<=", ">=", "==",
+    "!=",  "&&",  "||",  "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=",
+    "##",
+};
+
+static bool isIdentStart(int c)
+{
+    return isalpha(c) || c == '_' || c == '$';
+}
+
+static bool isIdentChar(int c)
+{
+    return isalnum(c) || c == '_' || c == '$';
+}
+
+bool PPToken::is(const char *s) const
+{
+    return (int) strlen(s) == len && !memcmp(text, s, len);
+}
+
+/// @brief  Splits the buffer into preprocessing tokens. Backslash newlines
+///         must already be removed, splices holds their offsets so the line
+///         numbers still match the physical lines. The tokens get no file or
+///         atoms yet, see bindTokens.
+static void lexBuffer(const char *s, size_t n, vector<PPToken> &out,
+                      const vector<size_t> &splices)
+{
+    size_t i      = 0;
+    size_t splice = 0;
+    int    line   = 1;
+    int    col    = 1;
+    bool   bol    = true;
+    bool   space  = false;
+
+    auto advance = [&](size_t count) {
+        for (size_t k = 0; k < count && i < n; k++)
+        {
+            if (s[i] == '\n')
+            {
+                line++;
+                col = 1;
+            }
+            else
+                col++;
+
+            i++;
+            while (splice < splices.size() && splices[splice] <= i)
+            {
+                line++;
+                splice++;
+            }
+        }
+    };
+
+    while (i < n)
+    {
+        char c = s[i];
+
+        if (c == '\n')
+        {
+            advance(1);
+            bol   = true;
+            space = false;
+            continue;
+        }
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v')
+        {
+            advance(1);
+            space = true;
+            continue;
+        }
+
+        if (c == '/' && i + 1 < n && s[i + 1] == '/')
+        {
+            while (i < n && s[i] != '\n')
+                advance(1);
+            space = true;
+            continue;
+        }
+
+        if (c == '/' && i + 1 < n && s[i + 1] == '*')
+        {
+            advance(2);
+            while (i < n && !(s[i] == '*' && i + 1 < n && s[i + 1] == '/'))
+                advance(1);
+            advance(2);
+            space = true;
+            continue;
+        }
+
+        PPToken tok;
+        tok.text  = s + i;
+        tok.line  = line;
+        tok.col   = col;
+        tok.bol   = bol;
+        tok.space = space;
+        bol       = false;
+        space     = false;
+
+        size_t start = i;
+
+        /* Wide and unicode literals are identifiers glued to a literal */
+        size_t prefix = 0;
+        if (c == 'L' || c == 'U')
+            prefix = 1;
+        else if (c == 'u')
+            prefix = (i + 1 < n && s[i + 1] == '8') ? 2 : 1;
+
+        if (prefix && i + prefix < n &&
+            (s[i + prefix] == '"' || s[i + prefix] == '\''))
+        {
+            advance(prefix);
+            c = s[i];
+        }
+
+        if (c == '"' || c == '\'')
+        {
+            char quote = c;
+            advance(1);
+            while (i < n && s[i] != quote && s[i] != '\n')
+                advance(s[i] == '\\' && i + 1 < n && s[i + 1] != '\n' ? 2 : 1);
+            if (i < n && s[i] == quote)
+                advance(1);
+
+            tok.kind = quote == '"' ? PP_STRING : PP_CHAR;
+        }
+        else if (isIdentStart(c))
+        {
+            while (i < n && isIdentChar(s[i]))
+                advance(1);
+
+            tok.kind = PP_IDENT;
+        }
+        else if (isdigit(c) || (c == '.' && i + 1 < n && isdigit(s[i + 1])))
+        {
+            advance(1);
+            while (i < n)
+            {
+                if (strchr("eEpP", s[i]) && i + 1 < n && strchr("+-", s[i + 1]))
+                    advance(2);
+                else if (isIdentChar(s[i]) || s[i] == '.')
+                    advance(1);
+                else
+                    break;
+            }
+
+            tok.kind = PP_NUMBER;
+        }
+        else
+        {
+            size_t len = 1;
+            for (const char *p : punctuators)
+            {
+                size_t plen = strlen(p);
+                if (plen <= n - i && !memcmp(s + i, p, plen))
+                {
+                    len = plen;
+                    break;
+                }
+            }
+
+            tok.kind = strchr("[](){}.&*+-~!/%<>^|?:;=,#", c) || len > 1
+                           ? PP_PUNCT
+                           : PP_OTHER;
+            advance(len);
+        }
+
+        tok.len = i - start;
+        out.push_back(tok);
+    }
+
+    PPToken eof;
+    eof.text = s + n;
+    eof.len  = 0;
+    eof.kind = PP_EOF;
+    eof.line = line;
+    eof.col  = col;
+    eof.bol  = true;
+    out.push_back(eof);
+}
+
+/// @brief  Removes the backslash newlines from the source, returns where
+///         they were
+static vector<size_t> removeSplices(string &src)
+{
+    vector<size_t> splices;
+
+    if (src.find("\\\n") != string::npos || src.find("\\\r\n") != string::npos)
+    {
+        string clean;
+        clean.reserve(src.size());
+        for (size_t i = 0; i < src.size(); i++)
+        {
+            if (src[i] == '\\' && i + 1 < src.size() && src[i + 1] == '\n')
+            {
+                splices.push_back(clean.size());
+                i++;
+            }
+            else if (src[i] == '\\' && i + 2 < src.size() &&
+                     src[i + 1] == '\r' && src[i + 2] == '\n')
+            {
+                splices.push_back(clean.size());
+                i += 2;
+            }
+            else
+                clean += src[i];
+        }
+        src.swap(clean);
+    }
+
+    return splices;
+}
+
+/// @brief  Tokenizes a file for any compilation to use
+shared_ptr<const LexedFile> lexFile(string &&source)
+{
+    shared_ptr<LexedFile> lexed(new LexedFile());
+    lexed->source          = move(source);
+    vector<size_t> splices = removeSplices(lexed->source);
+
+    lexBuffer(lexed->source.data(), lexed->source.size(), lexed->tokens,
+              splices);
+    return lexed;
+}
+
+/// @brief  Tokenizes a whole input file, line splices are removed first
+void Preprocessor::tokenize(PPFile *file)
+{
+    string        &src     = file->source;
+    vector<size_t> splices = removeSplices(src);
+
+    lexBuffer(src.data(), src.size(), file->tokens, splices);
+    bindTokens(file->tokens, file);
+}
+
+/// @brief  Makes fresh tokens part of this compilation: they get their file
+///         and identifiers their atom
+void Preprocessor::bindTokens(vector<PPToken> &tokens, PPFile *file)
+{
+    for (PPToken &tok : tokens)
+    {
+        tok.file = file;
+        if (tok.kind == PP_IDENT)
+            tok.ident = g_atoms.intern(tok.text, tok.len);
+    }
+}
+
+/// @brief  Makes a token out of text that isn't part of an input file (the
+///         result of # and ##), pos gives it a location for the output
+PPToken Preprocessor::makeToken(const string &text, const PPToken &pos)
+{
+    m_strings.push_back(text);
+    const string &stored = m_strings.back();
+
+    vector<PPToken> toks;
+    lexBuffer(stored.data(), stored.size(), toks, {});
+    bindTokens(toks, NULL);
+
+    PPToken tok = toks.size() > 1 ? toks[0] : pos;
+    if (toks.size() != 2)
+    {
+        // Doesn't lex to a single token, keep the text as is
+        tok.text  = stored.data();
+        tok.len   = stored.size();
+        tok.kind  = PP_OTHER;
+        tok.ident = NOATOM;
+    }
+
+    tok.file     = pos.file;
+    tok.line     = pos.line;
+    tok.col      = pos.col;
+    tok.bol      = false;
+    tok.space    = pos.space;
+    tok.expanded = true;
+    tok.hide     = pos.hide;
+    return tok;
+}
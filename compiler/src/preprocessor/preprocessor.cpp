@@ -0,0 +1,813 @@
+#include <context.h>
+#include <core.h>
+#include <errorhandler.h>
+#include <preprocessor.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define PP_MAX_INCLUDE_DEPTH 200
+
+// Blank lines up to this gap are written out, bigger gaps get a line marker
+#define PP_MAX_BLANK_LINES 8
+
+/*
+ * The predefined macros mirror what the host gcc -E defines, so the system
+ * headers take the same paths they took with the external preprocessor.
+ * We claim to be gcc 4.2 (like clang does) to keep the headers from using
+ * newer gnu extensions.
+ */
+static const char *predefines =
+    "#define __STDC__ 1\n"
+    "#define __STDC_VERSION__ 201710L\n"
+    "#define __STDC_HOSTED__ 1\n"
+    "#define __GNUC__ 4\n"
+    "#define __GNUC_MINOR__ 2\n"
+    "#define __GNUC_PATCHLEVEL__ 1\n"
+    "#define __safecc__ 1\n"
+    "#define __x86_64__ 1\n"
+    "#define __x86_64 1\n"
+    "#define __amd64__ 1\n"
+    "#define __amd64 1\n"
+    "#define __LP64__ 1\n"
+    "#define _LP64 1\n"
+    "#define __linux__ 1\n"
+    "#define __linux 1\n"
+    "#define __gnu_linux__ 1\n"
+    "#define __unix__ 1\n"
+    "#define __unix 1\n"
+    "#define __ELF__ 1\n"
+    "#define __CHAR_BIT__ 8\n"
+    "#define __SCHAR_MAX__ 0x7f\n"
+    "#define __SHRT_MAX__ 0x7fff\n"
+    "#define __INT_MAX__ 0x7fffffff\n"
+    "#define __LONG_MAX__ 0x7fffffffffffffffL\n"
+    "#define __LONG_LONG_MAX__ 0x7fffffffffffffffLL\n"
+    "#define __WCHAR_MAX__ 0x7fffffff\n"
+    "#define __WCHAR_MIN__ (-__WCHAR_MAX__ - 1)\n"
+    "#define __SIZEOF_INT__ 4\n"
+    "#define __SIZEOF_LONG__ 8\n"
+    "#define __SIZEOF_LONG_LONG__ 8\n"
+    "#define __SIZEOF_SHORT__ 2\n"
+    "#define __SIZEOF_POINTER__ 8\n"
+    "#define __SIZEOF_FLOAT__ 4\n"
+    "#define __SIZEOF_DOUBLE__ 8\n"
+    "#define __SIZEOF_LONG_DOUBLE__ 16\n"
+    "#define __SIZEOF_SIZE_T__ 8\n"
+    "#define __SIZEOF_WCHAR_T__ 4\n"
+    "#define __SIZEOF_WINT_T__ 4\n"
+    "#define __SIZEOF_PTRDIFF_T__ 8\n"
+    "#define __SIZE_TYPE__ long unsigned int\n"
+    "#define __PTRDIFF_TYPE__ long int\n"
+    "#define __WCHAR_TYPE__ int\n"
+    "#define __WINT_TYPE__ unsigned int\n"
+    "#define __INTMAX_TYPE__ long int\n"
+    "#define __UINTMAX_TYPE__ long unsigned int\n"
+    "#define __CHAR16_TYPE__ short unsigned int\n"
+    "#define __CHAR32_TYPE__ unsigned int\n"
+    "#define __ORDER_LITTLE_ENDIAN__ 1234\n"
+    "#define __ORDER_BIG_ENDIAN__ 4321\n"
+    "#define __ORDER_PDP_ENDIAN__ 3412\n"
+    "#define __BYTE_ORDER__ __ORDER_LITTLE_ENDIAN__\n";
+
+Preprocessor::Preprocessor()
+{
+    m_defined        = g_atoms.intern("defined");
+    m_hasInclude     = g_atoms.intern("__has_include");
+    m_hasIncludeNext = g_atoms.intern("__has_include_next");
+    m_vaArgs         = g_atoms.intern("__VA_ARGS__");
+    m_file           = g_atoms.intern("__FILE__");
+    m_line           = g_atoms.intern("__LINE__");
+    m_counter        = g_atoms.intern("__COUNTER__");
+    m_includeLevel   = g_atoms.intern("__INCLUDE_LEVEL__");
+
+    m_fileStore.emplace_back();
+    PPFile *builtin = &m_fileStore.back();
+    builtin->path   = "<built-in>";
+    builtin->dirIdx = -1;
+    builtin->source = predefines;
+    tokenize(builtin);
+    m_files[builtin->path] = builtin;
+}
+
+/// @brief  Adds a directory to search for #include files, in order
+void Preprocessor::addIncludeDir(const string &dir)
+{
+    m_includeDirs.push_back(dir);
+}
+
+/// @brief  Includes the file before the input file (like gcc -include)
+void Preprocessor::forceInclude(const string &path)
+{
+    m_forcedIncludes.push_back(path);
+}
+
+/// @brief  Defines a macro, formatted as 'NAME' or 'NAME=VALUE' (like -D)
+void Preprocessor::define(const string &definition)
+{
+    string text = definition;
+    size_t eq   = text.find('=');
+    if (eq == string::npos)
+        text += " 1";
+    else
+        text[eq] = ' ';
+
+    m_cmdlineDefines += "#define " + text + "\n";
+}
+
+[[noreturn]] void Preprocessor::error(const PPToken &tok, const string &msg)
+{
+    string where =
+        tok.file ? *presumedPath(tok) + ":" + to_string(presumedLine(tok)) : "";
+    g_err.fatalNL(HL(where) + " " + msg);
+}
+
+void Preprocessor::warning(const PPToken &tok, const string &msg)
+{
+    string where =
+        tok.file ? *presumedPath(tok) + ":" + to_string(presumedLine(tok)) : "";
+    g_err.warningNL(HL(where) + " " + msg);
+}
+
+/// @brief  The line of a token as #line renumbered it
+int Preprocessor::presumedLine(const PPToken &tok)
+{
+    if (m_includeStack.empty() || m_includeStack.back().file != tok.file)
+        return tok.line;
+
+    return tok.line + m_includeStack.back().lineDelta;
+}
+
+/// @brief  The name of the file of a token, #line can change it
+const string *Preprocessor::presumedPath(const PPToken &tok)
+{
+    if (m_includeStack.empty() || m_includeStack.back().file != tok.file)
+        return &tok.file->path;
+
+    return m_includeStack.back().path;
+}
+
+/// @brief  Reads and tokenizes a file, every file is only loaded once
+PPFile *Preprocessor::loadFile(const string &path, int dirIdx)
+{
+    auto it = m_files.find(path);
+    if (it != m_files.end())
+        return it->second;
+
+    if (m_fileCache)
+    {
+        shared_ptr<const LexedFile> lexed = m_fileCache->read(path);
+        return lexed ? addFile(path, dirIdx, lexed) : NULL;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        ::close(fd);
+        return NULL;
+    }
+
+    string  source;
+    char    chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0)
+        source.append(chunk, n);
+    ::close(fd);
+
+    return addFile(path, dirIdx, move(source));
+}
+
+/// @brief  Reads a file that was only known from a precompiled header
+PPFile *Preprocessor::readStub(PPFile *stub)
+{
+    m_files.erase(stub->path);
+    return loadFile(stub->path, stub->dirIdx);
+}
+
+PPFile *Preprocessor::addFile(const string &path, int dirIdx, string &&source)
+{
+    m_fileStore.emplace_back();
+    PPFile *file = &m_fileStore.back();
+    file->path   = path;
+    file->dirIdx = dirIdx;
+    file->source = move(source);
+
+    tokenize(file);
+    detectGuard(file);
+
+    m_files[path] = file;
+    return file;
+}
+
+/// @brief  Adds a file that was tokenized already, it gets a copy of the
+///         tokens that refers to this compilation
+PPFile *Preprocessor::addFile(const string &path, int dirIdx,
+                              shared_ptr<const LexedFile> lexed)
+{
+    m_fileStore.emplace_back();
+    PPFile *file = &m_fileStore.back();
+    file->path   = path;
+    file->dirIdx = dirIdx;
+    file->lexed  = lexed;
+    file->tokens = lexed->tokens;
+
+    bindTokens(file->tokens, file);
+    detectGuard(file);
+
+    m_files[path] = file;
+    return file;
+}
+
+/// @brief  Finds the file of an #include. Quoted includes look next to the
+///         including file first, startDir is where #include_next continues
+PPFile *Preprocessor::findInclude(const string &name, bool quoted,
+                                  int startDir, const PPFile *from)
+{
+    if (name.size() && name[0] == '/')
+        return loadFile(name, -1);
+
+    if (quoted && startDir == 0 && from)
+    {
+        size_t slash = from->path.rfind('/');
+        string path  = slash == string::npos
+                           ? name
+                           : from->path.substr(0, slash + 1) + name;
+
+        PPFile *file = loadFile(path, -1);
+        if (file)
+            return file;
+    }
+
+    for (int i = startDir; i < (int) m_includeDirs.size(); i++)
+    {
+        PPFile *file = loadFile(m_includeDirs[i] + "/" + name, i);
+        if (file)
+            return file;
+    }
+
+    return NULL;
+}
+
+/// @brief  Checks if the whole file is wrapped in #ifndef X ... #endif, the
+///         file won't be read again once X is defined
+void Preprocessor::detectGuard(PPFile *file)
+{
+    vector<PPToken> &toks = file->tokens;
+    if (toks.size() < 4 || !toks[0].is("#") || !toks[1].is("ifndef") ||
+        toks[2].kind != PP_IDENT || toks[2].bol || !toks[3].bol)
+        return;
+
+    int depth = 0;
+    for (size_t i = 0; i < toks.size(); i++)
+    {
+        if (!toks[i].bol || !toks[i].is("#") || toks[i + 1].bol)
+            continue;
+
+        const PPToken &d = toks[i + 1];
+        if (d.is("if") || d.is("ifdef") || d.is("ifndef"))
+            depth++;
+        else if (d.is("endif") && --depth == 0)
+        {
+            // The matching #endif must be the last thing in the file
+            size_t j = i + 2;
+            while (!toks[j].bol)
+                j++;
+
+            if (toks[j].kind == PP_EOF)
+                file->guard = toks[2].ident;
+            return;
+        }
+        else if ((d.is("else") || d.is("elif")) && depth == 1)
+            return;
+    }
+}
+
+void Preprocessor::pushFile(PPFile *file)
+{
+    if (m_includeStack.size() > PP_MAX_INCLUDE_DEPTH)
+        g_err.fatalNL("#include nested too deeply in " + HL(file->path));
+
+    m_includeStack.push_back({file, 0, m_conds.size(), 0, &file->path});
+}
+
+/// @brief  Returns the next token, expanded tokens come first. Reading
+///         stops at the end of the current file.
+PPToken Preprocessor::readRaw()
+{
+    if (m_pending.size())
+    {
+        PPToken tok = m_pending.back();
+        m_pending.pop_back();
+        return tok;
+    }
+
+    Cursor        &cur = m_includeStack.back();
+    const PPToken &tok = cur.file->tokens[cur.pos];
+    if (tok.kind != PP_EOF)
+        cur.pos++;
+
+    return tok;
+}
+
+void Preprocessor::unread(const PPToken &tok)
+{
+    m_pending.push_back(tok);
+}
+
+/// @brief  Returns the rest of the directive line
+vector<PPToken> Preprocessor::readLine()
+{
+    Cursor         &cur = m_includeStack.back();
+    vector<PPToken> line;
+
+    while (!cur.file->tokens[cur.pos].bol)
+        line.push_back(cur.file->tokens[cur.pos++]);
+
+    return line;
+}
+
+/// @brief  Skips to the #elif, #else or #endif that ends the current group,
+///         the directive itself is left for the main loop
+void Preprocessor::skipGroup()
+{
+    Cursor &cur   = m_includeStack.back();
+    int     depth = 0;
+
+    for (;; cur.pos++)
+    {
+        const PPToken &tok = cur.file->tokens[cur.pos];
+        if (tok.kind == PP_EOF)
+            return;
+
+        if (!tok.bol || !tok.is("#"))
+            continue;
+
+        const PPToken &d = cur.file->tokens[cur.pos + 1];
+        if (d.bol || d.kind != PP_IDENT)
+            continue;
+
+        if (d.is("if") || d.is("ifdef") || d.is("ifndef"))
+            depth++;
+        else if (d.is("endif") && depth)
+            depth--;
+        else if (!depth && (d.is("endif") || d.is("else") || d.is("elif")))
+            return;
+    }
+}
+
+/// @brief  Returns the file name of an #include, expanding macros if the
+///         name isn't written out
+string Preprocessor::includeName(vector<PPToken> &line, bool &quoted,
+                                 const PPToken &hash)
+{
+    if (line.size() < 2)
+        error(hash, "#include expects \"FILENAME\" or <FILENAME>");
+
+    const PPToken &first = line[1];
+    if (first.kind == PP_STRING)
+    {
+        quoted = true;
+        return string(first.text + 1, first.len - 2);
+    }
+
+    if (first.is("<"))
+    {
+        // Take the text as written, the tokens might not be C tokens
+        for (size_t i = 2; i < line.size(); i++)
+        {
+            if (line[i].is(">") && !line[i].expanded && !first.expanded)
+                return string(first.text + 1, line[i].text - first.text - 1);
+        }
+    }
+
+    vector<PPToken> toks(line.begin() + 1, line.end());
+    toks = expandAll(toks);
+    if (toks.size() && toks[0].kind == PP_STRING)
+    {
+        quoted = true;
+        return string(toks[0].text + 1, toks[0].len - 2);
+    }
+
+    if (toks.size() && toks[0].is("<"))
+    {
+        string name;
+        for (size_t i = 1; i < toks.size() && !toks[i].is(">"); i++)
+        {
+            if (i > 1 && toks[i].space)
+                name += ' ';
+            name.append(toks[i].text, toks[i].len);
+        }
+        return name;
+    }
+
+    error(hash, "#include expects \"FILENAME\" or <FILENAME>");
+}
+
+static bool sameFile(const string &a, const string &b)
+{
+    struct stat sa, sb;
+    return !stat(a.c_str(), &sa) && !stat(b.c_str(), &sb) &&
+           sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+void Preprocessor::includeDirective(vector<PPToken> &line, bool next,
+                                    const PPToken &hash)
+{
+    bool   quoted = false;
+    string name   = includeName(line, quoted, hash);
+
+    PPFile *cur      = m_includeStack.back().file;
+    int     startDir = 0;
+    if (next && cur->dirIdx >= 0)
+        startDir = cur->dirIdx + 1;
+
+    PPFile *file = findInclude(name, quoted, startDir, cur);
+    if (!file)
+        error(hash, "Cannot find include file " + HL(name));
+
+    if (file->pragmaOnce)
+        return;
+
+    if (file->guard && m_macros.count(file->guard))
+        return;
+
+    // The precompiled header was made from it, it's included already even
+    // without a guard
+    if (m_pchHeader.size() && sameFile(file->path, m_pchHeader))
+        return;
+
+    // Only known from the precompiled header, it has to be read after all
+    if (file->stub && !(file = readStub(file)))
+        error(hash, "Cannot find include file " + HL(name));
+
+    pushFile(file);
+}
+
+void Preprocessor::directive(const PPToken &hash)
+{
+    vector<PPToken> line = readLine();
+
+    // The null directive
+    if (line.empty())
+        return;
+
+    const PPToken &name = line[0];
+
+    if (name.is("include") || name.is("import"))
+        includeDirective(line, false, hash);
+
+    else if (name.is("include_next"))
+        includeDirective(line, true, hash);
+
+    else if (name.is("define"))
+        defineMacro(line, hash);
+
+    else if (name.is("undef"))
+    {
+        if (line.size() < 2 || line[1].kind != PP_IDENT)
+            error(hash, "Macro name expected after #undef");
+
+        m_macros.erase(line[1].ident);
+    }
+
+    else if (name.is("if") || name.is("ifdef") || name.is("ifndef"))
+    {
+        bool cond;
+        if (name.is("if"))
+            cond = evalCondition(line, hash);
+        else
+        {
+            if (line.size() < 2 || line[1].kind != PP_IDENT)
+                error(hash, "Macro name expected after #" +
+                                string(name.text, name.len));
+
+            cond = isDefined(line[1].ident) == name.is("ifdef");
+        }
+
+        m_conds.push_back({cond, false, !cond});
+        if (!cond)
+            skipGroup();
+    }
+
+    else if (name.is("elif") || name.is("else"))
+    {
+        if (m_conds.size() <= m_includeStack.back().condBase)
+            error(hash, "#" + string(name.text, name.len) + " without #if");
+
+        PPConditional &cond = m_conds.back();
+        if (cond.hadElse)
+            error(hash, "#" + string(name.text, name.len) + " after #else");
+
+        if (name.is("else"))
+            cond.hadElse = true;
+
+        if (cond.taken)
+        {
+            cond.skipping = true;
+            skipGroup();
+        }
+        else if (name.is("else") || evalCondition(line, hash))
+        {
+            cond.taken    = true;
+            cond.skipping = false;
+        }
+        else
+            skipGroup();
+    }
+
+    else if (name.is("endif"))
+    {
+        if (m_conds.size() <= m_includeStack.back().condBase)
+            error(hash, "#endif without #if");
+
+        m_conds.pop_back();
+    }
+
+    else if (name.is("error") || name.is("warning"))
+    {
+        string msg = "#" + string(name.text, name.len);
+        for (size_t i = 1; i < line.size(); i++)
+            msg += " " + string(line[i].text, line[i].len);
+
+        if (name.is("error"))
+            error(hash, msg);
+
+        warning(hash, msg);
+    }
+
+    else if (name.is("pragma"))
+    {
+        if (line.size() > 1 && line[1].is("once"))
+            m_includeStack.back().file->pragmaOnce = true;
+
+        // Other pragmas don't mean anything to us
+    }
+
+    else if (name.is("line") || name.kind == PP_NUMBER)
+        lineDirective(line, hash);
+
+    else if (name.is("ident") || name.is("sccs"))
+    {
+        // Nothing to do, we don't keep version strings
+    }
+
+    else
+        error(hash, "Invalid preprocessing directive " +
+                        HL("#" + string(name.text, name.len)));
+}
+
+/// @brief  #line N "file" and the # N "file" line marker form, the line after
+///         the directive becomes line N (of file). Flags after the name of a
+///         line marker are ignored.
+void Preprocessor::lineDirective(vector<PPToken> &line, const PPToken &hash)
+{
+    vector<PPToken> toks;
+    if (line[0].kind == PP_NUMBER)
+        toks = line;
+    else
+        toks = expandAll(vector<PPToken>(line.begin() + 1, line.end()));
+
+    string digits = toks.size() ? string(toks[0].text, toks[0].len) : "";
+    if (digits.empty() ||
+        digits.find_first_not_of("0123456789") != string::npos)
+        error(hash, "#line expects a line number instead of " + HL(digits));
+
+    Cursor &cur   = m_includeStack.back();
+    cur.lineDelta = atoi(digits.c_str()) - (line.back().line + 1);
+
+    if (toks.size() > 1)
+    {
+        const PPToken &name = toks[1];
+        if (name.kind != PP_STRING || name.text[0] != '"')
+            error(hash, "Invalid file name " +
+                            HL(string(name.text, name.len)) + " in #line");
+
+        m_strings.emplace_back(name.text + 1, name.len - 2);
+        cur.path = &m_strings.back();
+    }
+}
+
+/// @brief  Whether printing b right after a changes how the text lexes
+static bool wouldPaste(char a, char b)
+{
+    if ((isalnum(a) || a == '_' || a == '.') && (isalnum(b) || b == '_'))
+        return true;
+
+    switch (a)
+    {
+    case '+': return b == '+' || b == '=';
+    case '-': return b == '-' || b == '=' || b == '>';
+    case '<': return b == '<' || b == '=' || b == ':' || b == '%';
+    case '>': return b == '>' || b == '=';
+    case '&': return b == '&' || b == '=';
+    case '|': return b == '|' || b == '=';
+    case '/': return b == '/' || b == '*' || b == '=';
+    case '*':
+    case '%':
+    case '^':
+    case '!':
+    case '=': return b == '=';
+    case '#': return b == '#';
+    case '.': return b == '.';
+    }
+
+    return false;
+}
+
+void Preprocessor::emitMarker(const string &path, int line)
+{
+    if (!m_atLineStart)
+        m_out += '\n';
+
+    m_out += "# " + to_string(line) + " \"" + path + "\"\n";
+
+    m_outPath     = &path;
+    m_outLine     = line;
+    m_atLineStart = true;
+}
+
+/// @brief  Writes a token, keeping it on the output line of its source line
+void Preprocessor::emit(const PPToken &tok)
+{
+    int           line = presumedLine(tok);
+    const string *path = presumedPath(tok);
+
+    // #line can also number lines backwards
+    if (path != m_outPath || line < m_outLine)
+        emitMarker(*path, line);
+
+    else if (line > m_outLine)
+    {
+        int gap = line - m_outLine;
+        if (gap > PP_MAX_BLANK_LINES)
+            emitMarker(*path, line);
+        else
+        {
+            m_out.append(gap, '\n');
+            m_outLine     = line;
+            m_atLineStart = true;
+        }
+    }
+
+    if (m_atLineStart)
+        m_out.append(tok.col > 1 ? tok.col - 1 : 0, ' ');
+
+    else if (tok.space || ((tok.expanded || m_lastExpanded) &&
+                           wouldPaste(m_lastChar, tok.text[0])))
+        m_out += ' ';
+
+    m_out.append(tok.text, tok.len);
+    m_atLineStart  = false;
+    m_lastExpanded = tok.expanded;
+    m_lastChar     = tok.text[tok.len - 1];
+}
+
+/// @brief  Every macro that is defined now, as #define lines
+string Preprocessor::macroDefinitions()
+{
+    string out;
+    for (auto &it : m_macros)
+    {
+        const Macro &m = it.second;
+        out += "#define " + g_atoms.str(it.first);
+
+        if (m.funcLike)
+        {
+            out += '(';
+            for (size_t i = 0; i < m.params.size(); i++)
+            {
+                bool last = i + 1 == m.params.size();
+                if (i)
+                    out += ',';
+
+                // '...' is __VA_ARGS__, 'args...' is the GNU named form
+                if (!(last && m.variadic && m.params[i] == m_vaArgs))
+                    out += g_atoms.str(m.params[i]);
+                if (last && m.variadic)
+                    out += "...";
+            }
+            out += ')';
+        }
+
+        for (const PPToken &tok : m.body)
+        {
+            out += ' ';
+            if (tok.space)
+                out += ' ';
+            out.append(tok.text, tok.len);
+        }
+        out += '\n';
+    }
+
+    return out;
+}
+
+/// @brief  Makes a file the precompiled header included known without
+///         reading it, an include of it is skipped while it is guarded
+void Preprocessor::restoreFile(const string &path, int dirIdx, bool pragmaOnce,
+                               Atom guard)
+{
+    if (m_files.count(path))
+        return;
+
+    m_fileStore.emplace_back();
+    PPFile *file     = &m_fileStore.back();
+    file->path       = path;
+    file->dirIdx     = dirIdx;
+    file->pragmaOnce = pragmaOnce;
+    file->guard      = guard;
+    file->stub       = true;
+    m_files[path]    = file;
+}
+
+/// @brief  Preprocesses source that is already in memory, path is where it
+///         pretends to come from
+string Preprocessor::preprocess(const string &path, string &&source)
+{
+    addFile(path, -1, move(source));
+    return preprocess(path);
+}
+
+/// @brief  Preprocesses the file, the result is the complete translation
+///         unit with line markers for the scanner
+string Preprocessor::preprocess(const string &path)
+{
+    PPFile *main = loadFile(path, -1);
+    if (main && main->stub)
+        main = readStub(main);
+    if (!main)
+        g_err.fatalNL("Unable to open '" + path + "'");
+
+    pushFile(main);
+
+    for (auto i = m_forcedIncludes.rbegin(); i != m_forcedIncludes.rend(); i++)
+    {
+        PPFile *file = loadFile(*i, -1);
+        if (!file)
+            g_err.fatalNL("Unable to open forced include '" + *i + "'");
+
+        // The precompiled header was made with the same forced includes
+        if (!file->stub)
+            pushFile(file);
+    }
+
+    // The macros of a precompiled header come after the command line ones,
+    // which were the same when it was made
+    if (m_pchDefines.size())
+    {
+        m_fileStore.emplace_back();
+        PPFile *pch = &m_fileStore.back();
+        pch->path   = "<precompiled>";
+        pch->dirIdx = -1;
+        pch->source = move(m_pchDefines);
+        tokenize(pch);
+        pushFile(pch);
+    }
+
+    if (m_cmdlineDefines.size())
+    {
+        m_fileStore.emplace_back();
+        PPFile *cmdline = &m_fileStore.back();
+        cmdline->path   = "<command-line>";
+        cmdline->dirIdx = -1;
+        cmdline->source = m_cmdlineDefines;
+        tokenize(cmdline);
+        pushFile(cmdline);
+    }
+
+    pushFile(m_files["<built-in>"]);
+
+    while (m_includeStack.size())
+    {
+        PPToken tok = readRaw();
+
+        if (tok.kind == PP_EOF)
+        {
+            if (m_conds.size() > m_includeStack.back().condBase)
+                error(tok, "Unterminated #if");
+
+            m_includeStack.pop_back();
+            continue;
+        }
+
+        if (tok.bol && !tok.expanded && tok.is("#"))
+        {
+            directive(tok);
+            continue;
+        }
+
+        if (tok.kind == PP_IDENT && expandMacro(tok))
+            continue;
+
+        emit(tok);
+    }
+
+    if (!m_atLineStart)
+        m_out += '\n';
+
+    return move(m_out);
+}
@@ -0,0 +1,305 @@
+#include <arch/x86/assembler.h>
+#include <arch/x86/generator.h>
+#include <compilecache.h>
+#include <context.h>
+#include <errorhandler.h>
+#include <memfile.h>
+#include <parser/parser.h>
+#include <pch.h>
+#include <preprocessor.h>
+#include <safecc.h>
+#include <scanner.h>
+
+#include <memory>
+#include <sstream>
+
+/* Include search path of the built-in preprocessor, after our own includes */
+static const char *systemIncludeDirs[] = {
+    "/usr/local/include",
+    "/usr/include/x86_64-linux-gnu",
+    "/usr/include",
+};
+
+static const char *ppFlags = " -E -I" SOURCE_DIR "/includes "
+                             " -include " SOURCE_DIR "/includes/gnucompat.h";
+
+void applyOptions(CompilationContext &ctx, const CompileOptions &options)
+{
+    ctx.errors.f_warningAsError = options.warningAsError;
+    ctx.errors.f_conversionWarn = options.conversionWarnings;
+    ctx.errors.f_noMemChecking  = options.noMemoryChecking;
+}
+
+/// @brief  Sets up the built-in preprocessor the way the options ask for
+static void setupPreprocessor(Preprocessor &pp, const CompileOptions &options)
+{
+    pp.setFileCache(options.fileCache);
+    for (const string &dir : options.includeDirs)
+        pp.addIncludeDir(dir);
+    pp.addIncludeDir(SAFECC_INCLUDE_DIR);
+    for (const char *dir : systemIncludeDirs)
+        pp.addIncludeDir(dir);
+    pp.forceInclude(SAFECC_INCLUDE_DIR "/gnucompat.h");
+    for (const string &define : options.defines)
+        pp.define(define);
+}
+
+/**
+ * @brief   Preprocesses a file, or source that pretends to be that file.
+ *          With restore the macros of the precompiled header are restored,
+ *          otherwise the header it was made from is included first.
+ */
+static string preprocess(const string &path, const CompileOptions &options,
+                         const string *source, const PrecompiledHeader *pch,
+                         bool restore)
+{
+    if (options.preprocessor.size() && !source)
+    {
+        string command = options.preprocessor + ppFlags;
+        for (const string &dir : options.includeDirs)
+            command += " -I" + dir;
+        for (const string &define : options.defines)
+            command += " -D" + define;
+        if (pch)
+            command += " -include " + pch->header();
+
+        // The preprocessor writes to a pipe we read from
+        int    status;
+        string out = runCapture(command + " " + path, status);
+        if (status)
+            g_err.fatalNL("Failed to preprocess " + HL(path));
+
+        return out;
+    }
+
+    Preprocessor pp;
+    setupPreprocessor(pp, options);
+
+    if (pch && restore)
+        pch->restoreMacros(pp);
+    else if (pch)
+        pp.forceInclude(pch->header());
+    if (pch)
+        pp.markIncluded(pch->header());
+
+    if (source)
+        return pp.preprocess(path, string(*source));
+    return pp.preprocess(path);
+}
+
+/// @brief  The precompiled header of the options, if any
+static shared_ptr<const PrecompiledHeader> openPch(const CompileOptions &options)
+{
+    if (options.pch.empty())
+        return NULL;
+
+    return PrecompiledHeader::open(options.pch);
+}
+
+/// @brief  The precompiled header to continue from, NULL if there is none or
+///         it is out of date (the header itself is included then)
+static const PrecompiledHeader *restorable(CompilationContext &ctx,
+                                           const CompileOptions &options,
+                                           const PrecompiledHeader *pch)
+{
+    if (!pch || options.preprocessor.size())
+        return NULL;
+
+    if (pch->usable(options))
+        return pch;
+
+    ctx.errors.noticeNL("Precompiled header " + HL(options.pch) +
+                        " is out of date, including " + HL(pch->header()) +
+                        " instead");
+    return NULL;
+}
+
+/// @brief  Preprocesses a file, or source that pretends to be that file. A
+///         precompiled header is expanded from the header it was made from.
+string preprocessFile(const string &path, const CompileOptions &options,
+                      const string *source)
+{
+    return preprocess(path, options, source, openPch(options).get(), false);
+}
+
+/// @brief  Parses and generates one preprocessed file, it continues from the
+///         declarations of pch if there is one
+static void translate(CompilationContext &ctx, Generator &generator,
+                      const string &path, string &&preprocessed,
+                      const PrecompiledHeader *pch)
+{
+    if (pch)
+        pch->restoreDeclarations(ctx);
+
+    Scanner scanner(ctx, path.c_str(), move(preprocessed));
+    ctx.errors.setupLinehandler(scanner);
+    generator.setupInfileHandler(scanner);
+
+    Parser parser(ctx, scanner, generator);
+
+    scanner.scan();
+
+    ast_node *t = parser.parserMain();
+    generator.generateFromAst(t, -1, 0);
+
+    // The tree of this file is done, free it in one go
+    ctx.astArena.release();
+}
+
+/// @brief  Preprocesses, parses and generates one file
+void compileInto(CompilationContext &ctx, Generator &generator,
+                 const CompileOptions &options, const string &path,
+                 const string *source)
+{
+    shared_ptr<const PrecompiledHeader> pch      = openPch(options);
+    const PrecompiledHeader            *restored = restorable(ctx, options,
+                                                              pch.get());
+
+    string preprocessed = preprocess(path, options, source, pch.get(),
+                                     restored);
+    translate(ctx, generator, path, move(preprocessed), restored);
+}
+
+/// @brief  Generates the object or the assembly of a preprocessed file
+static string generate(CompilationContext &ctx, const CompileOptions &options,
+                       const string &path, string &&preprocessed,
+                       const PrecompiledHeader *pch)
+{
+    char  *text     = NULL;
+    size_t textSize = 0;
+    FILE  *textFile = NULL;
+
+    unique_ptr<AsmOutput> out;
+    AssemblerX86         *assembler = NULL;
+    if (options.assembly)
+    {
+        textFile = open_memstream(&text, &textSize);
+        out.reset(new TextAsmOutput(textFile));
+    }
+    else
+    {
+        assembler = new AssemblerX86("", path);
+        out.reset(assembler);
+    }
+
+    string output;
+    try
+    {
+        GeneratorX86 generator(ctx, out.get());
+        generator.setOptimization(options.optimize);
+        translate(ctx, generator, path, move(preprocessed), pch);
+        generator.genDataSection();
+        generator.close();
+
+        if (assembler)
+            output = assembler->object().contents();
+        else
+            output.assign(text, textSize);
+    }
+    catch (const CompileError &)
+    {
+        // The text stream has to be closed before its buffer is freed
+        if (textFile)
+            out->close();
+        free(text);
+        throw;
+    }
+
+    free(text);
+    return output;
+}
+
+static CompileResult compileUnit(const string &path, const string *source,
+                                 const CompileOptions &options)
+{
+    CompilationContext             ctx;
+    CompilationContext::Activation activation(ctx);
+    ostringstream                  diagnostics;
+    CompileResult                  result;
+
+    applyOptions(ctx, options);
+    ctx.errors.setStream(diagnostics);
+
+    try
+    {
+        shared_ptr<const PrecompiledHeader> pch      = openPch(options);
+        const PrecompiledHeader            *restored = restorable(ctx, options,
+                                                                  pch.get());
+
+        string preprocessed = preprocess(path, options, source, pch.get(),
+                                         restored);
+
+        if (options.cacheDir.empty())
+            result.output = generate(ctx, options, path, move(preprocessed),
+                                     restored);
+        else
+        {
+            // A hit replays the warnings of the compilation that was stored,
+            // the ones of the preprocessor were just printed again
+            CompileCache cache(options.cacheDir, path, preprocessed, options);
+            string       stored;
+            if (cache.lookup(result.output, stored))
+                diagnostics << stored;
+            else
+            {
+                size_t start  = diagnostics.tellp();
+                result.output = generate(ctx, options, path,
+                                         move(preprocessed), restored);
+                cache.store(result.output, diagnostics.str().substr(start));
+            }
+        }
+
+        result.success = true;
+    }
+    catch (const CompileError &)
+    {
+        // Already reported in the diagnostics
+    }
+
+    result.diagnostics = diagnostics.str();
+    return result;
+}
+
+/// @brief  Compiles source kept in memory, name is used for diagnostics and
+///         to find the headers it includes with quotes
+CompileResult compile(const string &source, const string &name,
+                      const CompileOptions &options)
+{
+    return compileUnit(name, &source, options);
+}
+
+CompileResult compileFile(const string &path, const CompileOptions &options)
+{
+    return compileUnit(path, NULL, options);
+}
+
+/// @brief  Parses a header that only declares things and saves what it
+///         leaves behind as a precompiled header (see pch.h)
+void precompileHeader(const string &header, const string &outfile,
+                      const CompileOptions &options)
+{
+    CompilationContext             ctx;
+    CompilationContext::Activation activation(ctx);
+    applyOptions(ctx, options);
+
+    if (options.preprocessor.size())
+        g_err.fatalNL("Headers can only be precompiled with the built-in "
+                      "preprocessor");
+
+    Preprocessor pp;
+    setupPreprocessor(pp, options);
+
+    Scanner scanner(ctx, header.c_str(), pp.preprocess(header));
+    ctx.errors.setupLinehandler(scanner);
+
+    // Nothing is generated, the parser just needs somewhere to send it
+    AssemblerX86 out("", header);
+    GeneratorX86 generator(ctx, &out);
+    generator.setupInfileHandler(scanner);
+
+    Parser parser(ctx, scanner, generator);
+    scanner.scan();
+    parser.parserMain();
+
+    PrecompiledHeader::write(outfile, header, options, pp, ctx);
+}
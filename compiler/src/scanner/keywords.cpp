@@ -2,125 +2,142 @@
 #include <scanner.h>
 #include <token.h>
 
-int Scanner::identifyKeyword(string keyword)
+/*
+ * Keywords are recognized through a perfect hash over the length and a few
+ * characters of the identifier. Both the hash parameters and the table are
+ * computed by the compiler, so adding a keyword only means adding a line to
+ * the list below (the static_assert tells you if no perfect hash exists).
+ */
+
+#define KEYWORD_TABLE_SIZE 128
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 13
+
+namespace
+{
+
+struct Keyword
+{
+    const char *name;
+    int         len;
+    int         token;
+};
+
+constexpr int keywordLength(const char *s)
 {
-    // Breath first ish optimized keyword scanner
-    switch (keyword[0])
+    int i = 0;
+    while (s[i])
+        i++;
+    return i;
+}
+
+#define KEYWORD(str, tok) {str, keywordLength(str), Token::Tokens::tok}
+
+constexpr Keyword keywords[] = {
+    KEYWORD("auto", AUTO),          KEYWORD("break", BREAK),
+    KEYWORD("case", CASE),          KEYWORD("char", CHAR),
+    KEYWORD("const", CONST),        KEYWORD("continue", CONTINUE),
+    KEYWORD("default", DEFAULT),    KEYWORD("do", DO),
+    KEYWORD("double", DOUBLE),      KEYWORD("else", ELSE),
+    KEYWORD("enum", ENUM),          KEYWORD("extern", EXTERN),
+    KEYWORD("float", FLOAT),        KEYWORD("for", FOR),
+    KEYWORD("goto", GOTO),          KEYWORD("if", IF),
+    KEYWORD("int", INT),            KEYWORD("long", LONG),
+    KEYWORD("register", REGISTER),  KEYWORD("return", RETURN),
+    KEYWORD("short", SHORT),        KEYWORD("signed", SIGNED),
+    KEYWORD("sizeof", SIZEOF),      KEYWORD("static", STATIC),
+    KEYWORD("struct", STRUCT),      KEYWORD("switch", SWITCH),
+    KEYWORD("typedef", TYPEDEF),    KEYWORD("union", UNION),
+    KEYWORD("unsigned", UNSIGNED),  KEYWORD("void", VOID),
+    KEYWORD("volatile", VOLATILE),  KEYWORD("while", WHILE),
+    KEYWORD("__restrict", RESTRICT),
+    KEYWORD("__attribute__", ATTRIBUTE),
+    KEYWORD("__asm__", ASM),
+};
+
+/* Shift amounts for the first, second and last character and the length */
+struct KeywordHash
+{
+    int first;
+    int second;
+    int last;
+    int length;
+};
+
+constexpr unsigned hashKeyword(KeywordHash h, const char *s, int len)
+{
+    return (((unsigned) (unsigned char) s[0] << h.first) +
+            ((unsigned) (unsigned char) s[1] << h.second) +
+            ((unsigned) (unsigned char) s[len - 1] << h.last) +
+            ((unsigned) len << h.length)) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+constexpr bool isPerfectHash(KeywordHash h)
+{
+    bool used[KEYWORD_TABLE_SIZE] = {};
+    for (const Keyword &kw : keywords)
     {
-    case 'a':
-        if (!keyword.compare("auto"))
-            return Token::Tokens::AUTO;
-        break;
-        
-    case 'b':
-        if (!keyword.compare("break"))
-            return Token::Tokens::BREAK;
-        break;
-        
-    case 'c':
-        if (!keyword.compare("char"))
-            return Token::Tokens::CHAR;
-        else if (!keyword.compare("const"))
-            return Token::Tokens::CONST;
-        else if (!keyword.compare("case"))
-            return Token::Tokens::CASE;
-        else if (!keyword.compare("continue"))
-            return Token::Tokens::CONTINUE;
-        break;
-    
-    case 'd':
-        if (!keyword.compare("default"))
-            return Token::Tokens::DEFAULT;
-        else if (!keyword.compare("do"))
-            return Token::Tokens::DO;
-        else if (!keyword.compare("double"))
-            return Token::Tokens::DOUBLE;
-        break;
-        
-    case 'e':
-        if (!keyword.compare("else"))
-            return Token::Tokens::ELSE;
-        else if (!keyword.compare("extern"))
-            return Token::Tokens::EXTERN;
-        else if (!keyword.compare("enum"))
-            return Token::Tokens::ENUM;
-        break;
-
-    case 'f':
-        if (!keyword.compare("for"))
-            return Token::Tokens::FOR;
-        else if (!keyword.compare("float"))
-            return Token::Tokens::FLOAT;
-        break;
-
-    case 'g':
-        if (!keyword.compare("goto"))
-            return Token::Tokens::GOTO;
-        break;
-        
-    case 'i':
-        if (!keyword.compare("int"))
-            return Token::Tokens::INT;
-        else if (!keyword.compare("if"))
-            return Token::Tokens::IF;
-        break;
-
-    case 'l':
-        if (!keyword.compare("long"))
-            return Token::Tokens::LONG;
-        break;
-
-    case 'r':
-        if (!keyword.compare("return"))
-            return Token::Tokens::RETURN;
-        else if (!keyword.compare("register"))
-            return Token::Tokens::REGISTER;
-        break;
-
-    case 's':
-        if (!keyword.compare("short"))
-            return Token::Tokens::SHORT;
-        else if (!keyword.compare("signed"))
-            return Token::Tokens::SIGNED;
-        else if (!keyword.compare("struct"))
-            return Token::Tokens::STRUCT;
-        else if (!keyword.compare("static"))
-            return Token::Tokens::STATIC;
-        else if (!keyword.compare("sizeof"))
-            return Token::Tokens::SIZEOF;
-        else if (!keyword.compare("switch"))
-            return Token::Tokens::SWITCH;
-        break;
-
-    case 't':
-        if (!keyword.compare("typedef"))
-            return Token::Tokens::TYPEDEF;
-
-    case 'u':
-        if (!keyword.compare("unsigned"))
-            return Token::Tokens::UNSIGNED;
-
-        else if (!keyword.compare("union"))
-            return Token::Tokens::UNION;
-        break;
-
-    case 'v':
-        if (!keyword.compare("void"))
-            return Token::Tokens::VOID;
-        else if (!keyword.compare("volatile"))
-            return Token::Tokens::VOLATILE;
-        break;
-
-    case 'w':
-        if (!keyword.compare("while"))
-            return Token::Tokens::WHILE;
-    case '_':
-        if (!keyword.compare("__restrict"))
-            return Token::Tokens::RESTRICT;
-        else if (!keyword.compare("__attribute__"))
-            return Token::Tokens::ATTRIBUTE;
-        else if (!keyword.compare("__asm__"))
-            return Token::Tokens::ASM;
+        unsigned slot = hashKeyword(h, kw.name, kw.len);
+        if (used[slot])
+            return false;
+        used[slot] = true;
     }
-    return 0;
+    return true;
+}
+
+constexpr KeywordHash findPerfectHash()
+{
+    for (int a = 0; a < 6; a++)
+        for (int b = 0; b < 6; b++)
+            for (int c = 0; c < 6; c++)
+                for (int d = 0; d < 6; d++)
+                    if (isPerfectHash({a, b, c, d}))
+                        return {a, b, c, d};
+
+    return {-1, -1, -1, -1};
+}
+
+constexpr KeywordHash keywordHash = findPerfectHash();
+static_assert(keywordHash.first != -1, "No perfect hash for the keyword table");
+
+static_assert(SIZE(keywords) < 128, "Keyword index must fit a signed char");
+
+/* Maps a hash slot to an index in keywords[] (-1 if the slot is empty) */
+struct KeywordTable
+{
+    signed char slots[KEYWORD_TABLE_SIZE];
+};
+
+constexpr KeywordTable buildKeywordTable()
+{
+    KeywordTable table = {};
+    for (int i = 0; i < KEYWORD_TABLE_SIZE; i++)
+        table.slots[i] = -1;
+
+    for (int i = 0; i < (int) (SIZE(keywords)); i++)
+        table.slots[hashKeyword(keywordHash, keywords[i].name,
+                                keywords[i].len)] = i;
+
+    return table;
+}
+
+constexpr KeywordTable keywordTable = buildKeywordTable();
+
+} // namespace
+
+/// @brief  Returns the keyword token of the identifier, 0 if it isn't one
+int identifyKeyword(const char *ident, int len)
+{
+    if (len < KEYWORD_MIN_LENGTH || len > KEYWORD_MAX_LENGTH)
+        return 0;
+
+    int idx = keywordTable.slots[hashKeyword(keywordHash, ident, len)];
+    if (idx < 0)
+        return 0;
+
+    const Keyword &kw = keywords[idx];
+    if (kw.len != len || memcmp(kw.name, ident, len))
+        return 0;
+
+    return kw.token;
 }
@@ -1,3 +1,4 @@
+#include <context.h>
 #include <symbols.h>
 #include <scanner.h>
 #include <core.h>
@@ -87,7 +88,7 @@ int Scanner::scanIdentifier(int c)
             return i;
         }
     }
-    err.syntaxError("identifier too long");
+    m_ctx.errors.syntaxError("identifier too long");
 }
 
 int Scanner::scanChar()
@@ -95,12 +96,12 @@ int Scanner::scanChar()
     int c = next();
     c = charParser(c);
     if (next() != '\'')
-        err.fatal("Expected end of character literal");
+        m_ctx.errors.fatal("Expected end of character literal");
 
     return c;
 }
 
-int Scanner::scanStringLiteral()
+int64_t Scanner::scanStringLiteral()
 {
     int c = 0;
     string end = "";
@@ -108,14 +109,14 @@ int Scanner::scanStringLiteral()
     while ((c = next()) != '"')
     {
         if (c == EOF)
-            err.fatal("Read end of file before string was terminated");
+            m_ctx.errors.fatal("Read end of file before string was terminated");
         
         c = charParser(c);
         
         end += c;
     }
 
-    return g_symtable.addString(end);
+    return m_ctx.symtable.addString(end);
 }
 
 /// @brief  The actual scan function, will scan the input stream for tokens
@@ -338,7 +339,7 @@ int Scanner::scan()
             int line = m_line;
             scanIdentifier(c);
             
-            int token = identifyKeyword(m_identBuf);
+            int token = identifyKeyword(m_identBuf.data(), m_identBuf.size());
             if (token)
             {
                 m_token.set(token, line, col);
@@ -353,15 +354,17 @@ int Scanner::scan()
             }
 
             /* unrecognized keyword, must be identifier */
+            m_identAtom = m_ctx.atoms.intern(m_identBuf);
             m_token.set(Token::Tokens::IDENTIFIER, line, col);
             break;
         }
 
-        err.fatal("Unrecognized character '" + string(1, (char)c) + "'");
+        m_ctx.errors.fatal("Unrecognized character '" + string(1, (char)c) +
+                           "'");
     }
     
-    //err.loadErrorInfo(err.createErrorInfo());
-    //err.unloadErrorInfo();
+    //m_ctx.errors.loadErrorInfo(m_ctx.errors.createErrorInfo());
+    //m_ctx.errors.unloadErrorInfo();
     
     return 1;
 }
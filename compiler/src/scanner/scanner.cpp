@@ -1,26 +1,89 @@
+#include <context.h>
 #include <core.h>
 #include <errorhandler.h>
 #include <scanner.h>
 #include <symbols.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 /// @brief   Opens the given file, if it can't it will throw an error
-Scanner::Scanner(const char *filename)
+Scanner::Scanner(CompilationContext &ctx, const char *filename) : m_ctx(ctx)
 {
-    m_infile = fopen(filename, "r");
     m_filename = filename;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd == -1)
+        m_ctx.errors.fatalNL("Unable to open '" + string(filename) + "'");
+
+    loadInput(fd);
+    ::close(fd);
+
+    init();
+}
+
+/// @brief  Scans already preprocessed source that is kept in memory, name is
+///         only used for error messages
+Scanner::Scanner(CompilationContext &ctx, const char *name, string &&source)
+    : m_ctx(ctx)
+{
+    m_filename = name;
+    m_slurped = move(source);
 
-    if (m_infile == NULL)
-        err.fatalNL("Unable to open '" + string(filename) + "'");
+    m_inputMode = InputModes::INPUT_SLURPED;
+    m_buf = m_slurped.data();
+    m_size = m_slurped.size();
 
+    init();
+}
+
+void Scanner::init()
+{
     /* Init ident buffer */
     m_identBuf.reserve(SCANNER_IDENTIFIER_LIMMIT + 1);
     m_putbackToken.set(-1, m_line, m_char);
+
+    m_lineStarts = &m_lineIndex[m_ppFile];
+    markLineStart();
 }
 
-/// @brief  Close the opened file
+/// @brief  Unmap the input file
 Scanner::~Scanner()
 {
-    fclose(m_infile);
+    if (m_inputMode == InputModes::INPUT_MAPPED)
+        munmap((void *) m_buf, m_size);
+}
+
+/// @brief  Makes the whole input resident, regular files get mapped and
+///         everything else (pipes, empty files) gets slurped into memory
+void Scanner::loadInput(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            m_inputMode = InputModes::INPUT_MAPPED;
+            m_buf = (const char *) map;
+            m_size = st.st_size;
+            return;
+        }
+    }
+
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0)
+        m_slurped.append(chunk, n);
+
+    if (n == -1)
+        m_ctx.errors.fatalNL("Unable to read '" + string(m_filename) + "'");
+
+    m_inputMode = InputModes::INPUT_SLURPED;
+    m_buf = m_slurped.data();
+    m_size = m_slurped.size();
 }
 
 int Scanner::curLine()
@@ -43,9 +106,19 @@ string &Scanner::identifier()
     return m_identBuf;
 }
 
+/// @brief  The interned version of identifier()
+Atom Scanner::identAtom()
+{
+    return m_identAtom;
+}
+
+/// @brief  Steps back over the last character read, the line and column
+///         counters are left alone because next() won't count it twice
 void Scanner::putback(int c)
 {
-    m_putback = c;
+    if (c != EOF)
+        m_pos--;
+    m_putback = true;
 }
 
 int Scanner::peek()
@@ -65,16 +138,20 @@ int Scanner::next()
 
     if (m_putback)
     {
-        c = m_putback;
-        m_putback = 0;
-        return c;
+        m_putback = false;
+        return m_pos < m_size ? (unsigned char) m_buf[m_pos++] : EOF;
     }
 
-    c = fgetc(m_infile);
+    if (m_pos < m_size)
+        c = (unsigned char) m_buf[m_pos++];
+    else
+        c = EOF;
+
     if ('\n' == c)
     {
         m_line++;
         m_char = 0;
+        markLineStart();
     }
     else
         m_char++;
@@ -82,6 +159,18 @@ int Scanner::next()
     return c;
 }
 
+/// @brief  Records where the current line starts in the current file
+void Scanner::markLineStart()
+{
+    if (m_line < 0)
+        return;
+
+    if (m_line >= (int) m_lineStarts->size())
+        m_lineStarts->resize(m_line + 1, -1);
+
+    (*m_lineStarts)[m_line] = m_pos;
+}
+
 int Scanner::skipLine()
 {
     int c;
@@ -99,7 +188,7 @@ int Scanner::skipMultiLineComment()
                 return next();
     }
 
-    err.fatal("End of file read before end of multi line comment");
+    m_ctx.errors.fatal("End of file read before end of multi line comment");
 }
 
 /// @brief  Skips over useless whitespace / comments
@@ -159,7 +248,7 @@ vector<int> Scanner::scanUntil(int tok1, int tok2, int tok3)
             return tokens;
     }
 
-    err.fatal("Infinite token scan loop detected");
+    m_ctx.errors.fatal("Infinite token scan loop detected");
 }
 
 int Scanner::charParser(int c)
@@ -192,7 +281,7 @@ int Scanner::parsePPStatement()
     
     if (m_token.token() != Token::Tokens::INTLIT)
     {
-        err.warning("Incorrect preprocessor statement");
+        m_ctx.errors.warning("Incorrect preprocessor statement");
         return skipLine();
     }
 
@@ -201,13 +290,17 @@ int Scanner::parsePPStatement()
     c = skip();
     if (c != '"')
     {
-        err.warning("Incorrect preprocessor statement");
+        m_ctx.errors.warning("Incorrect preprocessor statement");
         return skipLine();
     }
     
     c = skip();
     if (c == '<')
+    {
+        // <built-in> and <command-line> don't have lines of their own
+        m_lineStarts = &m_lineIndex["<>"];
         return skipLine();
+    }
     
     string buf = "";
     while (c != '"')
@@ -217,6 +310,7 @@ int Scanner::parsePPStatement()
     }
     
     m_ppFile = buf;
+    m_lineStarts = &m_lineIndex[m_ppFile];
     
     return skipLine();
 }
@@ -228,53 +322,53 @@ string Scanner::curPPFile()
 
 string Scanner::curFunction()
 {
-    if (g_symtable.currentFuncIdx() == -1)
+    SymbolId func = m_ctx.symtable.currentFuncIdx();
+    if (func == NOSYMBOL)
         return "";
-    return g_symtable.getSymbol(g_symtable.currentFuncIdx())->name;
+    return m_ctx.atoms.str(m_ctx.symtable.getSymbol(func)->name);
 }
 
-string Scanner::curStrLine(int loc)
+/// @brief  Returns the text of a line of any input file, the line start index
+///         makes this a lookup instead of a rescan of the input
+string Scanner::getLine(const string &file, int line)
 {
-    unsigned long pos = ftell(m_infile);
-    
-    string str = "";
-    fseek(m_infile, loc, SEEK_SET);
-    int c = fgetc(m_infile);
-    while (c != '\n')
-    {
-        str += c;
-        c = fgetc(m_infile);
-    }
-        
-    fseek(m_infile, pos, SEEK_SET);
-    
-    return str;
+    auto lines = m_lineIndex.find(file);
+    if (lines == m_lineIndex.end() || line < 0 ||
+        line >= (int) lines->second.size() || lines->second[line] == -1)
+        return "";
+
+    const char *start = m_buf + lines->second[line];
+    const char *end = (const char *) memchr(start, '\n', m_buf + m_size - start);
+    if (!end)
+        end = m_buf + m_size;
+
+    return string(start, end - start);
 }
 
+/// @brief  The offset of the next unread character, a character that was
+///         put back still counts as read
 int Scanner::curOffset()
 {
-    return ftell(m_infile);
+    if (m_putback && m_pos < m_size)
+        return m_pos + 1;
+    return m_pos;
 }
 
 string Scanner::getStrFromTo(int from, int to)
 {
-    unsigned long pos = ftell(m_infile);
-    
-    string str = "";
-    fseek(m_infile, from, SEEK_SET);
-    
-    for (int i = from; i <= to; i++)
-    {
-        str += fgetc(m_infile);
-    }
-    
-    fseek(m_infile, pos, SEEK_SET);
-    
-    return str;
+    if (from < 0)
+        from = 0;
+    if (to >= (int) m_size)
+        to = m_size - 1;
+    if (from > to)
+        return "";
+
+    return string(m_buf + from, to - from + 1);
 }
 
 
 void Scanner::setIdentifier(string s)
 {
     m_identBuf = s;
+    m_identAtom = m_ctx.atoms.intern(s);
 }
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include <context.h>
+#include <errorhandler.h>
+#include <server.h>
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+
+#define SERVER_MAGIC "SCC1"
+
+/* Reads and writes the fields of the protocol, ok() is false once the
+ * connection broke or the data is malformed (or too large) */
+class Connection
+{
+  private:
+    int  m_fd;
+    bool m_ok = true;
+
+  public:
+    Connection(int fd) : m_fd(fd) {}
+    ~Connection() { ::close(m_fd); }
+
+    bool ok() { return m_ok; }
+
+    void readBytes(void *buf, size_t size)
+    {
+        for (size_t done = 0; m_ok && done < size;)
+        {
+            ssize_t n = ::read(m_fd, (char *) buf + done, size - done);
+            if (n <= 0)
+                m_ok = false;
+            else
+                done += n;
+        }
+    }
+
+    void writeBytes(const void *buf, size_t size)
+    {
+        for (size_t done = 0; m_ok && done < size;)
+        {
+            ssize_t n = ::send(m_fd, (const char *) buf + done, size - done,
+                               MSG_NOSIGNAL);
+            if (n <= 0)
+                m_ok = false;
+            else
+                done += n;
+        }
+    }
+
+    uint32_t readU32()
+    {
+        uint32_t v = 0;
+        readBytes(&v, 4);
+        return v;
+    }
+
+    /// @brief  The string grows with the data that arrives, so a length
+    ///         alone can't make us allocate much
+    string readString()
+    {
+        uint32_t size = readU32();
+        if (size > SERVER_MAX_STRING)
+            m_ok = false;
+
+        string s;
+        while (m_ok && s.size() < size)
+        {
+            size_t done = s.size();
+            s.resize(done + min<size_t>(size - done, SERVER_READ_CHUNK));
+            readBytes(&s[done], s.size() - done);
+        }
+
+        return m_ok ? s : "";
+    }
+
+    vector<string> readStrings()
+    {
+        uint32_t count = readU32();
+        if (count > SERVER_MAX_STRINGS)
+            m_ok = false;
+
+        vector<string> list;
+        while (m_ok && list.size() < count)
+            list.push_back(readString());
+
+        return m_ok ? list : vector<string>();
+    }
+
+    void writeU32(uint32_t v) { writeBytes(&v, 4); }
+
+    void writeString(const string &s)
+    {
+        writeU32(s.size());
+        writeBytes(s.data(), s.size());
+    }
+
+    void writeStrings(const vector<string> &list)
+    {
+        writeU32(list.size());
+        for (const string &s : list)
+            writeString(s);
+    }
+};
+
+static sockaddr_un socketAddress(const string &path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family  = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        g_err.fatalNL("Socket path " + HL(path) + " is too long");
+
+    strcpy(addr.sun_path, path.c_str());
+    return addr;
+}
+
+static void handleRequest(Connection &conn, FileCache &cache,
+                          const string &cacheDir)
+{
+    char magic[4];
+    conn.readBytes(magic, 4);
+    if (!conn.ok() || memcmp(magic, SERVER_MAGIC, 4))
+        return;
+
+    CompileOptions options;
+    uint32_t       flags   = conn.readU32();
+    string         path    = conn.readString();
+    string         source  = conn.readString();
+    options.includeDirs    = conn.readStrings();
+    options.defines        = conn.readStrings();
+    if (!conn.ok())
+        return;
+
+    options.assembly           = flags & SERVER_ASSEMBLY;
+    options.warningAsError     = flags & SERVER_WERROR;
+    options.conversionWarnings = flags & SERVER_WCONVERSION;
+    options.noMemoryChecking   = flags & SERVER_NO_MEM_CHECK;
+    options.optimize           = (flags >> SERVER_OPTIMIZE_SHIFT) & 0xff;
+    options.fileCache          = &cache;
+    options.cacheDir           = cacheDir;
+
+    CompileResult result = compile(source, path, options);
+    conn.writeU32(result.success);
+    conn.writeString(result.output);
+    conn.writeString(result.diagnostics);
+}
+
+static void serve(int fd, FileCache &cache, const string &cacheDir)
+{
+    Connection conn(fd);
+
+    // Whatever goes wrong with a request only ends its own connection
+    try
+    {
+        handleRequest(conn, cache, cacheDir);
+    }
+    catch (const exception &)
+    {
+    }
+}
+
+/* Connections accepted for the workers. A connection is only accepted
+ * while a worker is idle, the others wait in the listen backlog. */
+struct ServerQueue
+{
+    mutex              lock;
+    condition_variable changed;
+    deque<int>         clients;
+    int                idle     = 0;
+    bool               stopping = false;
+};
+
+/// @brief  Accepts requests until SIGINT or SIGTERM, they are handled by jobs
+///         worker threads. The requests that are being compiled are finished
+///         before it returns.
+void runServer(const string &socketPath, const string &cacheDir, int jobs)
+{
+    sockaddr_un addr = socketAddress(socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        g_err.fatalNL("Could not create the server socket");
+
+    unlink(socketPath.c_str());
+    if (bind(fd, (sockaddr *) &addr, sizeof(addr)) || listen(fd, 64))
+        g_err.fatalNL("Could not listen on " + HL(socketPath) + ": " +
+                      strerror(errno));
+
+    // The workers inherit the blocked signals, they are only read here
+    sigset_t stop, old;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, &old);
+    int signals = signalfd(-1, &stop, SFD_CLOEXEC);
+
+    static FileCache cache;
+    ServerQueue      queue;
+
+    auto worker = [&]() {
+        unique_lock<mutex> lock(queue.lock);
+        while (true)
+        {
+            queue.idle++;
+            queue.changed.notify_all();
+            queue.changed.wait(lock, [&]() {
+                return queue.clients.size() || queue.stopping;
+            });
+            queue.idle--;
+
+            // Connections that were accepted already are still served
+            if (queue.clients.empty())
+                return;
+
+            int client = queue.clients.front();
+            queue.clients.pop_front();
+
+            lock.unlock();
+            serve(client, cache, cacheDir);
+            lock.lock();
+        }
+    };
+
+    vector<thread> threads;
+    for (int i = 0; i < jobs; i++)
+        threads.emplace_back(worker);
+
+    string failure;
+    while (failure.empty())
+    {
+        {
+            unique_lock<mutex> lock(queue.lock);
+            queue.changed.wait(lock, [&]() {
+                return queue.idle > (int) queue.clients.size();
+            });
+        }
+
+        pollfd fds[2] = {{fd, POLLIN, 0}, {signals, POLLIN, 0}};
+        if (poll(fds, 2, -1) == -1)
+        {
+            if (errno != EINTR)
+                failure = strerror(errno);
+            continue;
+        }
+
+        if (fds[1].revents)
+            break;
+
+        int client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client == -1)
+        {
+            if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN)
+                failure = strerror(errno);
+            continue;
+        }
+
+        lock_guard<mutex> guard(queue.lock);
+        queue.clients.push_back(client);
+        queue.changed.notify_all();
+    }
+
+    {
+        lock_guard<mutex> guard(queue.lock);
+        queue.stopping = true;
+        queue.changed.notify_all();
+    }
+
+    for (thread &t : threads)
+        t.join();
+
+    ::close(signals);
+    ::close(fd);
+    unlink(socketPath.c_str());
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (failure.size())
+        g_err.fatalNL("Server socket failed: " + failure);
+}
+
+/// @brief  Has a running server compile the file
+CompileResult compileRemote(const string &socketPath, const string &path,
+                            const CompileOptions &options)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+        g_err.fatalNL("Unable to open '" + path + "'");
+
+    stringstream source;
+    source << file.rdbuf();
+
+    sockaddr_un addr = socketAddress(socketPath);
+    int         fd   = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1 || connect(fd, (sockaddr *) &addr, sizeof(addr)))
+    {
+        if (fd != -1)
+            ::close(fd);
+        g_err.fatalNL("Could not connect to the compile server at " +
+                      HL(socketPath));
+    }
+
+    Connection conn(fd);
+
+    // Headers are looked up relative to the file, the server needs the full
+    // path for that
+    char  *real     = realpath(path.c_str(), NULL);
+    string fullPath = real ? real : path;
+    free(real);
+
+    uint32_t flags = (options.assembly ? SERVER_ASSEMBLY : 0) |
+                     (options.warningAsError ? SERVER_WERROR : 0) |
+                     (options.conversionWarnings ? SERVER_WCONVERSION : 0) |
+                     (options.noMemoryChecking ? SERVER_NO_MEM_CHECK : 0) |
+                     (min(options.optimize, 0xff) << SERVER_OPTIMIZE_SHIFT);
+
+    conn.writeBytes(SERVER_MAGIC, 4);
+    conn.writeU32(flags);
+    conn.writeString(fullPath);
+    conn.writeString(source.str());
+    conn.writeStrings(options.includeDirs);
+    conn.writeStrings(options.defines);
+
+    CompileResult result;
+    result.success     = conn.readU32();
+    result.output      = conn.readString();
+    result.diagnostics = conn.readString();
+
+    if (!conn.ok())
+        g_err.fatalNL("Lost the connection to the compile server at " +
+                      HL(socketPath));
+
+    return result;
+}
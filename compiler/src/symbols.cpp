@@ -1,10 +1,9 @@
+#include <context.h>
 #include <errorhandler.h>
+#include <pch.h>
 #include <symbols.h>
 #include <types.h>
 
-/* Global symbol table */
-SymbolTable g_symtable = SymbolTable();
-
 Scope *SymbolTable::_createScope()
 {
     Scope *scope = new Scope(m_allScopes.size());
@@ -12,7 +11,39 @@ Scope *SymbolTable::_createScope()
     return scope;
 }
 
-SymbolTable::SymbolTable()
+/// @brief  Adds the symbol to the scope, the first symbol with a given name
+///         keeps the name (same as the old linear search did)
+void Scope::add(SymbolId id, Atom name)
+{
+    push_back(id);
+    m_lookup.emplace(name, id);
+}
+
+/// @brief  Returns the symbol called name or NOSYMBOL
+SymbolId Scope::find(Atom name)
+{
+    auto it = m_lookup.find(name);
+    if (it == m_lookup.end())
+        return NOSYMBOL;
+
+    return it->second;
+}
+
+void Scope::rename(SymbolId id, Atom oldName, Atom newName)
+{
+    auto it = m_lookup.find(oldName);
+    if (it != m_lookup.end() && it->second == id)
+        m_lookup.erase(it);
+
+    // Older symbols win, like they would when searching front to back
+    it = m_lookup.find(newName);
+    if (it == m_lookup.end())
+        m_lookup.emplace(newName, id);
+    else if (it->second > id)
+        it->second = id;
+}
+
+SymbolTable::SymbolTable(CompilationContext &ctx) : m_ctx(ctx)
 {
     /* The global symbol table is the first scope */
     newScope();
@@ -20,7 +51,7 @@ SymbolTable::SymbolTable()
 
 SymbolTable::~SymbolTable()
 {
-    for (Scope *scope : m_scopeList)
+    for (Scope *scope : m_allScopes)
         delete scope;
 }
 
@@ -36,10 +67,11 @@ int SymbolTable::popScope(bool semantics, bool functionEnd)
     Scope *scope = m_scopeList.back();
     if (semantics)
     {
-        for (Symbol s : *scope)
+        for (SymbolId id : *scope)
         {
+            Symbol &s = m_symbols[id];
             if (s.varType.memSpot)
-                s.varType.memSpot->setName(s.name);
+                s.varType.memSpot->setName(m_ctx.atoms.str(s.name));
         }
         
         bool warn = false;
@@ -47,17 +79,19 @@ int SymbolTable::popScope(bool semantics, bool functionEnd)
         // Iterate backwards to remove the last allocated memory first
         for (auto i = scope->rbegin(); i != scope->rend(); ++i)
         {
-            if ((*i).varType.memSpot)
+            Symbol &s = m_symbols[*i];
+            if (s.varType.memSpot)
             {
-                if ((*i).varType.memSpot->destroy((*i).name, functionEnd))
+                if (s.varType.memSpot->destroy(s.name, functionEnd))
                     warn = true;
             }
             //delete s.varType.memSpot;
-            (*i).varType.memSpot = NULL;
+            s.varType.memSpot = NULL;
         }
         #endif
-        for (Symbol s : *scope)
+        for (SymbolId id : *scope)
         {
+            Symbol &s = m_symbols[id];
             if (s.varType.memSpot)
                 s.varType.memSpot->destroy(s.varType.memSpot->name(), functionEnd);
                 
@@ -65,61 +99,68 @@ int SymbolTable::popScope(bool semantics, bool functionEnd)
         
         if (warn && functionEnd)
         {
-            string fname = getSymbol(m_currentFunctionIndex)->name;
-            err.notice("At the end of function '" + HL(fname) + "'");
+            string fname =
+                m_ctx.atoms.str(getSymbol(m_currentFunctionIndex)->name);
+            m_ctx.errors.notice("At the end of function '" + HL(fname) + "'");
         }
     }
 
+    // Nothing refers to the function's memory spots anymore
+    if (functionEnd)
+        m_ctx.memTable.endFunction();
+
     m_scopeList.pop_back();
     return scope->index();
 }
 
-int SymbolTable::findSymbol(string sym)
+SymbolId SymbolTable::findSymbol(Atom sym)
 {
-    /* @todo this is a hack man wth */
     for (int table = m_scopeList.size() - 1; table >= 0; table--)
     {
-        int i = 0;
-        /* @todo: is this even remotely efficient? */
-        for (Symbol s : *m_scopeList[table])
-        {
-            if (s.name[0] == sym[0] && !s.name.compare(sym))
-                return (i << 8) | (char)table;
-            i++;
-        }
+        SymbolId id = m_scopeList[table]->find(sym);
+        if (id != NOSYMBOL)
+            return id;
     }
 
-    return -1;
+    return NOSYMBOL;
 }
 
-int SymbolTable::findInCurrentScope(string sym)
+SymbolId SymbolTable::findInCurrentScope(Atom sym)
 {
-    int i = 0;
-    /* @todo: is this even remotely efficient? */
-    for (Symbol s : *m_scopeList.back())
-    {
-        if (s.name[0] == sym[0] && !s.name.compare(sym))
-            return (i << 8) | (char)(m_scopeList.size() - 1);
-        i++;
-    }
+    return m_scopeList.back()->find(sym);
+}
 
-    return -1;
+Symbol *SymbolTable::getSymbol(SymbolId sym)
+{
+    return &m_symbols[sym];
 }
 
-Symbol *SymbolTable::getSymbol(int sym)
+/// @brief  Symbols must be renamed through here to keep the scope's name
+///         lookup up to date
+void SymbolTable::renameSymbol(SymbolId sym, Atom name)
 {
-    /* @todo: this really can't be good */
-    return &(*m_scopeList[sym & 0xFF])[sym >> 8];
+    Symbol &s = m_symbols[sym];
+    m_allScopes[s.scope]->rename(sym, s.name, name);
+    s.name = name;
+}
+
+/// @brief  Moves the symbol into the arena and adds it to the given scope
+SymbolId SymbolTable::newSymbol(Symbol &sym, Scope *scope)
+{
+    SymbolId id = m_symbols.size();
+    sym.scope   = scope->index();
+    m_symbols.push_back(sym);
+    scope->add(id, sym.name);
+    return id;
 }
 
-int SymbolTable::_addVariable(Symbol sym)
+SymbolId SymbolTable::_addVariable(Symbol sym)
 {
     if (isCurrentScopeGlobal())
     {
         if (sym.storageClass == StorageClass::AUTO)
             sym.storageClass = StorageClass::STATIC;
-        m_scopeList[0]->push_back(sym);
-        return ((m_scopeList[0]->size() - 1) << 8) | 0;
+        return newSymbol(sym, m_scopeList[0]);
     }
 
     int varSize = getTypeSize(sym);
@@ -127,7 +168,6 @@ int SymbolTable::_addVariable(Symbol sym)
     if (sym.storageClass == StorageClass::STATIC)
     {
         sym.stackLoc = m_staticVariableOffset;
-        m_staticVariables.push_back(sym);
         m_staticVariableOffset += varSize;
     }
 
@@ -165,26 +205,25 @@ int SymbolTable::_addVariable(Symbol sym)
             func->localVarAmount += INT_SIZE;
     }
 
-    m_scopeList.back()->push_back(sym);
-    return ((m_scopeList.back()->size() - 1) << 8) | (m_scopeList.size() - 1);
+    SymbolId id = newSymbol(sym, m_scopeList.back());
+    if (sym.storageClass == StorageClass::STATIC)
+        m_staticVariables.push_back(id);
+
+    return id;
 }
 
-int SymbolTable::addToFunction(Symbol s)
+SymbolId SymbolTable::addToFunction(Symbol s)
 {
-    if (m_currentFunctionIndex != -1)
-    {
-        m_scopeList[1]->push_back(s);
-        return ((m_scopeList[1]->size() - 1) << 8) | 1;
-    }
+    if (m_currentFunctionIndex != NOSYMBOL)
+        return newSymbol(s, m_scopeList[1]);
 
-    return -1;
+    return NOSYMBOL;
 }
 
-Symbol SymbolTable::createSymbol(string sym, int val, int symType,
+Symbol SymbolTable::createSymbol(Atom sym, int val, int symType,
                                         Type varType, int storageClass)
 {
-    Symbol newsym;
-    memset(&newsym, 0, sizeof(Symbol));
+    Symbol newsym = Symbol();
 
     newsym.name           = sym;
     newsym.value          = val;
@@ -201,31 +240,30 @@ Symbol SymbolTable::createSymbol(string sym, int val, int symType,
     return newsym;
 }
 
-int SymbolTable::addSymbol(string sym, int val, int symType,
+SymbolId SymbolTable::addSymbol(Atom sym, int val, int symType,
                            Type varType, int storageClass)
 {
     return _addVariable(createSymbol(sym, val, symType, varType, storageClass));
 }
 
-int SymbolTable::addSymbol(string sym, int val, int symType, int varType)
+SymbolId SymbolTable::addSymbol(Atom sym, int val, int symType, int varType)
 {
     return addSymbol(sym, val, symType, NULLTYPE, StorageClass::AUTO);
 }
 
-int SymbolTable::addSymbol(string sym, int val, int symType, int varType,
+SymbolId SymbolTable::addSymbol(Atom sym, int val, int symType, int varType,
                            int sc)
 {
-    Type t;
-    memset(&t, 0, sizeof(Type));
+    Type t = Type();
     return addSymbol(sym, val, symType, t, sc);
 }
 
-vector<Symbol> SymbolTable::getGlobalTable()
+Scope &SymbolTable::getGlobalTable()
 {
     return *m_scopeList[0];
 }
 
-int SymbolTable::pushSymbol(Symbol s)
+SymbolId SymbolTable::pushSymbol(Symbol s)
 {
     return _addVariable(s);
 }
@@ -238,21 +276,20 @@ bool SymbolTable::isCurrentScopeGlobal()
     return false;
 }
 
-void SymbolTable::changeCurFunc(int func)
+void SymbolTable::changeCurFunc(SymbolId func)
 {
     m_currentFunctionIndex = func;
 }
 
-int SymbolTable::currentFuncIdx()
+SymbolId SymbolTable::currentFuncIdx()
 {
     return m_currentFunctionIndex;
 }
 
-int SymbolTable::addString(string str)
+SymbolId SymbolTable::addString(string str)
 {
-    Symbol s;
-    memset(&s, 0, sizeof(Symbol));
-    s.name         = "S" + to_string(m_stringCount++);
+    Symbol s = Symbol();
+    s.name         = m_ctx.atoms.intern("S" + to_string(m_stringCount++));
     s.varType      = STRINGPTR;
     s.symType      = SymTypes::VARIABLE;
     s.storageClass = StorageClass::STATIC;
@@ -264,13 +301,88 @@ int SymbolTable::addString(string str)
     s.value = s.inits.size();
 
     // Strings are added in the global scope
-    m_scopeList[0]->push_back(s);
-
-    return ((m_scopeList[0]->size() - 1) << 8);
+    return newSymbol(s, m_scopeList[0]);
 }
 
 int SymbolTable::pushScopeById(int id)
 {
     m_scopeList.push_back(m_allScopes[id]);
     return id;
-}
\ No newline at end of file
+}
+
+void SymbolTable::saveGlobals(PchWriter &out)
+{
+    out.u32(m_stringCount);
+    out.u32(m_scopeList[0]->size());
+    for (SymbolId id : *m_scopeList[0])
+    {
+        const Symbol &s = m_symbols[id];
+        out.atom(s.name);
+        out.i64(s.value);
+        out.i64(s.used);
+        out.i64(s.defined);
+        out.i64(s.symType);
+        out.u32(s.inits.size());
+        for (const string &init : s.inits)
+            out.str(init);
+
+        out.type(s.varType);
+        out.i64(s.stackLoc);
+        out.i64(s.localVarAmount);
+        out.i64(s.returnLabelId);
+        out.u32(s.arguments.size());
+        for (const Type &t : s.arguments)
+            out.type(t);
+
+        out.i64(s.variableArg);
+        out.i64(s.storageClass);
+        out.u32(s.attributes.size());
+        for (const Attribute &a : s.attributes)
+        {
+            out.i64(a.attribute);
+            out.u32(a.values.size());
+            for (int v : a.values)
+                out.i64(v);
+        }
+    }
+}
+
+/// @brief  Adds the global symbols of a precompiled header, a symbol that
+///         was declared already is kept
+void SymbolTable::restoreGlobals(PchReader &in)
+{
+    m_stringCount = max(m_stringCount, (int) in.u32());
+    for (uint32_t n = in.count(); n && in.ok(); n--)
+    {
+        Symbol s         = Symbol();
+        s.name           = in.atom();
+        s.value          = in.i64();
+        s.used           = in.i64();
+        s.defined        = in.i64();
+        s.symType        = in.i64();
+        s.inits.resize(in.count());
+        for (string &init : s.inits)
+            init = in.str();
+
+        s.varType        = in.type();
+        s.stackLoc       = in.i64();
+        s.localVarAmount = in.i64();
+        s.returnLabelId  = in.i64();
+        s.arguments.resize(in.count());
+        for (Type &t : s.arguments)
+            t = in.type();
+
+        s.variableArg    = in.i64();
+        s.storageClass   = in.i64();
+        for (uint32_t a = in.count(); a && in.ok(); a--)
+        {
+            s.attributes.push_back(Attribute((int) in.i64()));
+            s.attributes.back().values.resize(in.count());
+            for (int &v : s.attributes.back().values)
+                v = in.i64();
+        }
+
+        if (in.ok() && m_scopeList[0]->find(s.name) == NOSYMBOL)
+            newSymbol(s, m_scopeList[0]);
+    }
+}
@@ -1,13 +1,45 @@
 #include <token.h>
 #include <core.h>
 
+static const char *const toknames[] =
+{
+    "EOF (end of file)", 
+    "+ (plus)", "- (minus)", "* (star)", "/ (slash)", "% (percent sign)",
+    "| (bitwise or)", "^ (bitwise xor)", "& (ampersant)", "<< (left shift)", ">> (right shift)",
+    
+    "== (equal to)", "!= (not equal to)", "< (less than)", "> (greater than)", 
+    "<= (less than or equal to)", ">= (greater than or equal to)",
+    "&& (logical and)", "|| (logical or)",
+    "! (logical not)", 
+    
+    "= (equalsign)", 
+    ": (colon)", "? (questionmark)",
+    
+    "++ (increment)", "-- (decrement)", "~ (bitwise negate)",
+
+    "integer literal", "string literal",
+    "identifier",
+    "; (semicolon)", "{ (left brace)", "} (right brace)", 
+    "( (left parenthesis)", ") (right parenthesis)", ", (comma)",
+    "[ (left bracket)", "] (right bracket)", ". (dot)",
+    
+    "void", "char", "short", "int", "long", "double", "float",
+    "unsigned", "signed", "const",
+    "if", "else", "while", "for", "do", "return", 
+    "sizeof",
+    "typedef", "struct", "union", "enum",
+    "auto", "static", "register", "extern",
+    "restrict", "attribute", "asm", "volatile",
+    "goto", "switch", "case", "default",
+    "break", "continue"
+};
 
 int Token::token()
 {
     return m_token;
 }
 
-int Token::intValue()
+int64_t Token::intValue()
 {
     return m_intValue;
 }
@@ -23,7 +55,7 @@ void Token::set(int tok, int line, int col)
     m_token = tok;
 }
 
-void Token::set(int tok, int val, int line, int col)
+void Token::set(int tok, int64_t val, int line, int col)
 {
     m_intValue = val;
     set(tok, line, col);
@@ -32,7 +64,7 @@ void Token::set(int tok, int val, int line, int col)
 
 string tokToStr(int token)
 {
-    return toknames[token] + " (" + to_string(token) + ")";
+    return string(toknames[token]) + " (" + to_string(token) + ")";
 }
 
 int Token::startLine()
@@ -1,31 +1,35 @@
 #include <ast.h>
+#include <context.h>
 #include <core.h>
 #include <errorhandler.h>
+#include <pch.h>
 #include <token.h>
 #include <types.h>
 #include <symbols.h>
 
-TypeList g_typeList = TypeList();
+static const char *const typeNames[] = {"nulltype", "void",  "char",
+                                        "short",    "int",   "long",
+                                        "float",    "double"};
 
 Type g_emptyType = {.primType = 0,
                            .isSigned = false,
                            .size     = 0,
                            .ptrDepth = 0,
-                           .name     = NULL,
+                           .name     = NOATOM,
                            .typeType = 0,
                            .isArray  = false};
 Type g_intType   = {.primType = PrimitiveTypes::INT,
                          .isSigned = true,
                          .size     = INT_SIZE,
                          .ptrDepth = 0,
-                         .name     = NULL,
+                         .name     = NOATOM,
                          .typeType = TypeTypes::VARIABLE,
                          .isArray  = false};
 Type g_strType   = {.primType = PrimitiveTypes::CHAR,
                          .isSigned = true,
                          .size     = PTR_SIZE,
                          .ptrDepth = 1,
-                         .name     = NULL,
+                         .name     = NOATOM,
                          .typeType = TypeTypes::VARIABLE,
                          .isArray  = true};
 
@@ -33,7 +37,7 @@ Type g_defaultType = {.primType = PrimitiveTypes::INT,
                              .isSigned = true,
                              .size     = INT_SIZE,
                              .ptrDepth = 0,
-                             .name     = NULL,
+                             .name     = NOATOM,
                              .typeType = TypeTypes::VARIABLE,
                              .isArray  = false};
 
@@ -41,7 +45,7 @@ Type g_ptrType = {.primType = PrimitiveTypes::INT,
                          .isSigned = true,
                          .size     = PTR_SIZE,
                          .ptrDepth = 0,
-                         .name     = NULL,
+                         .name     = NOATOM,
                          .typeType = TypeTypes::VARIABLE,
                          .isArray  = false};
 
@@ -49,12 +53,12 @@ int g_regSize     = PTR_SIZE;
 int g_defaultSize = INT_SIZE;
 int g_ptrSize     = PTR_SIZE;
 
-string typeString(Type *t)
+string typeString(const Type *t)
 {
     string ret = "";
     if (t->typeType == TypeTypes::STRUCT)
     {
-        ret += "struct " + *t->name;
+        ret += "struct " + g_atoms.str(t->name);
     }
     else
     {
@@ -87,7 +91,7 @@ int typeToSize(int type)
         return DOUBLE_SIZE;
     }
     
-    err.warning("YO WTH? " + to_string(type));
+    g_err.warning("YO WTH? " + to_string(type));
     debughandler(0);
     
     return -1;
@@ -119,7 +123,7 @@ int findType(vector<int> &tokens)
         case Token::Tokens::DOUBLE:
             return PrimitiveTypes::DOUBLE;
         default:
-            err.fatal("Compiler only supports a type at the end of a type state"
+            g_err.fatal("Compiler only supports a type at the end of a type state"
                       "ment (for example 'int signed' should be 'signed int )");
         }
     }
@@ -128,7 +132,7 @@ int findType(vector<int> &tokens)
 Type tokenToType(vector<int> &tokens)
 {
     if (tokens.size() == 0)
-        err.fatal("No type was specified");
+        g_err.fatal("No type was specified");
 
     /* Variables are signed by default */
     bool sign = true;
@@ -160,7 +164,7 @@ static int sameType(Type l, Type r)
     if (l.primType == r.primType)
     {
         if (l.isSigned != r.isSigned)
-            err.conversionWarning(&l, &r);
+            g_err.conversionWarning(&l, &r);
         return 1;
     }
 
@@ -172,25 +176,28 @@ ast_node *typeCompatible(ast_node *left, ast_node *right,
                                 bool onlyright)
 {
     if (!left || !right)
-        err.fatal("Compiler problem, passed invalid ast node to typeCompatible()");
+        g_err.fatal("Compiler problem, passed invalid ast node to typeCompatible()");
     
-    if ((left->type.typeType == TypeTypes::STRUCT &&
-        left->type.typeType != right->type.typeType) ||
-        left->type.typeType == TypeTypes::UNION &&
-        left->type.typeType != right->type.typeType)
-        err.typeConversionError(&left->type, &right->type);
-
-    else if (left->type.typeType == TypeTypes::STRUCT &&
-             !left->type.name->compare(*right->type.name))
+    const Type &ltype = left->type();
+    const Type &rtype = right->type();
+
+    if ((ltype.typeType == TypeTypes::STRUCT &&
+        ltype.typeType != rtype.typeType) ||
+        ltype.typeType == TypeTypes::UNION &&
+        ltype.typeType != rtype.typeType)
+        g_err.typeConversionError(&ltype, &rtype);
+
+    else if (ltype.typeType == TypeTypes::STRUCT &&
+             ltype.name == rtype.name)
         return 0;
-    else if (left->type.typeType == TypeTypes::STRUCT)
-        err.typeConversionError(&left->type, &right->type);
+    else if (ltype.typeType == TypeTypes::STRUCT)
+        g_err.typeConversionError(&ltype, &rtype);
 
     /* Void is never compatible */
-    if (((left->type.primType == PrimitiveTypes::VOID) ||
-         (right->type.primType == PrimitiveTypes::VOID)) &&
-        left->type.typeType == TypeTypes::VARIABLE && !left->type.ptrDepth)
-        err.fatal("Typeerror: void type is not ignored as it ought to be");
+    if (((ltype.primType == PrimitiveTypes::VOID) ||
+         (rtype.primType == PrimitiveTypes::VOID)) &&
+        ltype.typeType == TypeTypes::VARIABLE && !ltype.ptrDepth)
+        g_err.fatal("Typeerror: void type is not ignored as it ought to be");
     
     // NULL can easily fit every type and should never throw a warning
     if (right->operation == AST::Types::INTLIT && right->value == 0)
@@ -198,60 +205,64 @@ ast_node *typeCompatible(ast_node *left, ast_node *right,
     
 
     /* Same type is always compatible */
-    if (left->type.size == right->type.size)
+    if (ltype.size == rtype.size)
     {
 
-        if (!left->type.ptrDepth && right->type.ptrDepth)
+        if (!ltype.ptrDepth && rtype.ptrDepth)
         {
-            err.ptrConversionWarning(&left->type, &right->type);
+            g_err.ptrConversionWarning(&ltype, &rtype);
         }
-        else if (left->type.ptrDepth && !right->type.ptrDepth)
+        else if (ltype.ptrDepth && !rtype.ptrDepth)
         {
-            err.ptrConversionWarning(&right->type, &left->type);
+            g_err.ptrConversionWarning(&rtype, &ltype);
         }
 
-        if (left->type.isSigned != right->type.isSigned)
-            err.conversionWarning(&left->type, &right->type);
+        if (ltype.isSigned != rtype.isSigned)
+            g_err.conversionWarning(&ltype, &rtype);
 
         return 0;
     }
 
     /* Wider on the left, will widen but is compatible */
-    if (left->type.size > right->type.size)
+    if (ltype.size > rtype.size)
     {
-        if (left->type.isSigned != right->type.isSigned)
-            err.conversionWarning(&left->type, &right->type);
+        if (ltype.isSigned != rtype.isSigned)
+            g_err.conversionWarning(&ltype, &rtype);
 
         if (right->operation == AST::Types::INTLIT)
         {
             /* just scale the size up in the type var */
-            right->type.primType = left->type.primType;
-            right->type.size     = left->type.size;
+            Type t     = rtype;
+            t.primType = ltype.primType;
+            t.size     = ltype.size;
+            right->setType(t);
         }
         else
-            return mkAstUnary(AST::WIDEN, right, right->type.size, left->type,
-                              right->line, right->c);
+            return mkAstUnary(AST::WIDEN, right, rtype.size,
+                              left->typeWithSpot(), right->line, right->c);
     }
 
     /* Wider on the right, cannot always widen */
-    else if (right->type.size > left->type.size)
+    else if (rtype.size > ltype.size)
     {
         if (onlyright)
-            err.typeConversionError(&right->type, &left->type);
+            g_err.typeConversionError(&rtype, &ltype);
 
-        if (left->type.isSigned != right->type.isSigned)
-            err.conversionWarning(&left->type, &right->type);
+        if (ltype.isSigned != rtype.isSigned)
+            g_err.conversionWarning(&ltype, &rtype);
 
         if (left->operation == AST::Types::INTLIT)
         {
             /* just scale the size up in the type var */
-            left->type.primType = right->type.primType;
-            left->type.size     = right->type.size;
+            Type t     = ltype;
+            t.primType = rtype.primType;
+            t.size     = rtype.size;
+            left->setType(t);
             return 0;
         }
         else
-            return mkAstUnary(AST::WIDEN, left, left->type.size, right->type,
-                              right->line, right->c);
+            return mkAstUnary(AST::WIDEN, left, ltype.size,
+                              right->typeWithSpot(), right->line, right->c);
     }
 
     /* anything else fits ?*/
@@ -326,7 +337,7 @@ Type guessType(int val, bool issigned)
             ret.size     = CHAR_SIZE;
         }
         else
-            err.fatal("Number is too large to fit in any of the supported type "
+            g_err.fatal("Number is too large to fit in any of the supported type "
                       "sizes");
     }
     else
@@ -348,7 +359,7 @@ Type guessType(int val, bool issigned)
             ret.size     = INT_SIZE;
         }
         else
-            err.fatal("Number is too large to fit in any of the supported type "
+            g_err.fatal("Number is too large to fit in any of the supported type "
                       "sizes");
     }
     return ret;
@@ -365,7 +376,7 @@ void dereference(Type *ptr)
             // @todo: struct sizes
             if (ptr->typeType == TypeTypes::STRUCT)
             {
-                ptr->size = g_typeList.getType(*ptr->name).size;
+                ptr->size = g_typeList.getType(ptr->name).size;
             }
             else
                 ptr->size = typeToSize(ptr->primType);
@@ -379,7 +390,7 @@ int equalType(Type l, Type r)
         l.size == r.size && l.ptrDepth == r.ptrDepth &&
         l.typeType == r.typeType)
     {
-        if (l.typeType == TypeTypes::STRUCT && !l.name->compare(*r.name))
+        if (l.typeType == TypeTypes::STRUCT && l.name == r.name)
             return 1;
         else if (l.typeType == TypeTypes::STRUCT)
             return 0;
@@ -389,48 +400,111 @@ int equalType(Type l, Type r)
     return 0;
 }
 
-Type TypeList::getType(string ident)
+const Type &TypeList::getType(Atom ident)
 {
-    for (Type t : m_namedTypes)
-    {
-        if ((*t.name)[0] == ident[0] && !ident.compare(*t.name))
-            return t;
-    }
+    auto it = m_namedTypes.find(ident);
+    if (it == m_namedTypes.end())
+        return NULLTYPE;
 
-    return NULLTYPE;
+    return it->second;
 }
 
+/// @brief  Adds a named type, the first declaration of a name wins
 void TypeList::addType(Type t)
 {
-    m_namedTypes.push_back(t);
+    m_namedTypes.emplace(t.name, t);
 }
 
-void TypeList::replace(string ident, Type t)
+void TypeList::replace(Atom ident, Type t)
 {
-    for (auto i = m_namedTypes.begin(); i != m_namedTypes.end(); i++)
-    {
-        Type &ref(*i);
+    auto it = m_namedTypes.find(ident);
+    if (it != m_namedTypes.end())
+        it->second = t;
+}
+
+/// @brief  Creates the member list of a new struct or union
+StructDef *TypeList::newStruct()
+{
+    m_structs.emplace_back();
+    return &m_structs.back();
+}
+
+void TypeList::save(PchWriter &out)
+{
+    // Members can point to any struct, so they are all numbered first
+    out.u32(m_structs.size());
+    for (const StructDef &def : m_structs)
+        out.addStruct(&def);
 
-        if ((*ref.name)[0] == ident[0] && !ident.compare(*ref.name))
+    for (const StructDef &def : m_structs)
+    {
+        out.u32(def.items.size());
+        for (const StructItem &item : def.items)
         {
-            ref = t;
-            return;
+            out.type(item.itemType);
+            out.i64(item.offset);
+            out.atom(item.name);
         }
     }
+
+    out.u32(m_namedTypes.size());
+    for (auto &it : m_namedTypes)
+    {
+        out.atom(it.first);
+        out.type(it.second);
+    }
+
+    out.u32(anonStructCount);
+    out.u32(anonEnumCount);
 }
 
-int findStructItem(string item, Type t)
+/// @brief  Adds the types of a precompiled header, types that already exist
+///         are kept
+void TypeList::restore(PchReader &in)
 {
-    int j = 0;
-    for (struct StructItem s : t.contents)
+    vector<StructDef *> defs(in.count());
+    for (StructDef *&def : defs)
     {
-        if (s.name[0] == item[0] && !s.name.compare(item))
-            return j;
+        def = newStruct();
+        in.addStruct(def);
+    }
 
-        j++;
+    for (StructDef *def : defs)
+    {
+        for (uint32_t n = in.count(); n && in.ok(); n--)
+        {
+            StructItem item;
+            item.itemType = in.type();
+            item.offset   = in.i64();
+            item.name     = in.atom();
+            def->add(item);
+        }
     }
 
-    err.unknownStructItem(item, t);
+    for (uint32_t n = in.count(); n && in.ok(); n--)
+    {
+        Atom name = in.atom();
+        m_namedTypes.emplace(name, in.type());
+    }
+
+    anonStructCount = max(anonStructCount, (int) in.u32());
+    anonEnumCount   = max(anonEnumCount, (int) in.u32());
+}
+
+void StructDef::add(const StructItem &item)
+{
+    // Like before, a duplicate member name resolves to the first one
+    index.emplace(item.name, items.size());
+    items.push_back(item);
+}
+
+int findStructItem(Atom item, const Type &t)
+{
+    int idx = t.contents.find(item);
+    if (idx == -1)
+        g_err.unknownStructItem(g_atoms.str(item), t);
+
+    return idx;
 }
 
 int getArraySize(Symbol *arr)
@@ -440,7 +514,7 @@ int getArraySize(Symbol *arr)
     return t.size;
 }
 
-int getTypeSize(Symbol sym)
+int getTypeSize(Symbol &sym)
 {
     int size = sym.varType.size;
     
@@ -451,4 +525,46 @@ int getTypeSize(Symbol sym)
     }
 
     return size;
-}
\ No newline at end of file
+}
+/* Field for field equality, the memory spot is ignored and members are
+   shared so comparing the StructDef pointers is enough */
+static bool sameTypeLayout(const Type &l, const Type &r)
+{
+    return l.primType == r.primType && l.isSigned == r.isSigned &&
+           l.size == r.size && l.ptrDepth == r.ptrDepth &&
+           l.name == r.name && l.typeType == r.typeType &&
+           l.isArray == r.isArray && l.incomplete == r.incomplete &&
+           l.contents == r.contents;
+}
+
+static size_t hashType(const Type &t)
+{
+    size_t h = t.primType;
+    h = h * 31 + t.isSigned;
+    h = h * 31 + t.size;
+    h = h * 31 + t.ptrDepth;
+    h = h * 31 + t.name;
+    h = h * 31 + t.typeType;
+    h = h * 31 + t.isArray;
+    h = h * 31 + t.incomplete;
+    h = h * 31 + (size_t) t.contents.def();
+    return h;
+}
+
+TypeId TypeTable::intern(const Type &t)
+{
+    size_t hash  = hashType(t);
+    auto   range = m_index.equal_range(hash);
+    for (auto i = range.first; i != range.second; i++)
+    {
+        if (sameTypeLayout(m_types[i->second], t))
+            return i->second;
+    }
+
+    TypeId id = m_types.size();
+    m_types.push_back(t);
+    m_types.back().memSpot = NULL;
+
+    m_index.emplace(hash, id);
+    return id;
+}
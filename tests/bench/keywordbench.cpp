@@ -0,0 +1,230 @@
+/*
+ * Micro benchmark for the scanner's keyword recognizer.
+ *
+ * Collects every identifier from the given files (preprocessed sources make
+ * for a realistic, identifier heavy mix) and times how fast the previous
+ * switch based recognizer and the current perfect hash classify them.
+ *
+ * Usage: keywordbench <file.i>...
+ */
+
+#include <core.h>
+#include <scanner.h>
+#include <token.h>
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+/* The recognizer as it was before the perfect hash table */
+static int legacyIdentifyKeyword(string keyword)
+{
+    switch (keyword[0])
+    {
+    case 'a':
+        if (!keyword.compare("auto"))
+            return Token::Tokens::AUTO;
+        break;
+        
+    case 'b':
+        if (!keyword.compare("break"))
+            return Token::Tokens::BREAK;
+        break;
+        
+    case 'c':
+        if (!keyword.compare("char"))
+            return Token::Tokens::CHAR;
+        else if (!keyword.compare("const"))
+            return Token::Tokens::CONST;
+        else if (!keyword.compare("case"))
+            return Token::Tokens::CASE;
+        else if (!keyword.compare("continue"))
+            return Token::Tokens::CONTINUE;
+        break;
+    
+    case 'd':
+        if (!keyword.compare("default"))
+            return Token::Tokens::DEFAULT;
+        else if (!keyword.compare("do"))
+            return Token::Tokens::DO;
+        else if (!keyword.compare("double"))
+            return Token::Tokens::DOUBLE;
+        break;
+        
+    case 'e':
+        if (!keyword.compare("else"))
+            return Token::Tokens::ELSE;
+        else if (!keyword.compare("extern"))
+            return Token::Tokens::EXTERN;
+        else if (!keyword.compare("enum"))
+            return Token::Tokens::ENUM;
+        break;
+
+    case 'f':
+        if (!keyword.compare("for"))
+            return Token::Tokens::FOR;
+        else if (!keyword.compare("float"))
+            return Token::Tokens::FLOAT;
+        break;
+
+    case 'g':
+        if (!keyword.compare("goto"))
+            return Token::Tokens::GOTO;
+        break;
+        
+    case 'i':
+        if (!keyword.compare("int"))
+            return Token::Tokens::INT;
+        else if (!keyword.compare("if"))
+            return Token::Tokens::IF;
+        break;
+
+    case 'l':
+        if (!keyword.compare("long"))
+            return Token::Tokens::LONG;
+        break;
+
+    case 'r':
+        if (!keyword.compare("return"))
+            return Token::Tokens::RETURN;
+        else if (!keyword.compare("register"))
+            return Token::Tokens::REGISTER;
+        break;
+
+    case 's':
+        if (!keyword.compare("short"))
+            return Token::Tokens::SHORT;
+        else if (!keyword.compare("signed"))
+            return Token::Tokens::SIGNED;
+        else if (!keyword.compare("struct"))
+            return Token::Tokens::STRUCT;
+        else if (!keyword.compare("static"))
+            return Token::Tokens::STATIC;
+        else if (!keyword.compare("sizeof"))
+            return Token::Tokens::SIZEOF;
+        else if (!keyword.compare("switch"))
+            return Token::Tokens::SWITCH;
+        break;
+
+    case 't':
+        if (!keyword.compare("typedef"))
+            return Token::Tokens::TYPEDEF;
+
+    case 'u':
+        if (!keyword.compare("unsigned"))
+            return Token::Tokens::UNSIGNED;
+
+        else if (!keyword.compare("union"))
+            return Token::Tokens::UNION;
+        break;
+
+    case 'v':
+        if (!keyword.compare("void"))
+            return Token::Tokens::VOID;
+        else if (!keyword.compare("volatile"))
+            return Token::Tokens::VOLATILE;
+        break;
+
+    case 'w':
+        if (!keyword.compare("while"))
+            return Token::Tokens::WHILE;
+    case '_':
+        if (!keyword.compare("__restrict"))
+            return Token::Tokens::RESTRICT;
+        else if (!keyword.compare("__attribute__"))
+            return Token::Tokens::ATTRIBUTE;
+        else if (!keyword.compare("__asm__"))
+            return Token::Tokens::ASM;
+    }
+    return 0;
+}
+
+static vector<string> collectIdentifiers(const char *path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    string src = ss.str();
+
+    vector<string> idents;
+    for (size_t i = 0; i < src.size();)
+    {
+        if (isalpha(src[i]) || src[i] == '_')
+        {
+            size_t start = i;
+            while (i < src.size() && (isalnum(src[i]) || src[i] == '_'))
+                i++;
+            idents.push_back(src.substr(start, i - start));
+        }
+        else if (isdigit(src[i]))
+        {
+            while (i < src.size() && isalnum(src[i]))
+                i++;
+        }
+        else
+            i++;
+    }
+    return idents;
+}
+
+template <typename F>
+static double timeRun(const vector<string> &idents, int rounds, long &hits, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    hits = 0;
+    for (int r = 0; r < rounds; r++)
+        for (const string &s : idents)
+            hits += f(s) != 0;
+
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    return d.count();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <file>...\n", argv[0]);
+        return 1;
+    }
+
+    vector<string> idents;
+    for (int i = 1; i < argc; i++)
+    {
+        vector<string> v = collectIdentifiers(argv[i]);
+        idents.insert(idents.end(), v.begin(), v.end());
+    }
+
+    if (idents.empty())
+    {
+        fprintf(stderr, "no identifiers found\n");
+        return 1;
+    }
+
+    // Aim for a few million lookups so the timings are meaningful
+    int rounds = 5000000 / idents.size() + 1;
+    long total = (long) rounds * idents.size();
+
+    long oldHits, newHits;
+    double oldTime = timeRun(idents, rounds, oldHits, [](const string &s) {
+        return legacyIdentifyKeyword(s);
+    });
+    double newTime = timeRun(idents, rounds, newHits, [](const string &s) {
+        return identifyKeyword(s.data(), s.size());
+    });
+
+    if (oldHits != newHits)
+    {
+        fprintf(stderr, "recognizers disagree: %ld vs %ld keywords\n",
+                oldHits, newHits);
+        return 1;
+    }
+
+    printf("%zu identifiers (%.1f%% keywords), %ld lookups\n", idents.size(),
+           100.0 * oldHits / total, total);
+    printf("switch:       %7.2f ns/ident  %7.1f M idents/s\n",
+           oldTime * 1e9 / total, total / oldTime / 1e6);
+    printf("perfect hash: %7.2f ns/ident  %7.1f M idents/s\n",
+           newTime * 1e9 / total, total / newTime / 1e6);
+    return 0;
+}
@@ -0,0 +1,40 @@
+int printf(char *, ...);
+
+/* More values are live at once than there are registers, across calls
+ * and divisions, so some of them have to be spilled to the stack */
+
+int f(int x)
+{
+    return x + 1;
+}
+
+int g(int a, int b)
+{
+    return a * 10 + b;
+}
+
+int arr[10];
+
+int main()
+{
+    int a = 3;
+    int b = 4;
+    int c = 10;
+    int d = 20;
+    int *p = arr;
+    int k = 0;
+
+    while (k < 10)
+    {
+        arr[k] = k * k;
+        k++;
+    }
+
+    printf("%i\n", (a + (b + (a * (b + (a - (b * (a + (b + (a * (b + f(a) * f(b))))))))))));
+    printf("%i\n", a * f(b) + b * f(a) + f(a * b) * f(a + b) - f(f(f(a))) * (f(b) + (a + b * (a + b * (a + b * (a + b * f(3)))))));
+    printf("%i\n", c + d * f(c) + (f(d) - c) * (d + f(f(c))));
+    printf("%i\n", arr[3] + arr[a] * arr[b] + p[2] * (arr[f(a)] + (arr[1] * (arr[2] + (arr[3] * (arr[4] + arr[5] * arr[6]))))));
+    printf("%i %i\n", (a * 1000 + b) / (b - a + f(0)) % 7, (a * 1000 + b) % (f(a) + 2) / (a - 1));
+    printf("%i\n", g(g(a, b), g(c / a, d % b)) / (f(a) * f(b) - c) + g(d / f(a), c % f(b)) * (d / (b - a)));
+    printf("%i\n", (a < b) + (b < a) * 2 + (a == 3) * 4 + (f(a) != 4) * 8 + ((a + b) > (b * a)) * 16);
+}
@@ -0,0 +1,54 @@
+// flags: -O1
+int printf(char *, ...);
+
+/* The locals here never have their address taken, so with -O1 they live in
+ * registers and ++ and -- work on those directly */
+
+int count(int n)
+{
+    int steps = 0;
+    while (n--)
+        steps++;
+
+    return steps * 100 + n;
+}
+
+int main()
+{
+    int x = 5;
+    int y;
+    char c = 10;
+    int z;
+    int arr[4] = {1, 2, 3, 4};
+    int i = 0;
+    int total = 0;
+
+    y = x++;
+    printf("x++: %i %i\n", y, x);
+    y = ++x;
+    printf("++x: %i %i\n", y, x);
+    y = x--;
+    printf("x--: %i %i\n", y, x);
+    y = --x;
+    printf("--x: %i %i\n", y, x);
+
+    y = 100 + x++ * 2;
+    printf("100 + x++ * 2: %i %i\n", y, x);
+    y = --x * 3;
+    printf("--x * 3: %i %i\n", y, x);
+    y = 10 - x--;
+    printf("10 - x--: %i %i\n", y, x);
+
+    y = c--;
+    z = c;
+    printf("c--: %i %i\n", y, z);
+    y = ++c;
+    z = c;
+    printf("++c: %i %i\n", y, z);
+
+    while (i < 4)
+        total = total * 10 + arr[i++];
+    printf("arr[i++]: %i %i\n", total, i);
+
+    printf("count: %i %i\n", count(7), count(0));
+}
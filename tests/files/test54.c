@@ -0,0 +1,23 @@
+int printf(char *, ...);
+
+#define STR(x)  #x
+#define XSTR(x) STR(x)
+
+#define HASH_HASH # ## #
+#define NAME      val ## ue
+#define CAT(a, b) a ## b
+#define SUFFIX(a) a ## _x
+
+int value = 42;
+int _x    = 7;
+
+int main()
+{
+    printf("%s\n", XSTR(HASH_HASH));
+    printf("%i\n", NAME);
+    printf("%i\n", CAT(val, ue));
+    printf("%i\n", SUFFIX());
+#line 100 "renamed.c"
+    printf("%i %s\n", __LINE__, __FILE__);
+    return 0;
+}
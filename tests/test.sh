@@ -1,3 +1,4 @@
+flags=$(sed -n 's|^// flags: ||p' "$1" | head -1)
 cd tests
-../safecc $1 -o ../$1-bin
+../safecc $flags $1 -o ../$1-bin
 cd ..